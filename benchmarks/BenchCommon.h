@@ -0,0 +1,107 @@
+#pragma once
+#include "Metrics.h"
+#include "SocketCommon.h"
+#include "SocketTuning.h"
+#include <benchmark/benchmark.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace bench {
+
+/**
+ * @brief Event backends each benchmark runs on, passed as argument "backend" (the EventBackend value)
+ */
+const std::vector<int64_t> BACKENDS = {
+    static_cast<int64_t>(sockets::EventBackend::Select),
+    static_cast<int64_t>(sockets::EventBackend::Epoll),
+    static_cast<int64_t>(sockets::EventBackend::IoUring)
+};
+
+/**
+ * @brief How long to wait for the other end of the loopback connection before failing the benchmark
+ */
+constexpr std::chrono::seconds WAIT_TIMEOUT(5);
+
+/**
+ * @brief Name of an event backend, used as the label of each benchmark run
+ *
+ * @param backend - the event backend
+ * @return const char* - "select", "epoll" or "io_uring"
+ */
+inline const char *backendName(sockets::EventBackend backend) {
+    switch (backend) {
+    case sockets::EventBackend::Select:
+        return "select";
+    case sockets::EventBackend::Epoll:
+        return "epoll";
+    case sockets::EventBackend::IoUring:
+        return "io_uring";
+    }
+    return "unknown";
+}
+
+/**
+ * @brief Socket options selecting the event backend of a benchmark run, which is also set as its label
+ *
+ * @param state - the benchmark state; argument 0 is the backend
+ * @param profile - tuning profile for the socket buffers
+ * @return sockets::SocketOpt - the options
+ */
+inline sockets::SocketOpt options(benchmark::State &state,
+                                  sockets::TuningProfile profile = sockets::TuningProfile::Default) {
+    sockets::SocketOpt opts;
+    sockets::applyProfile(opts, profile);
+    opts.m_eventBackend = static_cast<sockets::EventBackend>(state.range(0));
+    state.SetLabel(backendName(opts.m_eventBackend));
+    return opts;
+}
+
+/**
+ * @brief Get a loopback port for a benchmark run.  Each run gets a new port so connections left in TIME_WAIT by
+ *        the previous run don't get in the way.  The ports are below Linux's ephemeral range (32768-60999), where
+ *        the clients' own ports are allocated.
+ *
+ * @return uint16_t - the port number
+ */
+inline uint16_t nextPort() {
+    static std::atomic<uint16_t> port(21000);
+    return port++;
+}
+
+/**
+ * @brief Wait for a condition set by a socket's event loop, yielding rather than sleeping so the wakeup latency
+ *        isn't added to the measurement
+ *
+ * @param done - predicate returning true once the condition holds
+ * @return true - the condition holds
+ * @return false - timed out
+ */
+template <class Predicate>
+bool waitFor(Predicate done) {
+    auto deadline = std::chrono::steady_clock::now() + WAIT_TIMEOUT;
+    while (!done()) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+/**
+ * @brief Report the 50th, 99th and 99.9th percentiles of a latency histogram as counters in microseconds
+ *
+ * @param state - the benchmark state
+ * @param latency - latencies recorded in nanoseconds
+ */
+inline void reportLatency(benchmark::State &state, const sockets::LatencyHistogram &latency) {
+    constexpr double NS_PER_US = 1000.0;
+    state.counters["p50_us"] = static_cast<double>(latency.percentile(50.0)) / NS_PER_US;
+    state.counters["p99_us"] = static_cast<double>(latency.percentile(99.0)) / NS_PER_US;
+    state.counters["p999_us"] = static_cast<double>(latency.percentile(99.9)) / NS_PER_US;
+}
+
+}  // namespace bench
@@ -0,0 +1,63 @@
+#include "BenchServer.h"
+#include "TcpServer.h"
+#include <atomic>
+
+namespace bench {
+
+struct BenchServer::Impl {
+    Impl(const sockets::SocketOpt &options, Mode mode) : m_options(options), m_mode(mode), m_server(*this, &m_options) {
+    }
+
+    void onClientConnect(const sockets::ClientHandle &) {
+        m_connects++;
+    }
+
+    void onReceiveClientData(const sockets::ClientHandle &client, const char *data, size_t size) {
+        m_bytesReceived += size;
+        if (m_mode == Mode::Echo) {
+            sockets::ClientHandle handle = client;
+            (void)m_server.sendClientMessage(handle, data, size);
+        }
+    }
+
+    void onClientDisconnect(const sockets::ClientHandle &, const sockets::SocketRet &) {
+        m_disconnects++;
+    }
+
+    sockets::SocketOpt m_options;
+    Mode m_mode;
+    std::atomic<uint64_t> m_bytesReceived { 0 };
+    std::atomic<uint64_t> m_connects { 0 };
+    std::atomic<uint64_t> m_disconnects { 0 };
+    sockets::TcpServer<Impl> m_server;
+};
+
+BenchServer::BenchServer(const sockets::SocketOpt &options, Mode mode)
+    : m_impl(std::make_unique<Impl>(options, mode)) {
+}
+
+BenchServer::~BenchServer() {
+    m_impl->m_server.finish();
+}
+
+sockets::SocketRet BenchServer::start(uint16_t port) {
+    return m_impl->m_server.start(port);
+}
+
+sockets::SocketRet BenchServer::sendBcast(const char *msg, size_t size) {
+    return m_impl->m_server.sendBcast(msg, size);
+}
+
+uint64_t BenchServer::bytesReceived() const {
+    return m_impl->m_bytesReceived.load();
+}
+
+uint64_t BenchServer::connects() const {
+    return m_impl->m_connects.load();
+}
+
+uint64_t BenchServer::disconnects() const {
+    return m_impl->m_disconnects.load();
+}
+
+}  // namespace bench
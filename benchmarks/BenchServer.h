@@ -0,0 +1,86 @@
+#pragma once
+#include "SocketCommon.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace bench {
+
+/**
+ * @brief BenchServer is the TcpServer end of the TCP benchmarks.  TcpServer.h and TcpClient.h can't be included
+ *        in the same translation unit, so the server lives in BenchServer.cpp behind this interface.
+ */
+class BenchServer {
+public:
+    /**
+     * @brief What the server does with received data
+     */
+    enum class Mode {
+        /**
+         * @brief Send received data back to the client
+         */
+        Echo,
+
+        /**
+         * @brief Count and discard received data
+         */
+        Sink
+    };
+
+    /**
+     * @brief Construct a new BenchServer object
+     *
+     * @param options - socket options, selecting the event backend
+     * @param mode - what to do with received data
+     */
+    BenchServer(const sockets::SocketOpt &options, Mode mode);
+
+    ~BenchServer();
+
+    BenchServer(const BenchServer &) = delete;
+    BenchServer(BenchServer &&) = delete;
+    BenchServer &operator=(const BenchServer &) = delete;
+    BenchServer &operator=(BenchServer &&) = delete;
+
+    /**
+     * @brief Start listening on a loopback port
+     *
+     * @param port - port to listen on
+     * @return sockets::SocketRet - indication that the server was started
+     */
+    sockets::SocketRet start(uint16_t port);
+
+    /**
+     * @brief Send a message to all connected clients with sendBcast()
+     *
+     * @param msg - pointer to the message data
+     * @param size - length of the message data
+     * @return sockets::SocketRet - indication that the message was sent to all clients
+     */
+    sockets::SocketRet sendBcast(const char *msg, size_t size);
+
+    /**
+     * @brief Get the number of bytes received from all clients
+     */
+    uint64_t bytesReceived() const;
+
+    /**
+     * @brief Get the number of onClientConnect() callbacks
+     */
+    uint64_t connects() const;
+
+    /**
+     * @brief Get the number of onClientDisconnect() callbacks
+     */
+    uint64_t disconnects() const;
+
+private:
+    struct Impl;
+
+    /**
+     * @brief The TcpServer and its callback recipient
+     */
+    std::unique_ptr<Impl> m_impl;
+};
+
+}  // namespace bench
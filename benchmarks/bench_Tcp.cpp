@@ -0,0 +1,220 @@
+#include "BenchCommon.h"
+#include "BenchServer.h"
+#include "TcpClient.h"
+#include <memory>
+#include <string>
+
+namespace {
+
+constexpr const char *LOOPBACK = "127.0.0.1";
+
+/**
+ * @brief Bytes a streaming client may have sent ahead of the server, so the send queue stays bounded
+ */
+constexpr uint64_t STREAM_WINDOW = 4 * 1024 * 1024;
+
+/**
+ * @brief Callback recipient of a benchmark TcpClient, counting received bytes
+ */
+class BenchClient {
+public:
+    BenchClient(const sockets::SocketOpt &options, std::atomic<uint64_t> &received)
+        : m_options(options), m_received(received), m_client(*this, &m_options) {
+    }
+
+    void onReceiveData(const char *, size_t size) {
+        m_received += size;
+    }
+
+    void onDisconnect(const sockets::SocketRet &) {
+    }
+
+    sockets::SocketOpt m_options;
+    std::atomic<uint64_t> &m_received;
+    sockets::TcpClient<BenchClient> m_client;
+};
+
+/**
+ * @brief Start a server for a benchmark run, failing the run if it can't start
+ *
+ * @return uint16_t - the server's port, or 0 on failure
+ */
+uint16_t startServer(benchmark::State &state, bench::BenchServer &server) {
+    uint16_t port = bench::nextPort();
+    auto ret = server.start(port);
+    if (!ret.m_success) {
+        state.SkipWithError(ret.m_msg.c_str());
+        return 0;
+    }
+    return port;
+}
+
+/**
+ * @brief Connect a client for a benchmark run, failing the run if it can't connect
+ */
+bool connectClient(benchmark::State &state, BenchClient &client, uint16_t port) {
+    auto ret = client.m_client.connectTo(LOOPBACK, port);
+    if (!ret.m_success) {
+        state.SkipWithError(ret.m_msg.c_str());
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Round trip of a message from a TcpClient through a TcpServer echoing it back
+ */
+void TcpPingPong(benchmark::State &state) {
+    auto options = bench::options(state);
+    auto size = static_cast<size_t>(state.range(1));
+    bench::BenchServer server(options, bench::BenchServer::Mode::Echo);
+    uint16_t port = startServer(state, server);
+    std::atomic<uint64_t> received(0);
+    BenchClient client(options, received);
+    if (port == 0 || !connectClient(state, client, port)) {
+        return;
+    }
+    std::string msg(size, 'p');
+    sockets::LatencyHistogram latency;
+    uint64_t expected = 0;
+    for (auto _ : state) {
+        auto start = std::chrono::steady_clock::now();
+        (void)client.m_client.sendMsg(msg.data(), size);
+        expected += size;
+        if (!bench::waitFor([&]() { return received.load() >= expected; })) {
+            state.SkipWithError("echo timed out");
+            break;
+        }
+        latency.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count()));
+    }
+    client.m_client.finish();
+    bench::reportLatency(state, latency);
+}
+BENCHMARK(TcpPingPong)
+    ->ArgNames({ "backend", "size" })
+    ->ArgsProduct({ bench::BACKENDS, { 64, 1024, 16384 } })
+    ->UseRealTime();
+
+/**
+ * @brief One-way stream of messages from a TcpClient to a TcpServer
+ */
+void TcpStream(benchmark::State &state) {
+    auto options = bench::options(state, sockets::TuningProfile::Throughput);
+    auto size = static_cast<size_t>(state.range(1));
+    bench::BenchServer server(options, bench::BenchServer::Mode::Sink);
+    uint16_t port = startServer(state, server);
+    std::atomic<uint64_t> received(0);
+    BenchClient client(options, received);
+    if (port == 0 || !connectClient(state, client, port)) {
+        return;
+    }
+    std::string msg(size, 's');
+    uint64_t sent = 0;
+    for (auto _ : state) {
+        if (sent > STREAM_WINDOW &&
+            !bench::waitFor([&]() { return server.bytesReceived() + STREAM_WINDOW >= sent; })) {
+            state.SkipWithError("stream stalled");
+            break;
+        }
+        (void)client.m_client.sendMsg(msg.data(), size);
+        sent += size;
+    }
+    // The run isn't over until the server has it all
+    if (!bench::waitFor([&]() { return server.bytesReceived() >= sent; })) {
+        state.SkipWithError("stream stalled");
+    }
+    client.m_client.finish();
+    state.SetBytesProcessed(static_cast<int64_t>(sent));
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(TcpStream)
+    ->ArgNames({ "backend", "size" })
+    ->ArgsProduct({ bench::BACKENDS, { 64, 1024, 16384, 65536 } })
+    ->UseRealTime();
+
+/**
+ * @brief sendBcast() of a message to a number of TcpClients, each iteration waiting until every client has it
+ */
+void TcpBcastFanOut(benchmark::State &state) {
+    auto options = bench::options(state);
+    auto clients = static_cast<size_t>(state.range(1));
+    constexpr size_t BCAST_SIZE = 256;
+    bench::BenchServer server(options, bench::BenchServer::Mode::Sink);
+    uint16_t port = startServer(state, server);
+    if (port == 0) {
+        return;
+    }
+    std::atomic<uint64_t> received(0);
+    std::vector<std::unique_ptr<BenchClient>> fanOut;
+    for (size_t idx = 0; idx < clients; idx++) {
+        fanOut.push_back(std::make_unique<BenchClient>(options, received));
+        if (!connectClient(state, *fanOut.back(), port)) {
+            return;
+        }
+    }
+    if (!bench::waitFor([&]() { return server.connects() >= clients; })) {
+        state.SkipWithError("clients didn't connect");
+        return;
+    }
+    std::string msg(BCAST_SIZE, 'b');
+    sockets::LatencyHistogram latency;
+    uint64_t expected = 0;
+    for (auto _ : state) {
+        auto start = std::chrono::steady_clock::now();
+        (void)server.sendBcast(msg.data(), msg.size());
+        expected += BCAST_SIZE * clients;
+        if (!bench::waitFor([&]() { return received.load() >= expected; })) {
+            state.SkipWithError("broadcast timed out");
+            break;
+        }
+        latency.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count()));
+    }
+    for (auto &client : fanOut) {
+        client->m_client.finish();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(clients));
+    bench::reportLatency(state, latency);
+}
+BENCHMARK(TcpBcastFanOut)
+    ->ArgNames({ "backend", "clients" })
+    ->ArgsProduct({ bench::BACKENDS, { 1, 4, 16, 64 } })
+    ->UseRealTime();
+
+/**
+ * @brief A TcpClient connecting to a TcpServer and closing the connection again
+ */
+void TcpConnectChurn(benchmark::State &state) {
+    auto options = bench::options(state);
+    bench::BenchServer server(options, bench::BenchServer::Mode::Sink);
+    uint16_t port = startServer(state, server);
+    if (port == 0) {
+        return;
+    }
+    std::atomic<uint64_t> received(0);
+    uint64_t connections = 0;
+    for (auto _ : state) {
+        BenchClient client(options, received);
+        if (!connectClient(state, client, port)) {
+            break;
+        }
+        if (!bench::waitFor([&]() { return server.connects() > connections; })) {
+            state.SkipWithError("connect timed out");
+            break;
+        }
+        client.m_client.finish();
+        connections++;
+        if (!bench::waitFor([&]() { return server.disconnects() >= connections; })) {
+            state.SkipWithError("disconnect timed out");
+            break;
+        }
+    }
+    state.SetItemsProcessed(static_cast<int64_t>(connections));
+}
+BENCHMARK(TcpConnectChurn)
+    ->ArgNames({ "backend" })
+    ->ArgsProduct({ bench::BACKENDS })
+    ->UseRealTime();
+
+}  // namespace
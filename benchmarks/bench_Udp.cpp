@@ -0,0 +1,136 @@
+#include "BenchCommon.h"
+#include "UdpSocket.h"
+#include <string>
+
+namespace {
+
+constexpr const char *LOOPBACK = "127.0.0.1";
+
+constexpr const char *MCAST_GROUP = "239.255.0.42";
+
+/**
+ * @brief Datagrams the sender may have outstanding before waiting for the receiver, so the receive buffer doesn't
+ *        overflow and the run measures delivered datagrams rather than drops.  Each datagram takes up at least
+ *        1 KiB of the receive buffer, whatever its size, and Linux caps the buffer at net.core.rmem_max (by
+ *        default 208 KiB).
+ */
+constexpr uint64_t DATAGRAM_WINDOW = 64;
+
+/**
+ * @brief How long the sender waits for the receiver to catch up before counting the outstanding datagrams as lost
+ */
+constexpr std::chrono::milliseconds LOSS_TIMEOUT(100);
+
+/**
+ * @brief Callback recipient of a benchmark UdpSocket, counting received datagrams
+ */
+class BenchUdp {
+public:
+    explicit BenchUdp(const sockets::SocketOpt &options) : m_options(options), m_socket(*this, &m_options) {
+    }
+
+    void onReceiveData(const char *, size_t) {
+        m_received++;
+    }
+
+    sockets::SocketOpt m_options;
+    std::atomic<uint64_t> m_received { 0 };
+    sockets::UdpSocket<BenchUdp> m_socket;
+};
+
+/**
+ * @brief Wait until at most `allowed` sent datagrams haven't arrived, giving up on them after LOSS_TIMEOUT
+ *
+ * @param receiver - the receiving socket
+ * @param sent - number of datagrams sent
+ * @param allowed - number of datagrams which may still be outstanding
+ * @return uint64_t - number of datagrams given up as lost
+ */
+uint64_t catchUp(const BenchUdp &receiver, uint64_t sent, uint64_t allowed) {
+    auto deadline = std::chrono::steady_clock::now() + LOSS_TIMEOUT;
+    uint64_t received = receiver.m_received.load();
+    while (received + allowed < sent) {
+        if (std::chrono::steady_clock::now() > deadline) {
+            return sent - allowed - received;
+        }
+        std::this_thread::yield();
+        received = receiver.m_received.load();
+    }
+    return 0;
+}
+
+/**
+ * @brief Send datagrams from one socket to another for the benchmark run and report the delivery rate
+ */
+void sendDatagrams(benchmark::State &state, BenchUdp &sender, BenchUdp &receiver, size_t size) {
+    std::string msg(size, 'u');
+    uint64_t sent = 0;
+    uint64_t lost = 0;
+    for (auto _ : state) {
+        if (sent - lost >= DATAGRAM_WINDOW) {
+            lost += catchUp(receiver, sent - lost, DATAGRAM_WINDOW - 1);
+        }
+        (void)sender.m_socket.sendMsg(msg.data(), size);
+        sent++;
+    }
+    lost += catchUp(receiver, sent - lost, 0);
+    auto delivered = static_cast<int64_t>(sent - lost);
+    state.SetItemsProcessed(delivered);
+    state.SetBytesProcessed(delivered * static_cast<int64_t>(size));
+    state.counters["lost"] = static_cast<double>(lost);
+}
+
+/**
+ * @brief Unicast datagrams between two UdpSockets on the loopback interface
+ */
+void UdpUnicast(benchmark::State &state) {
+    auto options = bench::options(state, sockets::TuningProfile::Throughput);
+    auto size = static_cast<size_t>(state.range(1));
+    uint16_t receivePort = bench::nextPort();
+    uint16_t sendPort = bench::nextPort();
+    BenchUdp receiver(options);
+    BenchUdp sender(options);
+    auto ret = receiver.m_socket.startUnicast(receivePort);
+    if (ret.m_success) {
+        ret = sender.m_socket.startUnicast(LOOPBACK, sendPort, receivePort);
+    }
+    if (!ret.m_success) {
+        state.SkipWithError(ret.m_msg.c_str());
+        return;
+    }
+    sendDatagrams(state, sender, receiver, size);
+    sender.m_socket.finish();
+    receiver.m_socket.finish();
+}
+BENCHMARK(UdpUnicast)
+    ->ArgNames({ "backend", "size" })
+    ->ArgsProduct({ bench::BACKENDS, { 64, 1024, 8192 } })
+    ->UseRealTime();
+
+/**
+ * @brief Multicast datagrams looped back to a UdpSocket which joined the group
+ */
+void UdpMulticast(benchmark::State &state) {
+    auto options = bench::options(state, sockets::TuningProfile::Throughput);
+    auto size = static_cast<size_t>(state.range(1));
+    uint16_t port = bench::nextPort();
+    BenchUdp receiver(options);
+    BenchUdp sender(options);
+    auto ret = receiver.m_socket.startMcast(MCAST_GROUP, port, LOOPBACK);
+    if (ret.m_success) {
+        ret = sender.m_socket.startMcast(MCAST_GROUP, port, LOOPBACK);
+    }
+    if (!ret.m_success) {
+        state.SkipWithError(ret.m_msg.c_str());
+        return;
+    }
+    sendDatagrams(state, sender, receiver, size);
+    sender.m_socket.finish();
+    receiver.m_socket.finish();
+}
+BENCHMARK(UdpMulticast)
+    ->ArgNames({ "backend", "size" })
+    ->ArgsProduct({ bench::BACKENDS, { 64, 1024, 8192 } })
+    ->UseRealTime();
+
+}  // namespace
@@ -0,0 +1,17 @@
+#include <benchmark/benchmark.h>
+
+#if !defined(SOCKETS_BENCH_COMMIT)
+#define SOCKETS_BENCH_COMMIT "unknown"
+#endif
+
+int main(int argc, char **argv) {
+    // Recorded in the "context" of the JSON output, so results from different commits can be told apart
+    benchmark::AddCustomContext("sockets_cpp_commit", SOCKETS_BENCH_COMMIT);
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
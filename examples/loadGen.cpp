@@ -0,0 +1,317 @@
+#include "loadGen.h"
+#include <algorithm>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+    #include "getopt.h"
+#else
+    #include <unistd.h>
+#endif
+
+namespace {
+
+/**
+ * @brief Largest UDP payload
+ */
+constexpr size_t MAX_DATAGRAM = 65507;
+
+std::atomic_bool g_stop(false);
+
+void onSignal(int) {
+    g_stop = true;
+}
+
+/**
+ * @brief Payload sizes picked with relative weights
+ */
+struct SizeMix {
+    std::vector<size_t> m_sizes;
+    std::vector<double> m_weights;
+
+    /**
+     * @brief Parse a size mix, e.g. "64" or "64:8,1024:2" for 80% 64 byte and 20% 1 KiB payloads
+     *
+     * @return true - the mix is valid
+     */
+    bool parse(const std::string &spec) {
+        size_t pos = 0;
+        while (pos < spec.size()) {
+            size_t end = spec.find(',', pos);
+            std::string item = spec.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+            size_t colon = item.find(':');
+            try {
+                m_sizes.push_back(std::stoul(item.substr(0, colon)));
+                m_weights.push_back(colon == std::string::npos ? 1.0 : std::stod(item.substr(colon + 1)));
+            } catch (...) {
+                return false;
+            }
+            pos = (end == std::string::npos) ? spec.size() : end + 1;
+        }
+        return !m_sizes.empty();
+    }
+
+    size_t largest() const {
+        size_t largest = 0;
+        for (size_t size : m_sizes) {
+            largest = std::max(largest, size);
+        }
+        return largest;
+    }
+
+    size_t smallest() const {
+        size_t smallest = SIZE_MAX;
+        for (size_t size : m_sizes) {
+            smallest = std::min(smallest, size);
+        }
+        return smallest;
+    }
+};
+
+/**
+ * @brief Send payloads on a set of flows until stopped.  With a rate, sends are spread evenly over time and each
+ *        payload is stamped with the time it was due rather than the time it went out, so a server which stalls
+ *        the sender shows up as latency instead of being hidden by the generator slowing down.  At full speed each
+ *        TCP connection has at most `window` payloads outstanding.
+ *
+ * @param flows - the flows this thread sends on
+ * @param rate - payloads per second for this thread, 0 for full speed
+ * @param mix - payload sizes
+ * @param window - outstanding payloads per TCP connection at full speed
+ * @param seed - seed for picking payload sizes
+ */
+void sendLoop(const std::vector<loadgen::Flow *> &flows, double rate, const SizeMix &mix, uint64_t window,
+              unsigned seed) {
+    std::vector<char> payload(mix.largest(), 'x');
+    std::mt19937 random(seed);
+    std::discrete_distribution<size_t> pick(mix.m_weights.begin(), mix.m_weights.end());
+    auto period = (rate > 0.0) ? std::chrono::duration_cast<loadgen::Clock::duration>(
+                                     std::chrono::duration<double>(1.0 / rate))
+                               : loadgen::Clock::duration::zero();
+    auto due = loadgen::Clock::now();
+    size_t next = 0;
+    while (!g_stop) {
+        loadgen::Flow *flow = flows[next];
+        next = (next + 1) % flows.size();
+        if (rate > 0.0) {
+            due += period;
+            std::this_thread::sleep_until(due);
+        } else if (flow->tracksEchoes() && flow->m_recorder.outstanding() >= window) {
+            if (next == 0) {
+                std::this_thread::yield();
+            }
+            continue;
+        } else {
+            due = loadgen::Clock::now();
+        }
+        size_t size = mix.m_sizes[pick(random)];
+        loadgen::putTimestamp(payload.data(), due);
+        if (flow->send(payload.data(), size).m_success) {
+            flow->m_recorder.sent(size);
+        } else {
+            flow->m_recorder.failed();
+        }
+    }
+}
+
+/**
+ * @brief Print the traffic and latency percentiles of an interval
+ *
+ * @param label - the interval's label
+ * @param interval - the traffic
+ * @param seconds - length of the interval
+ */
+void report(const char *label, const loadgen::Interval &interval, double seconds) {
+    constexpr double MEGA = 1e6;
+    constexpr double NS_PER_US = 1000.0;
+    const sockets::LatencyHistogram &latency = interval.m_latency;
+    std::printf("%8s sent %9.0f msg/s %8.2f MB/s  recv %9.0f msg/s %8.2f MB/s  errors %llu  "
+                "latency us p50 %.1f p99 %.1f p999 %.1f max %.1f\n",
+        label, static_cast<double>(interval.m_sentMsgs) / seconds,
+        static_cast<double>(interval.m_sentBytes) / seconds / MEGA,
+        static_cast<double>(interval.m_recvMsgs) / seconds,
+        static_cast<double>(interval.m_recvBytes) / seconds / MEGA,
+        static_cast<unsigned long long>(interval.m_errors),
+        static_cast<double>(latency.percentile(50.0)) / NS_PER_US,
+        static_cast<double>(latency.percentile(99.0)) / NS_PER_US,
+        static_cast<double>(latency.percentile(99.9)) / NS_PER_US,
+        static_cast<double>(latency.max()) / NS_PER_US);
+    std::fflush(stdout);
+}
+
+bool parseBackend(const std::string &name, sockets::EventBackend &backend) {
+    if (name == "select") {
+        backend = sockets::EventBackend::Select;
+    } else if (name == "epoll") {
+        backend = sockets::EventBackend::Epoll;
+    } else if (name == "io_uring") {
+        backend = sockets::EventBackend::IoUring;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void usage() {
+    std::cout << "LoadGen -a <addr> -p <port> [-c <connections>] [-u -l <localPort>] [-r <msgs/sec>]\n"
+                 "        [-s <size[:weight],...>] [-d <secs>] [-i <secs>] [-t <threads>] [-w <window>]\n"
+                 "        [-b select|epoll|io_uring]\n"
+                 "  -c  TCP connections or UDP flows (default 1)\n"
+                 "  -u  UDP flows from local ports <localPort>.., echoed back to <localPort>\n"
+                 "  -r  total send rate, 0 for full speed (default 0)\n"
+                 "  -s  payload size mix (default 64), e.g. 64:8,1024:2\n"
+                 "  -d  test duration (default 10), -i reporting interval (default 1)\n"
+                 "  -t  sending threads (default 1)\n"
+                 "  -w  outstanding payloads per TCP connection at full speed (default 16)\n";
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+    int arg = 0;
+    const char *addr = "127.0.0.1";
+    uint16_t port = 0;
+    uint16_t localPort = 0;
+    size_t connections = 1;
+    bool udp = false;
+    double rate = 0.0;
+    std::string sizes = "64";
+    int duration = 10;
+    int intervalSecs = 1;
+    size_t threads = 1;
+    uint64_t window = 16;
+    sockets::SocketOpt options;
+    try {
+        while ((arg = getopt(argc, argv, "a:p:c:ul:r:s:d:i:t:w:b:?")) != EOF) {    // NOLINT
+            switch (arg) {
+            case 'a':
+                addr = optarg;
+                break;
+            case 'p':
+                port = static_cast<uint16_t>(std::stoul(optarg));
+                break;
+            case 'c':
+                connections = std::stoul(optarg);
+                break;
+            case 'u':
+                udp = true;
+                break;
+            case 'l':
+                localPort = static_cast<uint16_t>(std::stoul(optarg));
+                break;
+            case 'r':
+                rate = std::stod(optarg);
+                break;
+            case 's':
+                sizes = optarg;
+                break;
+            case 'd':
+                duration = std::stoi(optarg);
+                break;
+            case 'i':
+                intervalSecs = std::stoi(optarg);
+                break;
+            case 't':
+                threads = std::stoul(optarg);
+                break;
+            case 'w':
+                window = std::stoull(optarg);
+                break;
+            case 'b':
+                if (!parseBackend(optarg, options.m_eventBackend)) {
+                    usage();
+                    exit(1);    // NOLINT
+                }
+                break;
+            case '?':
+                usage();
+                exit(1);    // NOLINT
+            }
+        }
+    } catch (...) {
+        usage();
+        exit(1);    // NOLINT
+    }
+    SizeMix mix;
+    if (port == 0 || (udp && localPort == 0) || connections == 0 || threads == 0 || intervalSecs <= 0 ||
+        !mix.parse(sizes)) {
+        usage();
+        exit(1);    // NOLINT
+    }
+    if (mix.smallest() < loadgen::TIMESTAMP_SIZE || (udp && mix.largest() > MAX_DATAGRAM)) {
+        std::cout << "Payload sizes must be at least " << loadgen::TIMESTAMP_SIZE << " bytes"
+                  << (udp ? " and at most 65507 bytes" : "") << "\n";
+        exit(1);    // NOLINT
+    }
+    threads = std::min(threads, connections);
+
+    std::vector<std::unique_ptr<loadgen::Flow>> flows;
+    for (size_t idx = 0; idx < connections; idx++) {
+        flows.push_back(udp ? loadgen::makeUdpFlow(addr, static_cast<uint16_t>(localPort + idx), port, options)
+                            : loadgen::makeTcpFlow(addr, port, options));
+        sockets::SocketRet ret = flows.back()->start();
+        if (!ret.m_success) {
+            std::cout << "Error: " << ret.m_msg << "\n";
+            exit(1);    // NOLINT
+        }
+    }
+    std::cout << "Started " << connections << (udp ? " UDP flows" : " TCP connections") << " to " << addr << ":"
+              << port << "\n";
+
+    (void)std::signal(SIGINT, onSignal);
+    std::vector<std::thread> senders;
+    for (size_t thread = 0; thread < threads; thread++) {
+        std::vector<loadgen::Flow *> owned;
+        for (size_t idx = thread; idx < flows.size(); idx += threads) {
+            owned.push_back(flows[idx].get());
+        }
+        senders.emplace_back(sendLoop, owned, rate / static_cast<double>(threads), mix, window,
+                             static_cast<unsigned>(thread + 1));
+    }
+
+    loadgen::Interval total;
+    auto start = loadgen::Clock::now();
+    auto last = start;
+    auto deadline = start + std::chrono::seconds(duration);
+    auto collect = [&flows, &total]() {
+        loadgen::Interval interval;
+        for (auto &flow : flows) {
+            flow->m_recorder.collect(interval);
+        }
+        total += interval;
+        return interval;
+    };
+    while (!g_stop) {
+        auto next = last + std::chrono::seconds(intervalSecs);
+        while (!g_stop && loadgen::Clock::now() < next) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+        if (g_stop) {
+            break;
+        }
+        std::string label = std::to_string(std::chrono::duration_cast<std::chrono::seconds>(
+                                               loadgen::Clock::now() - start).count()) + "s";
+        loadgen::Interval interval = collect();
+        auto now = loadgen::Clock::now();
+        report(label.c_str(), interval, std::chrono::duration<double>(now - last).count());
+        last = now;
+        g_stop = duration > 0 && loadgen::Clock::now() >= deadline;
+    }
+    for (auto &sender : senders) {
+        sender.join();
+    }
+    auto end = loadgen::Clock::now();
+    // Give the echoes still in flight a moment to arrive, and count them in the total
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    (void)collect();
+    for (auto &flow : flows) {
+        flow->stop();
+    }
+    report("total", total, std::chrono::duration<double>(end - start).count());
+    return 0;
+}
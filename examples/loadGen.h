@@ -0,0 +1,181 @@
+#pragma once
+#include "Metrics.h"
+#include "SocketCommon.h"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+// Shared by the load generator's sources.  TcpClient.h and UdpSocket.h can't be included in the same translation
+// unit, so the TCP and UDP flows live in loadGenTcp.cpp and loadGenUdp.cpp behind the Flow interface.
+
+namespace loadgen {
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief Each payload starts with the time it was due to be sent, in steady_clock nanoseconds.  The echo brings it
+ *        back to the generator, so the latency is measured with a single clock.
+ */
+constexpr size_t TIMESTAMP_SIZE = sizeof(int64_t);
+
+inline void putTimestamp(char *payload, Clock::time_point when) {
+    int64_t nanos = std::chrono::duration_cast<std::chrono::nanoseconds>(when.time_since_epoch()).count();
+    memcpy(payload, &nanos, sizeof(nanos));
+}
+
+inline Clock::time_point getTimestamp(const char *payload) {
+    int64_t nanos = 0;
+    memcpy(&nanos, payload, sizeof(nanos));
+    return Clock::time_point(std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(nanos)));
+}
+
+/**
+ * @brief Counters and latencies for one reporting interval
+ */
+struct Interval {
+    uint64_t m_sentMsgs = 0;
+    uint64_t m_sentBytes = 0;
+    uint64_t m_recvMsgs = 0;
+    uint64_t m_recvBytes = 0;
+    uint64_t m_errors = 0;
+    sockets::LatencyHistogram m_latency;
+
+    Interval &operator+=(const Interval &other) {
+        m_sentMsgs += other.m_sentMsgs;
+        m_sentBytes += other.m_sentBytes;
+        m_recvMsgs += other.m_recvMsgs;
+        m_recvBytes += other.m_recvBytes;
+        m_errors += other.m_errors;
+        m_latency += other.m_latency;
+        return *this;
+    }
+};
+
+/**
+ * @brief Recorder counts a flow's traffic, updated by the sending thread and the flow's receive thread, and
+ *        hands it to the reporting thread an interval at a time
+ */
+class Recorder {
+public:
+    void sent(size_t bytes) {
+        m_sentMsgs++;
+        m_sentBytes += bytes;
+    }
+
+    void failed() {
+        m_errors++;
+    }
+
+    /**
+     * @brief Record an echoed payload
+     *
+     * @param payload - the payload, starting with its timestamp
+     * @param size - length of the payload
+     */
+    void received(const char *payload, size_t size) {
+        auto now = Clock::now();
+        m_recvMsgs++;
+        m_recvBytes += size;
+        if (size < TIMESTAMP_SIZE) {
+            return;
+        }
+        auto latency = std::chrono::duration_cast<std::chrono::nanoseconds>(now - getTimestamp(payload)).count();
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_latency.record(latency < 0 ? 0 : static_cast<uint64_t>(latency));
+    }
+
+    /**
+     * @brief Get the number of payloads sent and not yet echoed back
+     */
+    uint64_t outstanding() const {
+        return m_sentMsgs.load() - m_recvMsgs.load();
+    }
+
+    /**
+     * @brief Add the traffic since the last call to an interval.  Called by the reporting thread only.
+     *
+     * @param interval - the interval to add to
+     */
+    void collect(Interval &interval) {
+        Interval now;
+        now.m_sentMsgs = m_sentMsgs.load();
+        now.m_sentBytes = m_sentBytes.load();
+        now.m_recvMsgs = m_recvMsgs.load();
+        now.m_recvBytes = m_recvBytes.load();
+        now.m_errors = m_errors.load();
+        interval.m_sentMsgs += now.m_sentMsgs - m_reported.m_sentMsgs;
+        interval.m_sentBytes += now.m_sentBytes - m_reported.m_sentBytes;
+        interval.m_recvMsgs += now.m_recvMsgs - m_reported.m_recvMsgs;
+        interval.m_recvBytes += now.m_recvBytes - m_reported.m_recvBytes;
+        interval.m_errors += now.m_errors - m_reported.m_errors;
+        m_reported = now;
+        std::lock_guard<std::mutex> guard(m_mutex);
+        interval.m_latency += m_latency;
+        m_latency = sockets::LatencyHistogram();
+    }
+
+private:
+    std::atomic<uint64_t> m_sentMsgs { 0 };
+    std::atomic<uint64_t> m_sentBytes { 0 };
+    std::atomic<uint64_t> m_recvMsgs { 0 };
+    std::atomic<uint64_t> m_recvBytes { 0 };
+    std::atomic<uint64_t> m_errors { 0 };
+
+    /**
+     * @brief Mutex protecting m_latency, which holds the latencies since the last collect()
+     */
+    std::mutex m_mutex;
+    sockets::LatencyHistogram m_latency;
+
+    /**
+     * @brief Counter values at the last collect()
+     */
+    Interval m_reported;
+};
+
+/**
+ * @brief A TCP connection or UDP flow to the echo server
+ */
+class Flow {
+public:
+    virtual ~Flow() = default;
+
+    /**
+     * @brief Connect (TCP) or open the socket (UDP)
+     */
+    virtual sockets::SocketRet start() = 0;
+
+    /**
+     * @brief Send a payload, which starts with its timestamp
+     */
+    virtual sockets::SocketRet send(const char *payload, size_t size) = 0;
+
+    /**
+     * @brief Close the connection or socket
+     */
+    virtual void stop() = 0;
+
+    /**
+     * @brief Whether echoes come back on this flow, so that its outstanding payloads can be counted
+     */
+    virtual bool tracksEchoes() const = 0;
+
+    Recorder m_recorder;
+};
+
+/**
+ * @brief Create a TCP connection to an echo server, e.g. serverApp -e.  Payloads are sent with a 4 byte length
+ *        prefix so they can be picked out of the echoed stream.
+ */
+std::unique_ptr<Flow> makeTcpFlow(const char *remoteAddr, uint16_t port, const sockets::SocketOpt &options);
+
+/**
+ * @brief Create a UDP flow from a local port to an echo peer, e.g. unicastApp -e.  The peer echoes to a single
+ *        address, so only the flow whose local port it echoes to sees the replies.
+ */
+std::unique_ptr<Flow> makeUdpFlow(const char *remoteAddr, uint16_t localPort, uint16_t port,
+                                  const sockets::SocketOpt &options);
+
+}  // namespace loadgen
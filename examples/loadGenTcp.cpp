@@ -0,0 +1,65 @@
+#include "loadGen.h"
+#include "TcpClient.h"
+#include <iostream>
+
+namespace loadgen {
+
+namespace {
+
+using Framing = sockets::LengthPrefixFraming<4>;
+
+class TcpFlow : public Flow {
+public:
+    TcpFlow(const char *remoteAddr, uint16_t port, const sockets::SocketOpt &options)
+        : m_remoteAddr(remoteAddr), m_port(port), m_options(options), m_client(*this, &m_options) {
+    }
+
+    ~TcpFlow() override {
+        m_client.finish();
+    }
+
+    TcpFlow(const TcpFlow &) = delete;
+    TcpFlow(TcpFlow &&) = delete;
+    TcpFlow &operator=(const TcpFlow &) = delete;
+    TcpFlow &operator=(TcpFlow &&) = delete;
+
+    sockets::SocketRet start() override {
+        return m_client.connectTo(m_remoteAddr, m_port);
+    }
+
+    sockets::SocketRet send(const char *payload, size_t size) override {
+        auto header = Framing::header(size);
+        const sockets::MsgPart parts[] = { { header.data(), header.size() }, { payload, size } };
+        return m_client.sendMsgv(parts, 2);
+    }
+
+    void stop() override {
+        m_client.finish();
+    }
+
+    bool tracksEchoes() const override {
+        return true;
+    }
+
+    void onReceiveData(const char *data, size_t size) {
+        m_recorder.received(data, size);
+    }
+
+    void onDisconnect(const sockets::SocketRet &ret) {
+        std::cout << "Disconnect: " << ret.m_msg << "\n";
+    }
+
+private:
+    const char *m_remoteAddr;
+    uint16_t m_port;
+    sockets::SocketOpt m_options;
+    sockets::TcpClient<TcpFlow, sockets::SocketCore, Framing> m_client;
+};
+
+}  // namespace
+
+std::unique_ptr<Flow> makeTcpFlow(const char *remoteAddr, uint16_t port, const sockets::SocketOpt &options) {
+    return std::make_unique<TcpFlow>(remoteAddr, port, options);
+}
+
+}  // namespace loadgen
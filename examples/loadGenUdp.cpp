@@ -0,0 +1,59 @@
+#include "loadGen.h"
+#include "UdpSocket.h"
+
+namespace loadgen {
+
+namespace {
+
+class UdpFlow : public Flow {
+public:
+    UdpFlow(const char *remoteAddr, uint16_t localPort, uint16_t port, const sockets::SocketOpt &options)
+        : m_remoteAddr(remoteAddr), m_localPort(localPort), m_port(port), m_options(options),
+          m_socket(*this, &m_options) {
+    }
+
+    ~UdpFlow() override {
+        m_socket.finish();
+    }
+
+    UdpFlow(const UdpFlow &) = delete;
+    UdpFlow(UdpFlow &&) = delete;
+    UdpFlow &operator=(const UdpFlow &) = delete;
+    UdpFlow &operator=(UdpFlow &&) = delete;
+
+    sockets::SocketRet start() override {
+        return m_socket.startUnicast(m_remoteAddr, m_localPort, m_port);
+    }
+
+    sockets::SocketRet send(const char *payload, size_t size) override {
+        return m_socket.sendMsg(payload, size);
+    }
+
+    void stop() override {
+        m_socket.finish();
+    }
+
+    bool tracksEchoes() const override {
+        return false;
+    }
+
+    void onReceiveData(const char *data, size_t size) {
+        m_recorder.received(data, size);
+    }
+
+private:
+    const char *m_remoteAddr;
+    uint16_t m_localPort;
+    uint16_t m_port;
+    sockets::SocketOpt m_options;
+    sockets::UdpSocket<UdpFlow> m_socket;
+};
+
+}  // namespace
+
+std::unique_ptr<Flow> makeUdpFlow(const char *remoteAddr, uint16_t localPort, uint16_t port,
+                                  const sockets::SocketOpt &options) {
+    return std::make_unique<UdpFlow>(remoteAddr, localPort, port, options);
+}
+
+}  // namespace loadgen
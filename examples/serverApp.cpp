@@ -1,5 +1,7 @@
 #include "TcpServer.h"
+#include <csignal>
 #include <set>
+#include <thread>
 #ifdef _WIN32
     #include "getopt.h"
 #else
@@ -9,7 +11,7 @@
 class ServerApp {
 public:
     // TCP Server
-    explicit ServerApp(const char *listenAddr, uint16_t port);
+    ServerApp(const sockets::SocketOpt &options, uint16_t port, bool echo);
 
     virtual ~ServerApp();
 
@@ -19,17 +21,18 @@ public:
 
     void onClientDisconnect(const sockets::ClientHandle &client, const sockets::SocketRet &ret);
 
-    void sendMsg(int idx, const char *data, size_t len);
+    void sendMsg(sockets::ClientHandle idx, const char *data, size_t len);
 
 private:
     sockets::SocketOpt m_socketOpt;
+    bool m_echo;
     sockets::TcpServer<ServerApp> m_server;
     int m_clientIdx = 0;
-    std::set<int> m_clients;
+    std::set<sockets::ClientHandle> m_clients;
     std::mutex m_mutex;
 };
 
-ServerApp::ServerApp(const char *listenAddr, uint16_t port) : m_socketOpt({ sockets::TX_BUFFER_SIZE, sockets::RX_BUFFER_SIZE, listenAddr}), m_server(*this, &m_socketOpt) {
+ServerApp::ServerApp(const sockets::SocketOpt &options, uint16_t port, bool echo) : m_socketOpt(options), m_echo(echo), m_server(*this, &m_socketOpt) {
     sockets::SocketRet ret = m_server.start(port);
     if (ret.m_success) {
         std::cout << "Server started on port " << port << "\n";
@@ -46,7 +49,7 @@ ServerApp::~ServerApp()
     }
 }
 
-void ServerApp::sendMsg(int idx, const char *data, size_t len) {
+void ServerApp::sendMsg(sockets::ClientHandle idx, const char *data, size_t len) {
     std::lock_guard<std::mutex> guard(m_mutex);
     if (idx == 0) {
         auto ret = m_server.sendBcast(data, len);
@@ -64,11 +67,19 @@ void ServerApp::sendMsg(int idx, const char *data, size_t len) {
 }
 
 void ServerApp::onReceiveClientData(const sockets::ClientHandle &client, const char *data, size_t size) {
+    if (m_echo) {
+        sockets::ClientHandle handle = client;
+        (void)m_server.sendClientMessage(handle, data, size);
+        return;
+    }
     std::string str(reinterpret_cast<const char *>(data), size);
     std::cout << "Client " << client << " Rcvd: " << str << "\n";
 }
 
 void ServerApp::onClientConnect(const sockets::ClientHandle &client) {
+    if (m_echo) {
+        return;
+    }
     std::string ipAddr;
     uint16_t port;
     bool connected;
@@ -82,6 +93,9 @@ void ServerApp::onClientConnect(const sockets::ClientHandle &client) {
 }
 
 void ServerApp::onClientDisconnect(const sockets::ClientHandle &client, const sockets::SocketRet &ret) {
+    if (m_echo) {
+        return;
+    }
     std::cout << "Client " << client << " Disconnect: " << ret.m_msg << "\n";
     {
         std::lock_guard<std::mutex> guard(m_mutex);
@@ -89,15 +103,24 @@ void ServerApp::onClientDisconnect(const sockets::ClientHandle &client, const so
     }
 }
 
+std::atomic_bool g_stop(false);
+
+void onSignal(int) {
+    g_stop = true;
+}
+
 void usage() {
-    std::cout << "ServerApp -p <port> -L <listenAddr>\n";
+    std::cout << "ServerApp -p <port> -L <listenAddr> [-e] [-b select|epoll|io_uring]\n"
+                 "  -e  echo everything received back to the client, e.g. for loadGen, until interrupted\n";
 }
 
 int main(int argc, char **argv) {
     int arg = 0;
     uint16_t port = 0;
     const char *listenAddr = "0.0.0.0";
-    while ((arg = getopt(argc, argv, "p:L:?")) != EOF) {    // NOLINT
+    bool echo = false;
+    std::string backend = "select";
+    while ((arg = getopt(argc, argv, "p:L:eb:?")) != EOF) {    // NOLINT
         switch (arg) {
         case 'p':
             port = static_cast<uint16_t>(std::stoul(optarg));
@@ -105,25 +128,46 @@ int main(int argc, char **argv) {
         case 'L':
             listenAddr = optarg;
             break;
+        case 'e':
+            echo = true;
+            break;
+        case 'b':
+            backend = optarg;
+            break;
         case '?':
             usage();
             exit(1);    // NOLINT
         }
     }
 
-    auto *app = new ServerApp(listenAddr, port);
+    sockets::SocketOpt options { sockets::TX_BUFFER_SIZE, sockets::RX_BUFFER_SIZE, listenAddr };
+    if (backend == "epoll") {
+        options.m_eventBackend = sockets::EventBackend::Epoll;
+    } else if (backend == "io_uring") {
+        options.m_eventBackend = sockets::EventBackend::IoUring;
+    } else if (backend != "select") {
+        usage();
+        exit(1);    // NOLINT
+    }
+    auto *app = new ServerApp(options, port, echo);
 
-    while (true) {
+    if (echo) {
+        (void)std::signal(SIGINT, onSignal);
+        while (!g_stop) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+    while (!echo) {
         std::string data;
         std::cout << "Data >";
         std::getline(std::cin, data);
         if (data == "quit") {
             break;
         }
-        int idx = 0;
+        sockets::ClientHandle idx = 0;
         if (data[0] != 'B' && data[0] != 'b') {
             try {
-                idx = std::stoi(data);
+                idx = std::stoll(data);
             } catch (...) { continue; }
         }
 
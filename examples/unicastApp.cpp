@@ -1,5 +1,7 @@
 #include "UdpSocket.h"
+#include <csignal>
 #include <iostream>
+#include <thread>
 #ifdef _WIN32
     #include "getopt.h"
 #else
@@ -9,7 +11,7 @@
 class UnicastApp {
 public:
     // UDP Multicast
-    UnicastApp(const char *remoteAddr, const char *listenAddr, uint16_t localPort, uint16_t port);
+    UnicastApp(const char *remoteAddr, const char *listenAddr, uint16_t localPort, uint16_t port, bool echo);
 
     virtual ~UnicastApp() = default;
 
@@ -19,10 +21,11 @@ public:
 
 private:
     sockets::SocketOpt m_socketOpts;
+    bool m_echo;
     sockets::UdpSocket<UnicastApp> m_unicast;
 };
 
-UnicastApp::UnicastApp(const char *remoteAddr, const char *listenAddr, uint16_t localPort, uint16_t port) : m_socketOpts({ sockets::TX_BUFFER_SIZE, sockets::RX_BUFFER_SIZE, listenAddr}), m_unicast(*this, &m_socketOpts) {
+UnicastApp::UnicastApp(const char *remoteAddr, const char *listenAddr, uint16_t localPort, uint16_t port, bool echo) : m_socketOpts({ sockets::TX_BUFFER_SIZE, sockets::RX_BUFFER_SIZE, listenAddr}), m_echo(echo), m_unicast(*this, &m_socketOpts) {
     sockets::SocketRet ret = m_unicast.startUnicast(remoteAddr, localPort, port);
     if (ret.m_success) {
         std::cout << "Listening on UDP " << listenAddr << ":" << localPort << " sending to " << remoteAddr << ":" << port << "\n";
@@ -40,13 +43,24 @@ void UnicastApp::sendMsg(const char *data, size_t len) {
 }
 
 void UnicastApp::onReceiveData(const char *data, size_t size) {
+    if (m_echo) {
+        (void)m_unicast.sendMsg(data, size);
+        return;
+    }
     std::string str(reinterpret_cast<const char *>(data), size);
 
     std::cout << "Received: " << str << "\n";
 }
 
+std::atomic_bool g_stop(false);
+
+void onSignal(int) {
+    g_stop = true;
+}
+
 void usage() {
-    std::cout << "UnicastApp -a <remoteAddr> -l <localPort> -p <port> -L <listenAddr>\n";
+    std::cout << "UnicastApp -a <remoteAddr> -l <localPort> -p <port> -L <listenAddr> [-e]\n"
+                 "  -e  echo every datagram received to <remoteAddr>:<port>, e.g. for loadGen, until interrupted\n";
 }
 
 int main(int argc, char **argv) {
@@ -55,7 +69,8 @@ int main(int argc, char **argv) {
     const char *listenAddr = "0.0.0.0";
     uint16_t port = 0;
     uint16_t localPort = 0;
-    while ((arg = getopt(argc, argv, "a:l:p:L:?")) != EOF) {    // NOLINT
+    bool echo = false;
+    while ((arg = getopt(argc, argv, "a:l:p:L:e?")) != EOF) {    // NOLINT
         switch (arg) {
         case 'a':
             addr = optarg;
@@ -69,15 +84,24 @@ int main(int argc, char **argv) {
         case 'L':
             listenAddr = optarg;
             break;
+        case 'e':
+            echo = true;
+            break;
         case '?':
             usage();
             exit(1);    // NOLINT
         }
     }
 
-    auto *app = new UnicastApp(addr, listenAddr, localPort, port);
+    auto *app = new UnicastApp(addr, listenAddr, localPort, port, echo);
 
-    while (true) {
+    if (echo) {
+        (void)std::signal(SIGINT, onSignal);
+        while (!g_stop) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+    }
+    while (!echo) {
         std::string data;
         std::cout << "Data >";
         std::getline(std::cin, data);
@@ -0,0 +1,178 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+namespace sockets {
+
+/**
+ * @brief Why TcpServer admission control turned a connection away
+ */
+enum class AdmissionReject {
+    /**
+     * @brief New connections are arriving faster than SocketOpt::m_acceptRate
+     */
+    RateLimit,
+
+    /**
+     * @brief The server already holds SocketOpt::m_maxConnections connections
+     */
+    MaxConnections,
+
+    /**
+     * @brief The event loop which would serve the connection is lagging by more than SocketOpt::m_maxLoopLagMs
+     */
+    Overload
+};
+
+/**
+ * @brief Counts of the connections admitted and turned away by TcpServer admission control
+ */
+struct AdmissionStats {
+    /**
+     * @brief Connections admitted
+     */
+    uint64_t m_admitted = 0;
+
+    /**
+     * @brief Connections rejected by the connection-rate limit
+     */
+    uint64_t m_rejectedRate = 0;
+
+    /**
+     * @brief Connections rejected by the connection cap
+     */
+    uint64_t m_rejectedMax = 0;
+
+    /**
+     * @brief Connections shed because the event loop was lagging
+     */
+    uint64_t m_rejectedOverload = 0;
+};
+
+/**
+ * @brief Invoke callback.onAcceptRejected(args...) if the callback recipient provides it
+ */
+template <class CallbackImpl, class... Args>
+auto notifyAcceptRejected(CallbackImpl &callback, int, Args... args)
+    -> decltype(callback.onAcceptRejected(args...), void()) {
+    callback.onAcceptRejected(args...);
+}
+
+template <class CallbackImpl, class... Args>
+void notifyAcceptRejected(CallbackImpl &, long, Args...) {
+}
+
+/**
+ * @brief TokenBucket limits the rate of events: it holds up to a burst of tokens, refilled at a steady rate,
+ *        and each event takes one.  Thread-safe.
+ */
+class TokenBucket {
+public:
+    /**
+     * @brief Construct a new TokenBucket object, initially full
+     *
+     * @param rate - tokens added per second, 0 for no limit
+     * @param burst - most tokens held, at least 1
+     */
+    TokenBucket(double rate, size_t burst)
+        : m_rate(rate), m_burst(static_cast<double>(std::max<size_t>(1, burst))), m_tokens(m_burst),
+          m_last(std::chrono::steady_clock::now()) {
+    }
+
+    /**
+     * @brief Take a token if one is available
+     *
+     * @param now - the current time
+     * @return true - a token was taken
+     * @return false - the bucket is empty
+     */
+    bool tryTake(std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()) {
+        if (m_rate <= 0.0) {
+            return true;
+        }
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (now > m_last) {
+            std::chrono::duration<double> elapsed = now - m_last;
+            m_tokens = std::min(m_burst, m_tokens + elapsed.count() * m_rate);
+            m_last = now;
+        }
+        if (m_tokens < 1.0) {
+            return false;
+        }
+        m_tokens -= 1.0;
+        return true;
+    }
+
+private:
+    /**
+     * @brief Tokens added per second
+     */
+    double m_rate;
+
+    /**
+     * @brief Capacity of the bucket
+     */
+    double m_burst;
+
+    /**
+     * @brief Mutex protecting m_tokens and m_last
+     */
+    std::mutex m_mutex;
+
+    /**
+     * @brief Tokens available
+     */
+    double m_tokens;
+
+    /**
+     * @brief Time of the last refill
+     */
+    std::chrono::steady_clock::time_point m_last;
+};
+
+/**
+ * @brief LoopLag tracks how long an event loop spends handling each batch of events, smoothed so that a single
+ *        slow pass doesn't count as overload.  Written by the loop thread, read from any thread.
+ */
+class LoopLag {
+public:
+    /**
+     * @brief Record the time one pass of the loop took
+     *
+     * @param busy - time from the end of a wait to the start of the next one
+     * @param waited - how long the next wait then lasted
+     */
+    void record(std::chrono::steady_clock::duration busy, std::chrono::steady_clock::duration waited) {
+        constexpr uint64_t WEIGHT = 8;
+        auto sample = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(busy).count());
+        auto idle = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(waited).count());
+        uint64_t smoothed = m_lagUs.load(std::memory_order_relaxed);
+        if (idle > smoothed) {
+            // The loop ran out of work, so it has caught up whatever its earlier passes took
+            smoothed = sample;
+        } else {
+            smoothed = smoothed - smoothed / WEIGHT + sample / WEIGHT;
+        }
+        m_lagUs.store(smoothed, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Smoothed time per pass
+     */
+    std::chrono::microseconds get() const {
+        return std::chrono::microseconds(m_lagUs.load(std::memory_order_relaxed));
+    }
+
+private:
+    /**
+     * @brief Exponentially weighted moving average of the pass times, in microseconds
+     */
+    std::atomic<uint64_t> m_lagUs { 0 };
+};
+
+}  // namespace sockets
@@ -0,0 +1,422 @@
+#pragma once
+#include "SharedBuffer.h"
+#include "SocketCommon.h"
+#include "SocketCore.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+#if !defined(_WIN32)
+    #include <sys/mman.h>
+    #include <sys/uio.h>
+#endif
+
+namespace sockets {
+
+/**
+ * @brief Most buffers a receive reads into with one readv()
+ */
+constexpr size_t RX_CHAIN_MAX = 8;
+
+/**
+ * @brief Occupancy and hit/miss counters of a BufferPool
+ */
+struct BufferPoolStats {
+    /**
+     * @brief Size of each buffer
+     */
+    size_t m_slabSize = 0;
+
+    /**
+     * @brief Number of buffers preallocated by the pool
+     */
+    size_t m_capacity = 0;
+
+    /**
+     * @brief Number of buffers currently handed out, including overflow buffers
+     */
+    size_t m_inUse = 0;
+
+    /**
+     * @brief Requests served from the preallocated buffers
+     */
+    uint64_t m_hits = 0;
+
+    /**
+     * @brief Requests served by a heap allocation because every preallocated buffer was in use
+     */
+    uint64_t m_misses = 0;
+
+    /**
+     * @brief The preallocated buffers are backed by huge pages
+     */
+    bool m_hugePages = false;
+
+    /**
+     * @brief Add another pool's counters to these
+     */
+    BufferPoolStats &operator+=(const BufferPoolStats &other) {
+        m_slabSize = std::max(m_slabSize, other.m_slabSize);
+        m_capacity += other.m_capacity;
+        m_inUse += other.m_inUse;
+        m_hits += other.m_hits;
+        m_misses += other.m_misses;
+        m_hugePages = m_hugePages || other.m_hugePages;
+        return *this;
+    }
+};
+
+/**
+ * @brief BufferPool hands out fixed-size receive buffers (slabs) carved from one preallocated arena, so receiving
+ *        doesn't allocate under sustained load and recently used buffers stay warm in the cache.  The arena can be
+ *        backed by huge pages to save TLB misses.  When every slab is in use the pool falls back to the heap and
+ *        counts a miss.  acquire() and release() may be called from any thread, so a buffer handed to the
+ *        application may be released by a worker thread.
+ */
+class BufferPool {
+public:
+    /**
+     * @brief Construct a new BufferPool object.  The arena is reserved on the first acquire().
+     *
+     * @param slabSize - size of each buffer, rounded up to a multiple of the cache line size
+     * @param slabCount - number of buffers in the arena
+     * @param hugePages - back the arena with huge pages where available
+     */
+    BufferPool(size_t slabSize, size_t slabCount, bool hugePages)
+        : m_slabSize(roundUp(std::max<size_t>(slabSize, 1), CACHE_LINE)), m_slabCount(slabCount),
+          m_wantHugePages(hugePages) {
+    }
+
+    BufferPool(const BufferPool &) = delete;
+    BufferPool &operator=(const BufferPool &) = delete;
+
+    ~BufferPool() {
+        unmap();
+    }
+
+    /**
+     * @brief Size of each buffer
+     */
+    size_t slabSize() const {
+        return m_slabSize;
+    }
+
+    /**
+     * @brief Take a buffer from the pool
+     *
+     * @return char* - a buffer of slabSize() bytes, to be returned with release()
+     */
+    char *acquire() {
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            if (m_arena == nullptr && m_slabCount != 0) {
+                map();
+            }
+            m_inUse++;
+            if (!m_free.empty()) {
+                char *slab = m_free.back();
+                m_free.pop_back();
+                m_hits++;
+                return slab;
+            }
+            m_misses++;
+        }
+        return new char[m_slabSize];
+    }
+
+    /**
+     * @brief Return a buffer to the pool
+     *
+     * @param slab - buffer from acquire()
+     */
+    void release(char *slab) {
+        if (slab == nullptr) {
+            return;
+        }
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_inUse--;
+        if (slab >= m_arena && slab < m_arena + m_slabCount * m_slabSize) {
+            // Most recently used first, while it's still in the cache
+            m_free.push_back(slab);
+        } else {
+            delete[] slab;
+        }
+    }
+
+    /**
+     * @brief Get the pool's occupancy and hit/miss counters
+     */
+    BufferPoolStats stats() const {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        BufferPoolStats stats;
+        stats.m_slabSize = m_slabSize;
+        stats.m_capacity = (m_arena != nullptr) ? m_slabCount : 0;
+        stats.m_inUse = m_inUse;
+        stats.m_hits = m_hits;
+        stats.m_misses = m_misses;
+        stats.m_hugePages = m_hugePages;
+        return stats;
+    }
+
+private:
+    /**
+     * @brief Slab alignment, so no two buffers share a cache line
+     */
+    static constexpr size_t CACHE_LINE = 64;
+
+    /**
+     * @brief Huge page size assumed when rounding the arena
+     */
+    static constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+    static size_t roundUp(size_t value, size_t multiple) {
+        return (value + multiple - 1) / multiple * multiple;
+    }
+
+    /**
+     * @brief Reserve the arena and fill the free list.  Caller holds m_mutex.
+     */
+    void map() {
+        size_t size = m_slabCount * m_slabSize;
+#if defined(_WIN32)
+        m_arenaSize = size;
+        m_arena = new char[size];
+#else
+        void *arena = MAP_FAILED;
+    #if defined(MAP_HUGETLB)
+        if (m_wantHugePages) {
+            // Explicit huge pages, if the administrator reserved some (vm.nr_hugepages)
+            m_arenaSize = roundUp(size, HUGE_PAGE_SIZE);
+            arena = ::mmap(nullptr, m_arenaSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                           -1, 0);
+            m_hugePages = arena != MAP_FAILED;
+        }
+    #endif
+        if (arena == MAP_FAILED) {
+            m_arenaSize = size;
+            arena = ::mmap(nullptr, m_arenaSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    #if defined(MADV_HUGEPAGE)
+            if (arena != MAP_FAILED && m_wantHugePages) {
+                // Otherwise ask for transparent huge pages
+                (void)::madvise(arena, m_arenaSize, MADV_HUGEPAGE);
+            }
+    #endif
+        }
+        if (arena == MAP_FAILED) {
+            // Every request becomes a miss
+            m_slabCount = 0;
+            return;
+        }
+        m_arena = static_cast<char *>(arena);
+#endif
+        m_free.reserve(m_slabCount);
+        for (size_t idx = m_slabCount; idx > 0; idx--) {
+            m_free.push_back(m_arena + (idx - 1) * m_slabSize);
+        }
+    }
+
+    void unmap() {
+        if (m_arena == nullptr) {
+            return;
+        }
+#if defined(_WIN32)
+        delete[] m_arena;
+#else
+        (void)::munmap(m_arena, m_arenaSize);
+#endif
+        m_arena = nullptr;
+    }
+
+    /**
+     * @brief Size of each buffer
+     */
+    size_t m_slabSize;
+
+    /**
+     * @brief Number of buffers in the arena
+     */
+    size_t m_slabCount;
+
+    /**
+     * @brief Back the arena with huge pages where available
+     */
+    bool m_wantHugePages;
+
+    /**
+     * @brief The arena got explicit huge pages
+     */
+    bool m_hugePages = false;
+
+    /**
+     * @brief The preallocated buffers, and the size of the mapping holding them
+     */
+    char *m_arena = nullptr;
+    size_t m_arenaSize = 0;
+
+    /**
+     * @brief Mutex protecting the free list and counters
+     */
+    mutable std::mutex m_mutex;
+
+    /**
+     * @brief Arena buffers not handed out, most recently released last
+     */
+    std::vector<char *> m_free;
+
+    /**
+     * @brief Occupancy and hit/miss counters
+     */
+    size_t m_inUse = 0;
+    uint64_t m_hits = 0;
+    uint64_t m_misses = 0;
+};
+
+/**
+ * @brief ReceiveChain is a set of BufferPool buffers which one receive call fills in order with readv(), so a
+ *        large read needs neither one large buffer nor several system calls.  It's used by a single event loop.
+ *        share() hands out counted references to a buffer; a buffer still referenced by the application at the
+ *        next receive is left to it and replaced from the pool.
+ */
+class ReceiveChain {
+public:
+    /**
+     * @brief Construct a new ReceiveChain object
+     *
+     * @param pool - pool supplying the buffers, kept alive while the application holds any of them
+     * @param capacity - most bytes read by one receive, up to RX_CHAIN_MAX buffers
+     */
+    ReceiveChain(std::shared_ptr<BufferPool> pool, size_t capacity)
+        : m_pool(std::move(pool)),
+          m_length(std::min(std::max<size_t>(1, (capacity + m_pool->slabSize() - 1) / m_pool->slabSize()),
+                            RX_CHAIN_MAX)) {
+    }
+
+    ReceiveChain(const ReceiveChain &) = delete;
+    ReceiveChain &operator=(const ReceiveChain &) = delete;
+
+    /**
+     * @brief Receive from a socket into the chain
+     *
+     * @param core - interface for socket calls
+     * @param fd - socket file descriptor
+     * @return ssize_t - number of bytes received, 0 if the peer closed the connection or -1 on failure (errno is set)
+     */
+    template <class SocketImpl>
+    ssize_t receive(SocketImpl &core, SOCKET fd) {
+        m_slabs.resize(m_length);
+        for (auto &slab : m_slabs) {
+            if (!slab || slab.use_count() > 1) {
+                // The application holds the old buffer; it returns to the pool when released
+                std::shared_ptr<BufferPool> pool = m_pool;
+                slab = std::shared_ptr<char>(pool->acquire(), [pool](char *data) { pool->release(data); });
+            }
+        }
+        size_t slabSize = m_pool->slabSize();
+#if !defined(_WIN32)
+        if (m_length > 1) {
+            std::array<struct iovec, RX_CHAIN_MAX> iov;
+            for (size_t idx = 0; idx < m_length; idx++) {
+                iov[idx].iov_base = m_slabs[idx].get();
+                iov[idx].iov_len = slabSize;
+            }
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = iov.data();
+            msg.msg_iovlen = m_length;
+            return core.RecvMsg(fd, &msg, 0);
+        }
+#endif
+        return core.Recv(fd, m_slabs[0].get(), slabSize, 0);
+    }
+
+    /**
+     * @brief Get the filled part of each buffer after a receive
+     *
+     * @param length - number of bytes received
+     * @param segments - receives up to RX_CHAIN_MAX segments
+     * @return size_t - number of segments
+     */
+    size_t segments(size_t length, MsgPart *segments) const {
+        size_t count = 0;
+        size_t slabSize = m_pool->slabSize();
+        for (; count < m_slabs.size() && length > 0; count++) {
+            segments[count] = MsgPart { m_slabs[count].get(), std::min(length, slabSize) };
+            length -= segments[count].m_size;
+        }
+        return count;
+    }
+
+    /**
+     * @brief Get a counted reference to received data, without copying it if it lies within one of the buffers
+     *
+     * @param data - start of the data, from a segment or elsewhere (e.g. a framer's reassembly buffer)
+     * @param size - length of the data
+     * @return SharedBuffer - handle keeping the data alive
+     */
+    SharedBuffer share(const char *data, size_t size) const {
+        size_t slabSize = m_pool->slabSize();
+        for (const auto &slab : m_slabs) {
+            if (data >= slab.get() && data + size <= slab.get() + slabSize) {
+                // Aliasing constructor: the handle points at the message but owns the whole buffer
+                return SharedBuffer(std::shared_ptr<const char>(slab, data), size);
+            }
+        }
+        return SharedBuffer::copyOf(data, size);
+    }
+
+private:
+    /**
+     * @brief Pool supplying the buffers
+     */
+    std::shared_ptr<BufferPool> m_pool;
+
+    /**
+     * @brief Number of buffers in the chain
+     */
+    size_t m_length;
+
+    /**
+     * @brief The buffers, acquired on the first receive
+     */
+    std::vector<std::shared_ptr<char>> m_slabs;
+};
+
+/**
+ * @brief Hand a received message to callback.onReceiveBuffer(buffer) if the callback recipient provides it,
+ *        transferring a counted reference to the data, otherwise to callback.onReceiveData(data, size)
+ *
+ * @param share - callable taking (const char *data, size_t size) and returning a SharedBuffer of the data
+ */
+template <class CallbackImpl, class Share>
+auto deliverReceived(CallbackImpl &callback, int, const char *data, size_t size, Share &&share)
+    -> decltype(callback.onReceiveBuffer(SharedBuffer()), void()) {
+    callback.onReceiveBuffer(share(data, size));
+}
+
+template <class CallbackImpl, class Share>
+void deliverReceived(CallbackImpl &callback, long, const char *data, size_t size, Share &&) {
+    callback.onReceiveData(data, size);
+}
+
+/**
+ * @brief Hand a message received from a client to callback.onReceiveClientBuffer(client, buffer) if the callback
+ *        recipient provides it, otherwise to callback.onReceiveClientData(client, data, size)
+ *
+ * @param share - callable taking (const char *data, size_t size) and returning a SharedBuffer of the data
+ */
+template <class CallbackImpl, class Handle, class Share>
+auto deliverClientReceived(CallbackImpl &callback, int, const Handle &client, const char *data, size_t size,
+                           Share &&share) -> decltype(callback.onReceiveClientBuffer(client, SharedBuffer()), void()) {
+    callback.onReceiveClientBuffer(client, share(data, size));
+}
+
+template <class CallbackImpl, class Handle, class Share>
+void deliverClientReceived(CallbackImpl &callback, long, const Handle &client, const char *data, size_t size,
+                           Share &&) {
+    callback.onReceiveClientData(client, data, size);
+}
+
+}  // namespace sockets
@@ -0,0 +1,359 @@
+#pragma once
+#include "SocketCore.h"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace sockets {
+
+/**
+ * @brief ClientHandle is an identifier which refers to a TCP client connection
+ *      established with this server.  The low 32 bits hold the connection's file descriptor and the
+ *      high bits a generation count, so a handle kept after its connection closes never refers to a
+ *      later connection which happens to reuse the descriptor.
+ *
+ */
+using ClientHandle = int64_t;
+
+/**
+ * @brief Value returned in place of a ClientHandle when a connection couldn't be registered
+ */
+constexpr ClientHandle INVALID_CLIENT_HANDLE = -1;
+
+/**
+ * @brief ClientRegistry is a slab of connections indexed by file descriptor.  Each slot carries a
+ *        generation count which is bumped when its connection is removed, and handles embed the
+ *        generation they were issued with, so stale handles fail to resolve.
+ *
+ *        Lookups never take a lock: a reader pins the slot, checks the generation and copies the
+ *        shared_ptr.  remove() retires the generation first and then waits for pinned readers to
+ *        finish copying before releasing the slot's reference, so the item itself is freed when the
+ *        last reader drops its copy.  Slots live in fixed-size chunks which are never moved or freed
+ *        while the registry exists.
+ *
+ * @tparam T - type of the registered items
+ */
+template <class T>
+class ClientRegistry {
+public:
+    /**
+     * @brief Number of slots allocated together
+     */
+    static constexpr size_t CHUNK_SLOTS = 1024;
+
+    /**
+     * @brief Maximum number of chunks, limiting the largest file descriptor which can be registered
+     */
+    static constexpr size_t MAX_CHUNKS = 4096;
+
+    ClientRegistry() {
+        for (auto &chunk : m_chunks) {
+            chunk.store(nullptr);
+        }
+    }
+
+    ClientRegistry(const ClientRegistry &) = delete;
+    ClientRegistry(ClientRegistry &&) = delete;
+
+    ~ClientRegistry() {
+        for (auto &chunk : m_chunks) {
+            delete chunk.load();
+        }
+    }
+
+    ClientRegistry &operator=(const ClientRegistry &) = delete;
+    ClientRegistry &operator=(ClientRegistry &&) = delete;
+
+    /**
+     * @brief Register an item for a file descriptor
+     *
+     * @param fd - the file descriptor, which must not already be registered
+     * @param item - the item
+     * @return ClientHandle - handle referring to the item, or INVALID_CLIENT_HANDLE if fd is out of range
+     *          or already registered
+     */
+    ClientHandle insert(SOCKET fd, std::shared_ptr<T> item) {
+        Slot *slot = slotFor(fd, true);
+        if (slot == nullptr) {
+            return INVALID_CLIENT_HANDLE;
+        }
+        uint64_t tag = slot->m_tag.load();
+        if ((tag & OCCUPIED) != 0) {
+            return INVALID_CLIENT_HANDLE;
+        }
+        // Readers only touch m_item once they see the occupied tag, which is published last
+        slot->m_item = std::move(item);
+        slot->m_tag.store(tag | OCCUPIED);
+        m_count++;
+
+        size_t limit = m_limit.load();
+        auto index = static_cast<size_t>(fd);
+        while (limit <= index && !m_limit.compare_exchange_weak(limit, index + 1)) {
+        }
+        return makeHandle(fd, tag);
+    }
+
+    /**
+     * @brief Get the handle which insert() will return for a file descriptor, so that an item can know its
+     *          own handle before it's registered
+     *
+     * @param fd - the file descriptor, which must not already be registered
+     * @return ClientHandle - the handle, or INVALID_CLIENT_HANDLE if fd is out of range
+     */
+    ClientHandle handleFor(SOCKET fd) {
+        Slot *slot = slotFor(fd, true);
+        if (slot == nullptr) {
+            return INVALID_CLIENT_HANDLE;
+        }
+        return makeHandle(fd, slot->m_tag.load() & ~OCCUPIED);
+    }
+
+    /**
+     * @brief Look up the item referred to by a handle
+     *
+     * @param handle - handle returned by insert()
+     * @return std::shared_ptr<T> - the item, or empty if the handle is stale or invalid
+     */
+    std::shared_ptr<T> find(ClientHandle handle) const {
+        const Slot *slot = const_cast<ClientRegistry *>(this)->handleSlot(handle);
+        if (slot == nullptr) {
+            return nullptr;
+        }
+        return acquire(*slot, tagFor(handle));
+    }
+
+    /**
+     * @brief Look up the item currently registered for a file descriptor
+     *
+     * @param fd - the file descriptor
+     * @param handle - set to the item's handle when found
+     * @return std::shared_ptr<T> - the item, or empty if nothing is registered for fd
+     */
+    std::shared_ptr<T> findFd(SOCKET fd, ClientHandle &handle) const {
+        const Slot *slot = slotFor(fd);
+        if (slot == nullptr) {
+            return nullptr;
+        }
+        uint64_t tag = slot->m_tag.load();
+        if ((tag & OCCUPIED) == 0) {
+            return nullptr;
+        }
+        std::shared_ptr<T> item = acquire(*slot, tag);
+        if (item) {
+            handle = makeHandle(fd, tag);
+        }
+        return item;
+    }
+
+    /**
+     * @brief Unregister the item referred to by a handle.  Only one of several concurrent callers
+     *          removing the same handle succeeds.
+     *
+     * @param handle - handle returned by insert()
+     * @return std::shared_ptr<T> - the removed item, or empty if the handle is stale or invalid
+     */
+    std::shared_ptr<T> remove(ClientHandle handle) {
+        Slot *slot = handleSlot(handle);
+        if (slot == nullptr) {
+            return nullptr;
+        }
+        uint64_t tag = tagFor(handle);
+        uint64_t next = ((tag + GENERATION_STEP) & GENERATION_MASK);
+        if (!slot->m_tag.compare_exchange_strong(tag, next)) {
+            return nullptr;
+        }
+        // New lookups now fail; wait for readers which matched the old generation to take their copy
+        while (slot->m_pins.load() != 0) {
+            std::this_thread::yield();
+        }
+        std::shared_ptr<T> item = std::move(slot->m_item);
+        slot->m_item.reset();
+        m_count--;
+        return item;
+    }
+
+    /**
+     * @brief Collect the registered items
+     *
+     * @param items - receives the items registered at the time of the call
+     */
+    void snapshot(std::vector<std::shared_ptr<T>> &items) const {
+        items.reserve(items.size() + m_count.load());
+        forEachSlot([&items](SOCKET, uint64_t, std::shared_ptr<T> &&item) { items.push_back(std::move(item)); });
+    }
+
+    /**
+     * @brief Unregister every item, calling func(item) on each one removed
+     *
+     * @param func - callable taking (std::shared_ptr<T> &)
+     */
+    template <class Func>
+    void clear(Func &&func) {
+        forEachSlot([this, &func](SOCKET fd, uint64_t tag, std::shared_ptr<T> &&) {
+            std::shared_ptr<T> item = remove(makeHandle(fd, tag));
+            if (item) {
+                func(item);
+            }
+        });
+    }
+
+    /**
+     * @brief Number of registered items
+     */
+    size_t size() const {
+        return m_count.load();
+    }
+
+private:
+    /**
+     * @brief Low bit of a slot tag, set while the slot holds an item
+     */
+    static constexpr uint64_t OCCUPIED = 0x1;
+
+    /**
+     * @brief Slot tags hold the generation above the OCCUPIED bit
+     */
+    static constexpr uint64_t GENERATION_STEP = 0x2;
+
+    /**
+     * @brief Generations wrap at 31 bits so that handles stay positive
+     */
+    static constexpr uint64_t GENERATION_MASK = 0xfffffffeULL;
+
+    /**
+     * @brief A registry slot for one file descriptor
+     */
+    struct Slot {
+        /**
+         * @brief Generation (shifted left one bit) plus the OCCUPIED bit
+         */
+        std::atomic<uint64_t> m_tag { 0 };
+
+        /**
+         * @brief Number of readers currently copying m_item
+         */
+        mutable std::atomic<uint32_t> m_pins { 0 };
+
+        /**
+         * @brief The registered item
+         */
+        std::shared_ptr<T> m_item;
+    };
+
+    using Chunk = std::array<Slot, CHUNK_SLOTS>;
+
+    /**
+     * @brief Build the handle for a file descriptor and slot tag
+     */
+    static ClientHandle makeHandle(SOCKET fd, uint64_t tag) {
+        return static_cast<ClientHandle>(((tag >> 1) << 32) | static_cast<uint32_t>(fd));
+    }
+
+    /**
+     * @brief The occupied slot tag a handle was issued with
+     */
+    static uint64_t tagFor(ClientHandle handle) {
+        return ((static_cast<uint64_t>(handle) >> 32) << 1) | OCCUPIED;
+    }
+
+    /**
+     * @brief Copy a slot's item if the slot still holds the given tag
+     */
+    static std::shared_ptr<T> acquire(const Slot &slot, uint64_t tag) {
+        std::shared_ptr<T> item;
+        slot.m_pins.fetch_add(1);
+        if (slot.m_tag.load() == tag) {
+            item = slot.m_item;
+        }
+        slot.m_pins.fetch_sub(1);
+        return item;
+    }
+
+    /**
+     * @brief Find the slot for a file descriptor, allocating its chunk if needed
+     */
+    Slot *slotFor(SOCKET fd, bool create) {
+        if (fd < 0 || static_cast<size_t>(fd) >= CHUNK_SLOTS * MAX_CHUNKS) {
+            return nullptr;
+        }
+        auto index = static_cast<size_t>(fd);
+        std::atomic<Chunk *> &entry = m_chunks[index / CHUNK_SLOTS];
+        Chunk *chunk = entry.load();
+        if (chunk == nullptr) {
+            if (!create) {
+                return nullptr;
+            }
+            // Event loops may race to allocate the same chunk; the loser frees its copy
+            auto *fresh = new Chunk();
+            if (entry.compare_exchange_strong(chunk, fresh)) {
+                chunk = fresh;
+            } else {
+                delete fresh;
+            }
+        }
+        return &(*chunk)[index % CHUNK_SLOTS];
+    }
+
+    /**
+     * @brief Find the slot for a file descriptor without allocating
+     */
+    const Slot *slotFor(SOCKET fd) const {
+        return const_cast<ClientRegistry *>(this)->slotFor(fd, false);
+    }
+
+    /**
+     * @brief Find the slot a handle refers to
+     */
+    Slot *handleSlot(ClientHandle handle) {
+        if (handle < 0) {
+            return nullptr;
+        }
+        return slotFor(static_cast<SOCKET>(handle & 0xffffffff), false);
+    }
+
+    /**
+     * @brief Call func(fd, tag, item) for each occupied slot
+     */
+    template <class Func>
+    void forEachSlot(Func &&func) const {
+        size_t limit = m_limit.load();
+        for (size_t index = 0; index < limit; index += CHUNK_SLOTS) {
+            const Chunk *chunk = m_chunks[index / CHUNK_SLOTS].load();
+            if (chunk == nullptr) {
+                continue;
+            }
+            for (size_t idx = 0; idx < CHUNK_SLOTS && index + idx < limit; idx++) {
+                const Slot &slot = (*chunk)[idx];
+                uint64_t tag = slot.m_tag.load();
+                if ((tag & OCCUPIED) == 0) {
+                    continue;
+                }
+                std::shared_ptr<T> item = acquire(slot, tag);
+                if (item) {
+                    func(static_cast<SOCKET>(index + idx), tag, std::move(item));
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Chunks of slots, allocated as file descriptors reach them
+     */
+    std::array<std::atomic<Chunk *>, MAX_CHUNKS> m_chunks;
+
+    /**
+     * @brief One past the highest file descriptor ever registered
+     */
+    std::atomic<size_t> m_limit { 0 };
+
+    /**
+     * @brief Number of registered items
+     */
+    std::atomic<size_t> m_count { 0 };
+};
+
+}  // namespace sockets
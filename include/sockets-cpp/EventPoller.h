@@ -0,0 +1,1200 @@
+#pragma once
+#include "IoUring.h"
+#include "SocketCommon.h"
+#include "SocketCore.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#if defined(SOCKETS_IO_URING)
+#include <poll.h>
+#include <sys/uio.h>
+#endif
+
+namespace sockets {
+
+/**
+ * @brief Readiness flags reported by EventPoller
+ */
+constexpr uint32_t POLL_READ = 0x1;
+constexpr uint32_t POLL_WRITE = 0x2;
+constexpr uint32_t POLL_ERROR = 0x4;
+
+/**
+ * @brief Completion flags reported by EventPoller with EventBackend::IoUring, which receives and accepts on the
+ *        caller's behalf: POLL_DATA carries received data, POLL_ACCEPT an accepted connection
+ */
+constexpr uint32_t POLL_DATA = 0x8;
+constexpr uint32_t POLL_ACCEPT = 0x10;
+
+/**
+ * @brief Completion flags for EventPoller::sendZeroCopy(): POLL_SENT reports the result of the send and
+ *        POLL_SEND_RELEASED that the kernel no longer references the data.  Each send reports both, once.
+ */
+constexpr uint32_t POLL_SENT = 0x20;
+constexpr uint32_t POLL_SEND_RELEASED = 0x40;
+
+/**
+ * @brief Maximum number of ready descriptors returned by a single EventPoller::wait() call
+ */
+constexpr int MAX_POLL_EVENTS = 256;
+
+/**
+ * @brief Submission queue size of the io_uring instance used with EventBackend::IoUring
+ */
+constexpr unsigned URING_ENTRIES = 256;
+
+/**
+ * @brief Size of the io_uring registered file table; descriptors below it are registered when added
+ */
+constexpr unsigned URING_FILE_SLOTS = 4096;
+
+/**
+ * @brief A descriptor reported as ready by EventPoller::wait()
+ */
+struct PollEvent {
+    /**
+     * @brief The ready file descriptor
+     */
+    SOCKET m_fd = INVALID_SOCKET;
+
+    /**
+     * @brief Combination of POLL_READ, POLL_WRITE and POLL_ERROR, or POLL_DATA or POLL_ACCEPT
+     */
+    uint32_t m_events = 0;
+
+    /**
+     * @brief With POLL_DATA, the number of bytes received (0 when a stream peer closed the connection) or a
+     *        negative errno value.  With POLL_ACCEPT, the accepted connection's file descriptor.  With POLL_SENT,
+     *        the number of bytes sent or a negative errno value.  With POLL_SEND_RELEASED, the sequence number
+     *        passed to sendZeroCopy().
+     */
+    int m_result = 0;
+
+    /**
+     * @brief With POLL_DATA, the received data.  It remains valid until the next wait() call.
+     */
+    const char *m_data = nullptr;
+};
+
+/**
+ * @brief EventPoller hides the readiness notification mechanism (select, epoll or io_uring) used by
+ *        an event loop.  Descriptors are registered once and wait() reports only the ready ones.
+ *
+ *        With io_uring, read interest arms a multishot receive on a group of provided buffers, and
+ *        addAcceptor() a multishot accept, so wait() reports received data (POLL_DATA) and accepted
+ *        connections (POLL_ACCEPT) rather than readability.  Write interest is still reported as POLL_WRITE.
+ *        sendZeroCopy() sends from the caller's memory without copying it into the kernel.
+ *
+ *        wake() interrupts a wait() from another thread, through an eventfd (a pipe outside Linux) or, with
+ *        io_uring, a no-op request.  post() uses it to hand tasks to the thread calling wait().
+ */
+template <class SocketImpl = sockets::SocketCore>
+class EventPoller {
+public:
+    explicit EventPoller(SocketImpl &impl) : m_socketCore(impl) {
+        FD_ZERO(&m_readFds);
+        FD_ZERO(&m_writeFds);
+    }
+
+    EventPoller(const EventPoller &) = delete;
+    EventPoller(EventPoller &&) = delete;
+
+    ~EventPoller() {
+        close();
+    }
+
+    EventPoller &operator=(const EventPoller &) = delete;
+    EventPoller &operator=(EventPoller &&) = delete;
+
+    /**
+     * @brief Prepare the poller for use
+     *
+     * @param backend - notification mechanism to use
+     * @param bufferCount - number of receive buffers provided to io_uring
+     * @param bufferSize - size of each io_uring receive buffer
+     * @return int - 0 indicates success, -1 indicates failure (errno is set)
+     */
+    int open(EventBackend backend, unsigned bufferCount = URING_BUFFER_COUNT, size_t bufferSize = URING_BUFFER_SIZE) {
+        close();
+        m_backend = backend;
+        if (m_backend == EventBackend::IoUring) {
+#if defined(SOCKETS_IO_URING)
+            if (m_ring.open(URING_ENTRIES) != 0) {
+                return -1;
+            }
+            if (m_buffers.allocate(0, bufferCount, bufferSize) != 0 || provideAll() != 0) {
+                int err = errno;
+                m_ring.close();
+                m_buffers.release();
+                errno = err;
+                return -1;
+            }
+            // Registered files save a descriptor lookup per request; without them requests use the descriptor
+            struct io_uring_rsrc_register files {};
+            files.nr = URING_FILE_SLOTS;
+            files.flags = IORING_RSRC_REGISTER_SPARSE;
+            m_fileSlots = m_ring.registerOp(IORING_REGISTER_FILES2, &files, sizeof(files)) == 0 ? URING_FILE_SLOTS : 0;
+#else
+            (void)bufferCount;
+            (void)bufferSize;
+            errno = ENOTSUP;
+            return -1;
+#endif
+        }
+        if (m_backend == EventBackend::Epoll) {
+#if defined(__linux__)
+            m_epfd = m_socketCore.EpollCreate();
+            if (m_epfd < 0) {
+                return -1;
+            }
+            m_epollEvents.resize(MAX_POLL_EVENTS);
+#else
+            errno = ENOTSUP;
+            return -1;
+#endif
+        }
+        openWakeup();
+        return 0;
+    }
+
+    /**
+     * @brief Release the resources held by the poller
+     */
+    void close() {
+#if defined(__linux__)
+        if (m_epfd >= 0) {
+            m_socketCore.Close(m_epfd);
+            m_epfd = -1;
+        }
+#endif
+        if (m_wakeRead != INVALID_SOCKET) {
+            m_socketCore.CloseWakeup(m_wakeRead, m_wakeWrite);
+            m_wakeRead = INVALID_SOCKET;
+            m_wakeWrite = INVALID_SOCKET;
+        }
+        m_wakePending = false;
+        {
+            // Tasks posted after the loop stopped are dropped
+            std::lock_guard<std::mutex> guard(m_postMutex);
+            m_posted.clear();
+        }
+        std::lock_guard<std::mutex> guard(m_mutex);
+#if defined(SOCKETS_IO_URING)
+        // Stop receives writing to the buffers before the ring goes away, and free the buffers last
+        if (m_ring.isOpen()) {
+            struct io_uring_sqe *sqe = m_ring.getSqe();
+            if (sqe != nullptr) {
+                sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                sqe->fd = -1;
+                sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+            }
+            sqe = m_ring.getSqe();
+            if (sqe != nullptr) {
+                m_buffers.remove(sqe, 0);
+            }
+            (void)m_ring.submit();
+        }
+        m_ring.close();
+        m_buffers.release();
+        m_uringFds.clear();
+        m_consumed.clear();
+        m_rearm.clear();
+        m_regions.clear();
+        m_fileSlots = 0;
+#endif
+        FD_ZERO(&m_readFds);
+        FD_ZERO(&m_writeFds);
+        m_fds.clear();
+        m_writeCount = 0;
+        m_maxFd = INVALID_SOCKET;
+    }
+
+    /**
+     * @brief Get the notification mechanism in use
+     */
+    EventBackend backend() const {
+        return m_backend;
+    }
+
+    /**
+     * @brief Indicates whether wake() can interrupt wait().  Otherwise callers must wait with a timeout to notice
+     *          posted tasks and shutdown requests.
+     */
+    bool canWake() const {
+        return m_backend == EventBackend::IoUring || m_wakeRead != INVALID_SOCKET;
+    }
+
+    /**
+     * @brief Make a wait() in progress return, or the next one return immediately.  May be called from any
+     *          thread; calls made before the wait returns are coalesced into one wakeup.
+     */
+    void wake() {
+        if (m_wakePending.exchange(true)) {
+            return;
+        }
+#if defined(SOCKETS_IO_URING)
+        if (m_backend == EventBackend::IoUring) {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            struct io_uring_sqe *sqe = m_ring.isOpen() ? uringSqe() : nullptr;
+            if (sqe != nullptr) {
+                sqe->opcode = IORING_OP_NOP;
+                sqe->user_data = uringTag(0, URING_WAKE, 0, 0);
+                (void)m_ring.submit();
+            }
+            return;
+        }
+#endif
+        if (m_wakeWrite != INVALID_SOCKET) {
+            (void)m_socketCore.SignalWakeup(m_wakeWrite);
+        }
+    }
+
+    /**
+     * @brief Queue a task for the thread calling wait() and wake it.  The tasks run, in the order they were
+     *          posted, when that thread calls runPosted().  Tasks still queued when the poller is closed are dropped.
+     *
+     * @param task - the task
+     */
+    void post(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> guard(m_postMutex);
+            m_posted.push_back(std::move(task));
+        }
+        wake();
+    }
+
+    /**
+     * @brief Run the tasks posted so far.  Called by the thread calling wait(), after it returns.
+     *
+     * @return size_t - number of tasks run
+     */
+    size_t runPosted() {
+        {
+            std::lock_guard<std::mutex> guard(m_postMutex);
+            if (m_posted.empty()) {
+                return 0;
+            }
+            m_running.swap(m_posted);
+        }
+        size_t count = m_running.size();
+        for (auto &task : m_running) {
+            task();
+        }
+        m_running.clear();
+        return count;
+    }
+
+    /**
+     * @brief Start monitoring a file descriptor
+     *
+     * @param fd - file descriptor to monitor
+     * @param events - combination of POLL_READ and POLL_WRITE
+     * @return int - 0 indicates success, -1 indicates failure (errno is set)
+     */
+    int add(SOCKET fd, uint32_t events) {
+#if defined(SOCKETS_IO_URING)
+        if (m_backend == EventBackend::IoUring) {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            return uringAdd(fd, events, false);
+        }
+#endif
+#if defined(__linux__)
+        if (m_backend == EventBackend::Epoll) {
+            struct epoll_event event = toEpoll(fd, events);
+            return m_socketCore.EpollCtl(m_epfd, EPOLL_CTL_ADD, fd, &event);
+        }
+#endif
+#if !defined(_WIN32)
+        if (fd < 0 || fd >= FD_SETSIZE) {
+            errno = EINVAL;
+            return -1;
+        }
+#endif
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (std::find(m_fds.begin(), m_fds.end(), fd) == m_fds.end()) {
+            m_fds.push_back(fd);
+        }
+        setSelectEvents(fd, events);
+        m_maxFd = std::max(m_maxFd, fd);
+        return 0;
+    }
+
+    /**
+     * @brief Start monitoring a listening socket for connections.  With io_uring the connections are accepted
+     *          by the kernel and reported as POLL_ACCEPT; otherwise this is add(fd, POLL_READ).
+     *
+     * @param fd - the listening socket
+     * @return int - 0 indicates success, -1 indicates failure (errno is set)
+     */
+    int addAcceptor(SOCKET fd) {
+#if defined(SOCKETS_IO_URING)
+        if (m_backend == EventBackend::IoUring) {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            return uringAdd(fd, POLL_READ, true);
+        }
+#endif
+        return add(fd, POLL_READ);
+    }
+
+    /**
+     * @brief Change the readiness events monitored for a file descriptor
+     *
+     * @param fd - file descriptor already being monitored
+     * @param events - combination of POLL_READ and POLL_WRITE
+     * @return int - 0 indicates success, -1 indicates failure (errno is set)
+     */
+    int modify(SOCKET fd, uint32_t events) {
+#if defined(SOCKETS_IO_URING)
+        if (m_backend == EventBackend::IoUring) {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            return uringModify(fd, events);
+        }
+#endif
+#if defined(__linux__)
+        if (m_backend == EventBackend::Epoll) {
+            struct epoll_event event = toEpoll(fd, events);
+            return m_socketCore.EpollCtl(m_epfd, EPOLL_CTL_MOD, fd, &event);
+        }
+#endif
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (std::find(m_fds.begin(), m_fds.end(), fd) == m_fds.end()) {
+            errno = ENOENT;
+            return -1;
+        }
+        setSelectEvents(fd, events);
+        return 0;
+    }
+
+    /**
+     * @brief Stop monitoring a file descriptor
+     *
+     * @param fd - file descriptor to remove
+     * @return int - 0 indicates success, -1 indicates failure (errno is set)
+     */
+    int remove(SOCKET fd) {
+#if defined(SOCKETS_IO_URING)
+        if (m_backend == EventBackend::IoUring) {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            return uringRemove(fd);
+        }
+#endif
+#if defined(__linux__)
+        if (m_backend == EventBackend::Epoll) {
+            struct epoll_event event = toEpoll(fd, 0);
+            return m_socketCore.EpollCtl(m_epfd, EPOLL_CTL_DEL, fd, &event);
+        }
+#endif
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto iter = std::find(m_fds.begin(), m_fds.end(), fd);
+        if (iter == m_fds.end()) {
+            errno = ENOENT;
+            return -1;
+        }
+        *iter = m_fds.back();
+        m_fds.pop_back();
+        FD_CLR(fd, &m_readFds);
+        FD_CLR(fd, &m_writeFds);
+        if (fd == m_maxFd) {
+            m_maxFd = m_fds.empty() ? INVALID_SOCKET : *std::max_element(m_fds.begin(), m_fds.end());
+        }
+        return 0;
+    }
+
+    /**
+     * @brief Register memory regions with io_uring, so that zero-copy sends from them skip pinning the pages
+     *          on every send.  Call before the first sendZeroCopy(); the regions must outlive the poller.
+     *          Other backends ignore the regions.
+     *
+     * @param regions - the regions, at most 1GB each
+     * @return int - 0 indicates success, -1 indicates failure (errno is set), e.g. RLIMIT_MEMLOCK exceeded
+     */
+    int registerSendRegions(const std::vector<SendRegion> &regions) {
+#if defined(SOCKETS_IO_URING)
+        if (m_backend == EventBackend::IoUring && !regions.empty()) {
+            std::vector<struct iovec> iovecs;
+            iovecs.reserve(regions.size());
+            for (const auto &region : regions) {
+                iovecs.push_back({ const_cast<char *>(region.m_data), region.m_size });
+            }
+            std::lock_guard<std::mutex> guard(m_mutex);
+            if (m_ring.registerOp(IORING_REGISTER_BUFFERS, iovecs.data(), static_cast<unsigned>(iovecs.size())) < 0) {
+                return -1;
+            }
+            m_regions = regions;
+        }
+#else
+        (void)regions;
+#endif
+        return 0;
+    }
+
+    /**
+     * @brief Send data without copying it into the kernel (EventBackend::IoUring only).  The result is reported
+     *          by wait() as POLL_SENT and the release of the data as POLL_SEND_RELEASED; the data must not be
+     *          modified or freed before then.  Only one send per descriptor should be outstanding, since sends
+     *          may otherwise complete out of order.
+     *
+     * @param fd - the connected socket, which must have been added
+     * @param data - the data to send, sent from a registered region if it lies in one
+     * @param size - length of the data, at most 4GB - 1
+     * @param seq - sequence number reported with POLL_SEND_RELEASED, 16 bits
+     * @return int - 0 indicates the send was submitted, -1 indicates failure (errno is set)
+     */
+    int sendZeroCopy(SOCKET fd, const char *data, size_t size, uint32_t seq) {
+#if defined(SOCKETS_IO_URING)
+        if (m_backend == EventBackend::IoUring) {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            auto iter = m_uringFds.find(fd);
+            if (iter == m_uringFds.end()) {
+                errno = ENOENT;
+                return -1;
+            }
+            struct io_uring_sqe *sqe = uringSqe();
+            if (sqe == nullptr) {
+                return -1;
+            }
+            sqe->opcode = IORING_OP_SEND_ZC;
+            sqe->fd = fd;
+            if (iter->second.m_fixedFile) {
+                sqe->flags = IOSQE_FIXED_FILE;
+            }
+            sqe->addr = reinterpret_cast<uint64_t>(data);
+            sqe->len = static_cast<uint32_t>(size);
+            // Let the kernel wait for buffer space rather than complete with a partial send
+            sqe->msg_flags = MSG_WAITALL | MSG_NOSIGNAL;
+            for (size_t idx = 0; idx < m_regions.size(); idx++) {
+                const SendRegion &region = m_regions[idx];
+                if (data >= region.m_data && data + size <= region.m_data + region.m_size) {
+                    sqe->ioprio = IORING_RECVSEND_FIXED_BUF;
+                    sqe->buf_index = static_cast<uint16_t>(idx);
+                    break;
+                }
+            }
+            sqe->user_data = uringTag(fd, URING_SEND_ZC, seq, iter->second.m_generation);
+            return m_ring.submit() < 0 ? -1 : 0;
+        }
+#else
+        (void)fd;
+        (void)data;
+        (void)size;
+        (void)seq;
+#endif
+        errno = ENOTSUP;
+        return -1;
+    }
+
+    /**
+     * @brief Wait for one or more monitored file descriptors to become ready
+     *
+     * @param ready - populated with the ready file descriptors
+     * @param timeoutMs - maximum time to wait in milliseconds, negative to wait until a descriptor is ready or
+     *          wake() is called
+     * @return int - number of ready file descriptors, 0 on timeout or wakeup, or -1 on failure
+     */
+    int wait(std::vector<PollEvent> &ready, int timeoutMs) {
+        ready.clear();
+#if defined(SOCKETS_IO_URING)
+        if (m_backend == EventBackend::IoUring) {
+            return waitUring(ready, timeoutMs);
+        }
+#endif
+#if defined(__linux__)
+        if (m_backend == EventBackend::Epoll) {
+            int count = m_socketCore.EpollWait(m_epfd, m_epollEvents.data(), MAX_POLL_EVENTS, timeoutMs);
+            if (count <= 0) {
+                return count;
+            }
+            for (int idx = 0; idx < count; idx++) {
+                const struct epoll_event &event = m_epollEvents[static_cast<size_t>(idx)];
+                if (event.data.fd == m_wakeRead) {
+                    drainWakeup();
+                    continue;
+                }
+                PollEvent pollEvent;
+                pollEvent.m_fd = event.data.fd;
+                pollEvent.m_events = fromEpoll(event.events);
+                ready.push_back(pollEvent);
+            }
+            return static_cast<int>(ready.size());
+        }
+#endif
+        return waitSelect(ready, timeoutMs);
+    }
+
+private:
+    /**
+     * @brief Create the descriptor wake() signals and watch it alongside the caller's descriptors.  Without it
+     *          (e.g. on Windows) wake() has no effect on select() and epoll waits.
+     */
+    void openWakeup() {
+        if (m_backend == EventBackend::IoUring) {
+            return;
+        }
+        if (m_socketCore.CreateWakeup(m_wakeRead, m_wakeWrite) != 0) {
+            m_wakeRead = INVALID_SOCKET;
+            m_wakeWrite = INVALID_SOCKET;
+            return;
+        }
+#if defined(__linux__)
+        if (m_backend == EventBackend::Epoll) {
+            struct epoll_event event = toEpoll(m_wakeRead, POLL_READ);
+            if (m_socketCore.EpollCtl(m_epfd, EPOLL_CTL_ADD, m_wakeRead, &event) != 0) {
+                m_socketCore.CloseWakeup(m_wakeRead, m_wakeWrite);
+                m_wakeRead = INVALID_SOCKET;
+                m_wakeWrite = INVALID_SOCKET;
+            }
+            return;
+        }
+#endif
+#if !defined(_WIN32)
+        if (m_wakeRead >= FD_SETSIZE) {
+            m_socketCore.CloseWakeup(m_wakeRead, m_wakeWrite);
+            m_wakeRead = INVALID_SOCKET;
+            m_wakeWrite = INVALID_SOCKET;
+        }
+#endif
+    }
+
+    /**
+     * @brief Consume the wakeup signal.  The pending flag is cleared first, so a wake() racing with this sends a
+     *          fresh signal rather than being lost.
+     */
+    void drainWakeup() {
+        m_wakePending = false;
+        m_socketCore.DrainWakeup(m_wakeRead);
+    }
+
+    /**
+     * @brief select() implementation of wait()
+     */
+    int waitSelect(std::vector<PollEvent> &ready, int timeoutMs) {
+        constexpr int MSEC_PER_SEC = 1000;
+        fd_set readSet;
+        fd_set writeSet;
+        SOCKET maxFd = INVALID_SOCKET;
+        bool anyWrite = false;
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            readSet = m_readFds;
+            writeSet = m_writeFds;
+            maxFd = m_maxFd;
+            m_selectFds = m_fds;
+            anyWrite = m_writeCount > 0;
+            m_selecting = true;
+        }
+        if (m_wakeRead != INVALID_SOCKET) {
+            FD_SET(m_wakeRead, &readSet);
+            maxFd = std::max(maxFd, m_wakeRead);
+        }
+        struct timeval delay {
+            timeoutMs / MSEC_PER_SEC, (timeoutMs % MSEC_PER_SEC) * MSEC_PER_SEC
+        };
+        int selectRet = m_socketCore.Select(static_cast<int>(maxFd + 1), &readSet, anyWrite ? &writeSet : nullptr, nullptr,
+                                            timeoutMs < 0 ? nullptr : &delay);
+        m_selecting = false;
+        if (selectRet <= 0) {
+            return selectRet;
+        }
+        if (m_wakeRead != INVALID_SOCKET && FD_ISSET(m_wakeRead, &readSet)) {
+            drainWakeup();
+        }
+        for (SOCKET fd : m_selectFds) {
+            PollEvent pollEvent;
+            pollEvent.m_fd = fd;
+            if (FD_ISSET(fd, &readSet)) {
+                pollEvent.m_events |= POLL_READ;
+            }
+            if (anyWrite && FD_ISSET(fd, &writeSet)) {
+                pollEvent.m_events |= POLL_WRITE;
+            }
+            if (pollEvent.m_events != 0) {
+                ready.push_back(pollEvent);
+            }
+        }
+        return static_cast<int>(ready.size());
+    }
+
+    /**
+     * @brief Update the select() descriptor sets for a file descriptor, waking a select() in progress so it
+     *          picks up the change.  Caller holds m_mutex.
+     */
+    void setSelectEvents(SOCKET fd, uint32_t events) {
+        if ((events & POLL_READ) != 0) {
+            FD_SET(fd, &m_readFds);
+        } else {
+            FD_CLR(fd, &m_readFds);
+        }
+        bool wasWrite = FD_ISSET(fd, &m_writeFds) != 0;
+        if ((events & POLL_WRITE) != 0) {
+            FD_SET(fd, &m_writeFds);
+            m_writeCount += wasWrite ? 0 : 1;
+        } else {
+            FD_CLR(fd, &m_writeFds);
+            m_writeCount -= wasWrite ? 1 : 0;
+        }
+        if (m_selecting) {
+            wake();
+        }
+    }
+
+#if defined(SOCKETS_IO_URING)
+    /**
+     * @brief Request kinds, encoded in io_uring user data
+     */
+    static constexpr uint32_t URING_RECV = 1;
+    static constexpr uint32_t URING_ACCEPT = 2;
+    static constexpr uint32_t URING_POLL_WRITE = 3;
+    static constexpr uint32_t URING_CANCEL = 4;
+    static constexpr uint32_t URING_BUFFERS = 5;
+    static constexpr uint32_t URING_SEND_ZC = 6;
+    static constexpr uint32_t URING_WAKE = 7;
+
+    /**
+     * @brief Masks for the request sequence and descriptor generation encoded in io_uring user data
+     */
+    static constexpr uint32_t URING_SEQ_MASK = 0xffff;
+    static constexpr uint32_t URING_GENERATION_MASK = 0xfff;
+
+    /**
+     * @brief io_uring state of a monitored descriptor
+     */
+    struct UringFd {
+        /**
+         * @brief Events the caller is interested in
+         */
+        uint32_t m_events = 0;
+
+        /**
+         * @brief Registration count, so that completions for an earlier descriptor with the same number are dropped
+         */
+        uint32_t m_generation = 0;
+
+        /**
+         * @brief Count of receive (or accept) and write poll requests armed, so that the final completion of a
+         *          cancelled request doesn't disarm its replacement
+         */
+        uint32_t m_readSeq = 0;
+        uint32_t m_writeSeq = 0;
+
+        /**
+         * @brief The descriptor is a listening socket
+         */
+        bool m_acceptor = false;
+
+        /**
+         * @brief The descriptor is in the registered file table, at the index equal to its number
+         */
+        bool m_fixedFile = false;
+
+        /**
+         * @brief A receive (or accept) request is outstanding
+         */
+        bool m_readArmed = false;
+
+        /**
+         * @brief A write poll request is outstanding
+         */
+        bool m_writeArmed = false;
+    };
+
+    /**
+     * @brief Build the user data identifying a request: the descriptor in the low 32 bits, then the request
+     *          kind, the request's sequence and the descriptor's generation
+     */
+    static uint64_t uringTag(SOCKET fd, uint32_t kind, uint32_t seq, uint32_t generation) {
+        constexpr uint64_t KIND_MASK = 0xf;
+        return static_cast<uint32_t>(fd) | ((kind & KIND_MASK) << 32) |
+               (static_cast<uint64_t>(seq & URING_SEQ_MASK) << 36) |
+               (static_cast<uint64_t>(generation & URING_GENERATION_MASK) << 52);
+    }
+
+    static SOCKET tagFd(uint64_t tag) {
+        return static_cast<SOCKET>(tag & 0xffffffff);
+    }
+
+    static uint32_t tagKind(uint64_t tag) {
+        return static_cast<uint32_t>((tag >> 32) & 0xf);
+    }
+
+    static uint32_t tagSeq(uint64_t tag) {
+        return static_cast<uint32_t>((tag >> 36) & URING_SEQ_MASK);
+    }
+
+    static uint32_t tagGeneration(uint64_t tag) {
+        return static_cast<uint32_t>(tag >> 52);
+    }
+
+    /**
+     * @brief Provide all the receive buffers to the kernel when the poller is opened
+     */
+    int provideAll() {
+        struct io_uring_sqe *sqe = m_ring.getSqe();
+        if (sqe == nullptr) {
+            errno = EBUSY;
+            return -1;
+        }
+        m_buffers.provide(sqe, 0, m_buffers.count(), uringTag(0, URING_BUFFERS, 0, 0));
+        if (m_ring.submit() < 0) {
+            return -1;
+        }
+        // The request completes during submission
+        int result = -EIO;
+        (void)m_ring.consume([&result](const struct io_uring_cqe &cqe) { result = cqe.res; });
+        if (result < 0) {
+            errno = -result;
+            return -1;
+        }
+        return 0;
+    }
+
+    /**
+     * @brief Give a buffer back to the kernel once its data has been consumed.  Caller holds m_mutex.
+     */
+    void recycle(uint16_t bid) {
+        struct io_uring_sqe *sqe = uringSqe();
+        if (sqe != nullptr) {
+            m_buffers.provide(sqe, bid, 1, uringTag(0, URING_BUFFERS, 0, 0));
+        }
+    }
+
+    /**
+     * @brief Set an entry of the registered file table.  Caller holds m_mutex.
+     *
+     * @return int - 1 on success, -1 on failure
+     */
+    int updateFileSlot(SOCKET slot, SOCKET fd) {
+        struct io_uring_files_update update {};
+        update.offset = static_cast<uint32_t>(slot);
+        update.fds = reinterpret_cast<uint64_t>(&fd);
+        return m_ring.registerOp(IORING_REGISTER_FILES_UPDATE, &update, 1);
+    }
+
+    /**
+     * @brief Get a submission queue entry, submitting queued entries first if the queue is full.  Caller holds m_mutex.
+     */
+    struct io_uring_sqe *uringSqe() {
+        struct io_uring_sqe *sqe = m_ring.getSqe();
+        if (sqe == nullptr) {
+            (void)m_ring.submit();
+            sqe = m_ring.getSqe();
+        }
+        if (sqe == nullptr) {
+            errno = EBUSY;
+        }
+        return sqe;
+    }
+
+    /**
+     * @brief Arm the requests a descriptor's interest calls for.  Caller holds m_mutex.
+     */
+    int uringArm(SOCKET fd, UringFd &state) {
+        if ((state.m_events & POLL_READ) != 0 && !state.m_readArmed) {
+            struct io_uring_sqe *sqe = uringSqe();
+            if (sqe == nullptr) {
+                return -1;
+            }
+            state.m_readSeq++;
+            sqe->fd = fd;
+            if (state.m_acceptor) {
+                sqe->opcode = IORING_OP_ACCEPT;
+                sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+                sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+                sqe->user_data = uringTag(fd, URING_ACCEPT, state.m_readSeq, state.m_generation);
+            } else {
+                sqe->opcode = IORING_OP_RECV;
+                sqe->ioprio = IORING_RECV_MULTISHOT;
+                sqe->flags = IOSQE_BUFFER_SELECT;
+                sqe->buf_group = m_buffers.groupId();
+                sqe->user_data = uringTag(fd, URING_RECV, state.m_readSeq, state.m_generation);
+            }
+            state.m_readArmed = true;
+        }
+        if ((state.m_events & POLL_WRITE) != 0 && !state.m_writeArmed) {
+            struct io_uring_sqe *sqe = uringSqe();
+            if (sqe == nullptr) {
+                return -1;
+            }
+            state.m_writeSeq++;
+            sqe->opcode = IORING_OP_POLL_ADD;
+            sqe->fd = fd;
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            // the kernel reads the mask's 16-bit halves swapped on big-endian machines
+            sqe->poll32_events = (static_cast<uint32_t>(POLLOUT) << 16) | (static_cast<uint32_t>(POLLOUT) >> 16);
+#else
+            sqe->poll32_events = POLLOUT;
+#endif
+            sqe->user_data = uringTag(fd, URING_POLL_WRITE, state.m_writeSeq, state.m_generation);
+            state.m_writeArmed = true;
+        }
+        return 0;
+    }
+
+    /**
+     * @brief Cancel the request identified by a tag.  Caller holds m_mutex.
+     */
+    int uringCancel(uint64_t tag) {
+        struct io_uring_sqe *sqe = uringSqe();
+        if (sqe == nullptr) {
+            return -1;
+        }
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = tag;
+        sqe->user_data = uringTag(0, URING_CANCEL, 0, 0);
+        return 0;
+    }
+
+    /**
+     * @brief io_uring implementation of add() and addAcceptor().  Caller holds m_mutex.
+     */
+    int uringAdd(SOCKET fd, uint32_t events, bool acceptor) {
+        if (m_uringFds.find(fd) != m_uringFds.end()) {
+            errno = EEXIST;
+            return -1;
+        }
+        UringFd &state = m_uringFds[fd];
+        state.m_events = events;
+        state.m_generation = ++m_generation;
+        state.m_acceptor = acceptor;
+        if (uringArm(fd, state) != 0 || m_ring.submit() < 0) {
+            m_uringFds.erase(fd);
+            return -1;
+        }
+        if (!acceptor && fd >= 0 && static_cast<unsigned>(fd) < m_fileSlots) {
+            state.m_fixedFile = updateFileSlot(fd, fd) == 1;
+        }
+        return 0;
+    }
+
+    /**
+     * @brief io_uring implementation of modify().  Caller holds m_mutex.
+     */
+    int uringModify(SOCKET fd, uint32_t events) {
+        auto iter = m_uringFds.find(fd);
+        if (iter == m_uringFds.end()) {
+            errno = ENOENT;
+            return -1;
+        }
+        UringFd &state = iter->second;
+        state.m_events = events;
+        uint32_t kind = state.m_acceptor ? URING_ACCEPT : URING_RECV;
+        if ((events & POLL_READ) == 0 && state.m_readArmed) {
+            // Data completed before the cancellation is still delivered
+            if (uringCancel(uringTag(fd, kind, state.m_readSeq, state.m_generation)) != 0) {
+                return -1;
+            }
+            state.m_readArmed = false;
+        }
+        if ((events & POLL_WRITE) == 0 && state.m_writeArmed) {
+            if (uringCancel(uringTag(fd, URING_POLL_WRITE, state.m_writeSeq, state.m_generation)) != 0) {
+                return -1;
+            }
+            state.m_writeArmed = false;
+        }
+        if (uringArm(fd, state) != 0) {
+            return -1;
+        }
+        return m_ring.submit() < 0 ? -1 : 0;
+    }
+
+    /**
+     * @brief io_uring implementation of remove().  Caller holds m_mutex.
+     */
+    int uringRemove(SOCKET fd) {
+        auto iter = m_uringFds.find(fd);
+        if (iter == m_uringFds.end()) {
+            errno = ENOENT;
+            return -1;
+        }
+        if (iter->second.m_fixedFile) {
+            // The table holds a reference to the socket, which would keep it open after the caller closes it
+            (void)updateFileSlot(fd, -1);
+        }
+        m_uringFds.erase(iter);
+        // Completions still to come carry the old generation and are dropped
+        struct io_uring_sqe *sqe = uringSqe();
+        if (sqe == nullptr) {
+            return -1;
+        }
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = fd;
+        sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+        sqe->user_data = uringTag(0, URING_CANCEL, 0, 0);
+        return m_ring.submit() < 0 ? -1 : 0;
+    }
+
+    /**
+     * @brief io_uring implementation of wait()
+     */
+    int waitUring(std::vector<PollEvent> &ready, int timeoutMs) {
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            // The caller has finished with the data returned by the previous wait()
+            for (uint16_t bid : m_consumed) {
+                recycle(bid);
+            }
+            m_consumed.clear();
+            // Re-arm requests which ended, e.g. a multishot receive which ran out of buffers
+            for (SOCKET fd : m_rearm) {
+                auto iter = m_uringFds.find(fd);
+                if (iter != m_uringFds.end()) {
+                    (void)uringArm(fd, iter->second);
+                }
+            }
+            m_rearm.clear();
+            if (m_ring.submit() < 0) {
+                return -1;
+            }
+        }
+        if (m_ring.wait(timeoutMs) != 0) {
+            return -1;
+        }
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_ring.consume([this, &ready](const struct io_uring_cqe &cqe) { uringComplete(cqe, ready); });
+        return static_cast<int>(ready.size());
+    }
+
+    /**
+     * @brief Translate a completion into a PollEvent.  Caller holds m_mutex.
+     */
+    void uringComplete(const struct io_uring_cqe &cqe, std::vector<PollEvent> &ready) {
+        uint32_t kind = tagKind(cqe.user_data);
+        if (kind == URING_WAKE) {
+            m_wakePending = false;
+            return;
+        }
+        if (kind == URING_CANCEL || kind == URING_BUFFERS) {
+            return;
+        }
+        SOCKET fd = tagFd(cqe.user_data);
+        bool hasBuffer = (cqe.flags & IORING_CQE_F_BUFFER) != 0;
+        auto bid = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        auto iter = m_uringFds.find(fd);
+        if (iter == m_uringFds.end() || (iter->second.m_generation & URING_GENERATION_MASK) != tagGeneration(cqe.user_data)) {
+            // The descriptor was removed
+            if (hasBuffer) {
+                m_consumed.push_back(bid);
+            }
+            return;
+        }
+        UringFd &state = iter->second;
+        bool finished = (cqe.flags & IORING_CQE_F_MORE) == 0;
+        PollEvent event;
+        event.m_fd = fd;
+        if (kind == URING_SEND_ZC) {
+            if ((cqe.flags & IORING_CQE_F_NOTIF) == 0) {
+                event.m_events = POLL_SENT;
+                event.m_result = cqe.res;
+                ready.push_back(event);
+            }
+            // A send which never used the data, e.g. one which failed, has no separate notification
+            if ((cqe.flags & IORING_CQE_F_NOTIF) != 0 || finished) {
+                event.m_events = POLL_SEND_RELEASED;
+                event.m_result = static_cast<int>(tagSeq(cqe.user_data));
+                ready.push_back(event);
+            }
+            return;
+        }
+        if (kind == URING_POLL_WRITE) {
+            if (tagSeq(cqe.user_data) == (state.m_writeSeq & URING_SEQ_MASK)) {
+                state.m_writeArmed = false;
+                m_rearm.push_back(fd);
+            }
+            if (cqe.res == -ECANCELED) {
+                return;
+            }
+            event.m_events = POLL_WRITE;
+            ready.push_back(event);
+            return;
+        }
+        if (finished && tagSeq(cqe.user_data) == (state.m_readSeq & URING_SEQ_MASK)) {
+            state.m_readArmed = false;
+            m_rearm.push_back(fd);
+        }
+        if (cqe.res == -ECANCELED || cqe.res == -ENOBUFS) {
+            // Cancelled, or the multishot request ended for want of buffers and is re-armed by the next wait()
+            return;
+        }
+        if (kind == URING_ACCEPT) {
+            if (cqe.res >= 0) {
+                event.m_events = POLL_ACCEPT;
+                event.m_result = cqe.res;
+                ready.push_back(event);
+            }
+            return;
+        }
+        event.m_events = POLL_DATA;
+        event.m_result = cqe.res;
+        if (hasBuffer) {
+            event.m_data = m_buffers.buffer(bid);
+            m_consumed.push_back(bid);
+        }
+        ready.push_back(event);
+    }
+#endif
+
+#if defined(__linux__)
+    static struct epoll_event toEpoll(SOCKET fd, uint32_t events) {
+        struct epoll_event event {};
+        event.data.fd = fd;
+        if ((events & POLL_READ) != 0) {
+            event.events |= EPOLLIN;
+        }
+        if ((events & POLL_WRITE) != 0) {
+            event.events |= EPOLLOUT;
+        }
+        return event;
+    }
+
+    static uint32_t fromEpoll(uint32_t events) {
+        uint32_t result = 0;
+        if ((events & (EPOLLIN | EPOLLRDHUP)) != 0) {
+            result |= POLL_READ;
+        }
+        if ((events & EPOLLOUT) != 0) {
+            result |= POLL_WRITE;
+        }
+        if ((events & (EPOLLERR | EPOLLHUP)) != 0) {
+            result |= POLL_ERROR;
+        }
+        return result;
+    }
+#endif
+
+    /**
+     * @brief Interface for socket calls
+     */
+    SocketImpl &m_socketCore;
+
+    /**
+     * @brief Notification mechanism in use
+     */
+    EventBackend m_backend = EventBackend::Select;
+
+    /**
+     * @brief Mutex protecting the select() descriptor sets, which may be updated from any thread
+     */
+    std::mutex m_mutex;
+
+    /**
+     * @brief Descriptors monitored for readability by select()
+     */
+    fd_set m_readFds;
+
+    /**
+     * @brief Descriptors monitored for writability by select()
+     */
+    fd_set m_writeFds;
+
+    /**
+     * @brief Number of descriptors in m_writeFds
+     */
+    int m_writeCount = 0;
+
+    /**
+     * @brief Highest descriptor monitored by select()
+     */
+    SOCKET m_maxFd = INVALID_SOCKET;
+
+    /**
+     * @brief All descriptors monitored by select()
+     */
+    std::vector<SOCKET> m_fds;
+
+    /**
+     * @brief The polling thread is in select() with a copy of the descriptor sets taken under m_mutex
+     */
+    std::atomic_bool m_selecting { false };
+
+    /**
+     * @brief Snapshot of m_fds used by the polling thread while scanning select() results
+     */
+    std::vector<SOCKET> m_selectFds;
+
+    /**
+     * @brief Descriptors signalled by wake() and watched by wait(); the same eventfd on Linux
+     */
+    SOCKET m_wakeRead = INVALID_SOCKET;
+    SOCKET m_wakeWrite = INVALID_SOCKET;
+
+    /**
+     * @brief A wakeup has been signalled and not yet consumed by wait()
+     */
+    std::atomic_bool m_wakePending { false };
+
+    /**
+     * @brief Mutex protecting m_posted
+     */
+    std::mutex m_postMutex;
+
+    /**
+     * @brief Tasks queued by post()
+     */
+    std::vector<std::function<void()>> m_posted;
+
+    /**
+     * @brief Tasks being run by runPosted(), only used by the polling thread
+     */
+    std::vector<std::function<void()>> m_running;
+
+#if defined(__linux__)
+    /**
+     * @brief The epoll instance
+     */
+    int m_epfd = -1;
+
+    /**
+     * @brief Buffer receiving ready events from epoll_wait()
+     */
+    std::vector<struct epoll_event> m_epollEvents;
+#endif
+
+#if defined(SOCKETS_IO_URING)
+    /**
+     * @brief The io_uring instance
+     */
+    IoUring m_ring;
+
+    /**
+     * @brief Receive buffers provided to m_ring
+     */
+    BufferGroup m_buffers;
+
+    /**
+     * @brief State of each descriptor monitored through io_uring
+     */
+    std::unordered_map<SOCKET, UringFd> m_uringFds;
+
+    /**
+     * @brief Registration count, see UringFd::m_generation
+     */
+    uint32_t m_generation = 0;
+
+    /**
+     * @brief Buffers whose data was returned by the last wait(), recycled by the next one
+     */
+    std::vector<uint16_t> m_consumed;
+
+    /**
+     * @brief Descriptors whose requests ended and may need re-arming
+     */
+    std::vector<SOCKET> m_rearm;
+
+    /**
+     * @brief Memory regions registered for zero-copy sends, indexed by registered buffer index
+     */
+    std::vector<SendRegion> m_regions;
+
+    /**
+     * @brief Size of the registered file table, 0 if it couldn't be registered
+     */
+    unsigned m_fileSlots = 0;
+#endif
+};
+
+}  // namespace sockets
@@ -0,0 +1,269 @@
+#pragma once
+#include "EventPoller.h"
+#include "SocketCommon.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace sockets {
+
+/**
+ * @brief Invoke callback.onBackPressure(args...) if the callback recipient provides it
+ */
+template <class CallbackImpl, class... Args>
+auto notifyBackPressure(CallbackImpl &callback, int, Args... args) -> decltype(callback.onBackPressure(args...), void()) {
+    callback.onBackPressure(args...);
+}
+
+template <class CallbackImpl, class... Args>
+void notifyBackPressure(CallbackImpl &, long, Args...) {
+}
+
+/**
+ * @brief Invoke callback.onWritable(args...) if the callback recipient provides it
+ */
+template <class CallbackImpl, class... Args>
+auto notifyWritable(CallbackImpl &callback, int, Args... args) -> decltype(callback.onWritable(args...), void()) {
+    callback.onWritable(args...);
+}
+
+template <class CallbackImpl, class... Args>
+void notifyWritable(CallbackImpl &, long, Args...) {
+}
+
+/**
+ * @brief Invoke callback.onSendComplete(args...) if the callback recipient provides it
+ */
+template <class CallbackImpl, class... Args>
+auto notifySendComplete(CallbackImpl &callback, int, Args... args) -> decltype(callback.onSendComplete(args...), void()) {
+    callback.onSendComplete(args...);
+}
+
+template <class CallbackImpl, class... Args>
+void notifySendComplete(CallbackImpl &, long, Args...) {
+}
+
+/**
+ * @brief FlowControl tracks a connection's back-pressure and read-pause state and derives the readiness
+ *        events its event loop should monitor.  It isn't thread-safe; the owning connection serializes
+ *        access with its send mutex.
+ */
+class FlowControl {
+public:
+    /**
+     * @brief Construct a new FlowControl object
+     *
+     * @param options - socket options holding the watermarks
+     */
+    explicit FlowControl(const SocketOpt &options)
+        : m_highWatermark(options.m_sendHighWatermark), m_lowWatermark(options.m_sendLowWatermark),
+          m_queueLimit(options.m_sendQueueLimit), m_pauseOnBackPressure(options.m_pauseReadOnBackPressure) {
+    }
+
+    /**
+     * @brief Check whether a message fits in the outbound queue
+     *
+     * @param queued - bytes already queued
+     * @param size - length of the message
+     * @return true - the message may be sent
+     * @return false - queuing the message would exceed the queue limit
+     */
+    bool admit(size_t queued, size_t size) const {
+        // An empty queue always admits a message, however large, so that it can be sent at all
+        return queued == 0 || m_queueLimit == 0 || queued + size <= m_queueLimit;
+    }
+
+    /**
+     * @brief Note that data was queued
+     *
+     * @param queued - bytes now queued
+     * @return true - the queue has just crossed the high watermark
+     */
+    bool queued(size_t queued) {
+        if (!m_backPressured && queued >= m_highWatermark) {
+            m_backPressured = true;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Note that queued data was sent
+     *
+     * @param queued - bytes still queued
+     * @return true - the queue has just drained to the low watermark after crossing the high watermark
+     */
+    bool drained(size_t queued) {
+        if (m_backPressured && queued <= m_lowWatermark) {
+            m_backPressured = false;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Pause or resume reading on behalf of the application
+     *
+     * @param paused - true to stop reading
+     */
+    void pauseRead(bool paused) {
+        m_readPaused = paused;
+    }
+
+    /**
+     * @brief Pause or resume reading because too much received data is waiting for the callback workers
+     *
+     * @param paused - true to stop reading
+     */
+    void pauseInbound(bool paused) {
+        m_inboundPaused = paused;
+    }
+
+    /**
+     * @brief Indicates whether the outbound queue is above the high watermark
+     */
+    bool backPressured() const {
+        return m_backPressured;
+    }
+
+    /**
+     * @brief Readiness events the event loop should monitor
+     *
+     * @param writePending - data is queued waiting for the socket to become writable
+     * @return uint32_t - combination of POLL_READ and POLL_WRITE
+     */
+    uint32_t interest(bool writePending) const {
+        uint32_t events = writePending ? POLL_WRITE : 0;
+        if (!m_readPaused && !m_inboundPaused && !(m_pauseOnBackPressure && m_backPressured)) {
+            events |= POLL_READ;
+        }
+        return events;
+    }
+
+private:
+    /**
+     * @brief Queued bytes at which back-pressure is signalled
+     */
+    size_t m_highWatermark;
+
+    /**
+     * @brief Queued bytes at which back-pressure is released
+     */
+    size_t m_lowWatermark;
+
+    /**
+     * @brief Maximum queued bytes, 0 for no limit
+     */
+    size_t m_queueLimit;
+
+    /**
+     * @brief Stop reading while back-pressured
+     */
+    bool m_pauseOnBackPressure;
+
+    /**
+     * @brief The queue crossed the high watermark and hasn't yet drained to the low watermark
+     */
+    bool m_backPressured = false;
+
+    /**
+     * @brief The application paused reading
+     */
+    bool m_readPaused = false;
+
+    /**
+     * @brief Reading is paused by InboundBacklog
+     */
+    bool m_inboundPaused = false;
+};
+
+/**
+ * @brief InboundBacklog counts the received bytes a connection has posted to its callback strand and not yet
+ *        delivered, so that reading can pause while the callbacks fall behind.  The event loop calls queued() as
+ *        it posts a message and a worker calls consumed() once the callback has run; either one returning true
+ *        means the caller should take the connection's lock and call pause() or resume() respectively, which
+ *        recheck the count so that a pause and a resume racing each other can't leave reading paused.
+ */
+class InboundBacklog {
+public:
+    /**
+     * @brief Construct a new InboundBacklog object
+     *
+     * @param options - socket options holding the inbound watermarks
+     */
+    explicit InboundBacklog(const SocketOpt &options)
+        : m_highWatermark(options.m_recvHighWatermark), m_lowWatermark(options.m_recvLowWatermark) {
+    }
+
+    /**
+     * @brief Note that a message was posted to the callback workers.  Called by the receiving thread.
+     *
+     * @param size - length of the message
+     * @return true - the backlog has reached the high watermark; call pause()
+     */
+    bool queued(size_t size) {
+        return m_bytes.fetch_add(size) + size >= m_highWatermark && !m_paused.load();
+    }
+
+    /**
+     * @brief Note that a message was delivered by the callback workers
+     *
+     * @param size - length of the message
+     * @return true - the backlog has drained to the low watermark while paused; call resume()
+     */
+    bool consumed(size_t size) {
+        return m_bytes.fetch_sub(size) - size <= m_lowWatermark && m_paused.load();
+    }
+
+    /**
+     * @brief Decide whether to pause reading.  Called with the connection's lock held after queued().
+     *
+     * @return true - reading should pause
+     */
+    bool pause() {
+        // Marking the pause before reading the count means a worker draining the backlog meanwhile either
+        // sees the mark in consumed(), or its drained count is seen here
+        m_paused = true;
+        if (m_bytes.load() >= m_highWatermark) {
+            return true;
+        }
+        m_paused = false;
+        return false;
+    }
+
+    /**
+     * @brief Decide whether to resume reading.  Called with the connection's lock held after consumed().
+     *
+     * @return true - reading should resume
+     */
+    bool resume() {
+        if (!m_paused.load() || m_bytes.load() > m_lowWatermark) {
+            return false;
+        }
+        m_paused = false;
+        return true;
+    }
+
+private:
+    /**
+     * @brief Backlog at which reading pauses
+     */
+    size_t m_highWatermark;
+
+    /**
+     * @brief Backlog at which paused reading resumes
+     */
+    size_t m_lowWatermark;
+
+    /**
+     * @brief Received bytes posted to the callback workers and not yet delivered
+     */
+    std::atomic<size_t> m_bytes { 0 };
+
+    /**
+     * @brief Reading is paused until the backlog drains
+     */
+    std::atomic_bool m_paused { false };
+};
+
+}  // namespace sockets
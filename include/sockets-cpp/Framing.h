@@ -0,0 +1,304 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace sockets {
+
+/**
+ * @brief Default limit on the size of a framed message, see SocketOpt::m_maxMessageSize
+ */
+constexpr size_t MAX_MESSAGE_SIZE = 16 * 1024 * 1024;
+
+/**
+ * @brief Byte order of a length prefix
+ */
+enum class ByteOrder {
+    /**
+     * @brief Most significant byte first (network byte order)
+     */
+    BigEndian,
+
+    /**
+     * @brief Least significant byte first
+     */
+    LittleEndian
+};
+
+/**
+ * @brief Result of a codec's attempt to find a message at the start of received data
+ */
+enum class FrameStatus {
+    /**
+     * @brief A complete message was found
+     */
+    Complete,
+
+    /**
+     * @brief More data is needed
+     */
+    Incomplete,
+
+    /**
+     * @brief The data violates the framing, e.g. a declared length beyond the limit
+     */
+    Invalid
+};
+
+/**
+ * @brief Location of a message found by a codec
+ */
+struct Frame {
+    /**
+     * @brief Offset of the message within the frame (i.e. the header size)
+     */
+    size_t m_offset = 0;
+
+    /**
+     * @brief Length of the message
+     */
+    size_t m_length = 0;
+
+    /**
+     * @brief Total bytes occupied by the frame.  For an incomplete frame, the total needed before the codec
+     *        can make progress, or 0 if that isn't known yet.
+     */
+    size_t m_size = 0;
+
+    /**
+     * @brief Leading bytes already searched by an earlier parse of the same incomplete frame, which a codec
+     *        searching for a terminator needn't search again.  Such a codec sets it when the frame is incomplete.
+     */
+    size_t m_scanned = 0;
+};
+
+/**
+ * @brief RawFraming passes every received chunk through as a message, i.e. no framing
+ */
+struct RawFraming {
+    FrameStatus parse(const char *, size_t size, size_t, Frame &frame) const {
+        frame.m_offset = 0;
+        frame.m_length = size;
+        frame.m_size = size;
+        return FrameStatus::Complete;
+    }
+};
+
+/**
+ * @brief LengthPrefixFraming delimits messages with a length header holding the size of the message which follows
+ *
+ * @tparam Bytes - size of the length header: 1, 2, 4 or 8
+ * @tparam Order - byte order of the length header
+ */
+template <size_t Bytes, ByteOrder Order = ByteOrder::BigEndian>
+struct LengthPrefixFraming {
+    static_assert(Bytes == 1 || Bytes == 2 || Bytes == 4 || Bytes == 8, "length prefix must be 1, 2, 4 or 8 bytes");
+
+    FrameStatus parse(const char *data, size_t size, size_t maxMessage, Frame &frame) const {
+        frame.m_offset = Bytes;
+        if (size < Bytes) {
+            frame.m_size = Bytes;
+            return FrameStatus::Incomplete;
+        }
+        uint64_t length = 0;
+        for (size_t idx = 0; idx < Bytes; idx++) {
+            size_t pos = (Order == ByteOrder::BigEndian) ? idx : Bytes - 1 - idx;
+            length = (length << 8) | static_cast<uint8_t>(data[pos]);
+        }
+        if (length > maxMessage) {
+            return FrameStatus::Invalid;
+        }
+        frame.m_length = static_cast<size_t>(length);
+        frame.m_size = Bytes + frame.m_length;
+        return (size < frame.m_size) ? FrameStatus::Incomplete : FrameStatus::Complete;
+    }
+
+    /**
+     * @brief Encode the length header which a sender writes before a message
+     *
+     * @param length - length of the message
+     * @return std::array<char, Bytes> - the header
+     */
+    static std::array<char, Bytes> header(size_t length) {
+        std::array<char, Bytes> hdr {};
+        auto value = static_cast<uint64_t>(length);
+        for (size_t idx = 0; idx < Bytes; idx++) {
+            size_t pos = (Order == ByteOrder::BigEndian) ? Bytes - 1 - idx : idx;
+            hdr[pos] = static_cast<char>(value & 0xff);
+            value >>= 8;
+        }
+        return hdr;
+    }
+};
+
+/**
+ * @brief FixedFraming delivers messages of a fixed size
+ *
+ * @tparam Size - size of every message
+ */
+template <size_t Size>
+struct FixedFraming {
+    static_assert(Size > 0, "fixed message size must be non-zero");
+
+    FrameStatus parse(const char *, size_t size, size_t maxMessage, Frame &frame) const {
+        if (Size > maxMessage) {
+            return FrameStatus::Invalid;
+        }
+        frame.m_offset = 0;
+        frame.m_length = Size;
+        frame.m_size = Size;
+        return (size < Size) ? FrameStatus::Incomplete : FrameStatus::Complete;
+    }
+};
+
+/**
+ * @brief DelimiterFraming delivers messages terminated by a delimiter character.  The delimiter isn't
+ *        part of the delivered message.
+ *
+ * @tparam Delimiter - the message terminator
+ */
+template <char Delimiter = '\n'>
+struct DelimiterFraming {
+    FrameStatus parse(const char *data, size_t size, size_t maxMessage, Frame &frame) const {
+        frame.m_offset = 0;
+        // Bytes searched before more data arrived can't hold the delimiter
+        size_t from = std::min(frame.m_scanned, size);
+        const void *end = std::memchr(data + from, Delimiter, size - from);
+        if (end == nullptr) {
+            frame.m_size = 0;
+            frame.m_scanned = size;
+            return (size > maxMessage) ? FrameStatus::Invalid : FrameStatus::Incomplete;
+        }
+        frame.m_length = static_cast<size_t>(static_cast<const char *>(end) - data);
+        frame.m_size = frame.m_length + 1;
+        return (frame.m_length > maxMessage) ? FrameStatus::Invalid : FrameStatus::Complete;
+    }
+};
+
+/**
+ * @brief Messages terminated by a newline
+ */
+using LineFraming = DelimiterFraming<'\n'>;
+
+/**
+ * @brief Framer reassembles messages from the chunks received on one connection.  Complete messages which
+ *        lie within a received chunk are delivered straight from the receive buffer; only a message split
+ *        across chunks is copied, into the connection's reassembly buffer.
+ *
+ * @tparam Codec - framing codec, e.g. LengthPrefixFraming, FixedFraming, DelimiterFraming or RawFraming
+ */
+template <class Codec>
+class Framer {
+public:
+    /**
+     * @brief Construct a new Framer object
+     *
+     * @param maxMessage - largest message accepted; longer messages are a framing violation
+     */
+    explicit Framer(size_t maxMessage = MAX_MESSAGE_SIZE) : m_maxMessage(maxMessage) {
+    }
+
+    /**
+     * @brief Feed received data, delivering each message it completes
+     *
+     * @param data - the received data
+     * @param size - length of the received data
+     * @param deliver - callable taking (const char *msg, size_t size), invoked for each complete message
+     * @return FrameStatus - FrameStatus::Invalid if the data violates the framing, otherwise Complete
+     */
+    template <class Deliver>
+    FrameStatus feed(const char *data, size_t size, Deliver &&deliver) {
+        Frame frame;
+        // Finish the message started by earlier chunks
+        while (!m_pending.empty() && size > 0) {
+            size_t held = m_pending.size();
+            size_t take = size;
+            frame.m_scanned = m_scanned;
+            if (m_codec.parse(m_pending.data(), held, m_maxMessage, frame) == FrameStatus::Invalid) {
+                return FrameStatus::Invalid;
+            }
+            if (frame.m_size > held) {
+                // Copy just what the codec needs to make progress
+                take = std::min(size, frame.m_size - held);
+            }
+            m_pending.insert(m_pending.end(), data, data + take);
+            frame.m_scanned = m_scanned;
+            FrameStatus status = m_codec.parse(m_pending.data(), m_pending.size(), m_maxMessage, frame);
+            if (status == FrameStatus::Invalid) {
+                return status;
+            }
+            if (status == FrameStatus::Incomplete) {
+                m_scanned = frame.m_scanned;
+                data += take;
+                size -= take;
+                continue;
+            }
+            deliver(m_pending.data() + frame.m_offset, frame.m_length);
+            // The frame may end before the copied data does; resume in the receive buffer after it
+            size_t used = frame.m_size - held;
+            m_pending.clear();
+            m_scanned = 0;
+            data += used;
+            size -= used;
+        }
+
+        while (size > 0) {
+            frame.m_scanned = 0;
+            FrameStatus status = m_codec.parse(data, size, m_maxMessage, frame);
+            if (status == FrameStatus::Invalid) {
+                return status;
+            }
+            if (status == FrameStatus::Incomplete) {
+                m_pending.assign(data, data + size);
+                m_scanned = frame.m_scanned;
+                break;
+            }
+            deliver(data + frame.m_offset, frame.m_length);
+            data += frame.m_size;
+            size -= frame.m_size;
+        }
+        return FrameStatus::Complete;
+    }
+
+    /**
+     * @brief Discard any partially received message
+     */
+    void reset() {
+        m_pending.clear();
+        m_scanned = 0;
+    }
+
+    /**
+     * @brief Number of bytes of a partially received message being held
+     */
+    size_t pending() const {
+        return m_pending.size();
+    }
+
+private:
+    /**
+     * @brief The framing codec
+     */
+    Codec m_codec;
+
+    /**
+     * @brief Largest message accepted
+     */
+    size_t m_maxMessage;
+
+    /**
+     * @brief Bytes of a message split across received chunks
+     */
+    std::vector<char> m_pending;
+
+    /**
+     * @brief Leading bytes of m_pending the codec has already searched, see Frame::m_scanned.  Without it a
+     *        long delimited message would be searched from the start for every chunk it arrives in.
+     */
+    size_t m_scanned = 0;
+};
+
+}  // namespace sockets
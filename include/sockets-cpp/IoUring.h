@@ -0,0 +1,401 @@
+#pragma once
+#include "SocketCore.h"
+
+// io_uring support needs kernel headers recent enough for multishot accept and recv and zero-copy send
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#if defined(IORING_RECV_MULTISHOT) && defined(IORING_ACCEPT_MULTISHOT) && defined(IORING_FEAT_EXT_ARG) && \
+    defined(IORING_CQE_F_NOTIF)
+#define SOCKETS_IO_URING 1
+#endif
+#endif
+#endif
+
+#if defined(SOCKETS_IO_URING)
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <vector>
+
+namespace sockets {
+
+/**
+ * @brief IoUring is a minimal io_uring instance: the submission and completion rings mapped from the kernel,
+ *        driven with raw system calls so that no liburing dependency is needed.  It isn't thread-safe; callers
+ *        serialize access to the submission queue, and only one thread consumes completions.
+ */
+class IoUring {
+public:
+    IoUring() = default;
+
+    IoUring(const IoUring &) = delete;
+    IoUring(IoUring &&) = delete;
+
+    ~IoUring() {
+        close();
+    }
+
+    IoUring &operator=(const IoUring &) = delete;
+    IoUring &operator=(IoUring &&) = delete;
+
+    /**
+     * @brief Create the io_uring instance and map its rings
+     *
+     * @param entries - submission queue size; the completion queue is larger since multishot requests post
+     *          many completions each
+     * @return int - 0 indicates success, -1 indicates failure (errno is set)
+     */
+    int open(unsigned entries) {
+        constexpr unsigned CQ_MULTIPLIER = 4;
+        close();
+        struct io_uring_params params {};
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = entries * CQ_MULTIPLIER;
+        int fd = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0) {
+            return -1;
+        }
+        m_fd = fd;
+        if ((params.features & IORING_FEAT_SINGLE_MMAP) == 0 || (params.features & IORING_FEAT_EXT_ARG) == 0) {
+            close();
+            errno = ENOTSUP;
+            return -1;
+        }
+
+        m_ringSize = std::max(params.sq_off.array + params.sq_entries * sizeof(unsigned),
+                              params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe));
+        void *ring = ::mmap(nullptr, m_ringSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+        if (ring == MAP_FAILED) {
+            close();
+            return -1;
+        }
+        m_ring = static_cast<char *>(ring);
+        m_sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+        void *sqes = ::mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            close();
+            return -1;
+        }
+        m_sqes = static_cast<struct io_uring_sqe *>(sqes);
+
+        m_sqHead = reinterpret_cast<unsigned *>(m_ring + params.sq_off.head);
+        m_sqTail = reinterpret_cast<unsigned *>(m_ring + params.sq_off.tail);
+        m_sqMask = *reinterpret_cast<unsigned *>(m_ring + params.sq_off.ring_mask);
+        m_sqEntries = params.sq_entries;
+        m_cqHead = reinterpret_cast<unsigned *>(m_ring + params.cq_off.head);
+        m_cqTail = reinterpret_cast<unsigned *>(m_ring + params.cq_off.tail);
+        m_cqMask = *reinterpret_cast<unsigned *>(m_ring + params.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<struct io_uring_cqe *>(m_ring + params.cq_off.cqes);
+
+        // Submission queue entries are always used in ring order
+        auto *array = reinterpret_cast<unsigned *>(m_ring + params.sq_off.array);
+        for (unsigned idx = 0; idx < m_sqEntries; idx++) {
+            array[idx] = idx;
+        }
+        m_sqLocalTail = *m_sqTail;
+        return 0;
+    }
+
+    /**
+     * @brief Destroy the io_uring instance, cancelling outstanding requests
+     */
+    void close() {
+        if (m_sqes != nullptr) {
+            ::munmap(m_sqes, m_sqesSize);
+            m_sqes = nullptr;
+        }
+        if (m_ring != nullptr) {
+            ::munmap(m_ring, m_ringSize);
+            m_ring = nullptr;
+        }
+        if (m_fd >= 0) {
+            ::close(m_fd);
+            m_fd = -1;
+        }
+    }
+
+    /**
+     * @brief Indicates whether the instance is open
+     */
+    bool isOpen() const {
+        return m_fd >= 0;
+    }
+
+    /**
+     * @brief Get the file descriptor of the io_uring instance
+     */
+    int fd() const {
+        return m_fd;
+    }
+
+    /**
+     * @brief Get a cleared submission queue entry to fill in.  It's submitted by the next submit().
+     *
+     * @return struct io_uring_sqe* - the entry, or nullptr if the submission queue is full
+     */
+    struct io_uring_sqe *getSqe() {
+        if (m_sqLocalTail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) >= m_sqEntries) {
+            return nullptr;
+        }
+        struct io_uring_sqe *sqe = &m_sqes[m_sqLocalTail & m_sqMask];
+        memset(sqe, 0, sizeof(*sqe));
+        m_sqLocalTail++;
+        return sqe;
+    }
+
+    /**
+     * @brief Submit the queued entries without waiting for completions
+     *
+     * @return int - number of entries submitted, or -1 on failure (errno is set)
+     */
+    int submit() {
+        unsigned pending = publish();
+        if (pending == 0) {
+            return 0;
+        }
+        return enter(pending, 0, 0, nullptr);
+    }
+
+    /**
+     * @brief Wait for at least one completion.  Unlike submit(), this doesn't touch the submission queue, so it
+     *          may run without the lock serializing submissions.
+     *
+     * @param timeoutMs - maximum time to wait in milliseconds, negative to wait indefinitely
+     * @return int - 0 when completions are ready or the wait timed out, -1 on failure (errno is set)
+     */
+    int wait(int timeoutMs) {
+        constexpr long NSEC_PER_MSEC = 1000000;
+        constexpr int MSEC_PER_SEC = 1000;
+        if (ready() > 0) {
+            return 0;
+        }
+        if (timeoutMs < 0) {
+            if (enter(0, 1, IORING_ENTER_GETEVENTS, nullptr) < 0 && errno != EINTR) {
+                return -1;
+            }
+            return 0;
+        }
+        struct __kernel_timespec timeout {};
+        timeout.tv_sec = timeoutMs / MSEC_PER_SEC;
+        timeout.tv_nsec = static_cast<long long>(timeoutMs % MSEC_PER_SEC) * NSEC_PER_MSEC;
+        struct io_uring_getevents_arg arg {};
+        arg.ts = reinterpret_cast<uint64_t>(&timeout);
+        if (enter(0, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg) < 0 && errno != ETIME && errno != EINTR) {
+            return -1;
+        }
+        return 0;
+    }
+
+    /**
+     * @brief Number of completions waiting to be consumed
+     */
+    unsigned ready() const {
+        return __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE) - *m_cqHead;
+    }
+
+    /**
+     * @brief Consume the waiting completions
+     *
+     * @param func - callable taking (const struct io_uring_cqe &), invoked for each completion
+     * @return unsigned - number of completions consumed
+     */
+    template <class Func>
+    unsigned consume(Func &&func) {
+        unsigned head = *m_cqHead;
+        unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+        for (unsigned idx = head; idx != tail; idx++) {
+            func(m_cqes[idx & m_cqMask]);
+        }
+        __atomic_store_n(m_cqHead, tail, __ATOMIC_RELEASE);
+        return tail - head;
+    }
+
+    /**
+     * @brief Issue an io_uring_register() call
+     *
+     * @param opcode - the IORING_REGISTER_* operation
+     * @param arg - the operation's argument
+     * @param count - the operation's argument count
+     * @return int - 0 (or a positive result) on success, -1 on failure (errno is set)
+     */
+    int registerOp(unsigned opcode, void *arg, unsigned count) {
+        return static_cast<int>(::syscall(__NR_io_uring_register, m_fd, opcode, arg, count));
+    }
+
+private:
+    /**
+     * @brief Make the entries filled in since the last call visible to the kernel
+     *
+     * @return unsigned - number of entries the kernel hasn't consumed yet
+     */
+    unsigned publish() {
+        __atomic_store_n(m_sqTail, m_sqLocalTail, __ATOMIC_RELEASE);
+        return m_sqLocalTail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+    }
+
+    int enter(unsigned toSubmit, unsigned minComplete, unsigned flags, struct io_uring_getevents_arg *arg) {
+        return static_cast<int>(::syscall(__NR_io_uring_enter, m_fd, toSubmit, minComplete, flags, arg,
+                                          arg != nullptr ? sizeof(*arg) : 0));
+    }
+
+    /**
+     * @brief The io_uring file descriptor
+     */
+    int m_fd = -1;
+
+    /**
+     * @brief Mapping holding the submission and completion rings
+     */
+    char *m_ring = nullptr;
+    size_t m_ringSize = 0;
+
+    /**
+     * @brief Mapping holding the submission queue entries
+     */
+    struct io_uring_sqe *m_sqes = nullptr;
+    size_t m_sqesSize = 0;
+
+    /**
+     * @brief Submission ring indices, mask and size
+     */
+    unsigned *m_sqHead = nullptr;
+    unsigned *m_sqTail = nullptr;
+    unsigned m_sqMask = 0;
+    unsigned m_sqEntries = 0;
+
+    /**
+     * @brief Tail including entries not yet published to the kernel
+     */
+    unsigned m_sqLocalTail = 0;
+
+    /**
+     * @brief Completion ring indices, mask and entries
+     */
+    unsigned *m_cqHead = nullptr;
+    unsigned *m_cqTail = nullptr;
+    unsigned m_cqMask = 0;
+    struct io_uring_cqe *m_cqes = nullptr;
+};
+
+/**
+ * @brief BufferGroup is a group of receive buffers provided to the kernel.  A multishot receive picks a free
+ *        buffer for each completion, so buffers are only tied up by data which has actually arrived.  A
+ *        buffer must be provided again once its data has been consumed.
+ *
+ *        Buffers are provided with IORING_OP_PROVIDE_BUFFERS rather than a registered buffer ring, which
+ *        saves a request per recycled buffer but isn't honoured by every kernel that accepts the registration.
+ */
+class BufferGroup {
+public:
+    /**
+     * @brief Allocate the buffers
+     *
+     * @param groupId - buffer group selected by receive requests
+     * @param count - number of buffers, no more than 32768
+     * @param size - size of each buffer
+     * @return int - 0 indicates success, -1 indicates failure (errno is set)
+     */
+    int allocate(uint16_t groupId, unsigned count, size_t size) {
+        constexpr unsigned MAX_BUFFERS = 32768;
+        constexpr size_t MAX_SIZE = 0x7fffffff;
+        release();
+        if (count == 0 || count > MAX_BUFFERS || size == 0 || size > MAX_SIZE) {
+            errno = EINVAL;
+            return -1;
+        }
+        m_storage.resize(count * size);
+        m_count = count;
+        m_size = size;
+        m_groupId = groupId;
+        return 0;
+    }
+
+    /**
+     * @brief Free the buffers.  No request may still be using them.
+     */
+    void release() {
+        m_storage.clear();
+        m_storage.shrink_to_fit();
+        m_count = 0;
+    }
+
+    /**
+     * @brief Fill in a request providing a run of buffers to the kernel
+     *
+     * @param sqe - the submission queue entry
+     * @param bid - id of the first buffer
+     * @param count - number of buffers
+     * @param userData - user data of the request
+     */
+    void provide(struct io_uring_sqe *sqe, uint16_t bid, unsigned count, uint64_t userData) const {
+        sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+        sqe->fd = static_cast<int>(count);
+        sqe->addr = reinterpret_cast<uint64_t>(buffer(bid));
+        sqe->len = static_cast<uint32_t>(m_size);
+        sqe->off = bid;
+        sqe->buf_group = m_groupId;
+        sqe->user_data = userData;
+    }
+
+    /**
+     * @brief Fill in a request taking all unused buffers back from the kernel
+     *
+     * @param sqe - the submission queue entry
+     * @param userData - user data of the request
+     */
+    void remove(struct io_uring_sqe *sqe, uint64_t userData) const {
+        sqe->opcode = IORING_OP_REMOVE_BUFFERS;
+        sqe->fd = static_cast<int>(m_count);
+        sqe->buf_group = m_groupId;
+        sqe->user_data = userData;
+    }
+
+    /**
+     * @brief Get the data of a buffer picked by the kernel
+     *
+     * @param bid - buffer id reported in the completion flags
+     */
+    const char *buffer(uint16_t bid) const {
+        return m_storage.data() + static_cast<size_t>(bid) * m_size;
+    }
+
+    /**
+     * @brief Get the number of buffers
+     */
+    unsigned count() const {
+        return m_count;
+    }
+
+    /**
+     * @brief Get the buffer group id
+     */
+    uint16_t groupId() const {
+        return m_groupId;
+    }
+
+private:
+    /**
+     * @brief The buffers themselves
+     */
+    std::vector<char> m_storage;
+
+    /**
+     * @brief Number and size of the buffers
+     */
+    unsigned m_count = 0;
+    size_t m_size = 0;
+
+    /**
+     * @brief Buffer group id
+     */
+    uint16_t m_groupId = 0;
+};
+
+}  // namespace sockets
+
+#endif
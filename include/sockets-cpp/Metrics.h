@@ -0,0 +1,610 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace sockets {
+
+/**
+ * @brief Size of a cache line, the granularity counters written by different threads are kept apart at
+ */
+constexpr size_t CACHE_LINE_SIZE = 64;
+
+/**
+ * @brief Default number of per-thread counter blocks kept by a socket's metrics
+ */
+constexpr size_t METRIC_SHARDS = 8;
+
+/**
+ * @brief Counters kept by a socket, in total and per TcpServer connection
+ */
+enum class Counter : size_t {
+    /**
+     * @brief Bytes received
+     */
+    BytesIn,
+
+    /**
+     * @brief Bytes handed to the kernel for sending
+     */
+    BytesOut,
+
+    /**
+     * @brief Messages delivered to the receive callback, after framing
+     */
+    MessagesIn,
+
+    /**
+     * @brief Messages (and file ranges) accepted for sending
+     */
+    MessagesOut,
+
+    /**
+     * @brief Receive calls made, or io_uring receive completions
+     */
+    RecvCalls,
+
+    /**
+     * @brief Send calls made, including those flushing a send queue, or io_uring zero-copy sends submitted
+     */
+    SendCalls,
+
+    /**
+     * @brief Send calls which failed with EAGAIN/EWOULDBLOCK because the kernel send buffer was full
+     */
+    SendWouldBlock,
+
+    /**
+     * @brief Send calls which sent only part of the data
+     */
+    SendPartial,
+
+    /**
+     * @brief Send calls which failed outright
+     */
+    SendErrors,
+
+    /**
+     * @brief Waits made by the event loops (select(), epoll_wait() or io_uring_enter())
+     */
+    PollWaits,
+
+    /**
+     * @brief Bytes currently waiting in send queues.  A gauge rather than a counter; a snapshot taken while it
+     *        changes may be slightly off.
+     */
+    QueuedBytes,
+
+    /**
+     * @brief Connections closed by the peer
+     */
+    DisconnectPeer,
+
+    /**
+     * @brief Connections lost to a receive or send failure
+     */
+    DisconnectError,
+
+    /**
+     * @brief Connections closed for violating the message framing
+     */
+    DisconnectFraming,
+
+    /**
+     * @brief Connections closed for being idle too long
+     */
+    DisconnectIdle,
+
+    /**
+     * @brief Connections closed by the application, e.g. with TcpServer::deleteClient()
+     */
+    DisconnectLocal
+};
+
+/**
+ * @brief Number of Counter values
+ */
+constexpr size_t COUNTER_COUNT = static_cast<size_t>(Counter::DisconnectLocal) + 1;
+
+/**
+ * @brief LatencyHistogram counts durations in nanoseconds in log-linear buckets, in the manner of an HDR
+ *        histogram: each power of two is split into 16 equal sub-buckets, so every recorded value is known to
+ *        within 1/16 (6.25%) across the whole range at a fixed, small size.  Values from 0 to 31ns are exact;
+ *        values beyond about 18 minutes share the top bucket.  A snapshot type: not thread-safe.
+ */
+class LatencyHistogram {
+public:
+    /**
+     * @brief Log2 of the number of sub-buckets per power of two
+     */
+    static constexpr unsigned SUB_BITS = 4;
+
+    /**
+     * @brief Number of sub-buckets per power of two
+     */
+    static constexpr size_t SUB_BUCKETS = size_t(1) << SUB_BITS;
+
+    /**
+     * @brief Most significant bit of the largest value with a bucket of its own
+     */
+    static constexpr unsigned MAX_BIT = 39;
+
+    /**
+     * @brief Number of buckets
+     */
+    static constexpr size_t BUCKETS = (MAX_BIT - SUB_BITS + 2) * SUB_BUCKETS;
+
+    /**
+     * @brief Bucket a value is counted in
+     *
+     * @param value - the value
+     * @return size_t - index of its bucket
+     */
+    static size_t bucketOf(uint64_t value) {
+        if (value < SUB_BUCKETS) {
+            return static_cast<size_t>(value);
+        }
+        unsigned msb = 63U - static_cast<unsigned>(countLeadingZeros(value));
+        if (msb > MAX_BIT) {
+            return BUCKETS - 1;
+        }
+        unsigned shift = msb - SUB_BITS;
+        return (msb - SUB_BITS + 1) * SUB_BUCKETS + static_cast<size_t>((value >> shift) & (SUB_BUCKETS - 1));
+    }
+
+    /**
+     * @brief Smallest value counted in a bucket
+     *
+     * @param bucket - index of the bucket
+     */
+    static uint64_t bucketLow(size_t bucket) {
+        size_t group = bucket / SUB_BUCKETS;
+        uint64_t sub = bucket % SUB_BUCKETS;
+        return (group == 0) ? sub : (SUB_BUCKETS + sub) << (group - 1);
+    }
+
+    /**
+     * @brief Largest value counted in a bucket
+     *
+     * @param bucket - index of the bucket
+     */
+    static uint64_t bucketHigh(size_t bucket) {
+        size_t group = bucket / SUB_BUCKETS;
+        return bucketLow(bucket) + ((group <= 1) ? 0 : (uint64_t(1) << (group - 1)) - 1);
+    }
+
+    /**
+     * @brief Record a value
+     *
+     * @param value - the value, in nanoseconds
+     * @param count - number of times it occurred
+     */
+    void record(uint64_t value, uint64_t count = 1) {
+        if (count == 0) {
+            return;
+        }
+        addBucket(bucketOf(value), count);
+        m_sum += value * count;
+        m_max = std::max(m_max, value);
+    }
+
+    /**
+     * @brief Add a bucket count, e.g. one read from a ConcurrentHistogram
+     *
+     * @param bucket - index of the bucket
+     * @param count - number of values in it
+     */
+    void addBucket(size_t bucket, uint64_t count) {
+        if (m_buckets.empty()) {
+            m_buckets.assign(BUCKETS, 0);
+        }
+        m_buckets[std::min(bucket, BUCKETS - 1)] += count;
+        m_count += count;
+    }
+
+    /**
+     * @brief Add the sum and maximum of values counted with addBucket()
+     */
+    void addTotals(uint64_t sum, uint64_t max) {
+        m_sum += sum;
+        m_max = std::max(m_max, max);
+    }
+
+    /**
+     * @brief Number of values recorded
+     */
+    uint64_t count() const {
+        return m_count;
+    }
+
+    /**
+     * @brief Largest value recorded
+     */
+    uint64_t max() const {
+        return m_max;
+    }
+
+    /**
+     * @brief Mean of the values recorded, 0 if there are none
+     */
+    double mean() const {
+        return (m_count == 0) ? 0.0 : static_cast<double>(m_sum) / static_cast<double>(m_count);
+    }
+
+    /**
+     * @brief Value at a percentile: the highest value counted in the bucket reaching that share of the values
+     *
+     * @param percentile - 0 to 100, e.g. 99.9
+     * @return uint64_t - the value, 0 if none were recorded
+     */
+    uint64_t percentile(double percentile) const {
+        if (m_count == 0) {
+            return 0;
+        }
+        double clamped = std::min(100.0, std::max(0.0, percentile));
+        auto target = static_cast<uint64_t>(clamped / 100.0 * static_cast<double>(m_count) + 0.5);
+        target = std::max<uint64_t>(1, std::min(target, m_count));
+        uint64_t seen = 0;
+        for (size_t bucket = 0; bucket < m_buckets.size(); bucket++) {
+            seen += m_buckets[bucket];
+            if (seen >= target) {
+                return std::min(bucketHigh(bucket), m_max);
+            }
+        }
+        return m_max;
+    }
+
+    /**
+     * @brief Number of values counted in each bucket, empty if none were recorded
+     */
+    const std::vector<uint64_t> &buckets() const {
+        return m_buckets;
+    }
+
+    /**
+     * @brief Add the values of another histogram
+     */
+    LatencyHistogram &operator+=(const LatencyHistogram &other) {
+        for (size_t bucket = 0; bucket < other.m_buckets.size(); bucket++) {
+            if (other.m_buckets[bucket] != 0) {
+                addBucket(bucket, other.m_buckets[bucket]);
+            }
+        }
+        addTotals(other.m_sum, other.m_max);
+        return *this;
+    }
+
+private:
+    static int countLeadingZeros(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+        return __builtin_clzll(value);
+#else
+        int count = 0;
+        for (uint64_t bit = uint64_t(1) << 63; (value & bit) == 0; bit >>= 1) {
+            count++;
+        }
+        return count;
+#endif
+    }
+
+    /**
+     * @brief Count of values in each bucket, allocated by the first record
+     */
+    std::vector<uint64_t> m_buckets;
+
+    /**
+     * @brief Number, sum and maximum of the values recorded
+     */
+    uint64_t m_count = 0;
+    uint64_t m_sum = 0;
+    uint64_t m_max = 0;
+};
+
+/**
+ * @brief ConcurrentHistogram is the recording side of a LatencyHistogram: the same buckets as relaxed atomic
+ *        counters, so one thread can record while another reads a snapshot
+ */
+class ConcurrentHistogram {
+public:
+    /**
+     * @brief Record a value
+     *
+     * @param value - the value, in nanoseconds
+     */
+    void record(uint64_t value) {
+        m_buckets[LatencyHistogram::bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(value, std::memory_order_relaxed);
+        uint64_t max = m_max.load(std::memory_order_relaxed);
+        while (value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed)) {
+        }
+    }
+
+    /**
+     * @brief Add the values recorded so far to a histogram
+     *
+     * @param histogram - receives the values
+     */
+    void snapshot(LatencyHistogram &histogram) const {
+        for (size_t bucket = 0; bucket < m_buckets.size(); bucket++) {
+            uint64_t count = m_buckets[bucket].load(std::memory_order_relaxed);
+            if (count != 0) {
+                histogram.addBucket(bucket, count);
+            }
+        }
+        histogram.addTotals(m_sum.load(std::memory_order_relaxed), m_max.load(std::memory_order_relaxed));
+    }
+
+private:
+    std::array<std::atomic<uint64_t>, LatencyHistogram::BUCKETS> m_buckets {};
+    std::atomic<uint64_t> m_sum { 0 };
+    std::atomic<uint64_t> m_max { 0 };
+};
+
+/**
+ * @brief A snapshot of a socket's or connection's counters and latency histograms
+ */
+struct SocketMetrics {
+    /**
+     * @brief Value of each Counter, indexed by the Counter
+     */
+    std::array<uint64_t, COUNTER_COUNT> m_counters {};
+
+    /**
+     * @brief Time each callback took to run, in nanoseconds
+     */
+    LatencyHistogram m_callbackTime;
+
+    /**
+     * @brief Time from a message being sent to its last byte being handed to the kernel, in nanoseconds.  For
+     *        a message sent at once this is the send call; for a queued one it includes the time in the queue.
+     */
+    LatencyHistogram m_sendLatency;
+
+    /**
+     * @brief Value of a counter
+     */
+    uint64_t operator[](Counter counter) const {
+        return m_counters[static_cast<size_t>(counter)];
+    }
+
+    /**
+     * @brief Add the counters and histograms of another snapshot
+     */
+    SocketMetrics &operator+=(const SocketMetrics &other) {
+        for (size_t idx = 0; idx < COUNTER_COUNT; idx++) {
+            m_counters[idx] += other.m_counters[idx];
+        }
+        m_callbackTime += other.m_callbackTime;
+        m_sendLatency += other.m_sendLatency;
+        return *this;
+    }
+};
+
+/**
+ * @brief Metrics holds a socket's counters and latency histograms.  Each thread updates a block of its own,
+ *        padded to a cache line, so the IO threads, worker threads and senders don't contend for the counters;
+ *        snapshot() sums the blocks with relaxed loads and never blocks a writer.  Thread-safe.
+ */
+class Metrics {
+public:
+    /**
+     * @brief Construct a new Metrics object
+     *
+     * @param histograms - record the latency histograms, at the cost of reading the clock around each callback
+     *          and send
+     * @param threads - number of threads expected to update the metrics, rounded up to a power of two
+     */
+    explicit Metrics(bool histograms = true, size_t threads = METRIC_SHARDS) {
+        size_t count = 1;
+        while (count < threads) {
+            count <<= 1;
+        }
+        m_mask = count - 1;
+        m_shards.reset(new Shard[count]);
+        if (histograms) {
+            m_timings.reset(new Timings[count]);
+        }
+    }
+
+    Metrics(const Metrics &) = delete;
+    Metrics &operator=(const Metrics &) = delete;
+
+    /**
+     * @brief Add to a counter
+     *
+     * @param counter - the counter
+     * @param value - amount to add; a gauge may be lowered by adding the two's complement
+     */
+    void add(Counter counter, uint64_t value = 1) {
+        m_shards[slot() & m_mask].m_counters[static_cast<size_t>(counter)].fetch_add(value, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Indicates whether the latency histograms are recorded
+     */
+    bool timing() const {
+        return m_timings != nullptr;
+    }
+
+    /**
+     * @brief Record the time a callback took
+     */
+    void recordCallback(std::chrono::steady_clock::duration duration) {
+        if (m_timings) {
+            m_timings[slot() & m_mask].m_callbackTime.record(nanoseconds(duration));
+        }
+    }
+
+    /**
+     * @brief Record the latency of a send
+     */
+    void recordSend(std::chrono::steady_clock::duration duration) {
+        if (m_timings) {
+            m_timings[slot() & m_mask].m_sendLatency.record(nanoseconds(duration));
+        }
+    }
+
+    /**
+     * @brief Run a callback, recording the time it takes
+     *
+     * @param callback - the callback invocation
+     */
+    template <class Callback>
+    void timeCallback(Callback &&callback) {
+        if (!m_timings) {
+            callback();
+            return;
+        }
+        auto start = std::chrono::steady_clock::now();
+        callback();
+        recordCallback(std::chrono::steady_clock::now() - start);
+    }
+
+    /**
+     * @brief Add the current counters and histograms to a snapshot
+     *
+     * @param metrics - receives the values
+     */
+    void snapshot(SocketMetrics &metrics) const {
+        size_t count = m_mask + 1;
+        std::array<uint64_t, COUNTER_COUNT> counters {};
+        for (size_t shard = 0; shard < count; shard++) {
+            for (size_t idx = 0; idx < COUNTER_COUNT; idx++) {
+                counters[idx] += m_shards[shard].m_counters[idx].load(std::memory_order_relaxed);
+            }
+            if (m_timings) {
+                m_timings[shard].m_callbackTime.snapshot(metrics.m_callbackTime);
+                m_timings[shard].m_sendLatency.snapshot(metrics.m_sendLatency);
+            }
+        }
+        addCounters(metrics, counters);
+    }
+
+    /**
+     * @brief Add counters read from per-thread blocks to a snapshot.  A gauge whose blocks were read mid-update
+     *          may sum below zero, which is reported as 0.
+     */
+    static void addCounters(SocketMetrics &metrics, const std::array<uint64_t, COUNTER_COUNT> &counters) {
+        for (size_t idx = 0; idx < COUNTER_COUNT; idx++) {
+            uint64_t value = counters[idx];
+            if (idx == static_cast<size_t>(Counter::QueuedBytes) && static_cast<int64_t>(value) < 0) {
+                value = 0;
+            }
+            metrics.m_counters[idx] += value;
+        }
+    }
+
+private:
+    /**
+     * @brief One thread's counters, on cache lines of their own
+     */
+    struct alignas(CACHE_LINE_SIZE) Shard {
+        std::array<std::atomic<uint64_t>, COUNTER_COUNT> m_counters {};
+    };
+
+    /**
+     * @brief One thread's histograms
+     */
+    struct alignas(CACHE_LINE_SIZE) Timings {
+        ConcurrentHistogram m_callbackTime;
+        ConcurrentHistogram m_sendLatency;
+    };
+
+    static uint64_t nanoseconds(std::chrono::steady_clock::duration duration) {
+        auto count = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+        return (count < 0) ? 0 : static_cast<uint64_t>(count);
+    }
+
+    /**
+     * @brief Number identifying the calling thread, which picks its block
+     */
+    static size_t slot() {
+        static std::atomic<size_t> nextSlot { 0 };
+        thread_local size_t threadSlot = nextSlot.fetch_add(1, std::memory_order_relaxed);
+        return threadSlot;
+    }
+
+    /**
+     * @brief Number of blocks - 1
+     */
+    size_t m_mask = 0;
+
+    /**
+     * @brief Per-thread counters
+     */
+    std::unique_ptr<Shard[]> m_shards;
+
+    /**
+     * @brief Per-thread histograms, when recorded
+     */
+    std::unique_ptr<Timings[]> m_timings;
+};
+
+/**
+ * @brief ConnectionMetrics holds the counters of one connection, and adds everything counted to the owning
+ *        socket's Metrics too.  Thread-safe.
+ */
+class ConnectionMetrics {
+public:
+    /**
+     * @brief Construct a new ConnectionMetrics object
+     *
+     * @param total - the owning socket's metrics, or nullptr
+     */
+    explicit ConnectionMetrics(Metrics *total = nullptr) : m_total(total) {
+    }
+
+    ConnectionMetrics(const ConnectionMetrics &) = delete;
+    ConnectionMetrics &operator=(const ConnectionMetrics &) = delete;
+
+    /**
+     * @brief Add to a counter of the connection and of its socket
+     *
+     * @param counter - the counter
+     * @param value - amount to add; a gauge may be lowered by adding the two's complement
+     */
+    void add(Counter counter, uint64_t value = 1) {
+        m_counters[static_cast<size_t>(counter)].fetch_add(value, std::memory_order_relaxed);
+        if (m_total != nullptr) {
+            m_total->add(counter, value);
+        }
+    }
+
+    /**
+     * @brief The owning socket's metrics, or nullptr
+     */
+    Metrics *total() const {
+        return m_total;
+    }
+
+    /**
+     * @brief Add the connection's counters to a snapshot
+     *
+     * @param metrics - receives the values
+     */
+    void snapshot(SocketMetrics &metrics) const {
+        std::array<uint64_t, COUNTER_COUNT> counters {};
+        for (size_t idx = 0; idx < COUNTER_COUNT; idx++) {
+            counters[idx] = m_counters[idx].load(std::memory_order_relaxed);
+        }
+        Metrics::addCounters(metrics, counters);
+    }
+
+private:
+    /**
+     * @brief The owning socket's metrics
+     */
+    Metrics *m_total;
+
+    /**
+     * @brief The connection's counters, on cache lines of their own
+     */
+    alignas(CACHE_LINE_SIZE) std::array<std::atomic<uint64_t>, COUNTER_COUNT> m_counters {};
+};
+
+}  // namespace sockets
@@ -0,0 +1,840 @@
+#pragma once
+#include "Metrics.h"
+#include "SharedBuffer.h"
+#include "SocketCommon.h"
+#include "SocketCore.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <vector>
+#if defined(_WIN32)
+    #include <io.h>
+#else
+    #include <sys/uio.h>
+#endif
+
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+    #include <linux/errqueue.h>
+    /**
+     * @brief Defined when zero-copy sends with MSG_ZEROCOPY are available, for event backends other than io_uring
+     */
+    #define SOCKETS_MSG_ZEROCOPY 1
+#endif
+
+namespace sockets {
+
+/**
+ * @brief Flags passed to send() for stream sockets.  MSG_NOSIGNAL keeps a peer which has gone away from
+ *        raising SIGPIPE in the sending thread.
+ */
+#if defined(MSG_NOSIGNAL)
+constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+#else
+constexpr int SEND_FLAGS = 0;
+#endif
+
+/**
+ * @brief Flag asking the kernel to hold a send back until more data follows, so a message sent in several calls
+ *        goes out in full-sized segments (MSG_MORE)
+ */
+#if defined(MSG_MORE)
+constexpr int MORE_FLAGS = MSG_MORE;
+#else
+constexpr int MORE_FLAGS = 0;
+#endif
+
+/**
+ * @brief Indicates whether a failed socket call would have blocked rather than failed outright
+ *
+ * @param err - errno value from the failed call
+ */
+inline bool wouldBlock(int err) {
+#if defined(_WIN32)
+    return err == EWOULDBLOCK || err == EAGAIN || WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+    return err == EWOULDBLOCK || err == EAGAIN;
+#endif
+}
+
+/**
+ * @brief Total length of a scatter-gather message
+ *
+ * @param parts - the message parts
+ * @param count - number of parts
+ */
+inline size_t partsSize(const MsgPart *parts, size_t count) {
+    size_t size = 0;
+    for (size_t idx = 0; idx < count; idx++) {
+        size += parts[idx].m_size;
+    }
+    return size;
+}
+
+/**
+ * @brief Send the parts of a scatter-gather message with one sendmsg() call
+ *
+ * @param core - interface for socket calls
+ * @param fd - socket file descriptor
+ * @param parts - the message parts
+ * @param count - number of parts, at most MAX_MSG_PARTS
+ * @param flags - send flags
+ * @param addr - destination address for an unconnected datagram socket, or nullptr
+ * @param addrLen - length of the destination address
+ * @return ssize_t - number of bytes sent, or -1 on failure (errno is set)
+ */
+template <class SocketImpl>
+ssize_t sendParts(SocketImpl &core, SOCKET fd, const MsgPart *parts, size_t count, int flags,
+                  const struct sockaddr *addr = nullptr, socklen_t addrLen = 0) {
+#if defined(_WIN32)
+    // No sendmsg(), so the parts are gathered into one buffer
+    std::vector<char> message;
+    message.reserve(partsSize(parts, count));
+    for (size_t idx = 0; idx < count; idx++) {
+        message.insert(message.end(), parts[idx].m_data, parts[idx].m_data + parts[idx].m_size);
+    }
+    if (addr != nullptr) {
+        return core.SendTo(fd, message.data(), message.size(), flags, addr, addrLen);
+    }
+    return core.Send(fd, message.data(), message.size(), flags);
+#else
+    std::array<struct iovec, MAX_MSG_PARTS> iov;
+    count = std::min(count, MAX_MSG_PARTS);
+    for (size_t idx = 0; idx < count; idx++) {
+        iov[idx].iov_base = const_cast<char *>(parts[idx].m_data);
+        iov[idx].iov_len = parts[idx].m_size;
+    }
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = const_cast<struct sockaddr *>(addr);
+    msg.msg_namelen = addrLen;
+    msg.msg_iov = iov.data();
+    msg.msg_iovlen = count;
+    return core.SendMsg(fd, &msg, flags);
+#endif
+}
+
+/**
+ * @brief Decide whether a message should be sent with a zero-copy send, on a connection which supports them
+ *
+ * @param options - the socket options
+ * @param regions - memory regions registered for zero-copy sends
+ * @param data - pointer to the message data
+ * @param size - length of the message data
+ * @param owned - the data is held by a SharedBuffer, so it can be kept alive until the kernel releases it
+ * @return true - send the message without copying it
+ */
+inline bool zeroCopyEligible(const SocketOpt &options, const std::vector<SendRegion> &regions, const char *data,
+                             size_t size, bool owned) {
+    if (!options.m_zeroCopySend || size == 0 || size < options.m_zeroCopyMinSize) {
+        return false;
+    }
+    return owned || std::any_of(regions.begin(), regions.end(), [data, size](const SendRegion &region) {
+        return data >= region.m_data && data + size <= region.m_data + region.m_size;
+    });
+}
+
+/**
+ * @brief Enable MSG_ZEROCOPY sends on a connected socket, the zero-copy path for event backends other than
+ *        io_uring
+ *
+ * @param core - interface for socket calls
+ * @param fd - socket file descriptor
+ * @param options - the socket options
+ * @return true - SocketOpt::m_zeroCopySend is set and the socket accepts SO_ZEROCOPY
+ */
+template <class SocketImpl>
+bool enableMsgZeroCopy(SocketImpl &core, SOCKET fd, const SocketOpt &options) {
+#if defined(SOCKETS_MSG_ZEROCOPY)
+    if (!options.m_zeroCopySend || options.m_eventBackend == EventBackend::IoUring) {
+        return false;
+    }
+    int option = 1;
+    return core.SetSockOpt(fd, SOL_SOCKET, SO_ZEROCOPY, &option, sizeof(option)) == 0;
+#else
+    (void)core;
+    (void)fd;
+    (void)options;
+    return false;
+#endif
+}
+
+/**
+ * @brief SendQueue holds the bytes of outbound messages which the kernel couldn't accept yet on a
+ *        non-blocking connection.  They are written by flush() once the socket becomes writable.  Data is
+ *        held as SharedBuffer handles, so a broadcast payload is shared by every queue it's in.  Ranges of files
+ *        are queued by descriptor and sent by the kernel straight from the page cache.
+ *
+ *        Messages queued for zero-copy sending are handed to the event poller one at a time, in order with
+ *        the rest, or with useMsgZeroCopy() sent by flush() itself with MSG_ZEROCOPY.  Either way their buffers
+ *        are held until the kernel releases them.  Completed zero-copy messages are collected for the owner to
+ *        report with takeCompleted().
+ *        With setMetrics() the queue counts its send calls and queued bytes, and records how long each message
+ *        waits to be sent.
+ *        SendQueue isn't thread-safe; the owning connection serializes access.
+ */
+class SendQueue {
+public:
+    /**
+     * @brief Indicates whether any bytes are waiting to be sent
+     */
+    bool empty() const {
+        return m_chunks.empty();
+    }
+
+    /**
+     * @brief Number of buffered bytes waiting to be sent.  Queued file ranges are read as they're sent and don't
+     *          count.
+     */
+    size_t size() const {
+        return m_bytes;
+    }
+
+    /**
+     * @brief Count the queue's send calls, bytes and queued bytes, and record its send latencies
+     *
+     * @param metrics - counters of the connection, which adds them to its socket's metrics too
+     */
+    void setMetrics(ConnectionMetrics *metrics) {
+        m_connectionMetrics = metrics;
+        m_metrics = (metrics != nullptr) ? metrics->total() : nullptr;
+    }
+
+    /**
+     * @brief Count the queue's send calls, bytes and queued bytes, and record its send latencies
+     *
+     * @param metrics - counters of the socket
+     */
+    void setMetrics(Metrics *metrics) {
+        m_connectionMetrics = nullptr;
+        m_metrics = metrics;
+    }
+
+    /**
+     * @brief Time a send starts, for directSent(), or none when send latencies aren't recorded
+     */
+    std::chrono::steady_clock::time_point sendStart() const {
+        return (m_metrics != nullptr && m_metrics->timing()) ? std::chrono::steady_clock::now()
+                                                             : std::chrono::steady_clock::time_point {};
+    }
+
+    /**
+     * @brief Count a send the owner made straight to the socket while the queue was empty, and record its
+     *          latency if it sent the whole message
+     *
+     * @param result - value returned by the send call
+     * @param size - length of the message
+     * @param start - value of sendStart() before the call
+     */
+    void directSent(ssize_t result, size_t size, std::chrono::steady_clock::time_point start) {
+        count(Counter::SendCalls);
+        if (result < 0) {
+            count(wouldBlock(errno) ? Counter::SendWouldBlock : Counter::SendErrors);
+            return;
+        }
+        count(Counter::BytesOut, static_cast<uint64_t>(result));
+        if (static_cast<size_t>(result) < size) {
+            count(Counter::SendPartial);
+        } else if (start != std::chrono::steady_clock::time_point {}) {
+            m_metrics->recordSend(std::chrono::steady_clock::now() - start);
+        }
+    }
+
+    /**
+     * @brief Queue a copy of message data behind any data already waiting
+     *
+     * @param data - pointer to the message data
+     * @param size - length of the message data
+     */
+    void append(const char *data, size_t size) {
+        if (size == 0) {
+            return;
+        }
+        append(SharedBuffer::copyOf(data, size));
+    }
+
+    /**
+     * @brief Queue a copy of the unsent tail of a scatter-gather message behind any data already waiting.  The
+     *          parts are gathered into one buffer.
+     *
+     * @param parts - the message parts
+     * @param count - number of parts
+     * @param offset - number of leading bytes of the message which have already been sent
+     */
+    void append(const MsgPart *parts, size_t count, size_t offset) {
+        size_t size = partsSize(parts, count);
+        if (offset >= size) {
+            return;
+        }
+        auto storage = std::make_shared<std::vector<char>>();
+        storage->reserve(size - offset);
+        for (size_t idx = 0; idx < count; idx++) {
+            size_t skip = std::min(offset, parts[idx].m_size);
+            offset -= skip;
+            storage->insert(storage->end(), parts[idx].m_data + skip, parts[idx].m_data + parts[idx].m_size);
+        }
+        append(SharedBuffer(std::shared_ptr<const char>(storage, storage->data()), storage->size()));
+    }
+
+    /**
+     * @brief Queue shared message data behind any data already waiting, without copying it
+     *
+     * @param buffer - the message data
+     * @param offset - number of leading bytes of the buffer which have already been sent
+     * @param zeroCopy - send the message with a zero-copy send and report its completion
+     */
+    void append(const SharedBuffer &buffer, size_t offset = 0, bool zeroCopy = false) {
+        if (offset >= buffer.size()) {
+            return;
+        }
+        m_chunks.push_back(
+            Chunk { buffer, offset, ++m_lastId, zeroCopy && !m_zeroCopyUnsupported, zeroCopy, nullptr, 0, 0 });
+        m_chunks.back().m_queued = sendStart();
+        m_bytes += buffer.size() - offset;
+        count(Counter::QueuedBytes, buffer.size() - offset);
+    }
+
+    /**
+     * @brief Queue a range of a file behind any data already waiting.  The queue sends from its own duplicate of
+     *          the descriptor, so the caller may close theirs.
+     *
+     * @param fileFd - descriptor of the file, open for reading
+     * @param offset - file offset of the first byte to send
+     * @param size - number of bytes to send
+     * @return true - the range was queued
+     * @return false - the descriptor couldn't be duplicated (errno is set)
+     */
+    bool appendFile(int fileFd, off_t offset, size_t size) {
+        if (size == 0) {
+            return true;
+        }
+#if defined(_WIN32)
+        int dupFd = ::_dup(fileFd);
+#else
+        int dupFd = ::fcntl(fileFd, F_DUPFD_CLOEXEC, 0);
+#endif
+        if (dupFd < 0) {
+            return false;
+        }
+        std::shared_ptr<int> file(new int(dupFd), [](int *fd) {
+#if defined(_WIN32)
+            (void)::_close(*fd);
+#else
+            (void)::close(*fd);
+#endif
+            delete fd;
+        });
+        m_chunks.push_back(Chunk { SharedBuffer(), 0, ++m_lastId, false, false, std::move(file), offset, size });
+        m_chunks.back().m_queued = sendStart();
+        return true;
+    }
+
+    /**
+     * @brief Discard all queued data.  Buffers of zero-copy sends already submitted stay held until released.
+     */
+    void clear() {
+        m_chunks.clear();
+        count(Counter::QueuedBytes, 0 - static_cast<uint64_t>(m_bytes));
+        m_bytes = 0;
+        m_zeroCopyInFlight = false;
+    }
+
+    /**
+     * @brief Send zero-copy messages from flush() with MSG_ZEROCOPY rather than handing them to the event poller.
+     *          The socket must have SO_ZEROCOPY enabled, see enableMsgZeroCopy(), and the owner must call
+     *          readNotifications() when the socket reports an error or becomes readable.
+     */
+    void useMsgZeroCopy() {
+        m_msgZeroCopy = true;
+    }
+
+    /**
+     * @brief Indicates whether the kernel may still reference the data of zero-copy sends
+     */
+    bool zeroCopyHeld() const {
+        return !m_held.empty();
+    }
+
+    /**
+     * @brief Indicates whether queued data is waiting for the socket to become writable, as opposed to nothing
+     *          being queued or the next message being sent by the event poller's zero-copy send
+     */
+    bool writePending() const {
+        return !m_chunks.empty() && !m_zeroCopyInFlight && (m_msgZeroCopy || !m_chunks.front().m_zeroCopy);
+    }
+
+    /**
+     * @brief Send as much queued data as the socket will accept without blocking
+     *
+     * @param core - interface for socket calls
+     * @param fd - socket file descriptor
+     * @return ssize_t - number of bytes sent, or -1 if the socket failed (errno is set)
+     */
+    template <class SocketImpl>
+    ssize_t flush(SocketImpl &core, SOCKET fd) {
+        ssize_t total = 0;
+        while (writePending()) {
+            Chunk &chunk = m_chunks.front();
+            size_t remaining = chunk.length() - chunk.m_offset;
+            if (chunk.m_file) {
+                ssize_t sent = sendFile(core, fd, chunk);
+                count(Counter::SendCalls);
+                if (sent < 0) {
+                    if (wouldBlock(errno)) {
+                        count(Counter::SendWouldBlock);
+                        break;
+                    }
+                    count(Counter::SendErrors);
+                    return -1;
+                }
+                total += sent;
+                count(Counter::BytesOut, static_cast<uint64_t>(sent));
+                chunk.m_offset += static_cast<size_t>(sent);
+                if (chunk.m_offset == chunk.m_fileSize) {
+                    popFront();
+                } else if (static_cast<size_t>(sent) < std::min(remaining, MAX_FILE_SEND)) {
+                    // Kernel send buffer is full
+                    count(Counter::SendPartial);
+                    break;
+                }
+                continue;
+            }
+            int flags = SEND_FLAGS;
+#if defined(SOCKETS_MSG_ZEROCOPY)
+            bool zeroCopy = chunk.m_zeroCopy && m_held.size() < MAX_HELD;
+            flags |= zeroCopy ? MSG_ZEROCOPY : 0;
+#endif
+            ssize_t sent = core.Send(fd, chunk.m_buffer.data() + chunk.m_offset, remaining, flags);
+            count(Counter::SendCalls);
+            if (sent < 0) {
+#if defined(SOCKETS_MSG_ZEROCOPY)
+                if (zeroCopy && errno == ENOBUFS) {
+                    // Too many zero-copy sends awaiting release (net.core.optmem_max), so copy this message
+                    chunk.m_zeroCopy = false;
+                    continue;
+                }
+#endif
+                if (wouldBlock(errno)) {
+                    count(Counter::SendWouldBlock);
+                    break;
+                }
+                count(Counter::SendErrors);
+                return -1;
+            }
+#if defined(SOCKETS_MSG_ZEROCOPY)
+            if (zeroCopy && sent > 0) {
+                // The kernel numbers each MSG_ZEROCOPY send which transferred data, starting from 0
+                m_held.push_back(Held { m_nextNotification++, chunk.m_id, chunk.m_buffer });
+            }
+#endif
+            total += sent;
+            m_bytes -= static_cast<size_t>(sent);
+            count(Counter::BytesOut, static_cast<uint64_t>(sent));
+            count(Counter::QueuedBytes, 0 - static_cast<uint64_t>(sent));
+            if (static_cast<size_t>(sent) < remaining) {
+                // Kernel send buffer is full
+                count(Counter::SendPartial);
+                chunk.m_offset += static_cast<size_t>(sent);
+                break;
+            }
+            popFront();
+        }
+        return total;
+    }
+
+    /**
+     * @brief Send as much queued data as the socket will accept without blocking, and submit the next zero-copy
+     *          message if it's reached
+     *
+     * @param core - interface for socket calls
+     * @param fd - socket file descriptor
+     * @param poller - event poller which sends zero-copy messages
+     * @return ssize_t - number of bytes sent by copying, or -1 if the socket failed (errno is set)
+     */
+    template <class SocketImpl, class Poller>
+    ssize_t flush(SocketImpl &core, SOCKET fd, Poller &poller) {
+        ssize_t total = 0;
+        for (;;) {
+            ssize_t sent = flush(core, fd);
+            if (sent < 0) {
+                return -1;
+            }
+            total += sent;
+            if (!zeroCopyReady() || startZeroCopy(poller, fd)) {
+                return total;
+            }
+            // The send couldn't be submitted, so the message is sent by copying instead
+        }
+    }
+
+    /**
+     * @brief Note the result of a zero-copy send
+     *
+     * @param result - number of bytes sent, or a negative errno value.  -EOPNOTSUPP (the socket doesn't support
+     *          zero-copy sends) sends this and later messages by copying instead; other failures must be
+     *          handled by the caller.
+     * @return size_t - number of bytes sent
+     */
+    size_t zeroCopySent(int result) {
+        if (!m_zeroCopyInFlight || m_chunks.empty()) {
+            return 0;
+        }
+        m_zeroCopyInFlight = false;
+        if (result < 0) {
+            if (result == -EOPNOTSUPP) {
+                disableZeroCopy();
+            } else {
+                count(Counter::SendErrors);
+            }
+            return 0;
+        }
+        Chunk &chunk = m_chunks.front();
+        size_t sent = std::min(static_cast<size_t>(result), chunk.m_buffer.size() - chunk.m_offset);
+        chunk.m_offset += sent;
+        m_bytes -= sent;
+        count(Counter::BytesOut, sent);
+        count(Counter::QueuedBytes, 0 - static_cast<uint64_t>(sent));
+        if (chunk.m_offset == chunk.m_buffer.size()) {
+            popFront();
+        }
+        return sent;
+    }
+
+    /**
+     * @brief Note that the kernel released the data of a zero-copy send
+     *
+     * @param seq - sequence number of the send
+     * @return true - the next zero-copy send was waiting for the release and may now be submitted by flush()
+     */
+    bool zeroCopyReleased(uint32_t seq) {
+        return release(seq, seq) && zeroCopyReady();
+    }
+
+    /**
+     * @brief Read the release notifications of MSG_ZEROCOPY sends from the socket error queue
+     *
+     * @param core - interface for socket calls
+     * @param fd - socket file descriptor
+     * @return true - at least one notification was read
+     */
+    template <class SocketImpl>
+    bool readNotifications(SocketImpl &core, SOCKET fd) {
+        bool notified = false;
+#if defined(SOCKETS_MSG_ZEROCOPY)
+        constexpr size_t CONTROL_SIZE = 128;
+        for (;;) {
+            alignas(struct cmsghdr) std::array<char, CONTROL_SIZE> control;
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_control = control.data();
+            msg.msg_controllen = control.size();
+            if (core.RecvMsg(fd, &msg, MSG_ERRQUEUE) < 0) {
+                // Error queue drained
+                break;
+            }
+            for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+                if (!(cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) &&
+                    !(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR)) {
+                    continue;
+                }
+                struct sock_extended_err err;
+                memcpy(&err, CMSG_DATA(cmsg), sizeof(err));
+                if (err.ee_errno != 0 || err.ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                    continue;
+                }
+                // Notifications for consecutive sends are coalesced into a range
+                notified = true;
+                (void)release(err.ee_info, err.ee_data);
+                if ((err.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0) {
+                    // The kernel copied the data after all (e.g. loopback), which costs more than a plain send
+                    disableZeroCopy();
+                }
+            }
+        }
+#else
+        (void)core;
+        (void)fd;
+#endif
+        return notified;
+    }
+
+    /**
+     * @brief Take the zero-copy messages which have been sent and released since the last call.  Their data may
+     *          be reused.
+     *
+     * @param completed - receives the messages' buffers
+     */
+    void takeCompleted(std::vector<SharedBuffer> &completed) {
+        completed.clear();
+        completed.swap(m_completed);
+    }
+
+private:
+    /**
+     * @brief Most zero-copy sends awaiting release by the kernel; sequence numbers are 16 bits
+     */
+    static constexpr size_t MAX_HELD = 32768;
+
+    /**
+     * @brief Largest single zero-copy send; a longer message is sent in several
+     */
+    static constexpr size_t MAX_ZEROCOPY_SEND = 1U << 30;
+
+    /**
+     * @brief Largest single file send; sendfile() transfers at most about 2GB per call
+     */
+    static constexpr size_t MAX_FILE_SEND = 1U << 30;
+
+    /**
+     * @brief A queued message (or message tail)
+     */
+    struct Chunk {
+        /**
+         * @brief The message data, possibly shared with other connections' queues
+         */
+        SharedBuffer m_buffer;
+
+        /**
+         * @brief Number of leading bytes of m_buffer already sent
+         */
+        size_t m_offset;
+
+        /**
+         * @brief Identifies the message among those queued
+         */
+        uint64_t m_id;
+
+        /**
+         * @brief Send the message with zero-copy sends
+         */
+        bool m_zeroCopy;
+
+        /**
+         * @brief The message was queued for zero-copy sending, so its completion is reported
+         */
+        bool m_report;
+
+        /**
+         * @brief Descriptor of a queued file range, shared by the chunk's copies and closed with the last one
+         */
+        std::shared_ptr<int> m_file;
+
+        /**
+         * @brief File offset and length of a queued file range
+         */
+        off_t m_fileOffset = 0;
+        size_t m_fileSize = 0;
+
+        /**
+         * @brief Time the chunk was queued, when send latencies are recorded
+         */
+        std::chrono::steady_clock::time_point m_queued {};
+
+        /**
+         * @brief Total length of the chunk
+         */
+        size_t length() const {
+            return m_file ? m_fileSize : m_buffer.size();
+        }
+    };
+
+    /**
+     * @brief A zero-copy send whose data the kernel may still reference
+     */
+    struct Held {
+        /**
+         * @brief Sequence number of the send
+         */
+        uint32_t m_seq;
+
+        /**
+         * @brief Message the data belongs to
+         */
+        uint64_t m_id;
+
+        /**
+         * @brief Keeps the data alive
+         */
+        SharedBuffer m_buffer;
+    };
+
+    /**
+     * @brief Indicates whether the message at the head of the queue should be submitted as a zero-copy send
+     */
+    bool zeroCopyReady() const {
+        return !m_msgZeroCopy && !m_chunks.empty() && !m_zeroCopyInFlight && m_chunks.front().m_zeroCopy &&
+               m_held.size() < MAX_HELD;
+    }
+
+    /**
+     * @brief Send this and later messages by copying
+     */
+    void disableZeroCopy() {
+        m_zeroCopyUnsupported = true;
+        for (auto &chunk : m_chunks) {
+            chunk.m_zeroCopy = false;
+        }
+    }
+
+    /**
+     * @brief Drop the buffers of released zero-copy sends, completing messages which have been sent in full
+     *
+     * @param first - sequence number of the first send released
+     * @param last - sequence number of the last send released
+     * @return true - a send was released
+     */
+    bool release(uint32_t first, uint32_t last) {
+        bool released = false;
+        for (auto iter = m_held.begin(); iter != m_held.end();) {
+            if (iter->m_seq - first > last - first) {
+                ++iter;
+                continue;
+            }
+            Held held = std::move(*iter);
+            iter = m_held.erase(iter);
+            released = true;
+            if (!isQueued(held.m_id) && !isHeld(held.m_id)) {
+                m_completed.push_back(held.m_buffer);
+            }
+        }
+        return released;
+    }
+
+    /**
+     * @brief Submit the message at the head of the queue as a zero-copy send
+     *
+     * @return true - the send was submitted
+     * @return false - it couldn't be, and the message is now sent by copying
+     */
+    template <class Poller>
+    bool startZeroCopy(Poller &poller, SOCKET fd) {
+        constexpr uint32_t SEQ_MASK = 0xffff;
+        Chunk &chunk = m_chunks.front();
+        size_t length = std::min(chunk.m_buffer.size() - chunk.m_offset, MAX_ZEROCOPY_SEND);
+        uint32_t seq = ++m_lastSeq & SEQ_MASK;
+        if (poller.sendZeroCopy(fd, chunk.m_buffer.data() + chunk.m_offset, length, seq) != 0) {
+            chunk.m_zeroCopy = false;
+            return false;
+        }
+        m_held.push_back(Held { seq, chunk.m_id, chunk.m_buffer });
+        m_zeroCopyInFlight = true;
+        count(Counter::SendCalls);
+        return true;
+    }
+
+    /**
+     * @brief Send part of the file range at the head of the queue
+     *
+     * @return ssize_t - number of bytes sent, or -1 on failure (errno is set)
+     */
+    template <class SocketImpl>
+    ssize_t sendFile(SocketImpl &core, SOCKET fd, Chunk &chunk) {
+        off_t position = chunk.m_fileOffset + static_cast<off_t>(chunk.m_offset);
+        size_t length = std::min(chunk.m_fileSize - chunk.m_offset, MAX_FILE_SEND);
+        ssize_t sent = core.SendFile(fd, *chunk.m_file, &position, length);
+        if (sent == 0) {
+            // The file is shorter than the range, so the peer would wait for data which never comes
+            errno = EIO;
+            return -1;
+        }
+        return sent;
+    }
+
+    /**
+     * @brief Remove the fully sent message at the head of the queue
+     */
+    void popFront() {
+        Chunk chunk = std::move(m_chunks.front());
+        m_chunks.pop_front();
+        if (chunk.m_queued != std::chrono::steady_clock::time_point {}) {
+            m_metrics->recordSend(std::chrono::steady_clock::now() - chunk.m_queued);
+        }
+        if (chunk.m_report && !isHeld(chunk.m_id)) {
+            m_completed.push_back(chunk.m_buffer);
+        }
+    }
+
+    /**
+     * @brief Add to a counter of the connection, if counted
+     */
+    void count(Counter counter, uint64_t value = 1) {
+        if (m_connectionMetrics != nullptr) {
+            m_connectionMetrics->add(counter, value);
+        } else if (m_metrics != nullptr) {
+            m_metrics->add(counter, value);
+        }
+    }
+
+    /**
+     * @brief Indicates whether the kernel may still reference part of a message
+     */
+    bool isHeld(uint64_t id) const {
+        return std::any_of(m_held.begin(), m_held.end(), [id](const Held &held) { return held.m_id == id; });
+    }
+
+    /**
+     * @brief Indicates whether part of a message is still waiting to be sent
+     */
+    bool isQueued(uint64_t id) const {
+        return !m_chunks.empty() && m_chunks.front().m_id == id;
+    }
+
+    /**
+     * @brief Queued messages in send order
+     */
+    std::deque<Chunk> m_chunks;
+
+    /**
+     * @brief Total number of bytes waiting to be sent
+     */
+    size_t m_bytes = 0;
+
+    /**
+     * @brief Zero-copy sends whose data the kernel may still reference, in submission order
+     */
+    std::deque<Held> m_held;
+
+    /**
+     * @brief Zero-copy messages sent and released, waiting for takeCompleted()
+     */
+    std::vector<SharedBuffer> m_completed;
+
+    /**
+     * @brief Id of the last message queued and sequence number of the last zero-copy send
+     */
+    uint64_t m_lastId = 0;
+    uint32_t m_lastSeq = 0;
+
+    /**
+     * @brief Sequence number the kernel gives the next MSG_ZEROCOPY send
+     */
+    uint32_t m_nextNotification = 0;
+
+    /**
+     * @brief A zero-copy send of the message at the head of the queue is outstanding
+     */
+    bool m_zeroCopyInFlight = false;
+
+    /**
+     * @brief The socket doesn't support zero-copy sends, so messages are sent by copying
+     */
+    bool m_zeroCopyUnsupported = false;
+
+    /**
+     * @brief Zero-copy messages are sent by flush() with MSG_ZEROCOPY
+     */
+    bool m_msgZeroCopy = false;
+
+    /**
+     * @brief Counters of the connection and of its socket, when counted
+     */
+    ConnectionMetrics *m_connectionMetrics = nullptr;
+    Metrics *m_metrics = nullptr;
+};
+
+}  // namespace sockets
@@ -0,0 +1,91 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace sockets {
+
+/**
+ * @brief SharedBuffer is a reference-counted handle to immutable message data.  Copying a SharedBuffer
+ *        copies the handle, not the data, so one payload can be queued on many connections at once.
+ */
+class SharedBuffer {
+public:
+    SharedBuffer() = default;
+
+    /**
+     * @brief Construct a SharedBuffer referring to existing storage
+     *
+     * @param storage - the data, kept alive for as long as any handle refers to it
+     * @param size - length of the data
+     */
+    SharedBuffer(std::shared_ptr<const char> storage, size_t size) : m_data(std::move(storage)), m_size(size) {
+    }
+
+    /**
+     * @brief Create a SharedBuffer holding a copy of message data
+     *
+     * @param data - pointer to the message data
+     * @param size - length of the message data
+     * @return SharedBuffer - handle to the copy
+     */
+    static SharedBuffer copyOf(const char *data, size_t size) {
+        auto storage = std::make_shared<std::vector<char>>(data, data + size);
+        // Aliasing constructor: the handle points at the bytes but owns the vector
+        return SharedBuffer(std::shared_ptr<const char>(storage, storage->data()), size);
+    }
+
+    /**
+     * @brief Create a SharedBuffer referring to data owned by the caller, without copying it.  The caller
+     *          keeps the data alive and unchanged for as long as any handle refers to it.
+     *
+     * @param data - pointer to the message data
+     * @param size - length of the message data
+     * @return SharedBuffer - handle to the data
+     */
+    static SharedBuffer reference(const char *data, size_t size) {
+        // Aliasing constructor with no owner: the handle points at the bytes but owns nothing
+        return SharedBuffer(std::shared_ptr<const char>(std::shared_ptr<const char>(), data), size);
+    }
+
+    /**
+     * @brief Pointer to the data
+     */
+    const char *data() const {
+        return m_data.get();
+    }
+
+    /**
+     * @brief Length of the data
+     */
+    size_t size() const {
+        return m_size;
+    }
+
+    /**
+     * @brief Indicates whether the handle refers to no data
+     */
+    bool empty() const {
+        return m_size == 0;
+    }
+
+    /**
+     * @brief Number of handles sharing the data
+     */
+    long useCount() const {
+        return m_data.use_count();
+    }
+
+private:
+    /**
+     * @brief The shared data
+     */
+    std::shared_ptr<const char> m_data;
+
+    /**
+     * @brief Length of the data
+     */
+    size_t m_size = 0;
+};
+
+}  // namespace sockets
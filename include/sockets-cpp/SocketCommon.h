@@ -1,4 +1,5 @@
 #pragma once
+#include "Framing.h"
 #include <memory>
 #include <string>
 
@@ -10,6 +11,189 @@ namespace sockets {
     constexpr int TX_BUFFER_SIZE = 10240;
     constexpr int RX_BUFFER_SIZE = 10240;
 
+    /**
+     * @brief Default outbound watermarks and queue limit for a connection
+     * 
+     */
+    constexpr size_t SEND_HIGH_WATERMARK = 1024 * 1024;
+    constexpr size_t SEND_LOW_WATERMARK = 256 * 1024;
+    constexpr size_t SEND_QUEUE_LIMIT = 64 * 1024 * 1024;
+
+    /**
+     * @brief Default inbound watermarks for the received data a connection has queued for the callback workers
+     * 
+     */
+    constexpr size_t RECV_HIGH_WATERMARK = 4 * 1024 * 1024;
+    constexpr size_t RECV_LOW_WATERMARK = 1024 * 1024;
+
+    /**
+     * @brief Default TcpServer listen() backlog, deep enough to absorb a burst of reconnecting clients
+     * 
+     */
+    constexpr int LISTEN_BACKLOG = 128;
+
+    /**
+     * @brief Default number of connections a TcpServer accepts per readiness event on its listening socket
+     * 
+     */
+    constexpr size_t ACCEPT_BATCH = 64;
+
+    /**
+     * @brief Default number of connections a TcpServer admits back-to-back before SocketOpt::m_acceptRate applies
+     * 
+     */
+    constexpr size_t ACCEPT_BURST = 100;
+
+    /**
+     * @brief Default number and size of the receive buffers provided to io_uring by each event loop
+     * 
+     */
+    constexpr unsigned URING_BUFFER_COUNT = 256;
+    constexpr size_t URING_BUFFER_SIZE = 16384;
+
+    /**
+     * @brief Default size and number of the pooled receive buffers of each event loop
+     *
+     */
+    constexpr size_t RX_SLAB_SIZE = 16384;
+    constexpr size_t RX_SLAB_COUNT = 16;
+
+    /**
+     * @brief Default resolution and slot count of each event loop's timing wheel
+     *
+     */
+    constexpr int TIMER_TICK_MS = 10;
+    constexpr size_t TIMER_WHEEL_SLOTS = 512;
+
+    /**
+     * @brief Default smallest message sent with io_uring zero-copy sends; below it copying is cheaper
+     * 
+     */
+    constexpr size_t ZEROCOPY_MIN_SIZE = 16384;
+
+    /**
+     * @brief Most parts in a scatter-gather message, see MsgPart
+     * 
+     */
+    constexpr size_t MAX_MSG_PARTS = 64;
+
+/**
+ * @brief Event notification mechanism used by a socket's event loop
+ *
+ */
+enum class EventBackend {
+    /**
+     * @brief Portable select() loop, limited to descriptors below FD_SETSIZE
+     */
+    Select,
+
+    /**
+     * @brief Linux epoll() loop, cost per wakeup is proportional to the number of ready descriptors
+     */
+    Epoll,
+
+    /**
+     * @brief Linux io_uring loop (kernel 6.0 or later).  Multishot accept and receive requests deliver new
+     *        connections and received data with the completion, so one system call serves many messages.
+     */
+    IoUring
+};
+
+/**
+ * @brief How a TcpServer with multiple event loops distributes new connections
+ *
+ */
+enum class AcceptMode {
+    /**
+     * @brief Each event loop accepts on its own SO_REUSEPORT listening socket and the kernel picks the loop
+     */
+    ReusePort,
+
+    /**
+     * @brief A dedicated acceptor thread accepts all connections and hands each one to the least loaded event loop
+     */
+    Acceptor
+};
+
+/**
+ * @brief Load measure used by the acceptor thread to pick an event loop
+ *
+ */
+enum class LoadBalance {
+    /**
+     * @brief The event loop with the fewest connections
+     */
+    LeastConnections,
+
+    /**
+     * @brief The event loop with the lowest recent byte rate (sent plus received), counting each connection handed
+     *        to it since the rate was sampled at the average rate per connection.  Ties are broken by connection
+     *        count.
+     */
+    LeastBytes
+};
+
+/**
+ * @brief Named sets of socket tuning values, see applyProfile()
+ *
+ */
+enum class TuningProfile {
+    /**
+     * @brief Library defaults: small buffers, no TCP option changes
+     */
+    Default,
+
+    /**
+     * @brief Small messages delivered as soon as possible: TCP_NODELAY, TCP_QUICKACK, a low TCP_NOTSENT_LOWAT
+     *        and SO_BUSY_POLL
+     */
+    LowLatency,
+
+    /**
+     * @brief Bulk transfer: large socket buffers and Nagle's algorithm left enabled
+     */
+    Throughput,
+
+    /**
+     * @brief Large numbers of mostly idle connections: small buffers, a deep listen backlog and TCP keepalive
+     *        to detect dead peers
+     */
+    ManyIdle
+};
+
+/**
+ * @brief A region of application memory registered for zero-copy sends, see TcpServer::registerSendRegion()
+ *
+ */
+struct SendRegion {
+    /**
+     * @brief Start of the region
+     */
+    const char *m_data = nullptr;
+
+    /**
+     * @brief Length of the region
+     */
+    size_t m_size = 0;
+};
+
+/**
+ * @brief One part of a scatter-gather message, e.g. a header or a payload held in separate buffers.  The parts of a
+ *        message are sent with one system call, without first being copied together.
+ *
+ */
+struct MsgPart {
+    /**
+     * @brief Start of the part
+     */
+    const char *m_data = nullptr;
+
+    /**
+     * @brief Length of the part
+     */
+    size_t m_size = 0;
+};
+
 /**
  * @brief Status structure returned by socket class methods.
  *
@@ -52,6 +236,255 @@ struct SocketOpt {
      */
     std::string m_listenAddr = "0.0.0.0";
 
+    /**
+     * @brief Event notification mechanism used by the TcpServer, TcpClient and UdpSocket event loops
+     *
+     */
+    EventBackend m_eventBackend = EventBackend::Select;
+
+    /**
+     * @brief Number of receive buffers each event loop provides to io_uring, at most 32768.  Used with
+     *        EventBackend::IoUring.
+     *
+     */
+    unsigned m_uringBufferCount = URING_BUFFER_COUNT;
+
+    /**
+     * @brief Size of each io_uring receive buffer, i.e. the most data delivered by one completion.  UdpSocket
+     *        uses at least the maximum datagram size.
+     *
+     */
+    size_t m_uringBufferSize = URING_BUFFER_SIZE;
+
+    /**
+     * @brief Size of each pooled receive buffer.  A TCP receive reads up to 64 KB into a chain of these with one
+     *        readv(); UdpSocket uses at least the maximum datagram size.  Not used with EventBackend::IoUring,
+     *        which receives into m_uringBufferSize buffers.
+     *
+     */
+    size_t m_rxSlabSize = RX_SLAB_SIZE;
+
+    /**
+     * @brief Number of receive buffers preallocated by each event loop's pool; further buffers come from the heap
+     *
+     */
+    size_t m_rxSlabCount = RX_SLAB_COUNT;
+
+    /**
+     * @brief Back the receive buffer pools with huge pages (MAP_HUGETLB, else transparent huge pages; Linux only)
+     *
+     */
+    bool m_rxHugePages = false;
+
+    /**
+     * @brief Send large messages without copying them into the kernel: with io_uring zero-copy sends
+     *        (IORING_OP_SEND_ZC) for EventBackend::IoUring, otherwise with MSG_ZEROCOPY (Linux).  Applies to
+     *        SharedBuffer messages and messages in a registered send region.
+     *
+     */
+    bool m_zeroCopySend = false;
+
+    /**
+     * @brief Smallest message sent with a zero-copy send
+     *
+     */
+    size_t m_zeroCopyMinSize = ZEROCOPY_MIN_SIZE;
+
+    /**
+     * @brief Number of TcpServer event-loop threads.  Each thread owns a SO_REUSEPORT listening
+     *        socket and the clients accepted on it.
+     *
+     */
+    size_t m_serverThreads = 1;
+
+    /**
+     * @brief How new TcpServer connections are distributed across the event-loop threads
+     *
+     */
+    AcceptMode m_acceptMode = AcceptMode::ReusePort;
+
+    /**
+     * @brief Load measure used to pick an event loop in AcceptMode::Acceptor
+     *
+     */
+    LoadBalance m_loadBalance = LoadBalance::LeastConnections;
+
+    /**
+     * @brief Number of threads TcpServer::sendBcast() uses to queue a broadcast on the clients
+     *
+     */
+    size_t m_bcastThreads = 1;
+
+    /**
+     * @brief Minimum number of clients before TcpServer::sendBcast() splits a broadcast across m_bcastThreads
+     *
+     */
+    size_t m_bcastParallelMin = 1024;
+
+    /**
+     * @brief Number of worker threads running the receive, connect and disconnect callbacks.  Each connection's
+     *        callbacks run in order on its own strand, so a slow callback doesn't stall the event loop or other
+     *        connections.  0 runs the callbacks on the event loop thread.
+     *
+     */
+    size_t m_callbackThreads = 0;
+
+    /**
+     * @brief Bytes of received messages a connection (or UdpSocket) may have queued for the callback workers
+     *        before reading from it pauses, when m_callbackThreads > 0.  The paused data waits in the kernel, where
+     *        TCP flow control slows the sender down; a UDP socket drops datagrams once its SO_RCVBUF is full.
+     *
+     */
+    size_t m_recvHighWatermark = RECV_HIGH_WATERMARK;
+
+    /**
+     * @brief Queued received bytes at which reading resumes after m_recvHighWatermark paused it
+     *
+     */
+    size_t m_recvLowWatermark = RECV_LOW_WATERMARK;
+
+    /**
+     * @brief Resolution of the timers on each TcpServer event loop's timing wheel, in milliseconds
+     *
+     */
+    int m_timerTickMs = TIMER_TICK_MS;
+
+    /**
+     * @brief Number of slots in each timing wheel.  Timers further out than m_timerTickMs * m_timerSlots are
+     *        visited once per revolution until they are due.
+     *
+     */
+    size_t m_timerSlots = TIMER_WHEEL_SLOTS;
+
+    /**
+     * @brief Close a TcpServer client connection after this many milliseconds without receiving data.  0 leaves
+     *        idle connections open.
+     *
+     */
+    int m_idleTimeoutMs = 0;
+
+    /**
+     * @brief Record the callback duration and send latency histograms returned by getMetrics().  Costs two clock
+     *        reads per callback and per send; the counters are kept either way.
+     *
+     */
+    bool m_latencyHistograms = true;
+
+    /**
+     * @brief Largest message accepted by a TcpServer or TcpClient framing codec; longer messages close the connection
+     *
+     */
+    size_t m_maxMessageSize = MAX_MESSAGE_SIZE;
+
+    /**
+     * @brief Queued outbound bytes on a connection at which onBackPressure() is called
+     *
+     */
+    size_t m_sendHighWatermark = SEND_HIGH_WATERMARK;
+
+    /**
+     * @brief Queued outbound bytes on a back-pressured connection at which onWritable() is called
+     *
+     */
+    size_t m_sendLowWatermark = SEND_LOW_WATERMARK;
+
+    /**
+     * @brief Maximum queued outbound bytes on a connection; sends beyond it fail.  0 for no limit.
+     *
+     */
+    size_t m_sendQueueLimit = SEND_QUEUE_LIMIT;
+
+    /**
+     * @brief Stop reading from a connection while its outbound data is above m_sendHighWatermark
+     *
+     */
+    bool m_pauseReadOnBackPressure = false;
+
+    /**
+     * @brief Length of a TcpServer's queue of pending connections, passed to listen()
+     *
+     */
+    int m_listenBacklog = LISTEN_BACKLOG;
+
+    /**
+     * @brief Most connections a TcpServer accepts in one pass before servicing its other sockets; anything
+     *        left in the accept queue is picked up on the next pass.  0 drains the queue completely.
+     *
+     */
+    size_t m_acceptBatch = ACCEPT_BATCH;
+
+    /**
+     * @brief Value for TCP_DEFER_ACCEPT in seconds (Linux only), so that a connection is only accepted once the
+     *        client has sent data.  0 leaves it disabled.
+     *
+     */
+    int m_deferAcceptSecs = 0;
+
+    /**
+     * @brief Most new connections a TcpServer admits per second, across all its event loops.  Connections
+     *        arriving faster are reset as soon as they are accepted.  0 for no limit.
+     *
+     */
+    double m_acceptRate = 0.0;
+
+    /**
+     * @brief Connections admitted back-to-back before m_acceptRate applies, i.e. the depth of its token bucket
+     *
+     */
+    size_t m_acceptBurst = ACCEPT_BURST;
+
+    /**
+     * @brief Most connections a TcpServer holds at once; further connections are reset.  0 for no limit.
+     *
+     */
+    size_t m_maxConnections = 0;
+
+    /**
+     * @brief Shed new connections while the event loop which would serve them takes longer than this per pass,
+     *        in milliseconds (a smoothed average).  0 disables the check.
+     *
+     */
+    int m_maxLoopLagMs = 0;
+
+    /**
+     * @brief Set TCP_NODELAY, disabling Nagle's algorithm
+     *
+     */
+    bool m_noDelay = false;
+
+    /**
+     * @brief Set TCP_QUICKACK, re-armed after every receive since the kernel clears it (Linux only)
+     *
+     */
+    bool m_quickAck = false;
+
+    /**
+     * @brief Value for TCP_NOTSENT_LOWAT, limiting unsent data held in the kernel.  0 leaves the system default.
+     *
+     */
+    int m_notSentLowat = 0;
+
+    /**
+     * @brief Value for SO_BUSY_POLL in microseconds (Linux only).  0 leaves the system default.
+     *
+     */
+    int m_busyPollUsecs = 0;
+
+    /**
+     * @brief Set SO_KEEPALIVE
+     *
+     */
+    bool m_keepAlive = false;
+
+    /**
+     * @brief Keepalive idle time (TCP_KEEPIDLE), probe interval (TCP_KEEPINTVL) and probe count (TCP_KEEPCNT).
+     *        0 leaves the system default.
+     *
+     */
+    int m_keepIdleSecs = 0;
+    int m_keepIntervalSecs = 0;
+    int m_keepCount = 0;
+
 };
 
 }  // Namespace sockets
\ No newline at end of file
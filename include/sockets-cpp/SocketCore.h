@@ -18,8 +18,20 @@
     #include <sys/socket.h>
     #include <netdb.h>
     #include <arpa/inet.h>
+    #include <fcntl.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
     #include <unistd.h>
 #endif
+#if defined(__linux__)
+    #include <sys/epoll.h>
+    #include <sys/eventfd.h>
+    #include <sys/sendfile.h>
+#endif
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
 
 namespace sockets {
 
@@ -66,6 +78,14 @@ public:
 #endif
     }
 
+    int GetSockOpt(SOCKET sockfd, int level, int optname, void *optval, socklen_t *optlen) {
+#ifdef _WIN32
+        return ::getsockopt(sockfd, level, optname, reinterpret_cast<char*>(optval), optlen);
+#else
+        return ::getsockopt(sockfd, level, optname, optval, optlen);
+#endif
+    }
+
     int Bind(SOCKET sockfd, const struct sockaddr *addr, socklen_t addrlen) {
         return ::bind(sockfd, addr, addrlen);
     }
@@ -74,6 +94,31 @@ public:
         return ::accept(sockfd, addr, addrlen);
     }
 
+    /**
+     * @brief Accept a connection as a non-blocking, close-on-exec socket, in one call where accept4() is available
+     */
+    SOCKET AcceptNonBlocking(SOCKET sockfd, struct sockaddr *addr, socklen_t *addrlen) {
+#if defined(__linux__)
+        return ::accept4(sockfd, addr, addrlen, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+        SOCKET fd = ::accept(sockfd, addr, addrlen);
+        if (fd != INVALID_SOCKET) {
+#ifndef _WIN32
+            (void)::fcntl(fd, F_SETFD, FD_CLOEXEC);
+#endif
+            if (SetNonBlocking(fd) != 0) {
+                Close(fd);
+                return INVALID_SOCKET;
+            }
+        }
+        return fd;
+#endif
+    }
+
+    int GetPeerName(SOCKET sockfd, struct sockaddr *addr, socklen_t *addrlen) {
+        return ::getpeername(sockfd, addr, addrlen);
+    }
+
     int Listen(SOCKET sockfd, int backlog) {
         return ::listen(sockfd, backlog);
     }
@@ -90,10 +135,37 @@ public:
 #endif
     }
 
+    int SetNonBlocking(SOCKET sockfd) {
+#ifdef _WIN32
+        u_long mode = 1;
+        return ::ioctlsocket(sockfd, FIONBIO, &mode);
+#else
+        int flags = ::fcntl(sockfd, F_GETFL, 0);
+        if (flags < 0) {
+            return -1;
+        }
+        return ::fcntl(sockfd, F_SETFL, flags | O_NONBLOCK);
+#endif
+    }
+
     int Select(int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, struct timeval * timeout) {
         return ::select(nfds, readfds, writefds, exceptfds, timeout);
     }
 
+#if defined(__linux__)
+    int EpollCreate() {
+        return ::epoll_create1(EPOLL_CLOEXEC);
+    }
+
+    int EpollCtl(int epfd, int op, SOCKET fd, struct epoll_event *event) {
+        return ::epoll_ctl(epfd, op, fd, event);
+    }
+
+    int EpollWait(int epfd, struct epoll_event *events, int maxevents, int timeout) {
+        return ::epoll_wait(epfd, events, maxevents, timeout);
+    }
+#endif
+
     ssize_t Recv(int sockfd, void *buf, size_t len, int flags) {
 #ifdef _WIN32
         return ::recv(sockfd, reinterpret_cast<char*>(buf), static_cast<int>(len), flags);
@@ -102,6 +174,16 @@ public:
 #endif
     }
 
+#if !defined(_WIN32)
+    ssize_t RecvMsg(int sockfd, struct msghdr *msg, int flags) {
+        return ::recvmsg(sockfd, msg, flags);
+    }
+
+    ssize_t SendMsg(int sockfd, const struct msghdr *msg, int flags) {
+        return ::sendmsg(sockfd, msg, flags);
+    }
+#endif
+
     ssize_t SendTo(int sockfd, const void *buf, size_t len, int flags, const struct sockaddr *dest_addr, socklen_t addrlen) {
 #ifdef _WIN32
         return ::sendto(sockfd, reinterpret_cast<const char*>(buf), static_cast<int>(len), flags, dest_addr, addrlen);
@@ -118,6 +200,98 @@ public:
 #endif        
     }
 
+    /**
+     * @brief sendfile() semantics: returns bytes sent, 0 at end of file, and advances *offset
+     */
+    ssize_t SendFile(SOCKET sockfd, int fileFd, off_t *offset, size_t count) {
+#if defined(__linux__)
+        return ::sendfile(sockfd, fileFd, offset, count);
+#elif defined(_WIN32)
+        (void)sockfd;
+        (void)fileFd;
+        (void)offset;
+        (void)count;
+        errno = ENOSYS;
+        return -1;
+#else
+        // Elsewhere the file is read into a bounce buffer
+        constexpr size_t BOUNCE_SIZE = 65536;
+        std::array<char, BOUNCE_SIZE> buffer;
+        ssize_t numRead = ::pread(fileFd, buffer.data(), std::min(count, buffer.size()), *offset);
+        if (numRead <= 0) {
+            return numRead;
+        }
+        ssize_t sent = ::send(sockfd, buffer.data(), static_cast<size_t>(numRead), 0);
+        if (sent > 0) {
+            *offset += sent;
+        }
+        return sent;
+#endif
+    }
+
+    /**
+     * @brief Create the descriptors used to interrupt select() or epoll_wait(): a non-blocking eventfd on Linux,
+     *        returned as both ends, otherwise a non-blocking pipe
+     */
+    int CreateWakeup(SOCKET &readFd, SOCKET &writeFd) {
+#if defined(__linux__)
+        int fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        readFd = fd;
+        writeFd = fd;
+        return fd < 0 ? -1 : 0;
+#elif defined(_WIN32)
+        (void)readFd;
+        (void)writeFd;
+        errno = ENOSYS;
+        return -1;
+#else
+        std::array<int, 2> fds {};
+        if (::pipe(fds.data()) != 0) {
+            return -1;
+        }
+        for (int fd : fds) {
+            (void)::fcntl(fd, F_SETFD, FD_CLOEXEC);
+            (void)SetNonBlocking(fd);
+        }
+        readFd = fds[0];
+        writeFd = fds[1];
+        return 0;
+#endif
+    }
+
+    int SignalWakeup(SOCKET writeFd) {
+#if defined(_WIN32)
+        (void)writeFd;
+        return -1;
+#else
+        // An eventfd takes an 8-byte count; a full pipe or counter already wakes the reader
+        uint64_t one = 1;
+        return (::write(writeFd, &one, sizeof(one)) < 0 && errno != EAGAIN) ? -1 : 0;
+#endif
+    }
+
+    void DrainWakeup(SOCKET readFd) {
+#if defined(_WIN32)
+        (void)readFd;
+#else
+        std::array<uint64_t, 16> buffer;
+        while (::read(readFd, buffer.data(), sizeof(buffer)) > 0) {
+        }
+#endif
+    }
+
+    void CloseWakeup(SOCKET readFd, SOCKET writeFd) {
+#if defined(_WIN32)
+        (void)readFd;
+        (void)writeFd;
+#else
+        ::close(readFd);
+        if (writeFd != readFd) {
+            ::close(writeFd);
+        }
+#endif
+    }
+
     int GetAddrInfo(const char *node, const char *service, const addrinfo *hints, addrinfo **res) {
         return ::getaddrinfo(node, service, hints, res);
     }
@@ -0,0 +1,197 @@
+#pragma once
+#include "SocketCommon.h"
+#include "SocketCore.h"
+
+namespace sockets {
+
+/**
+ * @brief Overwrite the tuning values in a set of socket options with those of a profile.  Other options,
+ *        e.g. the listen address, are left alone.
+ *
+ * @param options - socket options to update
+ * @param profile - the tuning profile
+ */
+inline void applyProfile(SocketOpt &options, TuningProfile profile) {
+    constexpr int LATENCY_BUF_SIZE = 256 * 1024;
+    constexpr int LATENCY_NOTSENT_LOWAT = 16 * 1024;
+    constexpr int LATENCY_BUSY_POLL_USECS = 50;
+    constexpr int THROUGHPUT_BUF_SIZE = 4 * 1024 * 1024;
+    constexpr int IDLE_BUF_SIZE = 16 * 1024;
+    constexpr int IDLE_KEEPIDLE_SECS = 60;
+    constexpr int IDLE_KEEPINTVL_SECS = 10;
+    constexpr int IDLE_KEEPCNT = 5;
+
+    const SocketOpt defaults;
+    options.m_txBufSize = defaults.m_txBufSize;
+    options.m_rxBufSize = defaults.m_rxBufSize;
+    options.m_listenBacklog = defaults.m_listenBacklog;
+    options.m_noDelay = defaults.m_noDelay;
+    options.m_quickAck = defaults.m_quickAck;
+    options.m_notSentLowat = defaults.m_notSentLowat;
+    options.m_busyPollUsecs = defaults.m_busyPollUsecs;
+    options.m_keepAlive = defaults.m_keepAlive;
+    options.m_keepIdleSecs = defaults.m_keepIdleSecs;
+    options.m_keepIntervalSecs = defaults.m_keepIntervalSecs;
+    options.m_keepCount = defaults.m_keepCount;
+
+    switch (profile) {
+    case TuningProfile::Default:
+        break;
+    case TuningProfile::LowLatency:
+        options.m_txBufSize = LATENCY_BUF_SIZE;
+        options.m_rxBufSize = LATENCY_BUF_SIZE;
+        options.m_noDelay = true;
+        options.m_quickAck = true;
+        options.m_notSentLowat = LATENCY_NOTSENT_LOWAT;
+        options.m_busyPollUsecs = LATENCY_BUSY_POLL_USECS;
+        break;
+    case TuningProfile::Throughput:
+        options.m_txBufSize = THROUGHPUT_BUF_SIZE;
+        options.m_rxBufSize = THROUGHPUT_BUF_SIZE;
+        break;
+    case TuningProfile::ManyIdle:
+        options.m_txBufSize = IDLE_BUF_SIZE;
+        options.m_rxBufSize = IDLE_BUF_SIZE;
+        options.m_listenBacklog = SOMAXCONN;
+        options.m_keepAlive = true;
+        options.m_keepIdleSecs = IDLE_KEEPIDLE_SECS;
+        options.m_keepIntervalSecs = IDLE_KEEPINTVL_SECS;
+        options.m_keepCount = IDLE_KEEPCNT;
+        break;
+    }
+}
+
+/**
+ * @brief Set an integer socket option
+ */
+template <class SocketImpl>
+int setIntOption(SocketImpl &core, SOCKET fd, int level, int optname, int value) {
+    return core.SetSockOpt(fd, level, optname, &value, sizeof(value));
+}
+
+/**
+ * @brief Read an integer socket option, leaving value unchanged if it can't be read
+ */
+template <class SocketImpl>
+void getIntOption(SocketImpl &core, SOCKET fd, int level, int optname, int &value) {
+    int result = 0;
+    socklen_t len = sizeof(result);
+    if (core.GetSockOpt(fd, level, optname, &result, &len) == 0) {
+        value = result;
+    }
+}
+
+/**
+ * @brief Apply the tuning options beyond the buffer sizes to a socket.  The options are hints, so failures
+ *          (e.g. an option the platform lacks or SO_BUSY_POLL without privileges) are ignored; readTuning()
+ *          shows what the kernel actually granted.  Options left at their defaults aren't touched.  Sockets
+ *          accepted from a listening socket inherit its options.
+ *
+ * @param core - interface for socket calls
+ * @param fd - the socket
+ * @param options - the tuning values
+ * @param tcp - the socket is a TCP socket, so TCP level options apply
+ */
+template <class SocketImpl>
+void applyTuning(SocketImpl &core, SOCKET fd, const SocketOpt &options, bool tcp) {
+#if defined(SO_BUSY_POLL)
+    if (options.m_busyPollUsecs > 0) {
+        (void)setIntOption(core, fd, SOL_SOCKET, SO_BUSY_POLL, options.m_busyPollUsecs);
+    }
+#endif
+    if (!tcp) {
+        return;
+    }
+    if (options.m_noDelay) {
+        (void)setIntOption(core, fd, IPPROTO_TCP, TCP_NODELAY, 1);
+    }
+#if defined(TCP_QUICKACK)
+    if (options.m_quickAck) {
+        (void)setIntOption(core, fd, IPPROTO_TCP, TCP_QUICKACK, 1);
+    }
+#endif
+#if defined(TCP_NOTSENT_LOWAT)
+    if (options.m_notSentLowat > 0) {
+        (void)setIntOption(core, fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, options.m_notSentLowat);
+    }
+#endif
+    if (options.m_keepAlive) {
+        (void)setIntOption(core, fd, SOL_SOCKET, SO_KEEPALIVE, 1);
+#if defined(TCP_KEEPIDLE)
+        if (options.m_keepIdleSecs > 0) {
+            (void)setIntOption(core, fd, IPPROTO_TCP, TCP_KEEPIDLE, options.m_keepIdleSecs);
+        }
+#endif
+#if defined(TCP_KEEPINTVL)
+        if (options.m_keepIntervalSecs > 0) {
+            (void)setIntOption(core, fd, IPPROTO_TCP, TCP_KEEPINTVL, options.m_keepIntervalSecs);
+        }
+#endif
+#if defined(TCP_KEEPCNT)
+        if (options.m_keepCount > 0) {
+            (void)setIntOption(core, fd, IPPROTO_TCP, TCP_KEEPCNT, options.m_keepCount);
+        }
+#endif
+    }
+}
+
+/**
+ * @brief Re-arm TCP_QUICKACK after a receive, since the kernel clears it once it switches back to delayed ACKs
+ *
+ * @param core - interface for socket calls
+ * @param fd - the socket
+ * @param options - the tuning values
+ */
+template <class SocketImpl>
+void rearmQuickAck(SocketImpl &core, SOCKET fd, const SocketOpt &options) {
+#if defined(TCP_QUICKACK)
+    if (options.m_quickAck) {
+        (void)setIntOption(core, fd, IPPROTO_TCP, TCP_QUICKACK, 1);
+    }
+#else
+    (void)core;
+    (void)fd;
+    (void)options;
+#endif
+}
+
+/**
+ * @brief Read back the tuning values in effect on a socket.  Values which can't be read (TCP_QUICKACK, the
+ *          listen backlog and options the platform lacks) keep their requested value.
+ *
+ * @param core - interface for socket calls
+ * @param fd - the socket
+ * @param tcp - the socket is a TCP socket, so TCP level options apply
+ * @param effective - holds the requested values on entry and the effective values on return
+ */
+template <class SocketImpl>
+void readTuning(SocketImpl &core, SOCKET fd, bool tcp, SocketOpt &effective) {
+    getIntOption(core, fd, SOL_SOCKET, SO_SNDBUF, effective.m_txBufSize);
+    getIntOption(core, fd, SOL_SOCKET, SO_RCVBUF, effective.m_rxBufSize);
+#if defined(SO_BUSY_POLL)
+    getIntOption(core, fd, SOL_SOCKET, SO_BUSY_POLL, effective.m_busyPollUsecs);
+#endif
+    if (!tcp) {
+        return;
+    }
+    int flag = effective.m_noDelay ? 1 : 0;
+    getIntOption(core, fd, IPPROTO_TCP, TCP_NODELAY, flag);
+    effective.m_noDelay = flag != 0;
+#if defined(TCP_NOTSENT_LOWAT)
+    getIntOption(core, fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, effective.m_notSentLowat);
+#endif
+    flag = effective.m_keepAlive ? 1 : 0;
+    getIntOption(core, fd, SOL_SOCKET, SO_KEEPALIVE, flag);
+    effective.m_keepAlive = flag != 0;
+#if defined(TCP_KEEPIDLE)
+    getIntOption(core, fd, IPPROTO_TCP, TCP_KEEPIDLE, effective.m_keepIdleSecs);
+#endif
+#if defined(TCP_KEEPINTVL)
+    getIntOption(core, fd, IPPROTO_TCP, TCP_KEEPINTVL, effective.m_keepIntervalSecs);
+#endif
+#if defined(TCP_KEEPCNT)
+    getIntOption(core, fd, IPPROTO_TCP, TCP_KEEPCNT, effective.m_keepCount);
+#endif
+}
+
+}  // namespace sockets
@@ -0,0 +1,111 @@
+#pragma once
+#include "ThreadPool.h"
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace sockets {
+
+/**
+ * @brief Most tasks a strand runs before giving its worker thread to other strands
+ */
+constexpr size_t STRAND_BATCH = 64;
+
+/**
+ * @brief Strand runs the tasks posted to it on a ThreadPool one at a time, in the order they were posted.  Tasks
+ *        of different strands run in parallel, so giving each connection a strand keeps its callbacks ordered
+ *        while the callbacks of different connections spread across the pool's threads.  The pool must outlive
+ *        every task posted to the strand.
+ */
+class Strand : public std::enable_shared_from_this<Strand> {
+public:
+    /**
+     * @brief Construct a new Strand object
+     *
+     * @param pool - thread pool running the tasks
+     */
+    explicit Strand(ThreadPool &pool) : m_pool(pool) {
+    }
+
+    Strand(const Strand &) = delete;
+    Strand &operator=(const Strand &) = delete;
+
+    /**
+     * @brief Queue a task to run after the tasks already posted to this strand
+     *
+     * @param task - the task
+     */
+    void post(std::function<void()> task) {
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_tasks.push_back(std::move(task));
+            if (m_scheduled) {
+                // The running batch picks it up
+                return;
+            }
+            m_scheduled = true;
+        }
+        schedule();
+    }
+
+    /**
+     * @brief Number of tasks waiting to run
+     */
+    size_t pending() const {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_tasks.size();
+    }
+
+private:
+    /**
+     * @brief Have the pool run a batch of this strand's tasks
+     */
+    void schedule() {
+        std::shared_ptr<Strand> self = shared_from_this();
+        m_pool.post([self]() { self->runBatch(); });
+    }
+
+    /**
+     * @brief Run up to STRAND_BATCH tasks, then reschedule if more are waiting
+     */
+    void runBatch() {
+        for (size_t count = 0; count < STRAND_BATCH; count++) {
+            std::function<void()> task;
+            {
+                std::lock_guard<std::mutex> guard(m_mutex);
+                if (m_tasks.empty()) {
+                    m_scheduled = false;
+                    return;
+                }
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+            task();
+        }
+        schedule();
+    }
+
+    /**
+     * @brief Thread pool running the tasks
+     */
+    ThreadPool &m_pool;
+
+    /**
+     * @brief Mutex protecting m_tasks and m_scheduled
+     */
+    mutable std::mutex m_mutex;
+
+    /**
+     * @brief Tasks waiting to run
+     */
+    std::deque<std::function<void()>> m_tasks;
+
+    /**
+     * @brief A batch is queued on the pool or running
+     */
+    bool m_scheduled = false;
+};
+
+}  // namespace sockets
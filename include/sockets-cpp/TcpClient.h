@@ -1,17 +1,31 @@
 #pragma once
 
 #include "AddrLookup.h"
+#include "BufferPool.h"
+#include "EventPoller.h"
+#include "FlowControl.h"
+#include "Framing.h"
+#include "Metrics.h"
+#include "SendQueue.h"
 #include "SocketCommon.h"
 #include "SocketCore.h"
+#include "SocketTuning.h"
+#include "Strand.h"
+#include "ThreadPool.h"
+#include "Tracing.h"
 #include <array>
 #include <atomic>
 #include <cerrno>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <sys/types.h>
 #include <thread>
+#include <utility>
 #include <vector>
 #if defined(FMT_SUPPORT)
 #include <fmt/core.h>
@@ -26,8 +40,15 @@ constexpr uint32_t MSG_SIZE = 100;
 /**
  * @brief TcpClient encapsulates a TCP client socket connection to a server
  *
+ * @tparam CallbackImpl - callback recipient
+ * @tparam SocketImpl - interface for socket calls
+ * @tparam Framing - codec splitting the received data into messages; RawFraming delivers received chunks
+ *          as they arrive
+ * @tparam Tracing - tracing policy called on receives, sends and callbacks; NoTracing compiles away,
+ *          UsdtTracing emits USDT probes
  */
-template <class CallbackImpl, class SocketImpl = sockets::SocketCore>
+template <class CallbackImpl, class SocketImpl = sockets::SocketCore, class Framing = RawFraming,
+          class Tracing = NoTracing>
 class TcpClient {
 public:
     /**
@@ -37,10 +58,17 @@ public:
      * @param options - optional socket options to configure SO_SNDBUF and SO_RCVBUF
      */
     explicit TcpClient(CallbackImpl &callback, SocketOpt *options = nullptr)
-        : m_stop(false), m_callback(callback), m_addrLookup(m_socketCore) {
-        if (options != nullptr) {
-            m_sockOptions = *options;
-        }
+        : m_stop(false), m_callback(callback), m_sockOptions(options != nullptr ? *options : SocketOpt()),
+          m_metrics(m_sockOptions.m_latencyHistograms, m_sockOptions.m_callbackThreads + 2),
+          m_addrLookup(m_socketCore),
+          m_poller(m_socketCore),
+          m_flow(m_sockOptions),
+          m_inbound(m_sockOptions),
+          m_framer(m_sockOptions.m_maxMessageSize),
+          m_rxPool(std::make_shared<BufferPool>(m_sockOptions.m_rxSlabSize, m_sockOptions.m_rxSlabCount,
+                                                m_sockOptions.m_rxHugePages)),
+          m_rxChain(m_rxPool, MAX_PACKET_SIZE) {
+        m_sendQueue.setMetrics(&m_metrics);
     }
 
     TcpClient(const TcpClient &) = delete;
@@ -126,6 +154,9 @@ public:
             return ret;
         }
 
+        // remaining tuning options are best effort
+        applyTuning(m_socketCore, m_sockfd, m_sockOptions, true);
+
         if (m_addrLookup.lookupHost(remoteIp, m_server.sin_addr.s_addr) != 0) {
 #if defined(FMT_SUPPORT)
             ret.m_msg = fmt::format("Failed to resolve hostname {}", remoteIp);
@@ -139,6 +170,7 @@ public:
         }
         m_server.sin_family = AF_INET;
         m_server.sin_port = htons(remotePort);
+        m_framer.reset();
 
         int connectRet = m_socketCore.Connect(m_sockfd, reinterpret_cast<struct sockaddr *>(&m_server), sizeof(m_server));
         if (connectRet == -1) {
@@ -152,61 +184,243 @@ public:
 #endif
             return ret;
         }
+
+        // Report what the kernel granted, e.g. buffer sizes are doubled and capped by system limits
+        m_effectiveOptions = m_sockOptions;
+        readTuning(m_socketCore, m_sockfd, true, m_effectiveOptions);
+
+        m_msgZeroCopy = enableMsgZeroCopy(m_socketCore, m_sockfd, m_sockOptions);
+        if (m_msgZeroCopy) {
+            m_sendQueue.useMsgZeroCopy();
+        }
+        m_zeroCopy =
+            m_sockOptions.m_zeroCopySend && (m_sockOptions.m_eventBackend == EventBackend::IoUring || m_msgZeroCopy);
+
+        // Switch to non-blocking mode so that sendMsg() never stalls the caller, and register with the event loop
+        bool opened = m_socketCore.SetNonBlocking(m_sockfd) == 0 &&
+                      m_poller.open(m_sockOptions.m_eventBackend, m_sockOptions.m_uringBufferCount,
+                                    m_sockOptions.m_uringBufferSize) == 0;
+        if (opened) {
+            // Registration pins the regions' pages once; if RLIMIT_MEMLOCK doesn't allow it, each zero-copy send
+            // pins its own pages instead
+            (void)m_poller.registerSendRegions(m_sendRegions);
+        }
+        if (!opened || m_poller.add(m_sockfd, POLL_READ) != 0) {
+            ret.m_success = false;
+#if defined(FMT_SUPPORT)
+            ret.m_msg = fmt::format("Error: event loop setup failed errno {}", errno);
+#else
+            std::array<char,MSG_SIZE> msg;
+            (void)snprintf(msg.data(),msg.size(),"Error: event loop setup failed: %d",errno);
+            ret.m_msg = msg.data();
+#endif
+            return ret;
+        }
+        if (m_sockOptions.m_callbackThreads > 0 && !m_callbackPool) {
+            m_callbackPool = std::make_shared<ThreadPool>(m_sockOptions.m_callbackThreads);
+            m_strand = std::make_shared<Strand>(*m_callbackPool);
+        }
         m_thread = std::thread(&TcpClient::ReceiveTask, this);
         ret.m_success = true;
         return ret;
     }
 
     /**
-     * @brief Send a message to the TCP server
+     * @brief Send a message to the TCP server.  Whatever the kernel can't accept immediately is queued
+     *          and sent by the receive thread once the socket becomes writable, so the caller never blocks.
      *
      * @param msg - pointer to the message data
      * @param size - length of the message data
-     * @return SocketRet - indication of whether the message was sent successfully
+     * @return SocketRet - indication of whether the message was sent or queued successfully
      */
     SocketRet sendMsg(const char *msg, size_t size) {
+        MsgPart part { msg, size };
+        return sendData(&part, 1, nullptr, 0);
+    }
+
+    /**
+     * @brief Send a message held in a SharedBuffer to the TCP server.  If it can't be sent immediately the buffer
+     *          handle is queued, not the data.
+     *
+     * @param buffer - the message data
+     * @return SocketRet - indication of whether the message was sent or queued successfully
+     */
+    SocketRet sendMsg(const SharedBuffer &buffer) {
+        MsgPart part { buffer.data(), buffer.size() };
+        return sendData(&part, 1, &buffer, 0);
+    }
+
+    /**
+     * @brief Send a message made of several parts (e.g. a header and a payload in separate buffers) to the TCP
+     *          server.  The parts go out with one sendmsg() call, without being copied together first; only a
+     *          remainder the socket can't accept immediately is gathered into the send queue.
+     *
+     * @param parts - the message parts
+     * @param count - number of parts, at most MAX_MSG_PARTS
+     * @param more - more data follows shortly (MSG_MORE), so the kernel may hold back a partly filled segment
+     *          until the next send
+     * @return SocketRet - indication of whether the message was sent or queued successfully
+     */
+    SocketRet sendMsgv(const MsgPart *parts, size_t count, bool more = false) {
+        if (count == 0 || count > MAX_MSG_PARTS) {
+            SocketRet ret;
+#if defined(FMT_SUPPORT)
+            ret.m_msg = fmt::format("Error: {} message parts, expected 1 to {}", count, MAX_MSG_PARTS);
+#else
+            std::array<char,MSG_SIZE> msg;
+            (void)snprintf(msg.data(),msg.size(),"Error: %zu message parts, expected 1 to %zu",count,MAX_MSG_PARTS);
+            ret.m_msg = msg.data();
+#endif
+            ret.m_success = false;
+            return ret;
+        }
+        return sendData(parts, count, nullptr, more ? MORE_FLAGS : 0);
+    }
+
+    /**
+     * @brief Send a range of a file to the TCP server.  The kernel sends it straight from the page cache with
+     *          sendfile(), as the socket accepts it, so the data never passes through user space and the caller
+     *          isn't held up by a large file.
+     *
+     * @param fileFd - descriptor of the file, open for reading.  It's duplicated, so it may be closed on return.
+     * @param offset - file offset of the first byte to send
+     * @param size - number of bytes to send
+     * @return SocketRet - indication of whether the range was sent or queued successfully
+     */
+    SocketRet sendFile(int fileFd, off_t offset, size_t size) {
         SocketRet ret;
-        ssize_t numBytesSent = m_socketCore.Send(m_sockfd, reinterpret_cast<const void *>(msg), size, 0);
-        if (numBytesSent < 0) {  // send failed
+        std::lock_guard<std::mutex> guard(m_sendMutex);
+        bool wasPending = m_sendQueue.writePending();
+        bool wasEmpty = m_sendQueue.empty();
+        if (!m_sendQueue.appendFile(fileFd, offset, size)) {
             ret.m_success = false;
 #if defined(FMT_SUPPORT)
-            ret.m_msg = fmt::format("Error: send() failed errno {}", errno);
+            ret.m_msg = fmt::format("Error: dup() failed errno {}", errno);
 #else
             std::array<char,MSG_SIZE> msg;
-            (void)snprintf(msg.data(),msg.size(),"Error: send() failed: %d",errno);
+            (void)snprintf(msg.data(),msg.size(),"Error: dup() failed: %d",errno);
             ret.m_msg = msg.data();
 #endif
             return ret;
         }
-        if (static_cast<size_t>(numBytesSent) < size) {  // not all bytes were sent
+        // Queued data must go out first to preserve message order
+        if (wasEmpty && sendQueued() < 0) {
+            m_sendQueue.clear();
             ret.m_success = false;
 #if defined(FMT_SUPPORT)
-            ret.m_msg = fmt::format("Error: Only {} bytes out of {} sent to client", numBytesSent, size);
+            ret.m_msg = fmt::format("Error: sendfile() failed errno {}", errno);
 #else
             std::array<char,MSG_SIZE> msg;
-            (void)snprintf(msg.data(), msg.size(), "Only %ld bytes out of %lu was sent to client", numBytesSent, size);
+            (void)snprintf(msg.data(),msg.size(),"Error: sendfile() failed: %d",errno);
             ret.m_msg = msg.data();
 #endif
             return ret;
         }
+        if (m_sendQueue.writePending() != wasPending) {
+            m_poller.modify(m_sockfd, m_flow.interest(m_sendQueue.writePending()));
+        }
+        m_metrics.add(Counter::MessagesOut);
         ret.m_success = true;
         return ret;
     }
 
+    /**
+     * @brief Register a region of memory from which messages are sent with zero-copy sends, when
+     *          SocketOpt::m_zeroCopySend is set.  Call this before connectTo(); the region must stay valid until
+     *          finish().  A message sent from the region must not be modified until onSendComplete() reports it.
+     *
+     * @param data - start of the region
+     * @param size - length of the region, at most 1GB
+     */
+    void registerSendRegion(const char *data, size_t size) {
+        m_sendRegions.push_back(SendRegion { data, size });
+    }
+
+    /**
+     * @brief Stop reading data from the server, e.g. while the application catches up.  Data the server sends
+     *          meanwhile is held in the kernel, whose TCP flow control then slows the server down.
+     */
+    void pauseReceive() {
+        pauseRead(true);
+    }
+
+    /**
+     * @brief Resume reading data from the server after pauseReceive()
+     */
+    void resumeReceive() {
+        pauseRead(false);
+    }
+
+    /**
+     * @brief Get the socket options in effect after connectTo(), as read back from the socket.  Options which
+     *          can't be read back report the requested value.
+     *
+     * @return SocketOpt - the effective socket options
+     */
+    SocketOpt getEffectiveOptions() const {
+        return m_effectiveOptions;
+    }
+
+    /**
+     * @brief Get the occupancy and hit/miss counters of the receive buffer pool
+     *
+     * @return BufferPoolStats - receive buffer pool counters
+     */
+    BufferPoolStats getReceivePoolStats() const {
+        return m_rxPool->stats();
+    }
+
+    /**
+     * @brief Get the connection's counters and latency histograms since construction.  Reading them doesn't
+     *          stall the receive thread.
+     *
+     * @return SocketMetrics - snapshot of the metrics
+     */
+    SocketMetrics getMetrics() const {
+        SocketMetrics metrics;
+        m_metrics.snapshot(metrics);
+        return metrics;
+    }
+
+    /**
+     * @brief Run a task on the receive thread, in order with the receive callbacks run there.  Tasks posted while
+     *          the socket isn't connected, or still queued when it is shut down, are dropped.
+     *
+     * @param task - the task
+     */
+    void post(std::function<void()> task) {
+        m_poller.post(std::move(task));
+    }
+
     /**
      * @brief Shut down the TCP client
      */
     void finish() {
+        if (m_thread.joinable() && !m_stop.exchange(true)) {
+            // Still connected, so the application is closing the connection
+            m_metrics.add(Counter::DisconnectLocal);
+        }
         m_stop.store(true);
+        m_poller.wake();
         if (m_thread.joinable()) {
             try {
                 m_thread.join();
             } catch (...) { }
         }
+        // Run the callbacks already dispatched to the worker pool.  A callback calling finish() leaves that to
+        // the destructor.
+        if (m_callbackPool && !m_callbackPool->inWorker()) {
+            m_callbackPool.reset();
+            m_strand.reset();
+        }
+        // A callback still running on the worker pool may pause or resume reading meanwhile
+        std::lock_guard<std::mutex> guard(m_sendMutex);
+        m_poller.close();
         if (m_sockfd != INVALID_SOCKET) {
             m_socketCore.Close(m_sockfd);
         }
         m_sockfd = INVALID_SOCKET;
+        m_sendQueue.clear();
     }
 
 private:
@@ -215,63 +429,423 @@ private:
      *
      * @param msg - pointer to the message data
      * @param msgSize - length of the message data
+     * @param chain - receive buffers holding the data, or nullptr if the data is in io_uring's buffers
      */
-    void publishServerMsg(const char *msg, size_t msgSize) {
-        m_callback.onReceiveData(msg, msgSize);
+    void publishServerMsg(const char *msg, size_t msgSize, const ReceiveChain *chain) {
+        auto share = [chain](const char *data, size_t size) {
+            return (chain != nullptr) ? chain->share(data, size) : SharedBuffer::copyOf(data, size);
+        };
+        m_metrics.add(Counter::MessagesIn);
+        if (!m_strand) {
+            runCallback(m_sockfd, msgSize, [&]() { deliverReceived(m_callback, 0, msg, msgSize, share); });
+            return;
+        }
+        // Counted before posting so the worker can't consume it first
+        bool pause = m_inbound.queued(msgSize);
+        // The receive buffer is reused once this returns, so the worker gets a counted reference to it
+        m_strand->post([this, fd = m_sockfd, buffer = share(msg, msgSize)]() {
+            runCallback(fd, buffer.size(), [&]() {
+                deliverReceived(m_callback, 0, buffer.data(), buffer.size(), [&buffer](const char *, size_t) { return buffer; });
+            });
+            if (m_inbound.consumed(buffer.size())) {
+                pauseInbound(false);
+            }
+        });
+        if (pause) {
+            pauseInbound(true);
+        }
     }
 
     /**
      * @brief Publish notification of disconnection
      *
      * @param ret - error information
+     * @param reason - the Counter of the disconnect reason
      */
-    void publishDisconnected(const SocketRet &ret) {
-        m_callback.onDisconnect(ret);
+    void publishDisconnected(const SocketRet &ret, Counter reason) {
+        m_metrics.add(reason);
+        if (m_strand) {
+            m_strand->post(
+                [this, fd = m_sockfd, ret]() { runCallback(fd, 0, [&]() { m_callback.onDisconnect(ret); }); });
+        } else {
+            runCallback(m_sockfd, 0, [&]() { m_callback.onDisconnect(ret); });
+        }
     }
 
     /**
-     * @brief Thread which receives data from the TCP server
+     * @brief Run a callback, timing and tracing it
+     *
+     * @param fd - the connection's socket descriptor
+     * @param size - length of the message passed to the callback, or 0
+     * @param task - the callback invocation
      */
-    void ReceiveTask() {
-        constexpr int64_t USEC_DELAY = 500000;
-        while (!m_stop.load()) {
-            fd_set fds;
-            struct timeval delay {
-                0, USEC_DELAY
-            };
-            FD_ZERO(&fds);
-            FD_SET(m_sockfd, &fds);
-            int selectRet = m_socketCore.Select(m_sockfd + 1, &fds, nullptr, nullptr, &delay);
-            if (selectRet <= 0) {  // select failed or timeout
-                if (m_stop) {
-                    break;
+    template <class Task>
+    void runCallback(SOCKET fd, size_t size, const Task &task) {
+        Tracing::trace(TraceEvent::CallbackBegin, fd, static_cast<int64_t>(size));
+        m_metrics.timeCallback(task);
+        Tracing::trace(TraceEvent::CallbackEnd, fd, static_cast<int64_t>(size));
+    }
+
+    /**
+     * @brief Send message data, queuing whatever the kernel doesn't accept
+     *
+     * @param parts - the message parts
+     * @param count - number of parts
+     * @param owner - buffer holding a single-part message to queue by reference, or nullptr to queue a copy
+     * @param flags - send flags in addition to SEND_FLAGS
+     * @return SocketRet - indication of whether the message was sent or queued successfully
+     */
+    SocketRet sendData(const MsgPart *parts, size_t count, const SharedBuffer *owner, int flags) {
+        SocketRet ret;
+        size_t backPressure = 0;
+        std::vector<SharedBuffer> completed;
+        const char *msg = parts[0].m_data;
+        size_t size = partsSize(parts, count);
+        bool zeroCopy = m_zeroCopy && count == 1 &&
+                        zeroCopyEligible(m_sockOptions, m_sendRegions, msg, size, owner != nullptr);
+        {
+            std::lock_guard<std::mutex> guard(m_sendMutex);
+            if (!m_flow.admit(m_sendQueue.size(), size)) {
+                ret.m_success = false;
+                ret.m_msg = "Error: send queue full";
+                return ret;
+            }
+            size_t numBytesSent = 0;
+            // Queued data must go out first to preserve message order
+            if (m_sendQueue.empty() && !zeroCopy) {
+                auto start = m_sendQueue.sendStart();
+                ssize_t sent = (count == 1)
+                    ? m_socketCore.Send(m_sockfd, reinterpret_cast<const void *>(msg), size, SEND_FLAGS | flags)
+                    : sendParts(m_socketCore, m_sockfd, parts, count, SEND_FLAGS | flags);
+                m_sendQueue.directSent(sent, size, start);
+                Tracing::trace(TraceEvent::Send, m_sockfd, sent);
+                if (sent < 0 && !wouldBlock(errno)) {  // send failed
+                    return sendFailed();
                 }
-            } else if (FD_ISSET(m_sockfd, &fds)) {
-                std::array<char, MAX_PACKET_SIZE> msg;
-                ssize_t numOfBytesReceived = m_socketCore.Recv(m_sockfd, msg.data(), MAX_PACKET_SIZE, 0);
-                if (numOfBytesReceived < 1) {
-                    SocketRet ret;
-                    ret.m_success = false;
-                    m_stop = true;
-                    if (numOfBytesReceived == 0) {  // server closed connection
+                numBytesSent = (sent < 0) ? 0 : static_cast<size_t>(sent);
+            }
+            if (numBytesSent < size) {
+                // Kernel send buffer is full, or the message is sent without copying, so the receive thread sends
+                // the rest
+                bool wasPending = m_sendQueue.writePending();
+                bool wasEmpty = m_sendQueue.empty();
+                if (owner != nullptr) {
+                    m_sendQueue.append(*owner, numBytesSent, zeroCopy);
+                } else if (zeroCopy) {
+                    m_sendQueue.append(SharedBuffer::reference(msg, size), 0, true);
+                } else {
+                    m_sendQueue.append(parts, count, numBytesSent);
+                }
+                if (zeroCopy && wasEmpty) {
+                    if (sendQueued() < 0) {
+                        m_sendQueue.clear();
+                        return sendFailed();
+                    }
+                    m_sendQueue.takeCompleted(completed);
+                }
+                bool pressured = m_flow.queued(m_sendQueue.size());
+                if (m_sendQueue.writePending() != wasPending || pressured) {
+                    m_poller.modify(m_sockfd, m_flow.interest(m_sendQueue.writePending()));
+                }
+                backPressure = pressured ? m_sendQueue.size() : 0;
+            }
+        }
+        if (backPressure != 0) {
+            // Outside m_sendMutex so the callback may send or pause
+            notifyBackPressure(m_callback, 0, backPressure);
+        }
+        reportSent(completed, false);
+        m_metrics.add(Counter::MessagesOut);
+        ret.m_success = true;
+        return ret;
+    }
+
+    /**
+     * @brief Build the result for a failed send
+     *
+     * @return SocketRet - the failure, including errno
+     */
+    static SocketRet sendFailed() {
+        SocketRet ret;
+        ret.m_success = false;
 #if defined(FMT_SUPPORT)
-                        ret.m_msg = fmt::format("Server closed connection");
+        ret.m_msg = fmt::format("Error: send() failed errno {}", errno);
 #else
-                        ret.m_msg = "Server closed connection";
+        std::array<char,MSG_SIZE> msg;
+        (void)snprintf(msg.data(),msg.size(),"Error: send() failed: %d",errno);
+        ret.m_msg = msg.data();
 #endif
-                    } else {
+        return ret;
+    }
+
+    /**
+     * @brief Send queued data now that the socket is writable
+     */
+    void flush() {
+        bool writable = false;
+        std::vector<SharedBuffer> completed;
+        {
+            std::lock_guard<std::mutex> guard(m_sendMutex);
+            writable = flushQueue();
+            m_sendQueue.takeCompleted(completed);
+        }
+        reportSent(completed, writable);
+    }
+
+    /**
+     * @brief Handle the result of a zero-copy send, and start sending the next message
+     *
+     * @param result - number of bytes sent, or a negative errno value
+     */
+    void zeroCopySent(int result) {
+        bool writable = false;
+        std::vector<SharedBuffer> completed;
+        {
+            std::lock_guard<std::mutex> guard(m_sendMutex);
+            (void)m_sendQueue.zeroCopySent(result);
+            Tracing::trace(TraceEvent::Send, m_sockfd, result);
+            if (result < 0 && result != -EOPNOTSUPP) {
+                // Connection failed; the receive path reports the disconnect
+                m_sendQueue.clear();
+                m_poller.modify(m_sockfd, m_flow.interest(false));
+            } else {
+                writable = flushQueue();
+            }
+            m_sendQueue.takeCompleted(completed);
+        }
+        reportSent(completed, writable);
+    }
+
+    /**
+     * @brief Handle the kernel's release of the data of a zero-copy send
+     *
+     * @param seq - sequence number of the send
+     */
+    void zeroCopyReleased(int seq) {
+        bool writable = false;
+        std::vector<SharedBuffer> completed;
+        {
+            std::lock_guard<std::mutex> guard(m_sendMutex);
+            if (m_sendQueue.zeroCopyReleased(static_cast<uint32_t>(seq))) {
+                // The next send was waiting for the kernel to release earlier ones
+                writable = flushQueue();
+            }
+            m_sendQueue.takeCompleted(completed);
+        }
+        reportSent(completed, writable);
+    }
+
+    /**
+     * @brief Read the release notifications of MSG_ZEROCOPY sends and report completed messages
+     *
+     * @return true - notifications were read
+     */
+    bool readNotifications() {
+        bool notified = false;
+        std::vector<SharedBuffer> completed;
+        {
+            std::lock_guard<std::mutex> guard(m_sendMutex);
+            if (!m_sendQueue.zeroCopyHeld()) {
+                return false;
+            }
+            notified = m_sendQueue.readNotifications(m_socketCore, m_sockfd);
+            m_sendQueue.takeCompleted(completed);
+        }
+        reportSent(completed, false);
+        return notified;
+    }
+
+    /**
+     * @brief Send as much queued data as the socket accepts.  Caller holds m_sendMutex.
+     *
+     * @return ssize_t - number of bytes sent, or -1 if the socket failed (errno is set)
+     */
+    ssize_t sendQueued() {
+        ssize_t sent = m_sendQueue.flush(m_socketCore, m_sockfd, m_poller);
+        Tracing::trace(TraceEvent::Send, m_sockfd, sent);
+        return sent;
+    }
+
+    /**
+     * @brief Send queued data and update the monitored events.  Caller holds m_sendMutex.
+     *
+     * @return true - the queue has drained to the low watermark after back-pressure
+     */
+    bool flushQueue() {
+        ssize_t sent = sendQueued();
+        if (sent < 0) {
+            // Connection failed; the receive path reports the disconnect
+            m_sendQueue.clear();
+        }
+        bool writable = m_flow.drained(m_sendQueue.size()) && sent >= 0;
+        if (!m_sendQueue.writePending() || writable) {
+            m_poller.modify(m_sockfd, m_flow.interest(m_sendQueue.writePending()));
+        }
+        return writable;
+    }
+
+    /**
+     * @brief Report completed zero-copy messages and the release of back-pressure.  Called without m_sendMutex
+     *          so the callbacks may send.
+     *
+     * @param completed - zero-copy messages whose data may be reused
+     * @param writable - the queue drained to the low watermark
+     */
+    void reportSent(const std::vector<SharedBuffer> &completed, bool writable) {
+        for (const auto &buffer : completed) {
+            notifySendComplete(m_callback, 0, buffer.data(), buffer.size());
+        }
+        if (writable) {
+            notifyWritable(m_callback, 0);
+        }
+    }
+
+    /**
+     * @brief Stop or resume monitoring the connection for received data
+     *
+     * @param paused - true to stop reading
+     */
+    void pauseRead(bool paused) {
+        std::lock_guard<std::mutex> guard(m_sendMutex);
+        m_flow.pauseRead(paused);
+        if (m_sockfd != INVALID_SOCKET) {
+            m_poller.modify(m_sockfd, m_flow.interest(m_sendQueue.writePending()));
+        }
+    }
+
+    /**
+     * @brief Stop reading while the callback workers are behind, or resume once they have caught up.  Called
+     *          when InboundBacklog::queued() or InboundBacklog::consumed() asks for it.
+     *
+     * @param paused - true to stop reading
+     */
+    void pauseInbound(bool paused) {
+        std::lock_guard<std::mutex> guard(m_sendMutex);
+        if (!(paused ? m_inbound.pause() : m_inbound.resume())) {
+            return;
+        }
+        m_flow.pauseInbound(paused);
+        if (m_sockfd != INVALID_SOCKET) {
+            m_poller.modify(m_sockfd, m_flow.interest(m_sendQueue.writePending()));
+        }
+    }
+
+    /**
+     * @brief Receive data from the TCP server
+     *
+     * @param events - the events reported for the connection
+     * @return true - connection is still up
+     * @return false - connection was closed or failed
+     */
+    bool receive(uint32_t events) {
+        if (m_msgZeroCopy && readNotifications() && (events & POLL_READ) == 0) {
+            // epoll reports a non-empty error queue even while reading is paused
+            return true;
+        }
+        ssize_t numOfBytesReceived = m_rxChain.receive(m_socketCore, m_sockfd);
+        if (numOfBytesReceived < 0 && wouldBlock(errno)) {
+            // spurious wakeup on the non-blocking socket
+            m_metrics.add(Counter::RecvCalls);
+            return true;
+        }
+        std::array<MsgPart, RX_CHAIN_MAX> segments;
+        size_t count = m_rxChain.segments(numOfBytesReceived < 0 ? 0 : static_cast<size_t>(numOfBytesReceived),
+                                          segments.data());
+        return processReceived(numOfBytesReceived, segments.data(), count, &m_rxChain);
+    }
+
+    /**
+     * @brief Handle the result of a receive from the TCP server
+     *
+     * @param numOfBytesReceived - number of bytes received, 0 if the server closed the connection or -1 on
+     *          failure (errno is set)
+     * @param segments - the received data, in order
+     * @param count - number of segments
+     * @param chain - receive buffers holding the segments, or nullptr if the data is in io_uring's buffers
+     * @return true - connection is still up
+     * @return false - connection was closed or failed
+     */
+    bool processReceived(ssize_t numOfBytesReceived, const MsgPart *segments, size_t count,
+                         const ReceiveChain *chain) {
+        Tracing::trace(TraceEvent::Receive, m_sockfd, numOfBytesReceived);
+        m_metrics.add(Counter::RecvCalls);
+        if (numOfBytesReceived < 1) {
+            SocketRet ret;
+            ret.m_success = false;
+            m_stop = true;
+            if (numOfBytesReceived == 0) {  // server closed connection
+#if defined(FMT_SUPPORT)
+                ret.m_msg = fmt::format("Server closed connection");
+#else
+                ret.m_msg = "Server closed connection";
+#endif
+            } else {
 #if defined(FMT_SUPPORT)
-                        ret.m_msg = fmt::format("Error: recv() failed errno {}", errno);
+                ret.m_msg = fmt::format("Error: recv() failed errno {}", errno);
 #else
-                        std::array<char,MSG_SIZE> errMsg;
-                        (void)snprintf(errMsg.data(),errMsg.size(),"Error: recv() failed: %d",errno);
-                        ret.m_msg = errMsg.data();
+                std::array<char,MSG_SIZE> errMsg;
+                (void)snprintf(errMsg.data(),errMsg.size(),"Error: recv() failed: %d",errno);
+                ret.m_msg = errMsg.data();
 #endif
+            }
+            publishDisconnected(ret, numOfBytesReceived == 0 ? Counter::DisconnectPeer : Counter::DisconnectError);
+            return false;
+        }
+        m_metrics.add(Counter::BytesIn, static_cast<uint64_t>(numOfBytesReceived));
+        rearmQuickAck(m_socketCore, m_sockfd, m_sockOptions);
+        FrameStatus status = FrameStatus::Incomplete;
+        for (size_t idx = 0; idx < count && status != FrameStatus::Invalid; idx++) {
+            status = m_framer.feed(segments[idx].m_data, segments[idx].m_size,
+                [this, chain](const char *data, size_t size) { publishServerMsg(data, size, chain); });
+        }
+        if (status == FrameStatus::Invalid) {
+            SocketRet ret;
+            ret.m_success = false;
+            ret.m_msg = "Error: framing error in data from server";
+            m_stop = true;
+            publishDisconnected(ret, Counter::DisconnectFraming);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Thread which receives data from the TCP server and sends queued data
+     */
+    void ReceiveTask() {
+        constexpr int MSEC_DELAY = 500;
+        std::vector<PollEvent> events;
+        // finish() and post() wake the loop; without a wakeup descriptor it polls for them
+        int timeout = m_poller.canWake() ? -1 : MSEC_DELAY;
+        while (!m_stop.load()) {
+            int ready = m_poller.wait(events, timeout);
+            m_metrics.add(Counter::PollWaits);
+            m_poller.runPosted();
+            if (ready <= 0) {  // wait failed, timeout or wakeup
+                continue;
+            }
+            for (const auto &event : events) {
+                if ((event.m_events & POLL_SENT) != 0) {
+                    // zero-copy send finished
+                    zeroCopySent(event.m_result);
+                } else if ((event.m_events & POLL_SEND_RELEASED) != 0) {
+                    // kernel released the data of a zero-copy send
+                    zeroCopyReleased(event.m_result);
+                } else if ((event.m_events & POLL_WRITE) != 0) {
+                    flush();
+                }
+                if ((event.m_events & POLL_DATA) != 0) {
+                    // data received by io_uring
+                    if (event.m_result < 0) {
+                        errno = -event.m_result;
+                    }
+                    MsgPart segment { event.m_data, event.m_result < 0 ? 0 : static_cast<size_t>(event.m_result) };
+                    if (!processReceived(event.m_result < 0 ? -1 : event.m_result, &segment, 1, nullptr)) {
+                        return;
                     }
-                    publishDisconnected(ret);
-                    break;
+                } else if ((event.m_events & (POLL_READ | POLL_ERROR)) != 0 && !receive(event.m_events)) {
+                    return;
                 }
-                publishServerMsg(msg.data(), static_cast<size_t>(numOfBytesReceived));
             }
         }
     }
@@ -306,6 +880,16 @@ private:
      */
     SocketOpt m_sockOptions;
 
+    /**
+     * @brief Socket options in effect on the connection, read back after connecting
+     */
+    SocketOpt m_effectiveOptions;
+
+    /**
+     * @brief Counters and latency histograms, see getMetrics()
+     */
+    Metrics m_metrics;
+
     /**
      * @brief Interface for socket calls
      */
@@ -315,6 +899,64 @@ private:
      * @brief Helper for hostname resolution
      */
     AddrLookup<SocketImpl> m_addrLookup;
+
+    /**
+     * @brief Event loop monitoring the connection
+     */
+    EventPoller<SocketImpl> m_poller;
+
+    /**
+     * @brief Mutex serializing senders and the receive thread's flush of m_sendQueue
+     */
+    std::mutex m_sendMutex;
+
+    /**
+     * @brief Outbound data the kernel couldn't accept yet
+     */
+    SendQueue m_sendQueue;
+
+    /**
+     * @brief Outbound watermarks and read pausing, protected by m_sendMutex
+     */
+    FlowControl m_flow;
+
+    /**
+     * @brief Received bytes waiting on m_strand for the callback workers
+     */
+    InboundBacklog m_inbound;
+
+    /**
+     * @brief Memory regions registered for zero-copy sends
+     */
+    std::vector<SendRegion> m_sendRegions;
+
+    /**
+     * @brief Large messages may be sent without copying, by io_uring or with MSG_ZEROCOPY
+     */
+    bool m_zeroCopy = false;
+
+    /**
+     * @brief Zero-copy sends use MSG_ZEROCOPY, whose release notifications arrive on the socket error queue
+     */
+    bool m_msgZeroCopy = false;
+
+    /**
+     * @brief Reassembles received messages; only used by the receive thread
+     */
+    Framer<Framing> m_framer;
+
+    /**
+     * @brief Receive buffers, and the chain of them the receive thread reads into
+     */
+    std::shared_ptr<BufferPool> m_rxPool;
+    ReceiveChain m_rxChain;
+
+    /**
+     * @brief Worker threads running the callbacks, and the strand keeping them in order, when
+     *        SocketOpt::m_callbackThreads > 0.  Declared last so pending callbacks run before other members go.
+     */
+    std::shared_ptr<ThreadPool> m_callbackPool;
+    std::shared_ptr<Strand> m_strand;
 };
 
 }  // Namespace sockets
\ No newline at end of file
@@ -1,20 +1,37 @@
 #pragma once
+#include "Admission.h"
+#include "BufferPool.h"
+#include "ClientRegistry.h"
+#include "EventPoller.h"
+#include "FlowControl.h"
+#include "Framing.h"
+#include "Metrics.h"
+#include "SendQueue.h"
+#include "SharedBuffer.h"
 #include "SocketCommon.h"
 #include "SocketCore.h"
+#include "SocketTuning.h"
+#include "Strand.h"
+#include "ThreadPool.h"
+#include "TimerWheel.h"
+#include "Tracing.h"
 #include <algorithm>
 #include <array>
 #include <atomic>
 #include <cerrno>
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <functional>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <sys/types.h>
 #include <thread>
-#include <unordered_map>
+#include <utility>
+#include <vector>
 #if defined(FMT_SUPPORT)
 #include <fmt/core.h>
 #endif
@@ -24,18 +41,18 @@ constexpr size_t MAX_PACKET_SIZE = 65536;
 
 constexpr uint32_t MSG_SIZE = 100;
 
-/**
- * @brief ClientHandle is an identifier which refers to a TCP client connection
- *      established with this server.
- *
- */
-using ClientHandle = int32_t;
-
 /**
  * @brief The TcpServer class encapsulates a TCP server supporting one or more TCP client connections
  *
+ * @tparam CallbackImpl - callback recipient
+ * @tparam SocketImpl - interface for socket calls
+ * @tparam Framing - codec splitting each connection's received data into messages; RawFraming delivers
+ *          received chunks as they arrive
+ * @tparam Tracing - tracing policy called on accepts, receives, sends and callbacks; NoTracing compiles away,
+ *          UsdtTracing emits USDT probes
  */
-template <class CallbackImpl, class SocketImpl = sockets::SocketCore>
+template <class CallbackImpl, class SocketImpl = sockets::SocketCore, class Framing = RawFraming,
+          class Tracing = NoTracing>
 class TcpServer {
 public:
     /**
@@ -45,7 +62,8 @@ public:
      * @param options - optional socket options to specify SO_SNDBUF and SO_RCVBUF
      */
     explicit TcpServer(CallbackImpl &callback, SocketOpt *options = nullptr)
-        : m_serverAddress({}), m_clientAddress({}), m_fds({}), m_stop(false), m_callback(callback) {
+        : m_serverAddress({}), m_stop(false),
+          m_metrics(options == nullptr || options->m_latencyHistograms, metricShards(options)), m_callback(callback) {
         if (options != nullptr) {
             m_sockOptions = *options;
         }
@@ -92,34 +110,1377 @@ public:
             return ret;
         }
 
-        m_sockfd = m_socketCore.Socket(AF_INET, SOCK_STREAM, 0);
-        if (m_sockfd == INVALID_SOCKET) {  // socket failed
-            ret.m_success = false;
-#if defined(FMT_SUPPORT)
-            ret.m_msg = fmt::format("Error: Socket creation failed errno{}", errno);
-#else
-            std::array<char,MSG_SIZE> msg;
-            (void)snprintf(msg.data(),msg.size(),"Error: Socket creation failed: %d",errno);
-            ret.m_msg = msg.data();
-#endif
+        memset(&m_serverAddress, 0, sizeof(m_serverAddress));
+        m_serverAddress.sin_family = AF_INET;
+        inet_pton(AF_INET, m_sockOptions.m_listenAddr.c_str(),&m_serverAddress.sin_addr.s_addr);
+//        m_serverAddress.sin_addr.s_addr = htonl(INADDR_ANY);
+        m_serverAddress.sin_port = htons(port);
+
+        size_t numLoops = std::max<size_t>(1, m_sockOptions.m_serverThreads);
+        m_stop = false;
+        m_loops.clear();
+        if (m_sockOptions.m_callbackThreads > 0 && !m_callbackPool) {
+            m_callbackPool = std::make_shared<ThreadPool>(m_sockOptions.m_callbackThreads);
+        }
+        m_acceptLimit.reset(new TokenBucket(m_sockOptions.m_acceptRate, m_sockOptions.m_acceptBurst));
+        if (m_sockOptions.m_acceptMode == AcceptMode::Acceptor) {
+            // Worker loops only monitor clients; a dedicated acceptor loop owns the listening socket
+            for (size_t idx = 0; idx < numLoops; idx++) {
+                m_loops.emplace_back(new EventLoop(m_socketCore, m_sockOptions, idx));
+                ret = openEventLoop(*m_loops.back());
+                if (!ret.m_success) {
+                    closeLoops();
+                    return ret;
+                }
+            }
+            m_acceptLoop.reset(new EventLoop(m_socketCore, m_sockOptions, numLoops));
+            ret = createListener(*m_acceptLoop, false);
+            if (!ret.m_success) {
+                closeLoops();
+                return ret;
+            }
+            m_lastLoadSample = std::chrono::steady_clock::now();
+            m_connectionRate = 0.0;
+        } else {
+            // Each event loop owns a listening socket; with more than one loop the listeners share the
+            // port via SO_REUSEPORT and the kernel spreads incoming connections across them.
+            for (size_t idx = 0; idx < numLoops; idx++) {
+                m_loops.emplace_back(new EventLoop(m_socketCore, m_sockOptions, idx));
+                ret = createListener(*m_loops.back(), numLoops > 1);
+                if (!ret.m_success) {
+                    closeLoops();
+                    return ret;
+                }
+            }
+        }
+
+        if (m_sockOptions.m_bcastThreads > 1) {
+            // The thread calling sendBcast() handles one share of the clients itself
+            std::atomic_store(&m_bcastPool, std::make_shared<ThreadPool>(m_sockOptions.m_bcastThreads - 1));
+        }
+
+        for (auto &loop : m_loops) {
+            loop->m_thread = std::thread(&TcpServer::serverTask, this, std::ref(*loop));
+        }
+        if (m_acceptLoop) {
+            m_acceptLoop->m_thread = std::thread(&TcpServer::serverTask, this, std::ref(*m_acceptLoop));
+        }
+
+        return ret;
+    }
+
+    /**
+     * @brief Remove a TCP client connection
+     *
+     * @param handle - handle of the TCP client to be dropped
+     * @return true
+     * @return false
+     */
+    bool deleteClient(ClientHandle &handle) {
+        std::shared_ptr<Client> client = m_clients.remove(handle);
+        if (client) {
+            // Connections closed by the server itself were marked disconnected with the reason beforehand
+            (void)client->markDisconnected(Counter::DisconnectLocal);
+            // Remove from the event loop and close socket connection
+            client->m_loop->m_poller.remove(client->m_sockfd);
+            client->m_loop->m_connections--;
+            m_connectionCount--;
+            client->m_loop->m_timers.cancel(client->m_idleTimer.load());
+            closeClient(*client);
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Send a broadcast message to all connected TCP clients.  The message is copied once into a
+     *          SharedBuffer which is then shared by every client that can't send it immediately.
+     *
+     * @param msg - pointer to the message data
+     * @param size - length of the message data
+     * @return SocketRet - indication that the message was sent to all clients
+     */
+    SocketRet sendBcast(const char *msg, size_t size) {
+        return sendBcast(SharedBuffer::copyOf(msg, size));
+    }
+
+    /**
+     * @brief Send a broadcast message held in a SharedBuffer to all connected TCP clients without copying it
+     *
+     * @param buffer - the message data
+     * @return SocketRet - indication that the message was sent to all clients
+     */
+    SocketRet sendBcast(const SharedBuffer &buffer) {
+        return forEachClient([&buffer](Client &client) { return client.sendMsg(buffer); });
+    }
+
+    /**
+     * @brief Send a broadcast message made of several parts to all connected TCP clients.  Each client is sent
+     *          the parts with one sendmsg() call; a client which can't take the whole message queues a gathered
+     *          copy of the remainder.
+     *
+     * @param parts - the message parts
+     * @param count - number of parts, at most MAX_MSG_PARTS
+     * @return SocketRet - indication that the message was sent to all clients
+     */
+    SocketRet sendBcastv(const MsgPart *parts, size_t count) {
+        if (count == 0 || count > MAX_MSG_PARTS) {
+            return tooManyParts(count);
+        }
+        return forEachClient([parts, count](Client &client) { return client.sendMsgv(parts, count, false); });
+    }
+
+    /**
+     * @brief Send a message to a specific connected client
+     *
+     * @param client - handle of the TCP client
+     * @param msg - pointer to the message data
+     * @param size - length of the message data
+     * @return SocketRet - indication that the message was sent to the client
+     */
+    SocketRet sendClientMessage(ClientHandle &clientId, const char *msg, size_t size) {
+        SocketRet ret;
+        std::shared_ptr<Client> client = m_clients.find(clientId);
+        if (client) {
+            ret = client->sendMsg(msg, size);
             return ret;
         }
-        // set socket for reuse (otherwise might have to wait 4 minutes every time socket is closed)
-        int option = 1;
-        if (m_socketCore.SetSockOpt(m_sockfd, SOL_SOCKET, SO_REUSEADDR, &option, sizeof(option)) < 0) {
-            ret.m_success = false;
+        return clientNotFound(clientId);
+    }
+
+    /**
+     * @brief Send a message made of several parts (e.g. a header and a payload in separate buffers) to a specific
+     *          connected client.  The parts go out with one sendmsg() call, without being copied together first;
+     *          only a remainder the socket can't accept immediately is gathered into the send queue.
+     *
+     * @param client - handle of the TCP client
+     * @param parts - the message parts
+     * @param count - number of parts, at most MAX_MSG_PARTS
+     * @param more - more data follows shortly (MSG_MORE), so the kernel may hold back a partly filled segment
+     *          until the next send
+     * @return SocketRet - indication that the message was sent to the client
+     */
+    SocketRet sendClientMessagev(ClientHandle &clientId, const MsgPart *parts, size_t count, bool more = false) {
+        if (count == 0 || count > MAX_MSG_PARTS) {
+            return tooManyParts(count);
+        }
+        std::shared_ptr<Client> client = m_clients.find(clientId);
+        if (client) {
+            return client->sendMsgv(parts, count, more);
+        }
+        return clientNotFound(clientId);
+    }
+
+    /**
+     * @brief Send a message held in a SharedBuffer to a specific connected client without copying it
+     *
+     * @param client - handle of the TCP client
+     * @param buffer - the message data
+     * @return SocketRet - indication that the message was sent to the client
+     */
+    SocketRet sendClientMessage(ClientHandle &clientId, const SharedBuffer &buffer) {
+        std::shared_ptr<Client> client = m_clients.find(clientId);
+        if (client) {
+            return client->sendMsg(buffer);
+        }
+        return clientNotFound(clientId);
+    }
+
+    /**
+     * @brief Send a range of a file to a specific connected client.  The kernel sends it straight from the page
+     *          cache with sendfile(), as the client's socket accepts it, so the data never passes through user
+     *          space and the event loop isn't held up by a large file.
+     *
+     * @param client - handle of the TCP client
+     * @param fileFd - descriptor of the file, open for reading.  It's duplicated, so it may be closed on return.
+     * @param offset - file offset of the first byte to send
+     * @param size - number of bytes to send
+     * @return SocketRet - indication that the range was sent or queued to the client
+     */
+    SocketRet sendFile(ClientHandle &clientId, int fileFd, off_t offset, size_t size) {
+        std::shared_ptr<Client> client = m_clients.find(clientId);
+        if (client) {
+            return client->sendFile(fileFd, offset, size);
+        }
+        return clientNotFound(clientId);
+    }
+
+    /**
+     * @brief Register a region of memory from which messages are sent with zero-copy sends, when
+     *          SocketOpt::m_zeroCopySend is set.  The region is registered with each event loop's io_uring instance
+     *          by start(), so call this before start(); it must stay valid until finish().  A message sent from the
+     *          region must not be modified until onSendComplete() reports it.
+     *
+     * @param data - start of the region
+     * @param size - length of the region, at most 1GB
+     */
+    void registerSendRegion(const char *data, size_t size) {
+        m_sendRegions.push_back(SendRegion { data, size });
+    }
+
+    /**
+     * @brief Stop reading data from a client, e.g. while the application catches up.  Data the client sends
+     *          meanwhile is held in the kernel, whose TCP flow control then slows the client down.
+     *
+     * @param clientId - handle of the TCP client
+     * @return true - reading is paused
+     * @return false - clientId is invalid
+     */
+    bool pauseReceive(ClientHandle clientId) {
+        std::shared_ptr<Client> client = m_clients.find(clientId);
+        if (client) {
+            client->pauseRead(true);
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Resume reading data from a client paused by pauseReceive()
+     *
+     * @param clientId - handle of the TCP client
+     * @return true - reading is resumed
+     * @return false - clientId is invalid
+     */
+    bool resumeReceive(ClientHandle clientId) {
+        std::shared_ptr<Client> client = m_clients.find(clientId);
+        if (client) {
+            client->pauseRead(false);
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Shut down the TCP server
+     */
+    void finish() {
+        m_stop = true;
+        for (auto &loop : m_loops) {
+            loop->m_poller.wake();
+        }
+        if (m_acceptLoop) {
+            m_acceptLoop->m_poller.wake();
+        }
+        if (m_acceptLoop && m_acceptLoop->m_thread.joinable()) {
+            try {
+                m_acceptLoop->m_thread.join();
+            }
+            catch (...) {
+            }
+        }
+        for (auto &loop : m_loops) {
+            if (loop->m_thread.joinable()) {
+                try {
+                    loop->m_thread.join();
+                }
+                catch (...) {
+                }
+            }
+        }
+        // Close the connections handed to a worker which stopped before registering them
+        for (auto &loop : m_loops) {
+            for (const auto &pending : loop->m_handedOff) {
+                m_socketCore.Close(pending.m_fd);
+            }
+            loop->m_handedOff.clear();
+        }
+
+        // Run the callbacks already dispatched to the worker pool while the clients still exist.  A callback
+        // calling finish() leaves that to the destructor.
+        if (m_callbackPool && !m_callbackPool->inWorker()) {
+            m_callbackPool.reset();
+        }
+
+        // Close client sockets
+        m_clients.clear([this](std::shared_ptr<Client> &client) { closeClient(*client); });
+        m_connectionCount = 0;
+
+        closeLoops();
+        std::atomic_store(&m_bcastPool, std::shared_ptr<ThreadPool>());
+    }
+
+    /**
+     * @brief Get current info for a client
+     *
+     * @param clientId - handle to this client connection
+     * @param ipAddr - Client's IP address
+     * @param port - Client's port number
+     * @param connected - indicates client is connected
+     * @return true - clientId is valid and information was returned
+     * @return false - clientId is invalid
+     */
+    bool getClientInfo(ClientHandle clientId, std::string &ipAddr, uint16_t &port, bool &connected) {
+        std::shared_ptr<Client> client = m_clients.find(clientId);
+        if (client) {
+            ipAddr = client->m_ip;
+            port = client->m_port;
+            connected = client->m_isConnected;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Get the socket options in effect after start(), as read back from the listening socket.  Accepted
+     *          connections inherit these from the listener.  Options which can't be read back, such as the listen
+     *          backlog, report the requested value.
+     *
+     * @return SocketOpt - the effective socket options
+     */
+    SocketOpt getEffectiveOptions() const {
+        std::lock_guard<std::mutex> guard(m_effectiveMutex);
+        return m_effectiveOptions;
+    }
+
+    /**
+     * @brief Get the number of client connections handled by each event loop
+     *
+     * @return std::vector<size_t> - connection count for each event-loop thread
+     */
+    std::vector<size_t> getLoopConnectionCounts() const {
+        std::vector<size_t> counts;
+        for (const auto &loop : m_loops) {
+            counts.push_back(loop->m_connections.load());
+        }
+        return counts;
+    }
+
+    /**
+     * @brief Get the occupancy and hit/miss counters of the event loops' receive buffer pools, summed
+     *
+     * @return BufferPoolStats - receive buffer pool counters
+     */
+    BufferPoolStats getReceivePoolStats() const {
+        BufferPoolStats stats;
+        for (const auto &loop : m_loops) {
+            stats += loop->m_rxPool->stats();
+        }
+        if (m_acceptLoop) {
+            stats += m_acceptLoop->m_rxPool->stats();
+        }
+        return stats;
+    }
+
+    /**
+     * @brief Get the number of connections admitted and turned away by admission control since construction
+     *
+     * @return AdmissionStats - admission counters
+     */
+    AdmissionStats getAdmissionStats() const {
+        AdmissionStats stats;
+        stats.m_admitted = m_admitted.load();
+        stats.m_rejectedRate = m_rejectedRate.load();
+        stats.m_rejectedMax = m_rejectedMax.load();
+        stats.m_rejectedOverload = m_rejectedOverload.load();
+        return stats;
+    }
+
+    /**
+     * @brief Get the server's counters and latency histograms, totalled over all connections since construction.
+     *          Reading them doesn't stall the event loops.
+     *
+     * @return SocketMetrics - snapshot of the metrics
+     */
+    SocketMetrics getMetrics() const {
+        SocketMetrics metrics;
+        m_metrics.snapshot(metrics);
+        return metrics;
+    }
+
+    /**
+     * @brief Get the counters of one client connection.  Its histograms are left empty; latencies are only kept
+     *          in total.
+     *
+     * @param clientId - handle to this client connection
+     * @param metrics - receives the counters
+     * @return true - clientId is valid and the counters were returned
+     * @return false - clientId is invalid
+     */
+    bool getClientMetrics(ClientHandle clientId, SocketMetrics &metrics) const {
+        std::shared_ptr<Client> client = m_clients.find(clientId);
+        if (!client) {
+            return false;
+        }
+        metrics = SocketMetrics();
+        client->m_metrics.snapshot(metrics);
+        return true;
+    }
+
+    /**
+     * @brief Schedule a callback on the first event loop's timing wheel.  It runs on the event loop thread, or on
+     *          the worker pool when SocketOpt::m_callbackThreads > 0.  Only valid while the server is running.
+     *
+     * @param delay - time until the callback runs, rounded up to whole SocketOpt::m_timerTickMs ticks
+     * @param callback - the callback
+     * @param interval - period at which the callback repeats, 0 to run it once
+     * @return TimerId - identifies the timer for cancelTimer(), INVALID_TIMER if the server isn't running
+     */
+    TimerId scheduleTimer(std::chrono::milliseconds delay, std::function<void()> callback,
+                          std::chrono::milliseconds interval = std::chrono::milliseconds(0)) {
+        if (m_loops.empty()) {
+            return INVALID_TIMER;
+        }
+        EventLoop &loop = *m_loops.front();
+        TimerId timerId = loop.m_timers.schedule(delay, [this, callback = std::move(callback)]() {
+            if (m_callbackPool) {
+                m_callbackPool->post(callback);
+            } else {
+                callback();
+            }
+        }, interval);
+        // An idle loop waits without a timeout until it has timers
+        loop.m_poller.wake();
+        return timerId;
+    }
+
+    /**
+     * @brief Schedule a callback about a client, e.g. a request deadline or a keepalive, on the timing wheel of
+     *          the client's event loop.  It runs in order with the client's other callbacks.  Once the client has
+     *          disconnected the timer no longer runs, and a periodic timer cancels itself.
+     *
+     * @param client - handle of the TCP client
+     * @param delay - time until the callback runs, rounded up to whole SocketOpt::m_timerTickMs ticks
+     * @param callback - the callback
+     * @param interval - period at which the callback repeats, 0 to run it once
+     * @return TimerId - identifies the timer for cancelTimer(), INVALID_TIMER if the client isn't connected
+     */
+    TimerId scheduleTimer(const ClientHandle &client, std::chrono::milliseconds delay, std::function<void()> callback,
+                          std::chrono::milliseconds interval = std::chrono::milliseconds(0)) {
+        std::shared_ptr<Client> target = m_clients.find(client);
+        if (!target) {
+            return INVALID_TIMER;
+        }
+        TimerWheel &timers = target->m_loop->m_timers;
+        auto self = std::make_shared<std::atomic<TimerId>>(INVALID_TIMER);
+        TimerId timerId = timers.schedule(delay, [this, &timers, self, handle = client, callback = std::move(callback)]() {
+            std::shared_ptr<Client> owner = m_clients.find(handle);
+            if (owner) {
+                dispatch(*owner, callback);
+            } else {
+                timers.cancel(self->load());
+            }
+        }, interval);
+        self->store(timerId);
+        target->m_loop->m_poller.wake();
+        return timerId;
+    }
+
+    /**
+     * @brief Cancel a timer scheduled with scheduleTimer().  A callback already running or dispatched to the
+     *          worker pool isn't affected.
+     *
+     * @param timerId - the timer
+     * @return true - the timer was cancelled
+     * @return false - the timer had already run or been cancelled
+     */
+    bool cancelTimer(TimerId timerId) {
+        size_t idx = TimerWheel::tagOf(timerId);
+        return (idx < m_loops.size()) && m_loops[idx]->m_timers.cancel(timerId);
+    }
+
+    /**
+     * @brief Run a task on the first event loop thread, e.g. to serialize work with the loop's timers.  Only valid
+     *          while the server is running; tasks still queued when it stops are dropped.
+     *
+     * @param task - the task
+     * @return true - the task was queued
+     * @return false - the server isn't running
+     */
+    bool post(std::function<void()> task) {
+        if (m_loops.empty()) {
+            return false;
+        }
+        m_loops.front()->m_poller.post(std::move(task));
+        return true;
+    }
+
+    /**
+     * @brief Run a task on the event loop thread monitoring a client, where it doesn't race with the loop's
+     *          receives, flushes and timers for that connection
+     *
+     * @param client - handle of the TCP client
+     * @param task - the task
+     * @return true - the task was queued
+     * @return false - the client isn't connected
+     */
+    bool post(const ClientHandle &client, std::function<void()> task) {
+        std::shared_ptr<Client> target = m_clients.find(client);
+        if (!target) {
+            return false;
+        }
+        target->m_loop->m_poller.post(std::move(task));
+        return true;
+    }
+
+private:
+    struct EventLoop;
+
+    /**
+     * @brief Build the result for a client which isn't connected
+     *
+     * @param clientId - handle of the TCP client
+     * @return SocketRet - the failure
+     */
+    SocketRet clientNotFound(const ClientHandle &clientId) {
+        SocketRet ret;
 #if defined(FMT_SUPPORT)
-            ret.m_msg = fmt::format("Error: SetSockOpt(SO_REUSEADDR) failed: errno {}", errno);
+        ret.m_msg = fmt::format("Error: Client {} not found", clientId);
+#else
+        std::array<char,MSG_SIZE> errMsg;
+        (void)snprintf(errMsg.data(),errMsg.size(),"Error: Client %lld not found",static_cast<long long>(clientId));
+        ret.m_msg = errMsg.data();
+#endif
+        ret.m_success = false;
+        return ret;
+    }
+
+    /**
+     * @brief Send to every connected client, splitting large broadcasts across the broadcast thread pool
+     *
+     * @param send - sends to one client, returning the result
+     * @return SocketRet - the first failure, or success
+     */
+    template <class Send>
+    SocketRet forEachClient(const Send &send) {
+        std::vector<std::shared_ptr<Client>> clients;
+
+        m_clients.snapshot(clients);
+
+        SocketRet ret;
+        ret.m_success = true;
+        std::mutex retMutex;
+        auto sendRange = [&](size_t begin, size_t end) {
+            for (size_t idx = begin; idx < end; idx++) {
+                auto clientRet = send(*clients[idx]);
+                if (!clientRet.m_success) {
+                    std::lock_guard<std::mutex> guard(retMutex);
+                    if (ret.m_success) {
+                        ret = clientRet;
+                    }
+                }
+            }
+        };
+        std::shared_ptr<ThreadPool> pool = std::atomic_load(&m_bcastPool);
+        if (pool && clients.size() >= m_sockOptions.m_bcastParallelMin) {
+            pool->parallelFor(clients.size(), sendRange);
+        } else {
+            sendRange(0, clients.size());
+        }
+        return ret;
+    }
+
+    /**
+     * @brief Build the result for a scatter-gather message with an unsupported number of parts
+     *
+     * @param count - number of parts
+     */
+    static SocketRet tooManyParts(size_t count) {
+        SocketRet ret;
+#if defined(FMT_SUPPORT)
+        ret.m_msg = fmt::format("Error: {} message parts, expected 1 to {}", count, MAX_MSG_PARTS);
+#else
+        std::array<char,MSG_SIZE> msg;
+        (void)snprintf(msg.data(),msg.size(),"Error: %zu message parts, expected 1 to %zu",count,MAX_MSG_PARTS);
+        ret.m_msg = msg.data();
+#endif
+        ret.m_success = false;
+        return ret;
+    }
+
+    /**
+     * @brief Number of per-thread blocks to keep metrics in: one per event loop, worker and broadcast thread,
+     *          plus the acceptor and an application thread
+     *
+     * @param options - socket options, or nullptr for the defaults
+     */
+    static size_t metricShards(const SocketOpt *options) {
+        SocketOpt defaults;
+        const SocketOpt &opts = (options != nullptr) ? *options : defaults;
+        return std::max(METRIC_SHARDS, std::max<size_t>(1, opts.m_serverThreads) + opts.m_callbackThreads +
+                                           opts.m_bcastThreads + 2);
+    }
+
+    /**
+     * @brief Client represents a connection to a TCP client
+     */
+    struct Client {
+        /**
+         * @brief The server owning this connection
+         */
+        TcpServer *m_server;
+
+        SocketImpl *m_socketCore;
+
+        /**
+         * @brief The event loop monitoring this connection
+         */
+        EventLoop *m_loop = nullptr;
+
+        /**
+         * @brief Handle identifying this connection
+         */
+        ClientHandle m_handle;
+
+        /**
+         * @brief The TCP client's IP address
+         */
+        std::string m_ip;
+
+        /**
+         * @brief The socket file descriptor for the TCP client connection
+         */
+        SOCKET m_sockfd = INVALID_SOCKET;
+
+        /**
+         * @brief The peer's port
+         */
+        uint16_t m_port = 0;
+
+        /**
+         * @brief Indicator whether TCP client is connected
+         */
+        std::atomic_bool m_isConnected { false };
+
+        /**
+         * @brief Mutex serializing senders and the event loop's flush of m_sendQueue
+         */
+        std::mutex m_sendMutex;
+
+        /**
+         * @brief Outbound data the kernel couldn't accept yet
+         */
+        SendQueue m_sendQueue;
+
+        /**
+         * @brief Outbound watermarks and read pausing, protected by m_sendMutex
+         */
+        FlowControl m_flow;
+
+        /**
+         * @brief Received bytes waiting on m_strand for the callback workers
+         */
+        InboundBacklog m_inbound;
+
+        /**
+         * @brief Reassembles received messages; only used by the event loop
+         */
+        Framer<Framing> m_framer;
+
+        /**
+         * @brief Large messages may be sent without copying, by io_uring or with MSG_ZEROCOPY
+         */
+        bool m_zeroCopy = false;
+
+        /**
+         * @brief Zero-copy sends use MSG_ZEROCOPY, whose release notifications arrive on the socket error queue
+         */
+        bool m_msgZeroCopy = false;
+
+        /**
+         * @brief Runs this connection's callbacks in order on the worker pool, when SocketOpt::m_callbackThreads > 0
+         */
+        std::shared_ptr<Strand> m_strand;
+
+        /**
+         * @brief Timing wheel tick of the last receive, when SocketOpt::m_idleTimeoutMs > 0
+         */
+        std::atomic<uint64_t> m_lastReceive { 0 };
+
+        /**
+         * @brief Timer closing the connection once it has been idle for SocketOpt::m_idleTimeoutMs
+         */
+        std::atomic<TimerId> m_idleTimer { INVALID_TIMER };
+
+        /**
+         * @brief This connection's counters, also added to the server's.  Counted through const references too.
+         */
+        mutable ConnectionMetrics m_metrics;
+
+        /**
+         * @brief Construct a new Client object
+         *
+         * @param server - the server owning the connection
+         * @param loop - event loop monitoring the connection
+         * @param handle - handle identifying the connection
+         * @param ipAddr - client's IP address
+         * @param clientFd - file descriptor for the client connection
+         * @param port - client's port number
+         */
+        Client(TcpServer *server, EventLoop *loop, ClientHandle handle, const char *ipAddr, SOCKET clientFd, uint16_t port)
+            : m_server(server), m_socketCore(&server->m_socketCore), m_loop(loop), m_handle(handle), m_ip(ipAddr),
+              m_sockfd(clientFd), m_port(port), m_isConnected(true), m_flow(server->m_sockOptions),
+              m_inbound(server->m_sockOptions), m_framer(server->m_sockOptions.m_maxMessageSize), m_metrics(&server->m_metrics) {
+            const SocketOpt &options = server->m_sockOptions;
+            m_sendQueue.setMetrics(&m_metrics);
+            m_msgZeroCopy = enableMsgZeroCopy(*m_socketCore, clientFd, options);
+            if (m_msgZeroCopy) {
+                m_sendQueue.useMsgZeroCopy();
+            }
+            m_zeroCopy = options.m_zeroCopySend && (options.m_eventBackend == EventBackend::IoUring || m_msgZeroCopy);
+            if (server->m_callbackPool) {
+                m_strand = std::make_shared<Strand>(*server->m_callbackPool);
+            }
+        }
+
+        /**
+         * @brief Mark the connection as no longer connected, counting why if it was
+         *
+         * @param reason - the Counter of the disconnect reason
+         * @return true - the connection was connected until now
+         */
+        bool markDisconnected(Counter reason) {
+            if (!m_isConnected.exchange(false)) {
+                return false;
+            }
+            m_metrics.add(reason);
+            return true;
+        }
+
+        /**
+         * @brief Send a message to this TCP client.  Whatever the kernel can't accept immediately is queued
+         *          and sent by the event loop once the socket becomes writable, so the caller never blocks.
+         *
+         * @param msg - pointer to the message data
+         * @param size - length of the message data
+         * @return SocketRet - indication of whether the message was sent or queued successfully
+         */
+        SocketRet sendMsg(const char *msg, size_t size) {
+            MsgPart part { msg, size };
+            return sendData(&part, 1, nullptr, 0);
+        }
+
+        /**
+         * @brief Send a message held in a SharedBuffer to this TCP client.  If it can't be sent immediately
+         *          the buffer handle is queued, not the data.
+         *
+         * @param buffer - the message data
+         * @return SocketRet - indication of whether the message was sent or queued successfully
+         */
+        SocketRet sendMsg(const SharedBuffer &buffer) {
+            MsgPart part { buffer.data(), buffer.size() };
+            return sendData(&part, 1, &buffer, 0);
+        }
+
+        /**
+         * @brief Send a scatter-gather message to this TCP client with one system call
+         *
+         * @param parts - the message parts
+         * @param count - number of parts
+         * @param more - more data follows shortly, so the kernel may hold back a partly filled segment
+         * @return SocketRet - indication of whether the message was sent or queued successfully
+         */
+        SocketRet sendMsgv(const MsgPart *parts, size_t count, bool more) {
+            return sendData(parts, count, nullptr, more ? MORE_FLAGS : 0);
+        }
+
+        /**
+         * @brief Send message data, queuing whatever the kernel doesn't accept
+         *
+         * @param parts - the message parts
+         * @param count - number of parts
+         * @param owner - buffer holding a single-part message to queue by reference, or nullptr to queue a copy
+         * @param flags - send flags in addition to SEND_FLAGS
+         * @return SocketRet - indication of whether the message was sent or queued successfully
+         */
+        SocketRet sendData(const MsgPart *parts, size_t count, const SharedBuffer *owner, int flags) {
+            SocketRet ret;
+            size_t backPressure = 0;
+            std::vector<SharedBuffer> completed;
+            const char *msg = parts[0].m_data;
+            size_t size = partsSize(parts, count);
+            bool zeroCopy = m_zeroCopy && count == 1 &&
+                zeroCopyEligible(m_server->m_sockOptions, m_server->m_sendRegions, msg, size, owner != nullptr);
+            {
+                std::lock_guard<std::mutex> guard(m_sendMutex);
+                if (m_sockfd != INVALID_SOCKET) {
+                    if (!m_flow.admit(m_sendQueue.size(), size)) {
+                        ret.m_success = false;
+                        ret.m_msg = "Error: send queue full";
+                        return ret;
+                    }
+                    size_t numBytesSent = 0;
+                    // Queued data must go out first to preserve message order
+                    if (m_sendQueue.empty() && !zeroCopy) {
+                        auto start = m_sendQueue.sendStart();
+                        ssize_t sent = (count == 1)
+                            ? m_socketCore->Send(m_sockfd, reinterpret_cast<const void *>(msg), size, SEND_FLAGS | flags)
+                            : sendParts(*m_socketCore, m_sockfd, parts, count, SEND_FLAGS | flags);
+                        m_sendQueue.directSent(sent, size, start);
+                        Tracing::trace(TraceEvent::Send, m_sockfd, sent);
+                        if (sent < 0 && !wouldBlock(errno)) {  // send failed
+                            ret.m_success = false;
+#if defined(FMT_SUPPORT)
+                            ret.m_msg = fmt::format("Error: send() failed errno {}", errno);
+#else
+                            std::array<char,MSG_SIZE> msg;
+                            (void)snprintf(msg.data(),msg.size(),"Error: send() failed: %d",errno);
+                            ret.m_msg = msg.data();
+#endif
+                            return ret;
+                        }
+                        numBytesSent = (sent < 0) ? 0 : static_cast<size_t>(sent);
+                        m_loop->m_bytes.fetch_add(numBytesSent, std::memory_order_relaxed);
+                    }
+                    if (numBytesSent < size) {
+                        // Kernel send buffer is full, or the message is sent without copying, so the event loop
+                        // sends the rest
+                        bool wasPending = m_sendQueue.writePending();
+                        bool wasEmpty = m_sendQueue.empty();
+                        if (owner != nullptr) {
+                            m_sendQueue.append(*owner, numBytesSent, zeroCopy);
+                        } else if (zeroCopy) {
+                            m_sendQueue.append(SharedBuffer::reference(msg, size), 0, true);
+                        } else {
+                            m_sendQueue.append(parts, count, numBytesSent);
+                        }
+                        if (zeroCopy && wasEmpty) {
+                            ssize_t sent = sendQueued();
+                            if (sent < 0) {
+                                m_sendQueue.clear();
+                                ret.m_success = false;
+#if defined(FMT_SUPPORT)
+                                ret.m_msg = fmt::format("Error: send() failed errno {}", errno);
+#else
+                                std::array<char,MSG_SIZE> msg;
+                                (void)snprintf(msg.data(),msg.size(),"Error: send() failed: %d",errno);
+                                ret.m_msg = msg.data();
+#endif
+                                return ret;
+                            }
+                            m_loop->m_bytes.fetch_add(static_cast<uint64_t>(sent), std::memory_order_relaxed);
+                            m_sendQueue.takeCompleted(completed);
+                        }
+                        bool pressured = m_flow.queued(m_sendQueue.size());
+                        if (m_sendQueue.writePending() != wasPending || pressured) {
+                            m_loop->m_poller.modify(m_sockfd, m_flow.interest(m_sendQueue.writePending()));
+                        }
+                        backPressure = pressured ? m_sendQueue.size() : 0;
+                    }
+                    m_metrics.add(Counter::MessagesOut);
+                }
+            }
+            if (backPressure != 0) {
+                // Outside m_sendMutex so the callback may send or pause
+                notifyBackPressure(m_server->m_callback, 0, m_handle, backPressure);
+            }
+            reportSent(completed, false);
+            ret.m_success = true;
+            return ret;
+        }
+
+        /**
+         * @brief Send a range of a file to this TCP client, queuing whatever the socket doesn't accept
+         *
+         * @param fileFd - descriptor of the file, open for reading
+         * @param offset - file offset of the first byte to send
+         * @param size - number of bytes to send
+         * @return SocketRet - indication of whether the range was sent or queued successfully
+         */
+        SocketRet sendFile(int fileFd, off_t offset, size_t size) {
+            SocketRet ret;
+            std::lock_guard<std::mutex> guard(m_sendMutex);
+            if (m_sockfd != INVALID_SOCKET) {
+                bool wasPending = m_sendQueue.writePending();
+                bool wasEmpty = m_sendQueue.empty();
+                if (!m_sendQueue.appendFile(fileFd, offset, size)) {
+                    ret.m_success = false;
+#if defined(FMT_SUPPORT)
+                    ret.m_msg = fmt::format("Error: dup() failed errno {}", errno);
+#else
+                    std::array<char,MSG_SIZE> msg;
+                    (void)snprintf(msg.data(),msg.size(),"Error: dup() failed: %d",errno);
+                    ret.m_msg = msg.data();
+#endif
+                    return ret;
+                }
+                if (wasEmpty) {
+                    // Queued data must go out first to preserve message order
+                    ssize_t sent = sendQueued();
+                    if (sent < 0) {
+                        m_sendQueue.clear();
+                        ret.m_success = false;
+#if defined(FMT_SUPPORT)
+                        ret.m_msg = fmt::format("Error: sendfile() failed errno {}", errno);
+#else
+                        std::array<char,MSG_SIZE> msg;
+                        (void)snprintf(msg.data(),msg.size(),"Error: sendfile() failed: %d",errno);
+                        ret.m_msg = msg.data();
+#endif
+                        return ret;
+                    }
+                    m_loop->m_bytes.fetch_add(static_cast<uint64_t>(sent), std::memory_order_relaxed);
+                }
+                if (m_sendQueue.writePending() != wasPending) {
+                    m_loop->m_poller.modify(m_sockfd, m_flow.interest(m_sendQueue.writePending()));
+                }
+                m_metrics.add(Counter::MessagesOut);
+            }
+            ret.m_success = true;
+            return ret;
+        }
+
+        /**
+         * @brief Send queued data now that the socket is writable.  Called by the event loop.
+         */
+        void flush() {
+            bool writable = false;
+            std::vector<SharedBuffer> completed;
+            {
+                std::lock_guard<std::mutex> guard(m_sendMutex);
+                if (m_sockfd == INVALID_SOCKET) {
+                    return;
+                }
+                writable = flushQueue();
+                m_sendQueue.takeCompleted(completed);
+            }
+            reportSent(completed, writable);
+        }
+
+        /**
+         * @brief Handle the result of a zero-copy send, and start sending the next message.  Called by the event
+         *          loop.
+         *
+         * @param result - number of bytes sent, or a negative errno value
+         */
+        void zeroCopySent(int result) {
+            bool writable = false;
+            std::vector<SharedBuffer> completed;
+            {
+                std::lock_guard<std::mutex> guard(m_sendMutex);
+                if (m_sockfd == INVALID_SOCKET) {
+                    return;
+                }
+                size_t sent = m_sendQueue.zeroCopySent(result);
+                Tracing::trace(TraceEvent::Send, m_sockfd, result);
+                m_loop->m_bytes.fetch_add(static_cast<uint64_t>(sent), std::memory_order_relaxed);
+                if (result < 0 && result != -EOPNOTSUPP) {
+                    // Connection failed; the receive path reports the disconnect
+                    m_sendQueue.clear();
+                    (void)markDisconnected(Counter::DisconnectError);
+                    m_loop->m_poller.modify(m_sockfd, m_flow.interest(false));
+                } else {
+                    writable = flushQueue();
+                }
+                m_sendQueue.takeCompleted(completed);
+            }
+            reportSent(completed, writable);
+        }
+
+        /**
+         * @brief Handle the kernel's release of the data of a zero-copy send.  Called by the event loop.
+         *
+         * @param seq - sequence number of the send
+         */
+        void zeroCopyReleased(int seq) {
+            bool writable = false;
+            std::vector<SharedBuffer> completed;
+            {
+                std::lock_guard<std::mutex> guard(m_sendMutex);
+                if (m_sockfd == INVALID_SOCKET) {
+                    return;
+                }
+                if (m_sendQueue.zeroCopyReleased(static_cast<uint32_t>(seq))) {
+                    // The next send was waiting for the kernel to release earlier ones
+                    writable = flushQueue();
+                }
+                m_sendQueue.takeCompleted(completed);
+            }
+            reportSent(completed, writable);
+        }
+
+        /**
+         * @brief Read the release notifications of MSG_ZEROCOPY sends and report completed messages.  Called by
+         *          the event loop.
+         *
+         * @return true - notifications were read
+         */
+        bool readNotifications() {
+            bool notified = false;
+            std::vector<SharedBuffer> completed;
+            {
+                std::lock_guard<std::mutex> guard(m_sendMutex);
+                if (m_sockfd == INVALID_SOCKET || !m_sendQueue.zeroCopyHeld()) {
+                    return false;
+                }
+                notified = m_sendQueue.readNotifications(*m_socketCore, m_sockfd);
+                m_sendQueue.takeCompleted(completed);
+            }
+            reportSent(completed, false);
+            return notified;
+        }
+
+        /**
+         * @brief Send as much queued data as the socket accepts.  Caller holds m_sendMutex.
+         *
+         * @return ssize_t - number of bytes sent, or -1 if the socket failed (errno is set)
+         */
+        ssize_t sendQueued() {
+            ssize_t sent = m_sendQueue.flush(*m_socketCore, m_sockfd, m_loop->m_poller);
+            Tracing::trace(TraceEvent::Send, m_sockfd, sent);
+            return sent;
+        }
+
+        /**
+         * @brief Send queued data and update the monitored events.  Caller holds m_sendMutex.
+         *
+         * @return true - the queue has drained to the low watermark after back-pressure
+         */
+        bool flushQueue() {
+            ssize_t sent = sendQueued();
+            if (sent < 0) {
+                // Connection failed; the receive path reports the disconnect
+                m_sendQueue.clear();
+                (void)markDisconnected(Counter::DisconnectError);
+            } else {
+                m_loop->m_bytes.fetch_add(static_cast<uint64_t>(sent), std::memory_order_relaxed);
+            }
+            bool writable = m_flow.drained(m_sendQueue.size()) && sent >= 0;
+            if (!m_sendQueue.writePending() || writable) {
+                m_loop->m_poller.modify(m_sockfd, m_flow.interest(m_sendQueue.writePending()));
+            }
+            return writable;
+        }
+
+        /**
+         * @brief Report completed zero-copy messages and the release of back-pressure.  Called without
+         *          m_sendMutex so the callbacks may send.
+         *
+         * @param completed - zero-copy messages whose data may be reused
+         * @param writable - the queue drained to the low watermark
+         */
+        void reportSent(const std::vector<SharedBuffer> &completed, bool writable) {
+            for (const auto &buffer : completed) {
+                notifySendComplete(m_server->m_callback, 0, m_handle, buffer.data(), buffer.size());
+            }
+            if (writable) {
+                notifyWritable(m_server->m_callback, 0, m_handle);
+            }
+        }
+
+        /**
+         * @brief Stop or resume monitoring the connection for received data
+         *
+         * @param paused - true to stop reading
+         */
+        void pauseRead(bool paused) {
+            std::lock_guard<std::mutex> guard(m_sendMutex);
+            m_flow.pauseRead(paused);
+            if (m_sockfd != INVALID_SOCKET) {
+                m_loop->m_poller.modify(m_sockfd, m_flow.interest(m_sendQueue.writePending()));
+            }
+        }
+
+        /**
+         * @brief Stop reading while the callback workers are behind, or resume once they have caught up.  Called
+         *          when InboundBacklog::queued() or InboundBacklog::consumed() asks for it.
+         *
+         * @param paused - true to stop reading
+         */
+        void pauseInbound(bool paused) {
+            std::lock_guard<std::mutex> guard(m_sendMutex);
+            if (!(paused ? m_inbound.pause() : m_inbound.resume())) {
+                return;
+            }
+            m_flow.pauseInbound(paused);
+            if (m_sockfd != INVALID_SOCKET) {
+                m_loop->m_poller.modify(m_sockfd, m_flow.interest(m_sendQueue.writePending()));
+            }
+        }
+    };
+
+    /**
+     * @brief A connection accepted by the acceptor for a worker event loop
+     */
+    struct Handoff {
+        SOCKET m_fd;
+        struct sockaddr_in m_address;
+    };
+
+    /**
+     * @brief EventLoop is one server thread with its own listening socket and its share of the clients
+     */
+    struct EventLoop {
+        /**
+         * @brief Construct a new EventLoop object
+         *
+         * @param socketImpl - interface for socket calls
+         * @param options - socket options sizing the receive buffer pool and timing wheel
+         * @param index - position of the loop, tagging the ids of its timers
+         */
+        EventLoop(SocketImpl &socketImpl, const SocketOpt &options, size_t index)
+            : m_poller(socketImpl), m_rxPool(std::make_shared<BufferPool>(options.m_rxSlabSize,
+                                                                          options.m_rxSlabCount, options.m_rxHugePages)),
+              m_timers(std::chrono::milliseconds(options.m_timerTickMs), options.m_timerSlots,
+                       static_cast<uint16_t>(index)) {
+        }
+
+        /**
+         * @brief The socket file descriptor used for accepting connections
+         */
+        SOCKET m_listenFd = INVALID_SOCKET;
+
+        /**
+         * @brief Monitors the accept socket and this loop's client connections
+         */
+        EventPoller<SocketImpl> m_poller;
+
+        /**
+         * @brief Receive buffers of this loop's connections
+         */
+        std::shared_ptr<BufferPool> m_rxPool;
+
+        /**
+         * @brief Timers run by this loop, e.g. its connections' idle timeouts
+         */
+        TimerWheel m_timers;
+
+        /**
+         * @brief Time this loop takes per pass, when SocketOpt::m_maxLoopLagMs > 0
+         */
+        LoopLag m_lag;
+
+        /**
+         * @brief Thread running this event loop
+         */
+        std::thread m_thread;
+
+        /**
+         * @brief Number of client connections monitored by this loop
+         */
+        std::atomic<size_t> m_connections { 0 };
+
+        /**
+         * @brief Bytes sent and received on this loop's connections
+         */
+        std::atomic<uint64_t> m_bytes { 0 };
+
+        /**
+         * @brief Value of m_bytes when the byte rate was last sampled by the acceptor
+         */
+        uint64_t m_lastBytes = 0;
+
+        /**
+         * @brief Smoothed byte rate (bytes/sec) sampled by the acceptor
+         */
+        double m_byteRate = 0.0;
+
+        /**
+         * @brief Connections handed to this loop by the acceptor since the byte rates were last sampled
+         */
+        std::atomic<size_t> m_handoffs { 0 };
+
+        /**
+         * @brief Mutex protecting m_handedOff
+         */
+        std::mutex m_handoffMutex;
+
+        /**
+         * @brief Connections admitted by the acceptor and waiting for this loop to start monitoring them
+         */
+        std::vector<Handoff> m_handedOff;
+    };
+
+    /**
+     * @brief Close a client's connection.  Senders still holding a reference to the client (e.g. a broadcast
+     *          in progress) see the invalidated descriptor, not a recycled one.
+     *
+     * @param client - client already removed from m_clients
+     */
+    void closeClient(Client &client) {
+        std::lock_guard<std::mutex> sendGuard(client.m_sendMutex);
+        m_socketCore.Close(client.m_sockfd);
+        client.m_sockfd = INVALID_SOCKET;
+        client.m_sendQueue.clear();
+    }
+
+    /**
+     * @brief Run a callback on the client's strand when callbacks are dispatched to the worker pool, otherwise
+     *          on the calling event loop thread
+     *
+     * @param client - the TCP client the callback is about
+     * @param task - the callback invocation
+     */
+    template <class Task>
+    void dispatch(const Client &client, Task &&task) {
+        if (client.m_strand) {
+            client.m_strand->post(
+                [this, handle = client.m_handle, task = std::forward<Task>(task)]() { runCallback(handle, 0, task); });
+        } else {
+            runCallback(client.m_handle, 0, task);
+        }
+    }
+
+    /**
+     * @brief Run a callback, timing and tracing it
+     *
+     * @param handle - the TCP client the callback is about
+     * @param size - length of the message passed to the callback, or 0
+     * @param task - the callback invocation
+     */
+    template <class Task>
+    void runCallback(ClientHandle handle, size_t size, const Task &task) {
+        auto fd = static_cast<SOCKET>(handle & 0xffffffff);
+        Tracing::trace(TraceEvent::CallbackBegin, fd, static_cast<int64_t>(size));
+        m_metrics.timeCallback(task);
+        Tracing::trace(TraceEvent::CallbackEnd, fd, static_cast<int64_t>(size));
+    }
+
+    /**
+     * @brief Publish data received from a TCP client
+     *
+     * @param client - the TCP client which sent the data
+     * @param msg - pointer to the message data
+     * @param msgSize - length of the message data
+     * @param chain - receive buffers holding the data, or nullptr if they aren't the loop's own
+     */
+    void publishClientMsg(const std::shared_ptr<Client> &client, const char *msg, size_t msgSize,
+                          const ReceiveChain *chain) {
+        auto share = [chain](const char *data, size_t size) {
+            return (chain != nullptr) ? chain->share(data, size) : SharedBuffer::copyOf(data, size);
+        };
+        client->m_metrics.add(Counter::MessagesIn);
+        if (!client->m_strand) {
+            runCallback(client->m_handle, msgSize,
+                        [&]() { deliverClientReceived(m_callback, 0, client->m_handle, msg, msgSize, share); });
+            return;
+        }
+        // Counted before posting so the worker can't consume it first
+        bool pause = client->m_inbound.queued(msgSize);
+        // The receive buffer is reused once this returns, so the worker gets a counted reference to it
+        client->m_strand->post([this, client, buffer = share(msg, msgSize)]() {
+            runCallback(client->m_handle, buffer.size(), [&]() {
+                deliverClientReceived(m_callback, 0, client->m_handle, buffer.data(), buffer.size(),
+                                      [&buffer](const char *, size_t) { return buffer; });
+            });
+            if (client->m_inbound.consumed(buffer.size())) {
+                client->pauseInbound(false);
+            }
+        });
+        if (pause) {
+            client->pauseInbound(true);
+        }
+    }
+
+    /**
+     * @brief Publish notification that a TCP client has disconnected
+     *
+     * @param client - the TCP client which has disconnected
+     */
+    void publishDisconnected(const Client &client) {
+        SocketRet ret;
+#if defined(FMT_SUPPORT)
+        ret.m_msg = fmt::format("Client {} disconnected", client.m_handle);
+#else
+        std::array<char,MSG_SIZE> msg;
+        (void)snprintf(msg.data(),msg.size(),"Client %lld disconnected",static_cast<long long>(client.m_handle));
+        ret.m_msg = msg.data();
+#endif
+        dispatch(client, [this, handle = client.m_handle, ret]() { m_callback.onClientDisconnect(handle, ret); });
+    }
+
+    /**
+     * @brief Publish notification that a TCP client was disconnected for violating the message framing
+     *
+     * @param client - the TCP client which has been disconnected
+     */
+    void publishFramingError(const Client &client) {
+        SocketRet ret;
+#if defined(FMT_SUPPORT)
+        ret.m_msg = fmt::format("Error: Client {} framing error", client.m_handle);
+#else
+        std::array<char,MSG_SIZE> msg;
+        (void)snprintf(msg.data(),msg.size(),"Error: Client %lld framing error",static_cast<long long>(client.m_handle));
+        ret.m_msg = msg.data();
+#endif
+        dispatch(client, [this, handle = client.m_handle, ret]() { m_callback.onClientDisconnect(handle, ret); });
+    }
+
+    /**
+     * @brief Publish notification that a TCP client was disconnected for being idle too long
+     *
+     * @param client - the TCP client which has been disconnected
+     */
+    void publishIdleTimeout(const Client &client) {
+        SocketRet ret;
+#if defined(FMT_SUPPORT)
+        ret.m_msg = fmt::format("Client {} idle timeout", client.m_handle);
+#else
+        std::array<char,MSG_SIZE> msg;
+        (void)snprintf(msg.data(),msg.size(),"Client %lld idle timeout",static_cast<long long>(client.m_handle));
+        ret.m_msg = msg.data();
+#endif
+        dispatch(client, [this, handle = client.m_handle, ret]() { m_callback.onClientDisconnect(handle, ret); });
+    }
+
+    /**
+     * @brief Publish notification of a new TCP client connection
+     *
+     * @param client - the new TCP client
+     */
+    void publishClientConnect(const Client &client) {
+        dispatch(client, [this, handle = client.m_handle]() { m_callback.onClientConnect(handle); });
+    }
+
+    /**
+     * @brief Create the listening socket for an event loop and register it with the loop's poller
+     *
+     * @param loop - event loop which will own the listening socket
+     * @param reusePort - share the port with other event loops via SO_REUSEPORT
+     * @return SocketRet - indication of whether the listening socket was set up successfully
+     */
+    SocketRet createListener(EventLoop &loop, bool reusePort) {
+        SocketRet ret;
+
+        loop.m_listenFd = m_socketCore.Socket(AF_INET, SOCK_STREAM, 0);
+        if (loop.m_listenFd == INVALID_SOCKET) {  // socket failed
+            ret.m_success = false;
+#if defined(FMT_SUPPORT)
+            ret.m_msg = fmt::format("Error: Socket creation failed errno{}", errno);
+#else
+            std::array<char,MSG_SIZE> msg;
+            (void)snprintf(msg.data(),msg.size(),"Error: Socket creation failed: %d",errno);
+            ret.m_msg = msg.data();
+#endif
+            return ret;
+        }
+        // set socket for reuse (otherwise might have to wait 4 minutes every time socket is closed)
+        int option = 1;
+        if (m_socketCore.SetSockOpt(loop.m_listenFd, SOL_SOCKET, SO_REUSEADDR, &option, sizeof(option)) < 0) {
+            ret.m_success = false;
+#if defined(FMT_SUPPORT)
+            ret.m_msg = fmt::format("Error: SetSockOpt(SO_REUSEADDR) failed: errno {}", errno);
+#else
+            std::array<char,MSG_SIZE> msg;
+            (void)snprintf(msg.data(),msg.size(),"Error: SetSockOpt(SO_REUSEADDR) failed: %d",errno);
+            ret.m_msg = msg.data();
+#endif
+            return ret;            
+        }
+
+        // share the port between the listening sockets of multiple event loops
+        if (reusePort) {
+#if defined(SO_REUSEPORT)
+            if (m_socketCore.SetSockOpt(loop.m_listenFd, SOL_SOCKET, SO_REUSEPORT, &option, sizeof(option)) < 0) {
+                ret.m_success = false;
+#if defined(FMT_SUPPORT)
+                ret.m_msg = fmt::format("Error: SetSockOpt(SO_REUSEPORT) failed: errno {}", errno);
+#else
+                std::array<char,MSG_SIZE> msg;
+                (void)snprintf(msg.data(),msg.size(),"Error: SetSockOpt(SO_REUSEPORT) failed: %d",errno);
+                ret.m_msg = msg.data();
+#endif
+                return ret;
+            }
 #else
-            std::array<char,MSG_SIZE> msg;
-            (void)snprintf(msg.data(),msg.size(),"Error: SetSockOpt(SO_REUSEADDR) failed: %d",errno);
-            ret.m_msg = msg.data();
+            ret.m_success = false;
+            ret.m_msg = "Error: SO_REUSEPORT not supported, multiple server threads unavailable";
+            return ret;
 #endif
-            return ret;            
         }
 
         // set TX and RX buffer sizes
-        if (m_socketCore.SetSockOpt(m_sockfd, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<char *>(&m_sockOptions.m_rxBufSize),
+        if (m_socketCore.SetSockOpt(loop.m_listenFd, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<char *>(&m_sockOptions.m_rxBufSize),
                 sizeof(m_sockOptions.m_rxBufSize)) < 0) {
             ret.m_success = false;
 #if defined(FMT_SUPPORT)
@@ -132,7 +1493,7 @@ public:
             return ret;
         }
 
-        if (m_socketCore.SetSockOpt(m_sockfd, SOL_SOCKET, SO_SNDBUF, reinterpret_cast<char *>(&m_sockOptions.m_txBufSize),
+        if (m_socketCore.SetSockOpt(loop.m_listenFd, SOL_SOCKET, SO_SNDBUF, reinterpret_cast<char *>(&m_sockOptions.m_txBufSize),
                 sizeof(m_sockOptions.m_txBufSize)) < 0) {
             ret.m_success = false;
 #if defined(FMT_SUPPORT)
@@ -145,14 +1506,16 @@ public:
             return ret;
         }
 
-        memset(&m_serverAddress, 0, sizeof(m_serverAddress));
-        m_serverAddress.sin_family = AF_INET;
-        inet_pton(AF_INET, m_sockOptions.m_listenAddr.c_str(),&m_serverAddress.sin_addr.s_addr);
-//        m_serverAddress.sin_addr.s_addr = htonl(INADDR_ANY);
-        m_serverAddress.sin_port = htons(port);
+        // remaining tuning options are best effort, and are inherited by accepted connections
+        applyTuning(m_socketCore, loop.m_listenFd, m_sockOptions, true);
+#if defined(TCP_DEFER_ACCEPT)
+        if (m_sockOptions.m_deferAcceptSecs > 0) {
+            (void)setIntOption(m_socketCore, loop.m_listenFd, IPPROTO_TCP, TCP_DEFER_ACCEPT, m_sockOptions.m_deferAcceptSecs);
+        }
+#endif
 
         int bindSuccess =
-            m_socketCore.Bind(m_sockfd, reinterpret_cast<struct sockaddr *>(&m_serverAddress), sizeof(m_serverAddress));
+            m_socketCore.Bind(loop.m_listenFd, reinterpret_cast<struct sockaddr *>(&m_serverAddress), sizeof(m_serverAddress));
         if (bindSuccess == -1) {  // bind failed
             ret.m_success = false;
 #if defined(FMT_SUPPORT)
@@ -164,8 +1527,11 @@ public:
 #endif
             return ret;
         }
-        const int clientsQueueSize = 5;
-        int listenSuccess = m_socketCore.Listen(m_sockfd, clientsQueueSize);
+        int listenSuccess = m_socketCore.Listen(loop.m_listenFd, m_sockOptions.m_listenBacklog);
+        // the accept queue is drained until accept() would block
+        if (listenSuccess == 0 && m_socketCore.SetNonBlocking(loop.m_listenFd) != 0) {
+            listenSuccess = -1;
+        }
         if (listenSuccess == -1) {  // listen failed
             ret.m_success = false;
 #if defined(FMT_SUPPORT)
@@ -177,358 +1543,561 @@ public:
 #endif
             return ret;
         }
-        ret.m_success = true;
-
-        // Add the accept socket to m_fds
-        FD_ZERO(&m_fds);
-        FD_SET(m_sockfd, &m_fds);
 
-        m_thread = std::thread(&TcpServer::serverTask, this);
+        // Report what the kernel granted, e.g. buffer sizes are doubled and capped by system limits
+        SocketOpt effective = m_sockOptions;
+        readTuning(m_socketCore, loop.m_listenFd, true, effective);
+        {
+            std::lock_guard<std::mutex> guard(m_effectiveMutex);
+            m_effectiveOptions = effective;
+        }
 
-        return ret;
+        // Register the accept socket with the event loop
+        return openEventLoop(loop);
     }
 
     /**
-     * @brief Remove a TCP client connection
-     *
-     * @param handle - handle of the TCP client to be dropped
-     * @return true
-     * @return false
+     * @brief Close the accept sockets and pollers of the event loops, which aren't running, and drop the loops
      */
-    bool deleteClient(ClientHandle &handle) {
-        std::lock_guard<std::mutex> guard(m_mutex);
-        if (m_clients.count(handle) > 0) {
-            Client &client = m_clients[handle];
-
-            // Close socket connection and remove from m_fds
-            m_socketCore.Close(client.m_sockfd);
-            FD_CLR(client.m_sockfd, &m_fds);
-
-            m_clients.erase(handle);
-            return true;
+    void closeLoops() {
+        if (m_acceptLoop) {
+            m_loops.push_back(std::move(m_acceptLoop));
         }
-        return false;
+        for (auto &loop : m_loops) {
+            if (loop->m_listenFd != INVALID_SOCKET) {
+                m_socketCore.Close(loop->m_listenFd);
+            }
+            loop->m_listenFd = INVALID_SOCKET;
+            loop->m_poller.close();
+        }
+        m_loops.clear();
     }
 
     /**
-     * @brief Send a broadcast message to all connected TCP clients
+     * @brief Prepare an event loop's poller, registering its listening socket if it has one
      *
-     * @param msg - pointer to the message data
-     * @param size - length of the message data
-     * @return SocketRet - indication that the message was sent to all clients
+     * @param loop - event loop to set up
+     * @return SocketRet - indication of whether the event loop was set up successfully
      */
-    SocketRet sendBcast(const char *msg, size_t size) {
+    SocketRet openEventLoop(EventLoop &loop) {
         SocketRet ret;
-        ret.m_success = true;
-        std::lock_guard<std::mutex> guard(m_mutex);
-        for (auto &client : m_clients) {
-            auto clientRet = client.second.sendMsg(msg, size);
-            ret.m_success &= clientRet.m_success;
-            if (!clientRet.m_success) {
-                ret.m_msg = clientRet.m_msg;
-                break;
-            }
+        bool opened = loop.m_poller.open(m_sockOptions.m_eventBackend, m_sockOptions.m_uringBufferCount,
+                                         m_sockOptions.m_uringBufferSize) == 0;
+        if (opened) {
+            // Registration pins the regions' pages once; if RLIMIT_MEMLOCK doesn't allow it, each zero-copy send
+            // pins its own pages instead
+            (void)loop.m_poller.registerSendRegions(m_sendRegions);
+        }
+        if (!opened || (loop.m_listenFd != INVALID_SOCKET && loop.m_poller.addAcceptor(loop.m_listenFd) != 0)) {
+            ret.m_success = false;
+#if defined(FMT_SUPPORT)
+            ret.m_msg = fmt::format("Error: event loop setup failed errno {}", errno);
+#else
+            std::array<char,MSG_SIZE> msg;
+            (void)snprintf(msg.data(),msg.size(),"Error: event loop setup failed: %d",errno);
+            ret.m_msg = msg.data();
+#endif
+            return ret;
         }
+        ret.m_success = true;
         return ret;
     }
 
     /**
-     * @brief Send a message to a specific connected client
+     * @brief Pick the least loaded worker event loop for a new connection accepted by the acceptor.  With
+     *          LoadBalance::LeastBytes a loop's load is its sampled byte rate plus the average rate per connection
+     *          for each connection handed to it since the sample, so a burst of new connections between samples
+     *          is spread over the loops rather than all going to the one that was quietest.
      *
-     * @param client - handle of the TCP client
-     * @param msg - pointer to the message data
-     * @param size - length of the message data
-     * @return SocketRet - indication that the message was sent to the client
+     * @return EventLoop& - the event loop which will monitor the connection
      */
-    SocketRet sendClientMessage(ClientHandle &clientId, const char *msg, size_t size) {
-        SocketRet ret;
-        Client *client = nullptr;
-        {
-            std::lock_guard<std::mutex> guard(m_mutex);
-            if (m_clients.count(clientId) > 0) {
-                client = &m_clients[clientId];
+    EventLoop &selectLoop() {
+        constexpr double SAMPLE_SECS = 0.1;
+        constexpr double RATE_WEIGHT = 0.5;
+        if (m_sockOptions.m_loadBalance == LoadBalance::LeastBytes) {
+            // Refresh the smoothed byte rates, ignoring intervals too short to be meaningful
+            auto now = std::chrono::steady_clock::now();
+            double elapsed = std::chrono::duration<double>(now - m_lastLoadSample).count();
+            if (elapsed >= SAMPLE_SECS) {
+                double totalRate = 0.0;
+                size_t totalConnections = 0;
+                for (auto &loop : m_loops) {
+                    uint64_t bytes = loop->m_bytes.load(std::memory_order_relaxed);
+                    double rate = static_cast<double>(bytes - loop->m_lastBytes) / elapsed;
+                    loop->m_byteRate = RATE_WEIGHT * rate + (1.0 - RATE_WEIGHT) * loop->m_byteRate;
+                    loop->m_lastBytes = bytes;
+                    loop->m_handoffs = 0;
+                    totalRate += loop->m_byteRate;
+                    totalConnections += loop->m_connections.load();
+                }
+                m_connectionRate = totalRate / static_cast<double>(std::max<size_t>(totalConnections, 1));
+                m_lastLoadSample = now;
             }
         }
-        if (client != nullptr) {
-            ret = client->sendMsg(msg, size);
-            return ret;
+        auto load = [this](const EventLoop &loop) {
+            return loop.m_byteRate + static_cast<double>(loop.m_handoffs.load()) * m_connectionRate;
+        };
+        EventLoop *best = m_loops.front().get();
+        for (auto &loop : m_loops) {
+            bool fewerConnections = loop->m_connections.load() < best->m_connections.load();
+            if (m_sockOptions.m_loadBalance == LoadBalance::LeastBytes) {
+                double loopLoad = load(*loop);
+                double bestLoad = load(*best);
+                if (loopLoad < bestLoad || (loopLoad <= bestLoad && fewerConnections)) {
+                    best = loop.get();
+                }
+            } else if (fewerConnections) {
+                best = loop.get();
+            }
         }
-#if defined(FMT_SUPPORT)
-        ret.m_msg = fmt::format("Error: Client {} not found", clientId);
-#else
-        std::array<char,MSG_SIZE> errMsg;
-        (void)snprintf(errMsg.data(),errMsg.size(),"Error: Client %d not found",clientId);
-        ret.m_msg = errMsg.data();
-#endif
-        ret.m_success = false;
-        return ret;
+        return *best;
     }
 
     /**
-     * @brief Shut down the TCP server
+     * @brief Accept the connections pending on an event loop's listening socket, up to SocketOpt::m_acceptBatch
+     *          of them, so that a burst of connections is absorbed in a single wakeup
+     *
+     * @param listener - event loop which owns the listening socket
      */
-    void finish() {
-        m_stop = true;
-        if (m_thread.joinable()) {
-            m_stop = true;
-            try {
-                m_thread.join();
-            }
-            catch (...) {              
+    void acceptClients(EventLoop &listener) {
+        size_t batch = m_sockOptions.m_acceptBatch;
+        for (size_t count = 0; batch == 0 || count < batch; count++) {
+            if (!acceptClient(listener)) {
+                break;
             }
         }
+    }
 
-        // Close client sockets
-        std::lock_guard<std::mutex> guard(m_mutex);
-        for (auto &client : m_clients) {
-            m_socketCore.Close(client.second.m_sockfd);
+    /**
+     * @brief Accept a pending connection on an event loop's listening socket
+     *
+     * @param listener - event loop which owns the listening socket.  It monitors the connection itself unless
+     *          it is the dedicated acceptor, which hands the connection to the least loaded worker loop.
+     * @return true - more connections may be pending
+     * @return false - the accept queue is empty or accept() failed
+     */
+    bool acceptClient(EventLoop &listener) {
+        struct sockaddr_in clientAddress {};
+        socklen_t sosize = sizeof(clientAddress);
+        SOCKET clientfd = m_socketCore.AcceptNonBlocking(listener.m_listenFd,
+            reinterpret_cast<struct sockaddr *>(&clientAddress), &sosize);
+        if (clientfd == INVALID_SOCKET) {
+            // the queue is empty, or e.g. out of descriptors; a connection which was reset while queued
+            // doesn't stop the rest being accepted
+            return errno == ECONNABORTED || errno == EINTR;
         }
+        registerClient(listener, clientfd, clientAddress);
+        return true;
+    }
 
-        // Close accept socket
-        if (m_sockfd != INVALID_SOCKET) {
-            m_socketCore.Close(m_sockfd);
-        }
-        m_sockfd = INVALID_SOCKET;
-        m_clients.clear();
+    /**
+     * @brief Take on a connection the kernel accepted on an event loop's listening socket (EventBackend::IoUring)
+     *
+     * @param listener - event loop which owns the listening socket
+     * @param clientfd - the accepted connection, already non-blocking
+     */
+    void acceptedClient(EventLoop &listener, SOCKET clientfd) {
+        struct sockaddr_in clientAddress {};
+        socklen_t sosize = sizeof(clientAddress);
+        (void)m_socketCore.GetPeerName(clientfd, reinterpret_cast<struct sockaddr *>(&clientAddress), &sosize);
+        registerClient(listener, clientfd, clientAddress);
     }
 
     /**
-     * @brief Get current info for a client
+     * @brief Admit an accepted connection.  The acceptor hands an admitted connection to the least loaded worker
+     *          loop, which registers it, so that its receives, callbacks and idle timer all run on that loop and
+     *          none of them can come before onClientConnect().
      *
-     * @param clientId - handle to this client connection
-     * @param ipAddr - Client's IP address
-     * @param port - Client's port number
-     * @param connected - indicates client is connected
-     * @return true - clientId is valid and information was returned
-     * @return false - clientId is invalid
+     * @param listener - event loop which owns the listening socket.  It monitors the connection itself unless
+     *          it is the dedicated acceptor.
+     * @param clientfd - the accepted connection
+     * @param clientAddress - the client's address
      */
-    bool getClientInfo(ClientHandle clientId, std::string &ipAddr, uint16_t &port, bool &connected) {
-        std::lock_guard<std::mutex> guard(m_mutex);
-        if (m_clients.count(clientId) > 0) {
-            Client &client = m_clients[clientId];
-            ipAddr = client.m_ip;
-            port = client.m_port;
-            connected = client.m_isConnected;
-            return true;
+    void registerClient(EventLoop &listener, SOCKET clientfd, const struct sockaddr_in &clientAddress) {
+        Tracing::trace(TraceEvent::Accept, clientfd, 0);
+        bool handoff = (&listener == m_acceptLoop.get());
+        EventLoop &loop = handoff ? selectLoop() : listener;
+        AdmissionReject reason = AdmissionReject::RateLimit;
+        if (!admitClient(loop, reason)) {
+            rejectClient(clientfd, clientAddress, reason);
+            return;
         }
-        return false;
+        // Counted straight away so the acceptor's next pick sees it
+        loop.m_connections++;
+        if (!handoff) {
+            addClient(loop, clientfd, clientAddress, false);
+            return;
+        }
+        loop.m_handoffs++;
+        {
+            std::lock_guard<std::mutex> guard(loop.m_handoffMutex);
+            loop.m_handedOff.push_back(Handoff { clientfd, clientAddress });
+        }
+        loop.m_poller.post([this, &loop]() { addHandedOff(loop); });
     }
 
-private:
     /**
-     * @brief Client represents a connection to a TCP client
+     * @brief Register the connections handed to a worker event loop by the acceptor.  Runs on the worker.
+     *
+     * @param loop - the worker event loop
      */
-    struct Client {
-        SocketImpl *m_socketCore;
-
-        /**
-         * @brief The TCP client's IP address
-         */
-        std::string m_ip;
-
-        /**
-         * @brief The socket file descriptor for the TCP client connection
-         */
-        SOCKET m_sockfd = INVALID_SOCKET;
-
-        /**
-         * @brief The peer's port
-         */
-        uint16_t m_port = 0;
+    void addHandedOff(EventLoop &loop) {
+        std::vector<Handoff> handedOff;
+        {
+            std::lock_guard<std::mutex> guard(loop.m_handoffMutex);
+            handedOff.swap(loop.m_handedOff);
+        }
+        for (const auto &pending : handedOff) {
+            addClient(loop, pending.m_fd, pending.m_address, true);
+        }
+    }
 
-        /**
-         * @brief Indicator whether TCP client is connected
-         */
-        bool m_isConnected = false;
+    /**
+     * @brief Start monitoring an admitted connection and report it.  Runs on the event loop which monitors it.
+     *
+     * @param loop - event loop which monitors the connection
+     * @param clientfd - the accepted connection
+     * @param clientAddress - the client's address
+     * @param handoff - the connection was handed over by the acceptor
+     */
+    void addClient(EventLoop &loop, SOCKET clientfd, const struct sockaddr_in &clientAddress, bool handoff) {
+        if (loop.m_poller.add(clientfd, POLL_READ) != 0) {
+            // The event loop can't monitor this descriptor (e.g. beyond FD_SETSIZE for select())
+            dropClient(loop, clientfd, handoff);
+            return;
+        }
+        std::array<char, INET_ADDRSTRLEN> addr;
+        inet_ntop(AF_INET, &clientAddress.sin_addr, addr.data(), INET_ADDRSTRLEN);
+        ClientHandle handle = m_clients.handleFor(clientfd);
+        std::shared_ptr<Client> client;
+        if (handle != INVALID_CLIENT_HANDLE) {
+            client = std::make_shared<Client>(this, &loop, handle, addr.data(), clientfd,
+                                              static_cast<uint16_t>(ntohs(clientAddress.sin_port)));
+            handle = m_clients.insert(clientfd, client);
+        }
+        if (handle == INVALID_CLIENT_HANDLE) {
+            // Descriptor beyond the registry's range
+            loop.m_poller.remove(clientfd);
+            dropClient(loop, clientfd, handoff);
+            return;
+        }
+        m_admitted++;
+        publishClientConnect(*client);
+        if (m_sockOptions.m_idleTimeoutMs > 0) {
+            client->m_lastReceive = loop.m_timers.now();
+            armIdleTimer(*client, std::chrono::milliseconds(m_sockOptions.m_idleTimeoutMs));
+        }
+    }
 
-        /**
-         * @brief Construct a new Client object
-         *
-         * @param ipAddr - client's IP address
-         * @param clientFd - file descriptor for the client connection
-         * @param port - client's port number
-         */
-        Client(SocketImpl *socketImpl, const char *ipAddr, SOCKET clientFd, uint16_t port)
-            : m_socketCore(socketImpl), m_ip(ipAddr), m_sockfd(clientFd), m_port(port), m_isConnected(true) {
+    /**
+     * @brief Close an admitted connection which couldn't be registered, taking it back out of the counts
+     *
+     * @param loop - event loop which would have monitored the connection
+     * @param clientfd - the accepted connection
+     * @param handoff - the connection was handed over by the acceptor
+     */
+    void dropClient(EventLoop &loop, SOCKET clientfd, bool handoff) {
+        loop.m_connections--;
+        m_connectionCount--;
+        if (handoff) {
+            // The acceptor may have reset the count since the handoff
+            size_t handoffs = loop.m_handoffs.load();
+            while (handoffs > 0 && !loop.m_handoffs.compare_exchange_weak(handoffs, handoffs - 1)) {
+            }
         }
+        m_socketCore.Close(clientfd);
+    }
 
-        /**
-         * @brief Construct a new Client object
-         */
-        Client() : m_socketCore(nullptr), m_sockfd(INVALID_SOCKET) {
+    /**
+     * @brief Decide whether to take on a new connection.  The cheap checks come first, and a connection turned
+     *          away by the cap or the lag check doesn't use up a token of the rate limit.  An admitted connection
+     *          is counted in m_connectionCount.
+     *
+     * @param loop - event loop which would monitor the connection
+     * @param reason - set to the reason when the connection is turned away
+     * @return true - the connection may be registered
+     * @return false - the connection must be rejected
+     */
+    bool admitClient(const EventLoop &loop, AdmissionReject &reason) {
+        if (m_sockOptions.m_maxLoopLagMs > 0 &&
+            loop.m_lag.get() > std::chrono::milliseconds(m_sockOptions.m_maxLoopLagMs)) {
+            reason = AdmissionReject::Overload;
+            return false;
+        }
+        size_t count = m_connectionCount.fetch_add(1);
+        if (m_sockOptions.m_maxConnections > 0 && count >= m_sockOptions.m_maxConnections) {
+            m_connectionCount--;
+            reason = AdmissionReject::MaxConnections;
+            return false;
         }
+        if (!m_acceptLimit->tryTake()) {
+            m_connectionCount--;
+            reason = AdmissionReject::RateLimit;
+            return false;
+        }
+        return true;
+    }
 
-        /**
-         * @brief Send a message to this TCP client
-         *
-         * @param msg - pointer to the message data
-         * @param size - length of the message data
-         * @return SocketRet - indication of whether the message was sent successfully
-         */
-        SocketRet sendMsg(const char *msg, size_t size) {
-            SocketRet ret;
-            if (m_sockfd != INVALID_SOCKET) {
-                ssize_t numBytesSent = m_socketCore->Send(m_sockfd, reinterpret_cast<const void *>(msg), size, 0);
-                if (numBytesSent < 0) {  // send failed
-                    ret.m_success = false;
-#if defined(FMT_SUPPORT)
-                    ret.m_msg = fmt::format("Error: send() failed errno {}", errno);
-#else
-                    std::array<char,MSG_SIZE> msg;
-                    (void)snprintf(msg.data(),msg.size(),"Error: send() failed: %d",errno);
-                    ret.m_msg = msg.data();
-#endif
-                    return ret;
-                }
-                if (static_cast<size_t>(numBytesSent) < size) {  // not all bytes were sent
-                    ret.m_success = false;
-#if defined(FMT_SUPPORT)
-                    ret.m_msg = fmt::format("Only {} bytes out of {} was sent to client", numBytesSent, size);
-#else
-                    std::array<char,MSG_SIZE> msg;
-                    (void)snprintf(msg.data(), msg.size(), "Only %ld bytes out of %lu was sent to client", numBytesSent, size);
-                    ret.m_msg = msg.data();
-#endif
-                    return ret;
-                }
-            }
-            ret.m_success = true;
-            return ret;
+    /**
+     * @brief Turn away an accepted connection and report it to onAcceptRejected(), if provided.  The connection
+     *          is reset rather than closed gracefully, so a storm of rejected connections doesn't leave TIME_WAIT
+     *          state behind on the server.
+     *
+     * @param clientfd - the accepted connection
+     * @param clientAddress - the client's address
+     * @param reason - why the connection was rejected
+     */
+    void rejectClient(SOCKET clientfd, const struct sockaddr_in &clientAddress, AdmissionReject reason) {
+        struct linger abortive {};
+        abortive.l_onoff = 1;
+        abortive.l_linger = 0;
+        (void)m_socketCore.SetSockOpt(clientfd, SOL_SOCKET, SO_LINGER, reinterpret_cast<char *>(&abortive),
+                                      sizeof(abortive));
+        m_socketCore.Close(clientfd);
+        switch (reason) {
+        case AdmissionReject::RateLimit:
+            m_rejectedRate++;
+            break;
+        case AdmissionReject::MaxConnections:
+            m_rejectedMax++;
+            break;
+        case AdmissionReject::Overload:
+            m_rejectedOverload++;
+            break;
         }
-    };
+        std::array<char, INET_ADDRSTRLEN> addr;
+        inet_ntop(AF_INET, &clientAddress.sin_addr, addr.data(), INET_ADDRSTRLEN);
+        notifyAcceptRejected(m_callback, 0, std::string(addr.data()), static_cast<uint16_t>(ntohs(clientAddress.sin_port)),
+                             reason);
+    }
 
     /**
-     * @brief Publish data received from a TCP client
+     * @brief Schedule the check of whether a client has gone idle
      *
-     * @param client - handle of the TCP client which sent the data
-     * @param msg - pointer to the message data
-     * @param msgSize - length of the message data
+     * @param client - the TCP client
+     * @param delay - time until the check
      */
-    void publishClientMsg(const ClientHandle &client, const char *msg, size_t msgSize) {
-        m_callback.onReceiveClientData(client, msg, msgSize);
+    void armIdleTimer(Client &client, std::chrono::milliseconds delay) {
+        client.m_idleTimer = client.m_loop->m_timers.schedule(delay, [this, handle = client.m_handle]() {
+            checkIdle(handle);
+        });
     }
 
     /**
-     * @brief Publish notification that a TCP client has disconnected
+     * @brief Close a client's connection if nothing has been received for SocketOpt::m_idleTimeoutMs, otherwise
+     *          check again when the timeout would expire.  Runs on the client's event loop, so the timer is
+     *          re-armed rather than pushed back on every receive.
      *
-     * @param client - handle of the TCP client which has disconnected
+     * @param handle - handle of the TCP client
      */
-    void publishDisconnected(const ClientHandle &client) {
-        SocketRet ret;
-#if defined(FMT_SUPPORT)
-        ret.m_msg = fmt::format("Client {} disconnected", client);
-#else
-        std::array<char,MSG_SIZE> msg;
-        (void)snprintf(msg.data(),msg.size(),"Client %d disconnected",client);
-        ret.m_msg = msg.data();
-#endif
-        m_callback.onClientDisconnect(client, ret);
+    void checkIdle(ClientHandle handle) {
+        std::shared_ptr<Client> client = m_clients.find(handle);
+        if (!client) {
+            return;
+        }
+        const TimerWheel &timers = client->m_loop->m_timers;
+        auto idle = std::chrono::milliseconds(
+            static_cast<int64_t>(timers.now() - client->m_lastReceive.load()) * timers.tick().count());
+        auto timeout = std::chrono::milliseconds(m_sockOptions.m_idleTimeoutMs);
+        if (idle < timeout) {
+            armIdleTimer(*client, timeout - idle);
+            return;
+        }
+        (void)client->markDisconnected(Counter::DisconnectIdle);
+        deleteClient(handle);
+        publishIdleTimeout(*client);
     }
 
     /**
-     * @brief Publish notification of a new TCP client connection
+     * @brief Receive data from a connected client
      *
-     * @param client - handle of the new TCP client
+     * @param fd - file descriptor of the client connection
+     * @param events - the events reported for the connection
+     * @param chain - receive buffers
      */
-    void publishClientConnect(const ClientHandle &client) {
-        m_callback.onClientConnect(client);
+    void receiveClient(SOCKET fd, uint32_t events, ReceiveChain &chain) {
+        ClientHandle handle = INVALID_CLIENT_HANDLE;
+        std::shared_ptr<Client> client = m_clients.findFd(fd, handle);
+        if (!client) {
+            return;
+        }
+        if (client->m_msgZeroCopy && client->readNotifications() && (events & POLL_READ) == 0) {
+            // epoll reports a non-empty error queue even while reading is paused
+            return;
+        }
+        ssize_t numOfBytesReceived = chain.receive(m_socketCore, fd);
+        if (numOfBytesReceived < 0 && wouldBlock(errno)) {
+            // spurious wakeup on the non-blocking socket
+            client->m_metrics.add(Counter::RecvCalls);
+            return;
+        }
+        std::array<MsgPart, RX_CHAIN_MAX> segments;
+        size_t count = chain.segments(numOfBytesReceived < 0 ? 0 : static_cast<size_t>(numOfBytesReceived),
+                                      segments.data());
+        processReceived(fd, numOfBytesReceived, segments.data(), count, &chain);
     }
 
     /**
-     * @brief Find the maximum file descriptor among listen socket and all client sockets for
-     *          use by select()
-     * @return int
+     * @brief Handle the result of a receive from a connected client
+     *
+     * @param fd - file descriptor of the client connection
+     * @param numOfBytesReceived - number of bytes received, 0 if the client closed the connection or -1 on
+     *          failure (errno is set)
+     * @param segments - the received data, in order
+     * @param count - number of segments
+     * @param chain - receive buffers holding the segments, or nullptr if the data is in io_uring's buffers
      */
-    int findMaxFd() {
-        int maxfd = m_sockfd;
-        for (const auto &client : m_clients) {
-            maxfd = std::max<SOCKET>(maxfd, client.second.m_sockfd);
+    void processReceived(SOCKET fd, ssize_t numOfBytesReceived, const MsgPart *segments, size_t count,
+                         const ReceiveChain *chain) {
+        Tracing::trace(TraceEvent::Receive, fd, numOfBytesReceived);
+        ClientHandle handle = INVALID_CLIENT_HANDLE;
+        std::shared_ptr<Client> client = m_clients.findFd(fd, handle);
+        if (!client) {
+            return;
+        }
+        client->m_metrics.add(Counter::RecvCalls);
+        if (numOfBytesReceived < 1) {
+            (void)client->markDisconnected(numOfBytesReceived == 0 ? Counter::DisconnectPeer : Counter::DisconnectError);
+            if (numOfBytesReceived == 0) {  // client closed connection
+                deleteClient(handle);
+                publishDisconnected(*client);
+            }
+        } else {
+            client->m_loop->m_bytes.fetch_add(static_cast<uint64_t>(numOfBytesReceived), std::memory_order_relaxed);
+            client->m_metrics.add(Counter::BytesIn, static_cast<uint64_t>(numOfBytesReceived));
+            if (m_sockOptions.m_idleTimeoutMs > 0) {
+                client->m_lastReceive.store(client->m_loop->m_timers.now(), std::memory_order_relaxed);
+            }
+            rearmQuickAck(m_socketCore, fd, m_sockOptions);
+            FrameStatus status = FrameStatus::Incomplete;
+            for (size_t idx = 0; idx < count && status != FrameStatus::Invalid; idx++) {
+                status = client->m_framer.feed(segments[idx].m_data, segments[idx].m_size,
+                    [this, &client, chain](const char *data, size_t size) {
+                        publishClientMsg(client, data, size, chain);
+                    });
+            }
+            if (status == FrameStatus::Invalid) {
+                (void)client->markDisconnected(Counter::DisconnectFraming);
+                deleteClient(handle);
+                publishFramingError(*client);
+            }
         }
-        return maxfd + 1;
     }
 
     /**
-     * @brief Thread handling all accept requests and reception of data from connected clients
+     * @brief Thread handling accept requests and reception of data for one event loop
+     *
+     * @param loop - the event loop run by this thread
      */
-    void serverTask() {
-        constexpr int64_t USEC_DELAY = 500000;
-        std::array<char, MAX_PACKET_SIZE> msg;
+    void serverTask(EventLoop &loop) {
+        constexpr int MSEC_DELAY = 500;
+        ReceiveChain chain(loop.m_rxPool, MAX_PACKET_SIZE);
+        std::vector<PollEvent> events;
+        events.reserve(MAX_POLL_EVENTS);
+        // finish(), post() and timers scheduled from other threads wake the loop; without a wakeup descriptor
+        // it polls for them
+        int idleWait = loop.m_poller.canWake() ? -1 : MSEC_DELAY;
+        bool trackLag = m_sockOptions.m_maxLoopLagMs > 0;
+        auto passStart = std::chrono::steady_clock::now();
 
         while (!m_stop.load()) {
-            struct timeval delay {
-                0, USEC_DELAY
-            };
-            fd_set read_set = m_fds;
-            int maxfds = findMaxFd();
-            int selectRet = m_socketCore.Select(maxfds, &read_set, nullptr, nullptr, &delay);
-            if (selectRet <= 0) {
-                // select() failed or timed out, so retry after a shutdown check
+            // Wake once per tick while timers are scheduled
+            int timeout = loop.m_timers.empty() ? idleWait : static_cast<int>(loop.m_timers.tick().count());
+            auto waitStart = trackLag ? std::chrono::steady_clock::now() : passStart;
+            int ready = loop.m_poller.wait(events, timeout);
+            m_metrics.add(Counter::PollWaits);
+            if (trackLag) {
+                auto waitEnd = std::chrono::steady_clock::now();
+                loop.m_lag.record(waitStart - passStart, waitEnd - waitStart);
+                passStart = waitEnd;
+            }
+            loop.m_poller.runPosted();
+            loop.m_timers.advance();
+            if (ready <= 0) {
+                // wait failed or timed out, so retry after a shutdown check
                 continue;
             }
-            for (int fd = 0; fd < maxfds; fd++) {
-                if (FD_ISSET(fd, &read_set)) {
-                    Client *client = nullptr;
-                    {
-                        std::lock_guard<std::mutex> guard(m_mutex);
-                        if (m_clients.count(fd) > 0) {
-                            client = &m_clients[fd];
-                        }
-                    }
-                    if (client != nullptr) {
-                        // data on client socket
-                        ssize_t numOfBytesReceived = m_socketCore.Recv(fd, msg.data(), MAX_PACKET_SIZE, 0);
-                        if (numOfBytesReceived < 1) {
-                            client->m_isConnected = false;
-                            if (numOfBytesReceived == 0) {  // client closed connection
-                                deleteClient(fd);
-                                publishDisconnected(fd);
-                            }
-                        } else {
-                            publishClientMsg(fd, msg.data(), static_cast<size_t>(numOfBytesReceived));
-                        }
+            for (const auto &event : events) {
+                if (event.m_fd == loop.m_listenFd) {
+                    if ((event.m_events & POLL_ACCEPT) != 0) {
+                        // connection accepted by io_uring
+                        acceptedClient(loop, event.m_result);
                     } else {
-                        // data on accept socket
-                        socklen_t sosize = sizeof(m_clientAddress);
-                        int clientfd = m_socketCore.Accept(fd, reinterpret_cast<struct sockaddr *>(&m_clientAddress), &sosize);
-                        if (clientfd == -1) {
-                            // accept() failed
-                        } else {
-                            std::array<char, INET_ADDRSTRLEN> addr;
-                            inet_ntop(AF_INET, &m_clientAddress.sin_addr, addr.data(), INET_ADDRSTRLEN);
-                            {
-                                std::lock_guard<std::mutex> guard(m_mutex);
-                                m_clients.emplace(clientfd,
-                                    Client(&m_socketCore, addr.data(), clientfd,
-                                        static_cast<uint16_t>(ntohs(m_clientAddress.sin_port))));
-                            }
-                            FD_SET(clientfd, &m_fds);
-                            publishClientConnect(clientfd);
-                        }
+                        // connections pending on accept socket
+                        acceptClients(loop);
+                    }
+                    continue;
+                }
+                if ((event.m_events & (POLL_WRITE | POLL_SENT | POLL_SEND_RELEASED)) != 0) {
+                    ClientHandle handle = INVALID_CLIENT_HANDLE;
+                    std::shared_ptr<Client> client = m_clients.findFd(event.m_fd, handle);
+                    if (client && (event.m_events & POLL_SENT) != 0) {
+                        // zero-copy send finished
+                        client->zeroCopySent(event.m_result);
+                    } else if (client && (event.m_events & POLL_SEND_RELEASED) != 0) {
+                        // kernel released the data of a zero-copy send
+                        client->zeroCopyReleased(event.m_result);
+                    } else if (client) {
+                        // client socket has room for queued data
+                        client->flush();
+                    }
+                }
+                if ((event.m_events & POLL_DATA) != 0) {
+                    // data received by io_uring on client socket
+                    if (event.m_result < 0) {
+                        errno = -event.m_result;
                     }
+                    MsgPart segment { event.m_data, event.m_result < 0 ? 0 : static_cast<size_t>(event.m_result) };
+                    processReceived(event.m_fd, event.m_result < 0 ? -1 : event.m_result, &segment, 1, nullptr);
+                } else if ((event.m_events & (POLL_READ | POLL_ERROR)) != 0) {
+                    // data on client socket, or zero-copy release notifications on its error queue
+                    receiveClient(event.m_fd, event.m_events, chain);
                 }
             }
         }
     }
 
     /**
-     * @brief The socket file descriptor used for accepting connections
+     * @brief The server socket address
      */
-    SOCKET m_sockfd = INVALID_SOCKET;
+    struct sockaddr_in m_serverAddress;
 
     /**
-     * @brief The server socket address
+     * @brief The server's event loops
      */
-    struct sockaddr_in m_serverAddress;
+    std::vector<std::unique_ptr<EventLoop>> m_loops;
+
+    /**
+     * @brief The dedicated acceptor loop used in AcceptMode::Acceptor
+     */
+    std::unique_ptr<EventLoop> m_acceptLoop;
+
+    /**
+     * @brief Memory regions registered for zero-copy sends
+     */
+    std::vector<SendRegion> m_sendRegions;
+
+    /**
+     * @brief Worker threads splitting large broadcasts, when SocketOpt::m_bcastThreads > 1.  sendBcast() may race
+     *        with finish(), so it's only accessed through std::atomic_load() and std::atomic_store().
+     */
+    std::shared_ptr<ThreadPool> m_bcastPool;
+
+    /**
+     * @brief Worker threads running the callbacks, when SocketOpt::m_callbackThreads > 0
+     */
+    std::shared_ptr<ThreadPool> m_callbackPool;
 
     /**
-     * @brief The client socket address when a connection is accepted
+     * @brief Time the event loops' byte rates were last sampled by the acceptor
      */
-    struct sockaddr_in m_clientAddress;
+    std::chrono::steady_clock::time_point m_lastLoadSample;
 
     /**
-     * @brief The set of file descriptor(s) for accepting connections and receiving data
+     * @brief Average byte rate of a connection when the loads were last sampled, the provisional load of a
+     *        connection handed off since then
      */
-    fd_set m_fds = {};
+    double m_connectionRate = 0.0;
 
     /**
      * @brief Flag to stop the server thread
@@ -536,30 +2105,54 @@ private:
     std::atomic_bool m_stop;
 
     /**
-     * @brief The collection of connected TCP clients
+     * @brief Connection-rate limit applied by admission control
      */
-    std::unordered_map<ClientHandle, Client> m_clients;
+    std::unique_ptr<TokenBucket> m_acceptLimit;
 
     /**
-     * @brief Mutex protecting m_clients
+     * @brief Connections admitted and not yet closed, across all event loops
      */
-    std::mutex m_mutex;
+    std::atomic<size_t> m_connectionCount { 0 };
 
     /**
-     * @brief The registered callback recipient
+     * @brief Admission control counters, see getAdmissionStats()
      */
-    CallbackImpl &m_callback;
+    std::atomic<uint64_t> m_admitted { 0 };
+    std::atomic<uint64_t> m_rejectedRate { 0 };
+    std::atomic<uint64_t> m_rejectedMax { 0 };
+    std::atomic<uint64_t> m_rejectedOverload { 0 };
+
+    /**
+     * @brief Counters and latency histograms, see getMetrics().  Declared before m_clients, whose connections
+     *        add to it.
+     */
+    Metrics m_metrics;
+
+    /**
+     * @brief The connected TCP clients, indexed by file descriptor.  Lookups don't take a lock.
+     */
+    ClientRegistry<Client> m_clients;
 
     /**
-     * @brief Server thread
+     * @brief The registered callback recipient
      */
-    std::thread m_thread;
+    CallbackImpl &m_callback;
 
     /**
      * @brief Socket options for SO_SNDBUF and SO_RCVBUF
      */
     SocketOpt m_sockOptions;
 
+    /**
+     * @brief Socket options in effect on the listening socket, read back after setup
+     */
+    SocketOpt m_effectiveOptions;
+
+    /**
+     * @brief Mutex protecting m_effectiveOptions, which each event loop's listener reports
+     */
+    mutable std::mutex m_effectiveMutex;
+
     /**
      * @brief Interface for socket calls
      */
@@ -0,0 +1,260 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace sockets {
+
+/**
+ * @brief ThreadPool runs posted tasks on a fixed set of worker threads.  Each worker has its own task queue, so
+ *        posting rarely contends on a lock shared by every worker; an idle worker steals from the others' queues.
+ *        A task posted from a worker thread goes to that worker's queue, where its data is likely still cached.
+ */
+class ThreadPool {
+public:
+    /**
+     * @brief Construct a new ThreadPool object
+     *
+     * @param threads - number of worker threads
+     */
+    explicit ThreadPool(size_t threads) {
+        for (size_t idx = 0; idx < threads; idx++) {
+            m_queues.emplace_back(new WorkQueue);
+        }
+        for (size_t idx = 0; idx < threads; idx++) {
+            m_threads.emplace_back(&ThreadPool::workerTask, this, idx);
+        }
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool(ThreadPool &&) = delete;
+
+    /**
+     * @brief Run the tasks already posted, then stop the worker threads
+     */
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_stop = true;
+        }
+        m_cond.notify_all();
+        for (auto &thread : m_threads) {
+            if (thread.joinable()) {
+                thread.join();
+            }
+        }
+    }
+
+    ThreadPool &operator=(const ThreadPool &) = delete;
+    ThreadPool &operator=(ThreadPool &&) = delete;
+
+    /**
+     * @brief Number of worker threads
+     */
+    size_t size() const {
+        return m_threads.size();
+    }
+
+    /**
+     * @brief Indicates whether the calling thread is one of this pool's workers, which must not destroy the pool
+     */
+    bool inWorker() const {
+        return current().first == this;
+    }
+
+    /**
+     * @brief Queue a task to run on a worker thread
+     *
+     * @param task - the task
+     */
+    void post(std::function<void()> task) {
+        if (m_queues.empty()) {
+            // No workers to run it
+            task();
+            return;
+        }
+        size_t idx = (current().first == this) ? current().second
+                                               : m_nextQueue.fetch_add(1, std::memory_order_relaxed) % m_queues.size();
+        {
+            std::lock_guard<std::mutex> guard(m_queues[idx]->m_mutex);
+            m_queues[idx]->m_tasks.push_back(std::move(task));
+        }
+        m_pending.fetch_add(1);
+        if (m_idle.load() > 0) {
+            // Wake a sleeping worker; the lock orders this with its check of m_pending
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_cond.notify_one();
+        }
+    }
+
+    /**
+     * @brief Split [0, count) into ranges and run func(begin, end) on each, using the worker threads and the
+     *        calling thread.  Returns once every range has been processed.
+     *
+     * @param count - number of items
+     * @param func - callable taking (size_t begin, size_t end)
+     */
+    template <class Func>
+    void parallelFor(size_t count, Func &&func) {
+        size_t parts = std::min(count, m_threads.size() + 1);
+        if (parts <= 1) {
+            func(size_t { 0 }, count);
+            return;
+        }
+        std::mutex doneMutex;
+        std::condition_variable doneCond;
+        size_t pending = parts - 1;
+        size_t step = (count + parts - 1) / parts;
+        for (size_t part = 1; part < parts; part++) {
+            size_t begin = std::min(count, part * step);
+            size_t end = std::min(count, begin + step);
+            post([&, begin, end]() {
+                func(begin, end);
+                std::lock_guard<std::mutex> guard(doneMutex);
+                if (--pending == 0) {
+                    doneCond.notify_one();
+                }
+            });
+        }
+        func(size_t { 0 }, std::min(count, step));
+        std::unique_lock<std::mutex> lock(doneMutex);
+        doneCond.wait(lock, [&pending]() { return pending == 0; });
+    }
+
+private:
+    /**
+     * @brief A worker's queue of tasks
+     */
+    struct WorkQueue {
+        std::mutex m_mutex;
+        std::deque<std::function<void()>> m_tasks;
+    };
+
+    /**
+     * @brief The pool and queue index of the calling worker thread, or nullptr on other threads
+     */
+    static std::pair<const ThreadPool *, size_t> &current() {
+        static thread_local std::pair<const ThreadPool *, size_t> worker { nullptr, 0 };
+        return worker;
+    }
+
+    /**
+     * @brief Take a task from a worker's own queue, oldest first, else steal the newest task of another queue
+     *
+     * @param idx - the worker's queue
+     * @param task - receives the task
+     * @return true - a task was taken
+     */
+    bool take(size_t idx, std::function<void()> &task) {
+        {
+            std::lock_guard<std::mutex> guard(m_queues[idx]->m_mutex);
+            if (!m_queues[idx]->m_tasks.empty()) {
+                task = std::move(m_queues[idx]->m_tasks.front());
+                m_queues[idx]->m_tasks.pop_front();
+                return true;
+            }
+        }
+        for (size_t offset = 1; offset < m_queues.size(); offset++) {
+            WorkQueue &victim = *m_queues[(idx + offset) % m_queues.size()];
+            std::lock_guard<std::mutex> guard(victim.m_mutex);
+            if (!victim.m_tasks.empty()) {
+                task = std::move(victim.m_tasks.back());
+                victim.m_tasks.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Worker thread running posted tasks
+     *
+     * @param idx - the worker's queue
+     */
+    void workerTask(size_t idx) {
+        current() = { this, idx };
+        while (true) {
+            if (!claim()) {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_idle++;
+                m_cond.wait(lock, [this]() { return m_stop || m_pending.load() > 0; });
+                m_idle--;
+                if (m_pending.load() == 0) {
+                    return;
+                }
+                continue;
+            }
+            // The claimed task is in some queue, though another worker may take it first
+            std::function<void()> task;
+            while (!take(idx, task)) {
+                std::this_thread::yield();
+            }
+            task();
+        }
+    }
+
+    /**
+     * @brief Claim one of the posted tasks
+     *
+     * @return true - a task was claimed
+     */
+    bool claim() {
+        size_t pending = m_pending.load();
+        while (pending > 0) {
+            if (m_pending.compare_exchange_weak(pending, pending - 1)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Mutex protecting m_stop, held by sleeping workers while they check for tasks
+     */
+    std::mutex m_mutex;
+
+    /**
+     * @brief Signalled when a task is posted or the pool is stopping
+     */
+    std::condition_variable m_cond;
+
+    /**
+     * @brief Tasks posted and not yet claimed by a worker
+     */
+    std::atomic<size_t> m_pending { 0 };
+
+    /**
+     * @brief Number of workers sleeping or about to sleep on m_cond
+     */
+    std::atomic<size_t> m_idle { 0 };
+
+    /**
+     * @brief Per-worker task queues
+     */
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;
+
+    /**
+     * @brief Queue receiving the next task posted from outside the pool
+     */
+    std::atomic<size_t> m_nextQueue { 0 };
+
+    /**
+     * @brief Indicator that the worker threads should exit
+     */
+    bool m_stop = false;
+
+    /**
+     * @brief Worker threads
+     */
+    std::vector<std::thread> m_threads;
+};
+
+}  // namespace sockets
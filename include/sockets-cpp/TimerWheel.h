@@ -0,0 +1,342 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace sockets {
+
+/**
+ * @brief Identifies a timer scheduled on a TimerWheel
+ */
+using TimerId = uint64_t;
+
+/**
+ * @brief TimerId which never refers to a timer
+ */
+constexpr TimerId INVALID_TIMER = 0;
+
+/**
+ * @brief TimerWheel is a hashed timing wheel: timers are hashed by expiry tick into a ring of slots, each holding
+ *        a linked list of the timers due in that slot (possibly several revolutions ahead).  Scheduling and
+ *        cancelling are O(1) and each tick only visits one slot, so a large number of mostly idle timers (e.g. one
+ *        per connection) costs almost nothing.  Timers fire on the thread calling advance(), with a resolution of
+ *        one tick; schedule() and cancel() may be called from any thread.
+ */
+class TimerWheel {
+public:
+    /**
+     * @brief Construct a new TimerWheel object
+     *
+     * @param tick - resolution of the timers
+     * @param slots - number of slots, rounded up to a power of two
+     * @param tag - value stored in the top 16 bits of every TimerId, identifying the wheel
+     */
+    TimerWheel(std::chrono::milliseconds tick, size_t slots, uint16_t tag = 0)
+        : m_tick(tick.count() > 0 ? tick : std::chrono::milliseconds(1)), m_tag(tag),
+          m_start(std::chrono::steady_clock::now()) {
+        size_t count = 1;
+        while (count < slots) {
+            count <<= 1;
+        }
+        m_heads.assign(count, NIL);
+        m_mask = count - 1;
+    }
+
+    TimerWheel(const TimerWheel &) = delete;
+    TimerWheel &operator=(const TimerWheel &) = delete;
+
+    /**
+     * @brief Resolution of the timers
+     */
+    std::chrono::milliseconds tick() const {
+        return m_tick;
+    }
+
+    /**
+     * @brief Number of ticks processed so far, a cheap timestamp for the wheel's thread
+     */
+    uint64_t now() const {
+        return m_current.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Tag of the wheel a timer was scheduled on
+     *
+     * @param id - the timer
+     * @return uint16_t - the wheel's tag
+     */
+    static uint16_t tagOf(TimerId id) {
+        return static_cast<uint16_t>(id >> TAG_SHIFT);
+    }
+
+    /**
+     * @brief Indicates whether no timers are scheduled
+     */
+    bool empty() const {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_active == 0;
+    }
+
+    /**
+     * @brief Schedule a callback
+     *
+     * @param delay - time until the callback runs; it runs on the first advance() reaching the tick after that
+     * @param callback - the callback
+     * @param interval - period at which the callback repeats after the first run, 0 to run it once
+     * @return TimerId - identifies the timer for cancel()
+     */
+    TimerId schedule(std::chrono::milliseconds delay, std::function<void()> callback,
+                     std::chrono::milliseconds interval = std::chrono::milliseconds(0)) {
+        auto now = std::chrono::steady_clock::now();
+        std::lock_guard<std::mutex> guard(m_mutex);
+        uint64_t current = m_current.load(std::memory_order_relaxed);
+        if (m_active == 0) {
+            // advance() may not have run for a while; with nothing scheduled it can skip the ticks in between
+            current = std::max(current, tickAt(now));
+            m_current.store(current, std::memory_order_relaxed);
+        }
+        // The first tick starting at or after the due time, so the timer never runs early
+        uint64_t due = tickAt(now + delay - std::chrono::nanoseconds(1)) + 1;
+        uint32_t idx = 0;
+        if (!m_free.empty()) {
+            idx = m_free.back();
+            m_free.pop_back();
+        } else {
+            idx = static_cast<uint32_t>(m_entries.size());
+            m_entries.emplace_back();
+        }
+        Entry &entry = m_entries[idx];
+        entry.m_callback = std::move(callback);
+        entry.m_interval = (interval.count() > 0) ? ticks(interval) : 0;
+        link(idx, due > current ? due - current : 1);
+        m_active++;
+        return makeId(idx, entry.m_generation);
+    }
+
+    /**
+     * @brief Cancel a timer.  A callback already running isn't affected.
+     *
+     * @param id - the timer
+     * @return true - the timer was cancelled
+     * @return false - the timer had already fired or been cancelled
+     */
+    bool cancel(TimerId id) {
+        auto idx = static_cast<uint32_t>(id & INDEX_MASK);
+        auto generation = static_cast<uint16_t>(id >> GENERATION_SHIFT);
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if ((id >> TAG_SHIFT) != m_tag || idx >= m_entries.size() || !m_entries[idx].m_linked ||
+            m_entries[idx].m_generation != generation) {
+            return false;
+        }
+        unlink(idx);
+        release(idx);
+        return true;
+    }
+
+    /**
+     * @brief Run the callbacks of the timers due up to a point in time
+     *
+     * @param now - the current time
+     * @return size_t - number of callbacks run
+     */
+    size_t advance(std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now()) {
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            uint64_t target = tickAt(now);
+            uint64_t current = m_current.load(std::memory_order_relaxed);
+            if (m_active == 0 && target > current) {
+                // Nothing to visit on the way
+                current = target;
+            }
+            while (current < target) {
+                current++;
+                m_current.store(current, std::memory_order_relaxed);
+                expireSlot(current & m_mask);
+            }
+            m_current.store(current, std::memory_order_relaxed);
+        }
+        // Run the callbacks unlocked, so they may schedule and cancel timers
+        size_t count = m_expired.size();
+        for (auto &callback : m_expired) {
+            callback();
+        }
+        m_expired.clear();
+        return count;
+    }
+
+private:
+    static constexpr uint32_t NIL = UINT32_MAX;
+    static constexpr uint64_t INDEX_MASK = 0xFFFFFFFFULL;
+    static constexpr unsigned GENERATION_SHIFT = 32;
+    static constexpr unsigned TAG_SHIFT = 48;
+
+    /**
+     * @brief A timer, linked into the list of its slot while scheduled
+     */
+    struct Entry {
+        std::function<void()> m_callback;
+        uint64_t m_interval = 0;
+        uint64_t m_rounds = 0;
+        uint32_t m_prev = NIL;
+        uint32_t m_next = NIL;
+        uint32_t m_slot = 0;
+        uint16_t m_generation = 1;
+        bool m_linked = false;
+    };
+
+    TimerId makeId(uint32_t idx, uint16_t generation) const {
+        return (static_cast<uint64_t>(m_tag) << TAG_SHIFT) | (static_cast<uint64_t>(generation) << GENERATION_SHIFT) |
+               idx;
+    }
+
+    /**
+     * @brief Tick a point in time falls in
+     */
+    uint64_t tickAt(std::chrono::steady_clock::time_point when) const {
+        auto elapsed = when - m_start;
+        return elapsed.count() < 0 ? 0 : static_cast<uint64_t>(elapsed / m_tick);
+    }
+
+    /**
+     * @brief Convert a duration to whole ticks, at least one
+     */
+    uint64_t ticks(std::chrono::milliseconds duration) const {
+        auto count = static_cast<uint64_t>((duration.count() + m_tick.count() - 1) / m_tick.count());
+        return (count == 0) ? 1 : count;
+    }
+
+    /**
+     * @brief Add a timer to the slot it expires in.  Caller holds m_mutex.
+     *
+     * @param idx - the timer
+     * @param delay - ticks from now until it expires
+     */
+    void link(uint32_t idx, uint64_t delay) {
+        Entry &entry = m_entries[idx];
+        entry.m_slot = static_cast<uint32_t>((m_current.load(std::memory_order_relaxed) + delay) & m_mask);
+        // The slot comes round once within the first m_heads.size() ticks, then once per revolution
+        entry.m_rounds = (delay - 1) / m_heads.size();
+        entry.m_prev = NIL;
+        entry.m_next = m_heads[entry.m_slot];
+        if (entry.m_next != NIL) {
+            m_entries[entry.m_next].m_prev = idx;
+        }
+        m_heads[entry.m_slot] = idx;
+        entry.m_linked = true;
+    }
+
+    /**
+     * @brief Remove a timer from its slot.  Caller holds m_mutex.
+     */
+    void unlink(uint32_t idx) {
+        Entry &entry = m_entries[idx];
+        if (entry.m_prev != NIL) {
+            m_entries[entry.m_prev].m_next = entry.m_next;
+        } else {
+            m_heads[entry.m_slot] = entry.m_next;
+        }
+        if (entry.m_next != NIL) {
+            m_entries[entry.m_next].m_prev = entry.m_prev;
+        }
+        entry.m_linked = false;
+    }
+
+    /**
+     * @brief Free a timer's entry; its id goes stale.  Caller holds m_mutex.
+     */
+    void release(uint32_t idx) {
+        Entry &entry = m_entries[idx];
+        entry.m_callback = nullptr;
+        entry.m_generation = static_cast<uint16_t>(entry.m_generation + 1);
+        if (entry.m_generation == 0) {
+            entry.m_generation = 1;
+        }
+        m_free.push_back(idx);
+        m_active--;
+    }
+
+    /**
+     * @brief Collect the callbacks of the timers due in a slot this tick.  Caller holds m_mutex.
+     */
+    void expireSlot(size_t slot) {
+        uint32_t idx = m_heads[slot];
+        while (idx != NIL) {
+            Entry &entry = m_entries[idx];
+            uint32_t next = entry.m_next;
+            if (entry.m_rounds > 0) {
+                entry.m_rounds--;
+            } else if (entry.m_interval > 0) {
+                unlink(idx);
+                m_expired.push_back(entry.m_callback);
+                link(idx, entry.m_interval);
+            } else {
+                unlink(idx);
+                m_expired.push_back(std::move(entry.m_callback));
+                release(idx);
+            }
+            idx = next;
+        }
+    }
+
+    /**
+     * @brief Resolution of the timers
+     */
+    std::chrono::milliseconds m_tick;
+
+    /**
+     * @brief Value in the top 16 bits of this wheel's timer ids
+     */
+    uint64_t m_tag;
+
+    /**
+     * @brief Time of tick 0
+     */
+    std::chrono::steady_clock::time_point m_start;
+
+    /**
+     * @brief Mutex protecting the timers
+     */
+    mutable std::mutex m_mutex;
+
+    /**
+     * @brief Last tick processed, written under m_mutex
+     */
+    std::atomic<uint64_t> m_current { 0 };
+
+    /**
+     * @brief Slot count - 1
+     */
+    size_t m_mask = 0;
+
+    /**
+     * @brief First timer of each slot's list
+     */
+    std::vector<uint32_t> m_heads;
+
+    /**
+     * @brief All timer entries, scheduled or free
+     */
+    std::vector<Entry> m_entries;
+
+    /**
+     * @brief Free entries
+     */
+    std::vector<uint32_t> m_free;
+
+    /**
+     * @brief Number of scheduled timers
+     */
+    size_t m_active = 0;
+
+    /**
+     * @brief Callbacks collected by advance(), only used by the advancing thread
+     */
+    std::vector<std::function<void()>> m_expired;
+};
+
+}  // namespace sockets
@@ -0,0 +1,115 @@
+#pragma once
+#include "SocketCore.h"
+#include <chrono>
+#include <cstdint>
+
+#if defined(__has_include)
+    #if __has_include(<sys/sdt.h>) && !defined(SOCKETS_NO_USDT)
+        #include <sys/sdt.h>
+        /**
+         * @brief Defined when UsdtTracing emits USDT probes, i.e. <sys/sdt.h> (systemtap-sdt-dev) is available
+         */
+        #define SOCKETS_USDT 1
+    #endif
+#endif
+
+namespace sockets {
+
+/**
+ * @brief Points on the hot paths reported to a tracing policy
+ */
+enum class TraceEvent {
+    /**
+     * @brief A TcpServer accepted a connection; size is 0
+     */
+    Accept,
+
+    /**
+     * @brief A receive completed; size is the number of bytes received, 0 if the peer closed the connection or
+     *        -1 on failure
+     */
+    Receive,
+
+    /**
+     * @brief A send call or flush of the send queue completed; size is the number of bytes sent, or -1 on failure
+     */
+    Send,
+
+    /**
+     * @brief A callback is about to run; size is the length of the received message, or 0
+     */
+    CallbackBegin,
+
+    /**
+     * @brief A callback returned; size as for CallbackBegin
+     */
+    CallbackEnd
+};
+
+/**
+ * @brief NoTracing is the default tracing policy of TcpServer, TcpClient and UdpSocket.  Its trace() is empty and
+ *        inlined, so the tracing points compile away.
+ *
+ *        A tracing policy is a class with a static member function
+ *            static void trace(TraceEvent event, SOCKET fd, int64_t size);
+ *        called on the thread where the event happens: the event loop for accepts and receives, the sending
+ *        thread (or the event loop flushing the send queue) for sends, and the thread running the callback for
+ *        callbacks.
+ */
+struct NoTracing {
+    static void trace(TraceEvent, SOCKET, int64_t) {
+    }
+};
+
+/**
+ * @brief UsdtTracing emits a USDT static probe at each tracing point, for perf, bpftrace or SystemTap, e.g.
+ *            bpftrace -e 'usdt:./server:sockets:receive { @bytes = hist(arg1); }'
+ *        The probes are provider "sockets", named accept, receive, send, callback_begin and callback_end, with the
+ *        descriptor and size as arguments.  A probe which isn't attached costs a single no-op instruction.
+ *        Without <sys/sdt.h> (SOCKETS_USDT undefined) no probes are emitted.
+ */
+struct UsdtTracing {
+    static void trace(TraceEvent event, SOCKET fd, int64_t size) {
+#if defined(SOCKETS_USDT)
+        auto descriptor = static_cast<int64_t>(fd);
+        switch (event) {
+        case TraceEvent::Accept:
+            DTRACE_PROBE2(sockets, accept, descriptor, size);
+            break;
+        case TraceEvent::Receive:
+            DTRACE_PROBE2(sockets, receive, descriptor, size);
+            break;
+        case TraceEvent::Send:
+            DTRACE_PROBE2(sockets, send, descriptor, size);
+            break;
+        case TraceEvent::CallbackBegin:
+            DTRACE_PROBE2(sockets, callback_begin, descriptor, size);
+            break;
+        case TraceEvent::CallbackEnd:
+            DTRACE_PROBE2(sockets, callback_end, descriptor, size);
+            break;
+        }
+#else
+        (void)event;
+        (void)fd;
+        (void)size;
+#endif
+    }
+};
+
+/**
+ * @brief HookTracing passes each tracing point, with a timestamp, to a static member function of the application:
+ *            static void onTrace(TraceEvent event, SOCKET fd, int64_t size,
+ *                                std::chrono::steady_clock::time_point when);
+ *        The hook runs on the hot path, so it should do little more than record the event.
+ *
+ * @tparam Hooks - class providing onTrace()
+ */
+template <class Hooks>
+struct HookTracing {
+    static void trace(TraceEvent event, SOCKET fd, int64_t size) {
+        Hooks::onTrace(event, fd, size, std::chrono::steady_clock::now());
+    }
+};
+
+}  // namespace sockets
@@ -1,12 +1,27 @@
 #pragma once
 #include "AddrLookup.h"
+#include "BufferPool.h"
+#include "EventPoller.h"
+#include "FlowControl.h"
+#include "Metrics.h"
 #include "SocketCommon.h"
+#include "SendQueue.h"
 #include "SocketCore.h"
+#include "SocketTuning.h"
+#include "Strand.h"
+#include "ThreadPool.h"
+#include "Tracing.h"
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
+#include <utility>
+#include <vector>
 #if defined(FMT_SUPPORT)
 #include <fmt/core.h>
 #endif
@@ -23,8 +38,12 @@ constexpr uint32_t MSG_SIZE = 100;
 /**
  * @brief The UdpSocket class represents a UDP unicast or multicast socket connection
  *
+ * @tparam CallbackImpl - callback recipient
+ * @tparam SocketImpl - interface for socket calls
+ * @tparam Tracing - tracing policy called on receives, sends and callbacks; NoTracing compiles away,
+ *          UsdtTracing emits USDT probes
  */
-template <class CallbackImpl, class SocketImpl = sockets::SocketCore>
+template <class CallbackImpl, class SocketImpl = sockets::SocketCore, class Tracing = NoTracing>
 class UdpSocket {
 public:
     /**
@@ -34,10 +53,17 @@ public:
      * @param options - optional socket options
      */
     explicit UdpSocket(CallbackImpl &callback, SocketOpt *options = nullptr)
-        : m_sockaddr({}), m_stop(false), m_callback(callback), m_addrLookup(m_socketCore) {
+        : m_sockaddr({}), m_stop(false), m_callback(callback),
+          m_metrics(options == nullptr || options->m_latencyHistograms,
+                    (options != nullptr ? options->m_callbackThreads : 0) + 2),
+          m_addrLookup(m_socketCore), m_poller(m_socketCore),
+          m_inbound(options != nullptr ? *options : SocketOpt()) {
         if (options != nullptr) {
             m_sockOptions = *options;
         }
+        // A receive buffer must hold a whole datagram
+        m_rxPool = std::make_shared<BufferPool>(std::max(m_sockOptions.m_rxSlabSize, MAX_PACKET_SIZE),
+                                                m_sockOptions.m_rxSlabCount, m_sockOptions.m_rxHugePages);
     }
 
     UdpSocket(const UdpSocket &) = delete;
@@ -136,6 +162,11 @@ public:
             return ret;
         }
 
+        // Remaining tuning options are best effort; report what the kernel granted
+        applyTuning(m_socketCore, m_fd, m_sockOptions, false);
+        m_effectiveOptions = m_sockOptions;
+        readTuning(m_socketCore, m_fd, false, m_effectiveOptions);
+
         sockaddr_in localAddr = {};
         localAddr.sin_family = AF_INET;
         localAddr.sin_addr.s_addr = htonl(INADDR_ANY);
@@ -200,9 +231,7 @@ public:
             return ret;
         }
 
-        m_thread = std::thread(&UdpSocket::ReceiveTask, this);
-        ret.m_success = true;
-        return ret;
+        return startReceiveTask();
     }
 
     /**
@@ -322,6 +351,11 @@ public:
             return ret;
         }
 
+        // Remaining tuning options are best effort; report what the kernel granted
+        applyTuning(m_socketCore, m_fd, m_sockOptions, false);
+        m_effectiveOptions = m_sockOptions;
+        readTuning(m_socketCore, m_fd, false, m_effectiveOptions);
+
         sockaddr_in localAddr {};
         localAddr.sin_family = AF_INET;
         inet_pton(AF_INET,m_sockOptions.m_listenAddr.c_str(),&localAddr.sin_addr.s_addr);
@@ -339,9 +373,7 @@ public:
             return ret;
         }
 
-        m_thread = std::thread(&UdpSocket::ReceiveTask, this);
-        ret.m_success = true;
-        return ret;
+        return startReceiveTask();
     }
 
     /**
@@ -355,40 +387,97 @@ public:
         SocketRet ret;
         // If destination addr/port specified
         if (m_sockaddr.sin_port != 0) {
+            auto start = sendStart();
             ssize_t numBytesSent = m_socketCore.SendTo(
                 m_fd, &msg[0], size, 0, reinterpret_cast<struct sockaddr *>(&m_sockaddr), sizeof(m_sockaddr));
-            if (numBytesSent < 0) {  // send failed
-                ret.m_success = false;
-#if defined(FMT_SUPPORT)
-                ret.m_msg = fmt::format("Error: sendto() failed: {}", errno);
-#else
-                std::array<char,MSG_SIZE> msg;
-               (void)snprintf(msg.data(),msg.size(),"Error: sendto() failed: %d",errno);
-                ret.m_msg = msg.data();
-#endif
-                return ret;
-            }
-            if (static_cast<size_t>(numBytesSent) < size) {  // not all bytes were sent
-                ret.m_success = false;
+            countSend(numBytesSent, size, start);
+            return sendResult(numBytesSent, size);
+        }
+        ret.m_success = true;
+        return ret;
+    }
+
+    /**
+     * @brief Send a datagram made of several parts (e.g. a header and a payload in separate buffers) with one
+     *          sendmsg() call, without copying them together first
+     *
+     * @param parts - the message parts
+     * @param count - number of parts, at most MAX_MSG_PARTS
+     * @param more - append the parts to a datagram completed by a later send (MSG_MORE) rather than sending it now
+     * @return SocketRet - indication that the datagram was sent successfully
+     */
+    SocketRet sendMsgv(const MsgPart *parts, size_t count, bool more = false) {
+        SocketRet ret;
+        if (count == 0 || count > MAX_MSG_PARTS) {
 #if defined(FMT_SUPPORT)
-                ret.m_msg = fmt::format("Only {} bytes of {} was sent to client", numBytesSent, size);
+            ret.m_msg = fmt::format("Error: {} message parts, expected 1 to {}", count, MAX_MSG_PARTS);
 #else
-                std::array<char,MSG_SIZE> msg;
-                (void)snprintf(msg.data(), msg.size(), "Only %ld bytes out of %lu was sent to client", numBytesSent, size);
-                ret.m_msg = msg.data();
+            std::array<char,MSG_SIZE> msg;
+            (void)snprintf(msg.data(),msg.size(),"Error: %zu message parts, expected 1 to %zu",count,MAX_MSG_PARTS);
+            ret.m_msg = msg.data();
 #endif
-                return ret;
-            }
+            ret.m_success = false;
+            return ret;
+        }
+        // If destination addr/port specified
+        if (m_sockaddr.sin_port != 0) {
+            auto start = sendStart();
+            ssize_t numBytesSent = sendParts(m_socketCore, m_fd, parts, count, more ? MORE_FLAGS : 0,
+                                             reinterpret_cast<struct sockaddr *>(&m_sockaddr), sizeof(m_sockaddr));
+            countSend(numBytesSent, partsSize(parts, count), start);
+            return sendResult(numBytesSent, partsSize(parts, count));
         }
         ret.m_success = true;
         return ret;
     }
 
+    /**
+     * @brief Get the socket options in effect after setup, as read back from the socket.  Options which can't be
+     *          read back report the requested value.
+     *
+     * @return SocketOpt - the effective socket options
+     */
+    SocketOpt getEffectiveOptions() const {
+        return m_effectiveOptions;
+    }
+
+    /**
+     * @brief Get the occupancy and hit/miss counters of the receive buffer pool
+     *
+     * @return BufferPoolStats - receive buffer pool counters
+     */
+    BufferPoolStats getReceivePoolStats() const {
+        return m_rxPool->stats();
+    }
+
+    /**
+     * @brief Get the socket's counters and latency histograms since construction.  Reading them doesn't stall
+     *          the receive thread.
+     *
+     * @return SocketMetrics - snapshot of the metrics
+     */
+    SocketMetrics getMetrics() const {
+        SocketMetrics metrics;
+        m_metrics.snapshot(metrics);
+        return metrics;
+    }
+
+    /**
+     * @brief Run a task on the receive thread, in order with the receive callbacks run there.  Tasks posted while
+     *          the socket isn't started, or still queued when it is shut down, are dropped.
+     *
+     * @param task - the task
+     */
+    void post(std::function<void()> task) {
+        m_poller.post(std::move(task));
+    }
+
     /**
      * @brief Shutdown the UDP socket
      */
     void finish() {
         m_stop.store(true);
+        m_poller.wake();
         if (m_thread.joinable()) {
             try {
                 m_thread.join();
@@ -396,6 +485,15 @@ public:
             catch (...) {
             }
         }
+        // Run the callbacks already dispatched to the worker pool.  A callback calling finish() leaves that to
+        // the destructor.
+        if (m_callbackPool && !m_callbackPool->inWorker()) {
+            m_callbackPool.reset();
+            m_strand.reset();
+        }
+        // A callback still running on the worker pool may pause or resume reading meanwhile
+        std::lock_guard<std::mutex> guard(m_pauseMutex);
+        m_poller.close();
         if (m_fd != INVALID_SOCKET) {
             m_socketCore.Close(m_fd);
         }
@@ -403,41 +501,201 @@ public:
     }
 
 private:
+    /**
+     * @brief Time a send starts, or none when send latencies aren't recorded
+     */
+    std::chrono::steady_clock::time_point sendStart() const {
+        return m_metrics.timing() ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point {};
+    }
+
+    /**
+     * @brief Count and trace a datagram send, and record its latency if it succeeded
+     *
+     * @param numBytesSent - value returned by the send call
+     * @param size - length of the datagram
+     * @param start - value of sendStart() before the call
+     */
+    void countSend(ssize_t numBytesSent, size_t size, std::chrono::steady_clock::time_point start) {
+        Tracing::trace(TraceEvent::Send, m_fd, numBytesSent);
+        m_metrics.add(Counter::SendCalls);
+        if (numBytesSent < 0) {
+            m_metrics.add(wouldBlock(errno) ? Counter::SendWouldBlock : Counter::SendErrors);
+            return;
+        }
+        m_metrics.add(Counter::BytesOut, static_cast<uint64_t>(numBytesSent));
+        if (static_cast<size_t>(numBytesSent) < size) {
+            m_metrics.add(Counter::SendPartial);
+            return;
+        }
+        m_metrics.add(Counter::MessagesOut);
+        if (start != std::chrono::steady_clock::time_point {}) {
+            m_metrics.recordSend(std::chrono::steady_clock::now() - start);
+        }
+    }
+
+    /**
+     * @brief Build the result of sending a datagram
+     *
+     * @param numBytesSent - value returned by the send call
+     * @param size - length of the datagram
+     * @return SocketRet - indication that the whole datagram was sent
+     */
+    static SocketRet sendResult(ssize_t numBytesSent, size_t size) {
+        SocketRet ret;
+        if (numBytesSent < 0) {  // send failed
+            ret.m_success = false;
+#if defined(FMT_SUPPORT)
+            ret.m_msg = fmt::format("Error: sendto() failed: {}", errno);
+#else
+            std::array<char,MSG_SIZE> msg;
+            (void)snprintf(msg.data(),msg.size(),"Error: sendto() failed: %d",errno);
+            ret.m_msg = msg.data();
+#endif
+            return ret;
+        }
+        if (static_cast<size_t>(numBytesSent) < size) {  // not all bytes were sent
+            ret.m_success = false;
+#if defined(FMT_SUPPORT)
+            ret.m_msg = fmt::format("Only {} bytes of {} was sent to client", numBytesSent, size);
+#else
+            std::array<char,MSG_SIZE> msg;
+            (void)snprintf(msg.data(), msg.size(), "Only %ld bytes out of %lu was sent to client", numBytesSent, size);
+            ret.m_msg = msg.data();
+#endif
+            return ret;
+        }
+        ret.m_success = true;
+        return ret;
+    }
+
+    /**
+     * @brief Register the socket with the event loop and start the receive thread
+     *
+     * @return SocketRet - indication that the event loop was set up successfully
+     */
+    SocketRet startReceiveTask() {
+        SocketRet ret;
+        // A receive buffer must hold a whole datagram, or io_uring truncates it
+        size_t bufferSize = std::max(m_sockOptions.m_uringBufferSize, MAX_PACKET_SIZE);
+        if (m_poller.open(m_sockOptions.m_eventBackend, m_sockOptions.m_uringBufferCount, bufferSize) != 0 ||
+            m_poller.add(m_fd, POLL_READ) != 0) {
+            ret.m_success = false;
+#if defined(FMT_SUPPORT)
+            ret.m_msg = fmt::format("Error: event loop setup failed errno {}", errno);
+#else
+            std::array<char,MSG_SIZE> msg;
+            (void)snprintf(msg.data(),msg.size(),"Error: event loop setup failed: %d",errno);
+            ret.m_msg = msg.data();
+#endif
+            return ret;
+        }
+        if (m_sockOptions.m_callbackThreads > 0 && !m_callbackPool) {
+            m_callbackPool = std::make_shared<ThreadPool>(m_sockOptions.m_callbackThreads);
+            m_strand = std::make_shared<Strand>(*m_callbackPool);
+        }
+        m_thread = std::thread(&UdpSocket::ReceiveTask, this);
+        ret.m_success = true;
+        return ret;
+    }
+
     /**
      * @brief Publish a UDP message received from a peer
      *
      * @param msg - pointer to the message data
      * @param msgSize - length of the message data
+     * @param chain - receive buffers holding the data, or nullptr if the data is in io_uring's buffers
      */
-    void publishUdpMsg(const char *msg, size_t msgSize) {
-        m_callback.onReceiveData(msg, msgSize);
+    void publishUdpMsg(const char *msg, size_t msgSize, const ReceiveChain *chain) {
+        auto share = [chain](const char *data, size_t size) {
+            return (chain != nullptr) ? chain->share(data, size) : SharedBuffer::copyOf(data, size);
+        };
+        m_metrics.add(Counter::MessagesIn);
+        m_metrics.add(Counter::BytesIn, msgSize);
+        if (!m_strand) {
+            runCallback(m_fd, msgSize, [&]() { deliverReceived(m_callback, 0, msg, msgSize, share); });
+            return;
+        }
+        // Counted before posting so the worker can't consume it first
+        bool pause = m_inbound.queued(msgSize);
+        // The receive buffer is reused once this returns, so the worker gets a counted reference to it
+        m_strand->post([this, fd = m_fd, buffer = share(msg, msgSize)]() {
+            runCallback(fd, buffer.size(), [&]() {
+                deliverReceived(m_callback, 0, buffer.data(), buffer.size(), [&buffer](const char *, size_t) { return buffer; });
+            });
+            if (m_inbound.consumed(buffer.size())) {
+                pauseInbound(false);
+            }
+        });
+        if (pause) {
+            pauseInbound(true);
+        }
+    }
+
+    /**
+     * @brief Stop reading while the callback workers are behind, or resume once they have caught up.  Called
+     *          when InboundBacklog::queued() or InboundBacklog::consumed() asks for it.  Datagrams arriving
+     *          meanwhile are held in the socket's receive buffer, and dropped once it is full.
+     *
+     * @param paused - true to stop reading
+     */
+    void pauseInbound(bool paused) {
+        std::lock_guard<std::mutex> guard(m_pauseMutex);
+        if (!(paused ? m_inbound.pause() : m_inbound.resume())) {
+            return;
+        }
+        if (m_fd != INVALID_SOCKET) {
+            m_poller.modify(m_fd, paused ? 0 : POLL_READ);
+        }
+    }
+
+    /**
+     * @brief Run a callback, timing and tracing it
+     *
+     * @param fd - the socket descriptor
+     * @param size - length of the datagram passed to the callback
+     * @param task - the callback invocation
+     */
+    template <class Task>
+    void runCallback(SOCKET fd, size_t size, const Task &task) {
+        Tracing::trace(TraceEvent::CallbackBegin, fd, static_cast<int64_t>(size));
+        m_metrics.timeCallback(task);
+        Tracing::trace(TraceEvent::CallbackEnd, fd, static_cast<int64_t>(size));
     }
 
     /**
      * @brief The receive thread for receiving data from UDP peer(s).
      */
     void ReceiveTask() {
-        constexpr int64_t USEC_DELAY = 500000;
+        constexpr int MSEC_DELAY = 500;
+        ReceiveChain chain(m_rxPool, MAX_PACKET_SIZE);
+        std::vector<PollEvent> events;
+        // finish() and post() wake the loop; without a wakeup descriptor it polls for them
+        int timeout = m_poller.canWake() ? -1 : MSEC_DELAY;
         while (!m_stop.load()) {
-            if (m_fd != INVALID_SOCKET) {
-                fd_set fds;
-                struct timeval delay {
-                    0, USEC_DELAY
-                };
-                FD_ZERO(&fds);
-                FD_SET(m_fd, &fds);
-                int selectRet = m_socketCore.Select(m_fd + 1, &fds, nullptr, nullptr, &delay);
-                if (selectRet <= 0) {  // select failed or timeout
-                    if (m_stop) {
-                        break;
+            int ready = m_poller.wait(events, timeout);
+            m_metrics.add(Counter::PollWaits);
+            m_poller.runPosted();
+            if (ready <= 0) {  // wait failed, timeout or wakeup
+                continue;
+            }
+            for (const auto &event : events) {
+                // Note: a receive returning 0 can happen for zero-length datagrams
+                if ((event.m_events & POLL_DATA) != 0) {
+                    // datagram received by io_uring
+                    m_metrics.add(Counter::RecvCalls);
+                    Tracing::trace(TraceEvent::Receive, m_fd, event.m_result < 0 ? -1 : event.m_result);
+                    if (event.m_result >= 0) {
+                        publishUdpMsg(event.m_data, static_cast<size_t>(event.m_result), nullptr);
                     }
-                } else if (FD_ISSET(m_fd, &fds)) {
-
-                    std::array<char, MAX_PACKET_SIZE> msg;
-                    ssize_t numOfBytesReceived = m_socketCore.Recv(m_fd, msg.data(), MAX_PACKET_SIZE, 0);
-                    // Note: recv() returning 0 can happen for zero-length datagrams
+                } else if ((event.m_events & (POLL_READ | POLL_ERROR)) != 0) {
+                    ssize_t numOfBytesReceived = chain.receive(m_socketCore, m_fd);
+                    m_metrics.add(Counter::RecvCalls);
+                    Tracing::trace(TraceEvent::Receive, m_fd, numOfBytesReceived);
                     if (numOfBytesReceived >= 0) {
-                        publishUdpMsg(msg.data(), static_cast<size_t>(numOfBytesReceived));
+                        // the chain is one buffer, so the datagram is contiguous
+                        MsgPart datagram;
+                        (void)chain.segments(static_cast<size_t>(numOfBytesReceived), &datagram);
+                        publishUdpMsg(datagram.m_data, datagram.m_size, &chain);
                     }
                 }
             }
@@ -474,6 +732,16 @@ private:
      */
     SocketOpt m_sockOptions;
 
+    /**
+     * @brief Socket options in effect on the socket, read back after setup
+     */
+    SocketOpt m_effectiveOptions;
+
+    /**
+     * @brief Counters and latency histograms, see getMetrics()
+     */
+    Metrics m_metrics;
+
     /**
      * @brief Interface for socket calls
      */
@@ -483,6 +751,33 @@ private:
      * @brief Helper for hostname resolution
      */
     AddrLookup<SocketImpl> m_addrLookup;
+
+    /**
+     * @brief Readiness notification for the receive thread
+     */
+    EventPoller<SocketImpl> m_poller;
+
+    /**
+     * @brief Received bytes waiting on m_strand for the callback workers
+     */
+    InboundBacklog m_inbound;
+
+    /**
+     * @brief Mutex serializing pausing and resuming reads for m_inbound
+     */
+    std::mutex m_pauseMutex;
+
+    /**
+     * @brief Receive buffers, each large enough for a datagram
+     */
+    std::shared_ptr<BufferPool> m_rxPool;
+
+    /**
+     * @brief Worker threads running the callbacks, and the strand keeping them in order, when
+     *        SocketOpt::m_callbackThreads > 0.  Declared last so pending callbacks run before other members go.
+     */
+    std::shared_ptr<ThreadPool> m_callbackPool;
+    std::shared_ptr<Strand> m_strand;
 };
 
 }  // Namespace sockets
\ No newline at end of file
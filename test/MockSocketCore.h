@@ -18,8 +18,16 @@
     #include <sys/socket.h>
     #include <netdb.h>
     #include <arpa/inet.h>
+    #include <netinet/in.h>
+    #include <netinet/tcp.h>
     #include <unistd.h>
 #endif
+#if defined(__linux__)
+    #include <sys/epoll.h>
+#endif
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
 
 #ifdef _WIN32
 using ssize_t = int;
@@ -45,14 +53,43 @@ public:
         return 0;
     }
 
+    int SetNonBlocking(int) {
+        return 0;
+    }
+
+    /**
+     * @brief No wakeup descriptor, so event loops poll with a timeout and no descriptors are added behind the
+     *        tests' expectations
+     */
+    int CreateWakeup(int &, int &) {
+        errno = ENOSYS;
+        return -1;
+    }
+
+    int SignalWakeup(int) {
+        return -1;
+    }
+
+    void DrainWakeup(int) {
+    }
+
+    void CloseWakeup(int, int) {
+    }
+
     MOCK_METHOD(int, Socket, (int domain, int type, int protocol), ());
 
     MOCK_METHOD(int, SetSockOpt, (int sockfd, int level, int optname, void *optval, socklen_t optlen), ());
 
+    MOCK_METHOD(int, GetSockOpt, (int sockfd, int level, int optname, void *optval, socklen_t *optlen), ());
+
     MOCK_METHOD(int, Bind, (int sockfd, const struct sockaddr *addr, socklen_t addrlen), ());
 
     MOCK_METHOD(int, Accept, (int sockfd, struct sockaddr *addr, socklen_t *addrlen), ());
 
+    MOCK_METHOD(int, AcceptNonBlocking, (int sockfd, struct sockaddr *addr, socklen_t *addrlen), ());
+
+    MOCK_METHOD(int, GetPeerName, (int sockfd, struct sockaddr *addr, socklen_t *addrlen), ());
+
     MOCK_METHOD(int, Listen, (int sockfd, int backlog), ());
 
     MOCK_METHOD(int, Connect, (int sockfd, const struct sockaddr *addr, socklen_t addrlen), ());
@@ -61,14 +98,45 @@ public:
 
     MOCK_METHOD(int, Select, (int nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds, struct timeval *timeout), ());
 
+#if defined(__linux__)
+    MOCK_METHOD(int, EpollCreate, (), ());
+
+    MOCK_METHOD(int, EpollCtl, (int epfd, int op, int fd, struct epoll_event *event), ());
+
+    MOCK_METHOD(int, EpollWait, (int epfd, struct epoll_event *events, int maxevents, int timeout), ());
+#endif
+
     MOCK_METHOD(ssize_t, Recv, (int sockfd, char *buf, size_t len, int flags), ());
 
+#if !defined(_WIN32)
+    MOCK_METHOD(ssize_t, RecvMsg, (int sockfd, struct msghdr *msg, int flags), ());
+
+    MOCK_METHOD(ssize_t, SendMsg, (int sockfd, const struct msghdr *msg, int flags), ());
+#endif
+
     MOCK_METHOD(ssize_t, SendTo,
         (int sockfd, const void *buf, size_t len, int flags, const struct sockaddr *dest_addr, socklen_t addrlen), ());
 
     MOCK_METHOD(ssize_t, Send, (int sockfd, const void *buf, size_t len, int flags), ());
 
+    MOCK_METHOD(ssize_t, SendFile, (int sockfd, int fileFd, off_t *offset, size_t count), ());
+
     MOCK_METHOD(int, GetAddrInfo, (const char *node, const char *service, const struct addrinfo *hints, struct addrinfo **res), ());
 
     MOCK_METHOD(void, FreeAddrInfo,(struct addrinfo *res), ());
-};
\ No newline at end of file
+};
+
+#if !defined(_WIN32)
+/**
+ * @brief Action for RecvMsg() copying size bytes of data into the message's buffers, in order
+ */
+ACTION_P2(FillMsgBuffers, data, size) {
+    size_t total = static_cast<size_t>(size);
+    size_t offset = 0;
+    for (size_t idx = 0; idx < arg1->msg_iovlen && offset < total; idx++) {
+        size_t part = std::min(arg1->msg_iov[idx].iov_len, total - offset);
+        memcpy(arg1->msg_iov[idx].iov_base, data + offset, part);
+        offset += part;
+    }
+}
+#endif
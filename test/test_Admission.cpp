@@ -0,0 +1,53 @@
+#include "Admission.h"
+#include "gtest/gtest.h"
+#include <chrono>
+
+using std::chrono::milliseconds;
+
+TEST(TokenBucket, burst_then_rate)
+{
+    auto start = std::chrono::steady_clock::now();
+    sockets::TokenBucket bucket(10.0, 3);
+    for (int idx = 0; idx < 3; idx++) {
+        EXPECT_TRUE(bucket.tryTake(start));
+    }
+    EXPECT_FALSE(bucket.tryTake(start));
+
+    // One token per 100 ms
+    EXPECT_FALSE(bucket.tryTake(start + milliseconds(50)));
+    EXPECT_TRUE(bucket.tryTake(start + milliseconds(110)));
+    EXPECT_FALSE(bucket.tryTake(start + milliseconds(120)));
+
+    // Refills up to the burst, no further
+    auto later = start + std::chrono::seconds(10);
+    for (int idx = 0; idx < 3; idx++) {
+        EXPECT_TRUE(bucket.tryTake(later));
+    }
+    EXPECT_FALSE(bucket.tryTake(later));
+}
+
+TEST(TokenBucket, zero_rate_is_unlimited)
+{
+    sockets::TokenBucket bucket(0.0, 1);
+    for (int idx = 0; idx < 1000; idx++) {
+        EXPECT_TRUE(bucket.tryTake());
+    }
+}
+
+TEST(LoopLag, smoothed_until_the_loop_idles)
+{
+    sockets::LoopLag lag;
+    EXPECT_EQ(0, lag.get().count());
+
+    // A loop with work waiting averages its passes
+    lag.record(milliseconds(80), milliseconds(0));
+    EXPECT_EQ(10000, lag.get().count());
+    for (int idx = 0; idx < 50; idx++) {
+        lag.record(milliseconds(80), milliseconds(0));
+    }
+    EXPECT_GT(lag.get().count(), 75000);
+
+    // Waiting longer than the lag means it has caught up
+    lag.record(milliseconds(1), milliseconds(100));
+    EXPECT_EQ(1000, lag.get().count());
+}
@@ -0,0 +1,173 @@
+#include "BufferPool.h"
+#include "MockSocketCore.h"
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+using ::testing::DoAll;
+using ::testing::Return;
+using ::testing::_;
+
+TEST(BufferPool, slabs_reused_most_recent_first)
+{
+    sockets::BufferPool pool(1000, 2, false);
+    EXPECT_EQ(1024u, pool.slabSize());
+    EXPECT_EQ(0u, pool.stats().m_capacity);
+
+    char *first = pool.acquire();
+    char *second = pool.acquire();
+    EXPECT_NE(first, second);
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(first) % 64);
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(second) % 64);
+    pool.release(first);
+    EXPECT_EQ(first, pool.acquire());
+    pool.release(first);
+    pool.release(second);
+
+    sockets::BufferPoolStats stats = pool.stats();
+    EXPECT_EQ(1024u, stats.m_slabSize);
+    EXPECT_EQ(2u, stats.m_capacity);
+    EXPECT_EQ(0u, stats.m_inUse);
+    EXPECT_EQ(3u, stats.m_hits);
+    EXPECT_EQ(0u, stats.m_misses);
+}
+
+TEST(BufferPool, exhausted_pool_falls_back_to_heap)
+{
+    sockets::BufferPool pool(64, 1, false);
+    char *pooled = pool.acquire();
+    char *extra = pool.acquire();
+    memset(extra, 'x', pool.slabSize());
+    EXPECT_EQ(2u, pool.stats().m_inUse);
+    EXPECT_EQ(1u, pool.stats().m_misses);
+
+    // The heap buffer is freed, not added to the pool
+    pool.release(extra);
+    pool.release(pooled);
+    EXPECT_EQ(pooled, pool.acquire());
+    char *overflow = pool.acquire();
+    EXPECT_NE(pooled, overflow);
+    EXPECT_EQ(2u, pool.stats().m_misses);
+    EXPECT_EQ(2u, pool.stats().m_hits);
+    pool.release(overflow);
+    pool.release(pooled);
+    EXPECT_EQ(0u, pool.stats().m_inUse);
+}
+
+TEST(BufferPool, huge_pages_requested)
+{
+    // Explicit huge pages are rarely reserved; either way the pool must work
+    sockets::BufferPool pool(16384, 4, true);
+    char *slab = pool.acquire();
+    memset(slab, 'h', pool.slabSize());
+    pool.release(slab);
+    EXPECT_EQ(4u, pool.stats().m_capacity);
+    EXPECT_EQ(0u, pool.stats().m_misses);
+}
+
+TEST(BufferPool, stats_summed)
+{
+    sockets::BufferPoolStats total;
+    sockets::BufferPoolStats loop;
+    loop.m_slabSize = 128;
+    loop.m_capacity = 4;
+    loop.m_inUse = 1;
+    loop.m_hits = 10;
+    loop.m_misses = 2;
+    total += loop;
+    total += loop;
+    EXPECT_EQ(128u, total.m_slabSize);
+    EXPECT_EQ(8u, total.m_capacity);
+    EXPECT_EQ(2u, total.m_inUse);
+    EXPECT_EQ(20u, total.m_hits);
+    EXPECT_EQ(4u, total.m_misses);
+}
+
+TEST(ReceiveChain, one_read_fills_chain_in_order)
+{
+    MockSocketCore core;
+    auto pool = std::make_shared<sockets::BufferPool>(64, 4, false);
+    std::string data(150, 'a');
+    data.replace(64, 64, 64, 'b');
+    data.replace(128, 22, 22, 'c');
+    {
+        sockets::ReceiveChain chain(pool, 256);
+        EXPECT_CALL(core, RecvMsg(3, _, _)).WillOnce(DoAll(FillMsgBuffers(data.data(), 150), Return(150)));
+        EXPECT_EQ(150, chain.receive(core, 3));
+        EXPECT_EQ(4u, pool->stats().m_inUse);
+
+        std::array<sockets::MsgPart, sockets::RX_CHAIN_MAX> segments;
+        ASSERT_EQ(3u, chain.segments(150, segments.data()));
+        std::string received;
+        for (size_t idx = 0; idx < 3; idx++) {
+            received.append(segments[idx].m_data, segments[idx].m_size);
+        }
+        EXPECT_EQ(64u, segments[0].m_size);
+        EXPECT_EQ(22u, segments[2].m_size);
+        EXPECT_EQ(data, received);
+    }
+    EXPECT_EQ(0u, pool->stats().m_inUse);
+}
+
+TEST(ReceiveChain, single_buffer_uses_recv)
+{
+    MockSocketCore core;
+    auto pool = std::make_shared<sockets::BufferPool>(1024, 1, false);
+    sockets::ReceiveChain chain(pool, 100);
+    char received[] = { "Received Data" };
+    EXPECT_CALL(core, Recv(3, _, 1024, _)).WillOnce(DoAll(::testing::SetArrayArgument<1>(received, received + 13),
+                                                          Return(13)));
+    EXPECT_EQ(13, chain.receive(core, 3));
+    sockets::MsgPart segment;
+    ASSERT_EQ(1u, chain.segments(13, &segment));
+    EXPECT_EQ(std::string("Received Data"), std::string(segment.m_data, segment.m_size));
+
+    // The buffers are kept for the next receive
+    EXPECT_CALL(core, Recv(3, _, 1024, _)).WillOnce(Return(0));
+    EXPECT_EQ(0, chain.receive(core, 3));
+    EXPECT_EQ(0u, chain.segments(0, &segment));
+    EXPECT_EQ(1u, pool->stats().m_hits);
+}
+
+TEST(ReceiveChain, shared_buffer_kept_until_released)
+{
+    MockSocketCore core;
+    auto pool = std::make_shared<sockets::BufferPool>(1024, 2, false);
+    char first[] = { "first message" };
+    char second[] = { "second message" };
+    sockets::SharedBuffer held;
+    {
+        sockets::ReceiveChain chain(pool, 100);
+        EXPECT_CALL(core, Recv(3, _, _, _))
+            .WillOnce(DoAll(::testing::SetArrayArgument<1>(first, first + 13), Return(13)))
+            .WillOnce(DoAll(::testing::SetArrayArgument<1>(second, second + 14), Return(14)));
+        EXPECT_EQ(13, chain.receive(core, 3));
+        sockets::MsgPart segment;
+        ASSERT_EQ(1u, chain.segments(13, &segment));
+
+        // The handle refers to the receive buffer itself
+        held = chain.share(segment.m_data + 6, 7);
+        EXPECT_EQ(segment.m_data + 6, held.data());
+
+        // A held buffer isn't overwritten; the next receive takes another one
+        EXPECT_EQ(14, chain.receive(core, 3));
+        ASSERT_EQ(1u, chain.segments(14, &segment));
+        EXPECT_NE(segment.m_data, held.data() - 6);
+        EXPECT_EQ(std::string("message"), std::string(held.data(), held.size()));
+        EXPECT_EQ(2u, pool->stats().m_inUse);
+
+        // Data outside the chain, e.g. a reassembled message, is copied
+        sockets::SharedBuffer copy = chain.share(second, 6);
+        EXPECT_NE(second, copy.data());
+        EXPECT_EQ(std::string("second"), std::string(copy.data(), copy.size()));
+    }
+    // The pool outlives the chain while the application holds a buffer
+    pool.reset();
+    EXPECT_EQ(std::string("message"), std::string(held.data(), held.size()));
+    held = sockets::SharedBuffer();
+}
@@ -0,0 +1,96 @@
+#include "ClientRegistry.h"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+TEST(ClientRegistry, insert_find_remove)
+{
+    sockets::ClientRegistry<std::string> registry;
+    sockets::ClientHandle handle = registry.insert(5, std::make_shared<std::string>("first"));
+    // The first connection on a descriptor gets a handle equal to the descriptor
+    EXPECT_EQ(5, handle);
+    EXPECT_EQ(1u, registry.size());
+
+    auto item = registry.find(handle);
+    ASSERT_TRUE(item != nullptr);
+    EXPECT_EQ("first", *item);
+
+    sockets::ClientHandle found = sockets::INVALID_CLIENT_HANDLE;
+    EXPECT_TRUE(registry.findFd(5, found) != nullptr);
+    EXPECT_EQ(handle, found);
+
+    // A descriptor can't be registered twice
+    EXPECT_EQ(sockets::INVALID_CLIENT_HANDLE, registry.insert(5, std::make_shared<std::string>("dup")));
+
+    EXPECT_TRUE(registry.remove(handle) != nullptr);
+    EXPECT_TRUE(registry.remove(handle) == nullptr);
+    EXPECT_TRUE(registry.find(handle) == nullptr);
+    EXPECT_TRUE(registry.findFd(5, found) == nullptr);
+    EXPECT_EQ(0u, registry.size());
+}
+
+TEST(ClientRegistry, stale_handle_after_reuse)
+{
+    sockets::ClientRegistry<std::string> registry;
+    sockets::ClientHandle oldHandle = registry.insert(7, std::make_shared<std::string>("old"));
+    EXPECT_TRUE(registry.remove(oldHandle) != nullptr);
+
+    sockets::ClientHandle newHandle = registry.insert(7, std::make_shared<std::string>("new"));
+    EXPECT_NE(oldHandle, newHandle);
+    EXPECT_TRUE(registry.find(oldHandle) == nullptr);
+    EXPECT_TRUE(registry.remove(oldHandle) == nullptr);
+    auto item = registry.find(newHandle);
+    ASSERT_TRUE(item != nullptr);
+    EXPECT_EQ("new", *item);
+}
+
+TEST(ClientRegistry, invalid_descriptors)
+{
+    sockets::ClientRegistry<std::string> registry;
+    EXPECT_EQ(sockets::INVALID_CLIENT_HANDLE, registry.insert(-1, std::make_shared<std::string>("bad")));
+    EXPECT_EQ(sockets::INVALID_CLIENT_HANDLE,
+        registry.insert(static_cast<int>(registry.CHUNK_SLOTS * registry.MAX_CHUNKS), std::make_shared<std::string>("bad")));
+    EXPECT_TRUE(registry.find(sockets::INVALID_CLIENT_HANDLE) == nullptr);
+    EXPECT_TRUE(registry.find(3) == nullptr);
+}
+
+TEST(ClientRegistry, snapshot_and_clear)
+{
+    sockets::ClientRegistry<std::string> registry;
+    registry.insert(3, std::make_shared<std::string>("a"));
+    registry.insert(2000, std::make_shared<std::string>("b"));
+    registry.insert(9, std::make_shared<std::string>("c"));
+
+    std::vector<std::shared_ptr<std::string>> items;
+    registry.snapshot(items);
+    EXPECT_EQ(3u, items.size());
+
+    size_t cleared = 0;
+    registry.clear([&cleared](std::shared_ptr<std::string> &) { cleared++; });
+    EXPECT_EQ(3u, cleared);
+    EXPECT_EQ(0u, registry.size());
+}
+
+TEST(ClientRegistry, concurrent_lookup_and_remove)
+{
+    sockets::ClientRegistry<std::string> registry;
+    std::atomic<sockets::ClientHandle> current { registry.insert(4, std::make_shared<std::string>("item")) };
+    std::atomic_bool stop { false };
+    std::thread reader([&]() {
+        while (!stop.load()) {
+            auto item = registry.find(current.load());
+            if (item) {
+                EXPECT_EQ("item", *item);
+            }
+        }
+    });
+    for (int idx = 0; idx < 10000; idx++) {
+        EXPECT_TRUE(registry.remove(current.load()) != nullptr);
+        current = registry.insert(4, std::make_shared<std::string>("item"));
+    }
+    stop = true;
+    reader.join();
+}
@@ -0,0 +1,378 @@
+#include "EventPoller.h"
+#include "MockSocketCore.h"
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using ::testing::Return;
+using ::testing::_;
+using ::testing::SetArgPointee;
+using ::testing::DoAll;
+
+TEST(EventPoller, select_reports_ready_fds)
+{
+    MockSocketCore core;
+    sockets::EventPoller<MockSocketCore> poller(core);
+    std::vector<sockets::PollEvent> events;
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(7,&fds);
+    EXPECT_CALL(core, Select(8,_,nullptr,nullptr,_)).WillOnce(DoAll(SetArgPointee<1>(fds),Return(1)));
+
+    EXPECT_EQ(0, poller.open(sockets::EventBackend::Select));
+    EXPECT_EQ(0, poller.add(4, sockets::POLL_READ));
+    EXPECT_EQ(0, poller.add(7, sockets::POLL_READ));
+    EXPECT_EQ(1, poller.wait(events, 10));
+    ASSERT_EQ(1u, events.size());
+    EXPECT_EQ(7, events[0].m_fd);
+    EXPECT_EQ(sockets::POLL_READ, events[0].m_events);
+}
+
+TEST(EventPoller, select_rejects_large_fd)
+{
+    MockSocketCore core;
+    sockets::EventPoller<MockSocketCore> poller(core);
+
+    EXPECT_EQ(0, poller.open(sockets::EventBackend::Select));
+    EXPECT_EQ(-1, poller.add(FD_SETSIZE, sockets::POLL_READ));
+    EXPECT_EQ(-1, poller.remove(5));
+}
+
+#if defined(__linux__)
+TEST(EventPoller, epoll_translates_events)
+{
+    MockSocketCore core;
+    sockets::EventPoller<MockSocketCore> poller(core);
+    std::vector<sockets::PollEvent> events;
+    std::array<struct epoll_event, 2> ready {};
+    ready[0].events = EPOLLIN;
+    ready[0].data.fd = 2000;
+    ready[1].events = EPOLLOUT | EPOLLHUP;
+    ready[1].data.fd = 2001;
+    EXPECT_CALL(core, EpollCreate()).WillOnce(Return(3));
+    EXPECT_CALL(core, EpollCtl(3,EPOLL_CTL_ADD,2000,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, EpollWait(3,_,_,10)).WillOnce(DoAll(::testing::SetArrayArgument<1>(ready.begin(),ready.end()),Return(2)));
+    EXPECT_CALL(core, Close(3)).WillOnce(Return(0));
+
+    EXPECT_EQ(0, poller.open(sockets::EventBackend::Epoll));
+    EXPECT_EQ(0, poller.add(2000, sockets::POLL_READ));
+    EXPECT_EQ(2, poller.wait(events, 10));
+    ASSERT_EQ(2u, events.size());
+    EXPECT_EQ(sockets::POLL_READ, events[0].m_events);
+    EXPECT_EQ(sockets::POLL_WRITE | sockets::POLL_ERROR, events[1].m_events);
+    poller.close();
+}
+#endif
+
+#if defined(SOCKETS_IO_URING)
+namespace {
+
+/**
+ * @brief Wait until an io_uring poller reports an event, retrying on timeout
+ */
+int waitFor(sockets::EventPoller<sockets::SocketCore> &poller, std::vector<sockets::PollEvent> &events)
+{
+    for (int attempt = 0; attempt < 20; attempt++) {
+        int count = poller.wait(events, 100);
+        if (count != 0) {
+            return count;
+        }
+    }
+    return 0;
+}
+
+}  // namespace
+
+TEST(EventPoller, uring_delivers_received_data)
+{
+    sockets::SocketCore core;
+    sockets::EventPoller<sockets::SocketCore> poller(core);
+    std::vector<sockets::PollEvent> events;
+    if (poller.open(sockets::EventBackend::IoUring, 8, 64) != 0) {
+        GTEST_SKIP() << "io_uring unavailable: errno " << errno;
+    }
+    int fds[2];
+    ASSERT_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    ASSERT_EQ(0, poller.add(fds[0], sockets::POLL_READ));
+
+    ASSERT_EQ(5, ::write(fds[1], "hello", 5));
+    ASSERT_EQ(1, waitFor(poller, events));
+    EXPECT_EQ(fds[0], events[0].m_fd);
+    EXPECT_EQ(sockets::POLL_DATA, events[0].m_events);
+    ASSERT_EQ(5, events[0].m_result);
+    EXPECT_EQ("hello", std::string(events[0].m_data, 5));
+
+    // More data than one buffer holds arrives in several completions from the same request
+    std::string big(200, 'x');
+    ASSERT_EQ(200, ::write(fds[1], big.data(), big.size()));
+    std::string received;
+    while (received.size() < big.size() && waitFor(poller, events) > 0) {
+        for (const auto &event : events) {
+            ASSERT_EQ(sockets::POLL_DATA, event.m_events);
+            ASSERT_GT(event.m_result, 0);
+            EXPECT_LE(event.m_result, 64);
+            received.append(event.m_data, static_cast<size_t>(event.m_result));
+        }
+    }
+    EXPECT_EQ(big, received);
+
+    // Paused reads leave data in the socket until read interest returns
+    ASSERT_EQ(0, poller.modify(fds[0], 0));
+    ASSERT_EQ(3, ::write(fds[1], "abc", 3));
+    EXPECT_EQ(0, poller.wait(events, 100));
+    ASSERT_EQ(0, poller.modify(fds[0], sockets::POLL_READ));
+    ASSERT_EQ(1, waitFor(poller, events));
+    EXPECT_EQ("abc", std::string(events[0].m_data, static_cast<size_t>(events[0].m_result)));
+
+    // Peer close
+    ::close(fds[1]);
+    ASSERT_EQ(1, waitFor(poller, events));
+    EXPECT_EQ(sockets::POLL_DATA, events[0].m_events);
+    EXPECT_EQ(0, events[0].m_result);
+    EXPECT_EQ(0, poller.remove(fds[0]));
+    EXPECT_EQ(-1, poller.remove(fds[0]));
+    ::close(fds[0]);
+    poller.close();
+}
+
+TEST(EventPoller, uring_accepts_and_reports_writable)
+{
+    sockets::SocketCore core;
+    sockets::EventPoller<sockets::SocketCore> poller(core);
+    std::vector<sockets::PollEvent> events;
+    if (poller.open(sockets::EventBackend::IoUring) != 0) {
+        GTEST_SKIP() << "io_uring unavailable: errno " << errno;
+    }
+    int listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GE(listenFd, 0);
+    struct sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(0, ::bind(listenFd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)));
+    ASSERT_EQ(0, ::listen(listenFd, 8));
+    socklen_t len = sizeof(addr);
+    ASSERT_EQ(0, ::getsockname(listenFd, reinterpret_cast<struct sockaddr *>(&addr), &len));
+    ASSERT_EQ(0, poller.addAcceptor(listenFd));
+
+    // One accept request serves several connections
+    std::vector<int> clients;
+    for (int idx = 0; idx < 3; idx++) {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        ASSERT_EQ(0, ::connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)));
+        clients.push_back(fd);
+    }
+    std::vector<int> accepted;
+    while (accepted.size() < clients.size() && waitFor(poller, events) > 0) {
+        for (const auto &event : events) {
+            ASSERT_EQ(listenFd, event.m_fd);
+            ASSERT_EQ(sockets::POLL_ACCEPT, event.m_events);
+            accepted.push_back(event.m_result);
+        }
+    }
+    ASSERT_EQ(3u, accepted.size());
+
+    ASSERT_EQ(0, poller.add(accepted[0], sockets::POLL_WRITE));
+    ASSERT_EQ(1, waitFor(poller, events));
+    EXPECT_EQ(accepted[0], events[0].m_fd);
+    EXPECT_EQ(sockets::POLL_WRITE, events[0].m_events);
+
+    poller.close();
+    for (int fd : accepted) {
+        ::close(fd);
+    }
+    for (int fd : clients) {
+        ::close(fd);
+    }
+    ::close(listenFd);
+}
+
+TEST(EventPoller, uring_zero_copy_send)
+{
+    sockets::SocketCore core;
+    sockets::EventPoller<sockets::SocketCore> poller(core);
+    std::vector<sockets::PollEvent> events;
+    if (poller.open(sockets::EventBackend::IoUring) != 0) {
+        GTEST_SKIP() << "io_uring unavailable: errno " << errno;
+    }
+    int listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GE(listenFd, 0);
+    struct sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(0, ::bind(listenFd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)));
+    ASSERT_EQ(0, ::listen(listenFd, 8));
+    socklen_t len = sizeof(addr);
+    ASSERT_EQ(0, ::getsockname(listenFd, reinterpret_cast<struct sockaddr *>(&addr), &len));
+    int sender = ::socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_EQ(0, ::connect(sender, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)));
+    int receiver = ::accept(listenFd, nullptr, nullptr);
+    ASSERT_GE(receiver, 0);
+
+    std::vector<char> region(256 * 1024, 'r');
+    ASSERT_EQ(0, poller.registerSendRegions({ sockets::SendRegion { region.data(), region.size() } }));
+    ASSERT_EQ(0, poller.add(sender, 0));
+
+    // Sends from a registered region and from ordinary memory each report the result, then the release
+    std::string plain(100000, 'p');
+    const std::vector<std::pair<const char *, size_t>> sends { { region.data(), region.size() },
+                                                              { plain.data(), plain.size() } };
+    uint32_t seq = 7;
+    for (const auto &send : sends) {
+        ASSERT_EQ(0, poller.sendZeroCopy(sender, send.first, send.second, seq));
+        std::string received;
+        std::vector<char> buffer(65536);
+        while (received.size() < send.second) {
+            ssize_t count = ::recv(receiver, buffer.data(), buffer.size(), 0);
+            ASSERT_GT(count, 0);
+            received.append(buffer.data(), static_cast<size_t>(count));
+        }
+        EXPECT_EQ(std::string(send.first, send.second), received);
+        bool sent = false;
+        bool released = false;
+        while (!released && waitFor(poller, events) > 0) {
+            for (const auto &event : events) {
+                EXPECT_EQ(sender, event.m_fd);
+                if (event.m_events == sockets::POLL_SENT) {
+                    EXPECT_EQ(static_cast<int>(send.second), event.m_result);
+                    sent = true;
+                } else {
+                    ASSERT_EQ(sockets::POLL_SEND_RELEASED, event.m_events);
+                    EXPECT_EQ(static_cast<int>(seq), event.m_result);
+                    EXPECT_TRUE(sent);
+                    released = true;
+                }
+            }
+        }
+        EXPECT_TRUE(released);
+        seq++;
+    }
+
+    // Removing the socket drops the registered file's reference, so closing it reaches the peer
+    ASSERT_EQ(0, poller.remove(sender));
+    ::close(sender);
+    char byte;
+    EXPECT_EQ(0, ::recv(receiver, &byte, 1, 0));
+
+    // Sockets without zero-copy support fail the send but still report the release
+    int fds[2];
+    ASSERT_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    ASSERT_EQ(0, poller.add(fds[0], 0));
+    ASSERT_EQ(0, poller.sendZeroCopy(fds[0], plain.data(), 10, 9));
+    std::vector<sockets::PollEvent> all;
+    while (all.size() < 2 && waitFor(poller, events) > 0) {
+        all.insert(all.end(), events.begin(), events.end());
+    }
+    ASSERT_EQ(2u, all.size());
+    EXPECT_EQ(sockets::POLL_SENT, all[0].m_events);
+    EXPECT_EQ(-EOPNOTSUPP, all[0].m_result);
+    EXPECT_EQ(sockets::POLL_SEND_RELEASED, all[1].m_events);
+    EXPECT_EQ(9, all[1].m_result);
+
+    poller.close();
+    ::close(fds[0]);
+    ::close(fds[1]);
+    ::close(receiver);
+    ::close(listenFd);
+}
+#endif
+
+TEST(EventPoller, zero_copy_send_needs_io_uring)
+{
+    MockSocketCore core;
+    sockets::EventPoller<MockSocketCore> poller(core);
+    ASSERT_EQ(0, poller.open(sockets::EventBackend::Select));
+    EXPECT_EQ(0, poller.registerSendRegions({ sockets::SendRegion { "abc", 3 } }));
+    EXPECT_EQ(-1, poller.sendZeroCopy(3, "abc", 3, 1));
+    EXPECT_EQ(ENOTSUP, errno);
+}
+
+namespace {
+
+/**
+ * @brief Check that a task posted from another thread interrupts a wait() without a timeout and runs on the
+ *        waiting thread
+ */
+void checkPostWakesWait(sockets::EventBackend backend)
+{
+    sockets::SocketCore core;
+    sockets::EventPoller<sockets::SocketCore> poller(core);
+    if (poller.open(backend) != 0) {
+        GTEST_SKIP() << "backend unavailable: errno " << errno;
+    }
+    ASSERT_TRUE(poller.canWake());
+    std::vector<sockets::PollEvent> events;
+    std::thread::id ranOn;
+    std::thread poster([&poller, &ranOn]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        poller.post([&ranOn]() { ranOn = std::this_thread::get_id(); });
+    });
+    auto start = std::chrono::steady_clock::now();
+    while (poller.runPosted() == 0) {
+        ASSERT_GE(poller.wait(events, -1), 0);
+        EXPECT_TRUE(events.empty());
+    }
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+    EXPECT_EQ(std::this_thread::get_id(), ranOn);
+    poster.join();
+
+    // Wakeups before the wait are kept, and coalesced
+    poller.wake();
+    poller.wake();
+    start = std::chrono::steady_clock::now();
+    EXPECT_EQ(0, poller.wait(events, 5000));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+    EXPECT_EQ(0, poller.wait(events, 10));
+}
+
+}  // namespace
+
+TEST(EventPoller, select_modify_wakes_wait)
+{
+    // A descriptor made writable by another thread while select() is waiting on the old sets is reported
+    sockets::SocketCore core;
+    sockets::EventPoller<sockets::SocketCore> poller(core);
+    ASSERT_EQ(0, poller.open(sockets::EventBackend::Select));
+    ASSERT_TRUE(poller.canWake());
+    int fds[2];
+    ASSERT_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    ASSERT_EQ(0, poller.add(fds[0], sockets::POLL_READ));
+    std::thread modifier([&poller, &fds]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        poller.modify(fds[0], sockets::POLL_READ | sockets::POLL_WRITE);
+    });
+    std::vector<sockets::PollEvent> events;
+    auto start = std::chrono::steady_clock::now();
+    while (events.empty() && std::chrono::steady_clock::now() - start < std::chrono::seconds(5)) {
+        ASSERT_GE(poller.wait(events, 5000), 0);
+    }
+    modifier.join();
+    ASSERT_EQ(1u, events.size());
+    EXPECT_EQ(fds[0], events[0].m_fd);
+    EXPECT_EQ(sockets::POLL_WRITE, events[0].m_events);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+    ::close(fds[0]);
+    ::close(fds[1]);
+    poller.close();
+}
+
+TEST(EventPoller, select_post_wakes_wait)
+{
+    checkPostWakesWait(sockets::EventBackend::Select);
+}
+
+#if defined(__linux__)
+TEST(EventPoller, epoll_post_wakes_wait)
+{
+    checkPostWakesWait(sockets::EventBackend::Epoll);
+}
+#endif
+
+#if defined(SOCKETS_IO_URING)
+TEST(EventPoller, uring_post_wakes_wait)
+{
+    checkPostWakesWait(sockets::EventBackend::IoUring);
+}
+#endif
@@ -0,0 +1,152 @@
+#include "Framing.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+#include <string>
+#include <vector>
+
+namespace {
+
+/**
+ * @brief Feed chunks to a Framer, collecting the delivered messages
+ */
+template <class Codec>
+struct FramerHarness {
+    explicit FramerHarness(size_t maxMessage = sockets::MAX_MESSAGE_SIZE) : m_framer(maxMessage) {}
+
+    sockets::FrameStatus feed(const std::string &chunk) {
+        m_chunk = chunk;
+        return m_framer.feed(m_chunk.data(), m_chunk.size(), [this](const char *data, size_t size) {
+            m_messages.emplace_back(data, size);
+            m_inChunk.push_back(data >= m_chunk.data() && data < m_chunk.data() + m_chunk.size());
+        });
+    }
+
+    sockets::Framer<Codec> m_framer;
+    std::string m_chunk;
+    std::vector<std::string> m_messages;
+    std::vector<bool> m_inChunk;
+};
+
+/**
+ * @brief Bytes CountingLineFraming has had to search
+ */
+size_t g_searched = 0;
+
+/**
+ * @brief LineFraming which counts the bytes it has to search
+ */
+struct CountingLineFraming {
+    sockets::FrameStatus parse(const char *data, size_t size, size_t maxMessage, sockets::Frame &frame) const {
+        g_searched += size - std::min(frame.m_scanned, size);
+        return m_codec.parse(data, size, maxMessage, frame);
+    }
+
+    sockets::LineFraming m_codec;
+};
+
+}  // namespace
+
+TEST(Framing, length_prefix_whole_messages_not_copied)
+{
+    FramerHarness<sockets::LengthPrefixFraming<2>> harness;
+    EXPECT_EQ(sockets::FrameStatus::Complete, harness.feed(std::string("\x00\x03" "abc" "\x00\x02" "de", 9)));
+    ASSERT_EQ(2u, harness.m_messages.size());
+    EXPECT_EQ("abc", harness.m_messages[0]);
+    EXPECT_EQ("de", harness.m_messages[1]);
+    EXPECT_TRUE(harness.m_inChunk[0]);
+    EXPECT_TRUE(harness.m_inChunk[1]);
+    EXPECT_EQ(0u, harness.m_framer.pending());
+}
+
+TEST(Framing, length_prefix_split_header_and_body)
+{
+    FramerHarness<sockets::LengthPrefixFraming<4, sockets::ByteOrder::LittleEndian>> harness;
+    EXPECT_EQ(sockets::FrameStatus::Complete, harness.feed(std::string("\x05\x00", 2)));
+    EXPECT_EQ(sockets::FrameStatus::Complete, harness.feed(std::string("\x00\x00" "he", 4)));
+    EXPECT_TRUE(harness.m_messages.empty());
+    // Completes the split message and carries a whole one which is delivered in place
+    EXPECT_EQ(sockets::FrameStatus::Complete, harness.feed(std::string("llo" "\x01\x00\x00\x00" "!", 8)));
+    ASSERT_EQ(2u, harness.m_messages.size());
+    EXPECT_EQ("hello", harness.m_messages[0]);
+    EXPECT_FALSE(harness.m_inChunk[0]);
+    EXPECT_EQ("!", harness.m_messages[1]);
+    EXPECT_TRUE(harness.m_inChunk[1]);
+}
+
+TEST(Framing, length_prefix_header_encoding)
+{
+    auto big = sockets::LengthPrefixFraming<2>::header(0x0102);
+    EXPECT_EQ(0x01, big[0]);
+    EXPECT_EQ(0x02, big[1]);
+    auto little = sockets::LengthPrefixFraming<8, sockets::ByteOrder::LittleEndian>::header(0x0102);
+    EXPECT_EQ(0x02, little[0]);
+    EXPECT_EQ(0x01, little[1]);
+    EXPECT_EQ(0x00, little[7]);
+}
+
+TEST(Framing, length_prefix_too_long)
+{
+    FramerHarness<sockets::LengthPrefixFraming<1>> harness(4);
+    EXPECT_EQ(sockets::FrameStatus::Invalid, harness.feed(std::string("\x05" "hello", 6)));
+}
+
+TEST(Framing, fixed_size)
+{
+    FramerHarness<sockets::FixedFraming<3>> harness;
+    EXPECT_EQ(sockets::FrameStatus::Complete, harness.feed("abcd"));
+    EXPECT_EQ(sockets::FrameStatus::Complete, harness.feed("efghi"));
+    ASSERT_EQ(3u, harness.m_messages.size());
+    EXPECT_EQ("abc", harness.m_messages[0]);
+    EXPECT_EQ("def", harness.m_messages[1]);
+    EXPECT_EQ("ghi", harness.m_messages[2]);
+    EXPECT_TRUE(harness.m_inChunk[2]);
+}
+
+TEST(Framing, delimiter)
+{
+    FramerHarness<sockets::LineFraming> harness;
+    EXPECT_EQ(sockets::FrameStatus::Complete, harness.feed("one\ntw"));
+    EXPECT_EQ(sockets::FrameStatus::Complete, harness.feed("o\n\nthree\nfo"));
+    ASSERT_EQ(4u, harness.m_messages.size());
+    EXPECT_EQ("one", harness.m_messages[0]);
+    EXPECT_EQ("two", harness.m_messages[1]);
+    EXPECT_EQ("", harness.m_messages[2]);
+    EXPECT_EQ("three", harness.m_messages[3]);
+    EXPECT_TRUE(harness.m_inChunk[3]);
+    EXPECT_EQ(2u, harness.m_framer.pending());
+}
+
+TEST(Framing, delimiter_too_long)
+{
+    FramerHarness<sockets::DelimiterFraming<';'>> harness(4);
+    EXPECT_EQ(sockets::FrameStatus::Complete, harness.feed("abc"));
+    EXPECT_EQ(sockets::FrameStatus::Invalid, harness.feed("def"));
+}
+
+TEST(Framing, delimiter_long_line_searched_once)
+{
+    constexpr size_t CHUNK = 16;
+    constexpr size_t CHUNKS = 4096;
+    FramerHarness<CountingLineFraming> harness;
+    g_searched = 0;
+    std::string line(CHUNK * CHUNKS, 'x');
+    for (size_t idx = 0; idx < CHUNKS; idx++) {
+        EXPECT_EQ(sockets::FrameStatus::Complete, harness.feed(line.substr(idx * CHUNK, CHUNK)));
+    }
+    EXPECT_TRUE(harness.m_messages.empty());
+    EXPECT_EQ(sockets::FrameStatus::Complete, harness.feed("\nab\n"));
+    ASSERT_EQ(2u, harness.m_messages.size());
+    EXPECT_EQ(line, harness.m_messages[0]);
+    EXPECT_EQ("ab", harness.m_messages[1]);
+    // Each byte is searched about once, rather than once for every chunk after it
+    EXPECT_LT(g_searched, 2 * line.size());
+}
+
+TEST(Framing, raw)
+{
+    FramerHarness<sockets::RawFraming> harness;
+    EXPECT_EQ(sockets::FrameStatus::Complete, harness.feed("chunk"));
+    ASSERT_EQ(1u, harness.m_messages.size());
+    EXPECT_EQ("chunk", harness.m_messages[0]);
+    EXPECT_TRUE(harness.m_inChunk[0]);
+}
@@ -0,0 +1,107 @@
+#include "Metrics.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+using sockets::Counter;
+using sockets::LatencyHistogram;
+
+TEST(LatencyHistogram, buckets_within_one_sixteenth)
+{
+    // Small values are exact
+    for (uint64_t value = 0; value < 32; value++) {
+        size_t bucket = LatencyHistogram::bucketOf(value);
+        EXPECT_EQ(value, LatencyHistogram::bucketLow(bucket));
+        EXPECT_EQ(value, LatencyHistogram::bucketHigh(bucket));
+    }
+    for (uint64_t value = 32; value < (uint64_t(1) << 40); value = value * 5 / 4 + 1) {
+        size_t bucket = LatencyHistogram::bucketOf(value);
+        uint64_t low = LatencyHistogram::bucketLow(bucket);
+        uint64_t high = LatencyHistogram::bucketHigh(bucket);
+        EXPECT_LE(low, value);
+        EXPECT_GE(high, value);
+        EXPECT_LE(high - low, low / LatencyHistogram::SUB_BUCKETS);
+        // Buckets are contiguous
+        EXPECT_EQ(high + 1, LatencyHistogram::bucketLow(bucket + 1));
+    }
+    EXPECT_EQ(LatencyHistogram::BUCKETS - 1, LatencyHistogram::bucketOf(UINT64_MAX));
+}
+
+TEST(LatencyHistogram, percentiles_and_merge)
+{
+    LatencyHistogram first;
+    EXPECT_EQ(0u, first.percentile(50.0));
+    for (uint64_t value = 1; value <= 100; value++) {
+        first.record(value * 1000);
+    }
+    LatencyHistogram second;
+    second.record(1000000, 100);
+
+    EXPECT_EQ(100u, first.count());
+    EXPECT_DOUBLE_EQ(50500.0, first.mean());
+    uint64_t median = first.percentile(50.0);
+    EXPECT_GE(median, 50000u);
+    EXPECT_LE(median, 50000u + 50000u / 16);
+    EXPECT_EQ(100000u, first.percentile(100.0));
+
+    first += second;
+    EXPECT_EQ(200u, first.count());
+    EXPECT_EQ(1000000u, first.max());
+    EXPECT_LE(first.percentile(50.0), 100000u + 100000u / 16);
+    EXPECT_EQ(1000000u, first.percentile(99.0));
+}
+
+TEST(Metrics, threads_counted_in_total)
+{
+    constexpr size_t THREADS = 4;
+    constexpr uint64_t COUNT = 10000;
+    sockets::Metrics metrics(true, 2);
+    std::vector<std::thread> threads;
+    for (size_t idx = 0; idx < THREADS; idx++) {
+        threads.emplace_back([&metrics]() {
+            for (uint64_t count = 0; count < COUNT; count++) {
+                metrics.add(Counter::BytesIn, 2);
+                metrics.add(Counter::MessagesIn);
+                metrics.recordSend(std::chrono::microseconds(5));
+            }
+        });
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    sockets::SocketMetrics snapshot;
+    metrics.snapshot(snapshot);
+    EXPECT_EQ(THREADS * COUNT * 2, snapshot[Counter::BytesIn]);
+    EXPECT_EQ(THREADS * COUNT, snapshot[Counter::MessagesIn]);
+    EXPECT_EQ(THREADS * COUNT, snapshot.m_sendLatency.count());
+    EXPECT_EQ(5000u, snapshot.m_sendLatency.max());
+    EXPECT_EQ(0u, snapshot.m_callbackTime.count());
+}
+
+TEST(Metrics, connection_adds_to_total)
+{
+    sockets::Metrics total(false);
+    sockets::ConnectionMetrics first(&total);
+    sockets::ConnectionMetrics second(&total);
+    first.add(Counter::QueuedBytes, 100);
+    second.add(Counter::QueuedBytes, 50);
+    first.add(Counter::QueuedBytes, 0 - uint64_t(100));
+    first.add(Counter::DisconnectPeer);
+
+    sockets::SocketMetrics snapshot;
+    first.snapshot(snapshot);
+    EXPECT_EQ(0u, snapshot[Counter::QueuedBytes]);
+    EXPECT_EQ(1u, snapshot[Counter::DisconnectPeer]);
+    snapshot = sockets::SocketMetrics();
+    total.snapshot(snapshot);
+    EXPECT_EQ(50u, snapshot[Counter::QueuedBytes]);
+    EXPECT_EQ(1u, snapshot[Counter::DisconnectPeer]);
+
+    // Histograms disabled: callbacks still run, untimed
+    bool ran = false;
+    total.timeCallback([&ran]() { ran = true; });
+    EXPECT_TRUE(ran);
+    EXPECT_FALSE(total.timing());
+}
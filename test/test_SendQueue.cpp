@@ -0,0 +1,430 @@
+#include "SendQueue.h"
+#include "MockSocketCore.h"
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include <cstdio>
+#include <cstring>
+#include <poll.h>
+#include <string>
+#include <vector>
+
+using ::testing::InSequence;
+using ::testing::Return;
+using ::testing::_;
+
+namespace {
+
+/**
+ * @brief Stand-in for EventPoller recording the zero-copy sends submitted
+ */
+struct FakePoller {
+    struct Send {
+        int m_fd;
+        const char *m_data;
+        size_t m_size;
+        uint32_t m_seq;
+    };
+
+    int sendZeroCopy(int fd, const char *data, size_t size, uint32_t seq) {
+        if (m_fail) {
+            return -1;
+        }
+        m_sends.push_back(Send { fd, data, size, seq });
+        return 0;
+    }
+
+    std::vector<Send> m_sends;
+    bool m_fail = false;
+};
+
+}  // namespace
+
+TEST(SendQueue, zero_copy_message_held_until_released)
+{
+    MockSocketCore core;
+    FakePoller poller;
+    sockets::SendQueue queue;
+    sockets::SharedBuffer big = sockets::SharedBuffer::copyOf(std::vector<char>(100, 'z').data(), 100);
+    queue.append("abc", 3);
+    queue.append(big, 0, true);
+    EXPECT_EQ(103u, queue.size());
+
+    // Copied data ahead of the zero-copy message goes first
+    EXPECT_CALL(core, Send(3, _, 3, _)).WillOnce(Return(3));
+    EXPECT_EQ(3, queue.flush(core, 3, poller));
+    ASSERT_EQ(1u, poller.m_sends.size());
+    EXPECT_EQ(big.data(), poller.m_sends[0].m_data);
+    EXPECT_EQ(100u, poller.m_sends[0].m_size);
+    EXPECT_FALSE(queue.writePending());
+
+    // Only one zero-copy send is outstanding at a time
+    queue.append(big, 0, true);
+    EXPECT_EQ(0, queue.flush(core, 3, poller));
+    EXPECT_EQ(1u, poller.m_sends.size());
+
+    EXPECT_EQ(100u, queue.zeroCopySent(100));
+    EXPECT_EQ(100u, queue.size());
+    std::vector<sockets::SharedBuffer> completed;
+    queue.takeCompleted(completed);
+    EXPECT_TRUE(completed.empty());
+    EXPECT_EQ(3L, big.useCount());
+
+    // The queued message may go out now
+    EXPECT_TRUE(queue.zeroCopyReleased(poller.m_sends[0].m_seq));
+    queue.takeCompleted(completed);
+    ASSERT_EQ(1u, completed.size());
+    EXPECT_EQ(big.data(), completed[0].data());
+
+    // The next message goes out once the first has been sent
+    EXPECT_EQ(0, queue.flush(core, 3, poller));
+    ASSERT_EQ(2u, poller.m_sends.size());
+    EXPECT_NE(poller.m_sends[0].m_seq, poller.m_sends[1].m_seq);
+}
+
+TEST(SendQueue, zero_copy_partial_send_resubmits_the_rest)
+{
+    MockSocketCore core;
+    FakePoller poller;
+    sockets::SendQueue queue;
+    sockets::SharedBuffer big = sockets::SharedBuffer::copyOf(std::vector<char>(100, 'z').data(), 100);
+    queue.append(big, 0, true);
+    EXPECT_EQ(0, queue.flush(core, 3, poller));
+    EXPECT_EQ(40u, queue.zeroCopySent(40));
+    EXPECT_EQ(0, queue.flush(core, 3, poller));
+    ASSERT_EQ(2u, poller.m_sends.size());
+    EXPECT_EQ(big.data() + 40, poller.m_sends[1].m_data);
+    EXPECT_EQ(60u, poller.m_sends[1].m_size);
+    EXPECT_EQ(60u, queue.zeroCopySent(60));
+
+    // The message is complete once every send of it has been released, in any order
+    std::vector<sockets::SharedBuffer> completed;
+    EXPECT_FALSE(queue.zeroCopyReleased(poller.m_sends[1].m_seq));
+    queue.takeCompleted(completed);
+    EXPECT_TRUE(completed.empty());
+    EXPECT_FALSE(queue.zeroCopyReleased(poller.m_sends[0].m_seq));
+    queue.takeCompleted(completed);
+    EXPECT_EQ(1u, completed.size());
+}
+
+TEST(SendQueue, zero_copy_unsupported_falls_back_to_copying)
+{
+    MockSocketCore core;
+    FakePoller poller;
+    sockets::SendQueue queue;
+    sockets::SharedBuffer big = sockets::SharedBuffer::copyOf(std::vector<char>(100, 'z').data(), 100);
+    queue.append(big, 0, true);
+    EXPECT_EQ(0, queue.flush(core, 3, poller));
+    EXPECT_EQ(0u, queue.zeroCopySent(-EOPNOTSUPP));
+    EXPECT_TRUE(queue.writePending());
+
+    EXPECT_CALL(core, Send(3, big.data(), 100, _)).WillOnce(Return(100));
+    EXPECT_EQ(100, queue.flush(core, 3, poller));
+    EXPECT_TRUE(queue.empty());
+    std::vector<sockets::SharedBuffer> completed;
+    queue.takeCompleted(completed);
+    EXPECT_TRUE(completed.empty());
+    EXPECT_FALSE(queue.zeroCopyReleased(poller.m_sends[0].m_seq));
+    queue.takeCompleted(completed);
+    EXPECT_EQ(1u, completed.size());
+
+    // Later messages are copied straight away
+    queue.append(big, 0, true);
+    EXPECT_TRUE(queue.writePending());
+    EXPECT_EQ(1u, poller.m_sends.size());
+}
+
+TEST(SendQueue, zero_copy_submit_failure_copies_the_message)
+{
+    MockSocketCore core;
+    FakePoller poller;
+    poller.m_fail = true;
+    sockets::SendQueue queue;
+    sockets::SharedBuffer big = sockets::SharedBuffer::copyOf(std::vector<char>(100, 'z').data(), 100);
+    queue.append(big, 0, true);
+    EXPECT_CALL(core, Send(3, big.data(), 100, _)).WillOnce(Return(60));
+    EXPECT_EQ(60, queue.flush(core, 3, poller));
+    EXPECT_EQ(40u, queue.size());
+    EXPECT_TRUE(queue.writePending());
+}
+
+TEST(SendQueue, unsent_parts_gathered)
+{
+    MockSocketCore core;
+    sockets::SendQueue queue;
+    sockets::MsgPart parts[] = { { "head", 4 }, { "", 0 }, { "payload", 7 } };
+    queue.append(parts, 3, 6);
+    queue.append(parts, 3, 11);
+    EXPECT_EQ(5u, queue.size());
+    std::string sent;
+    EXPECT_CALL(core, Send(3, _, 5, _)).WillOnce([&sent](int, const void *buf, size_t len, int) {
+        sent.assign(static_cast<const char *>(buf), len);
+        return ssize_t(len);
+    });
+    EXPECT_EQ(5, queue.flush(core, 3));
+    EXPECT_EQ("yload", sent);
+}
+
+TEST(SendQueue, parts_sent_in_one_call)
+{
+    sockets::SocketCore core;
+    int fds[2];
+    ASSERT_EQ(0, ::socketpair(AF_UNIX, SOCK_DGRAM, 0, fds));
+    sockets::MsgPart parts[] = { { "head", 4 }, { "payload", 7 } };
+    EXPECT_EQ(11, sockets::sendParts(core, fds[0], parts, 2, 0));
+    std::array<char, 64> buffer;
+    ASSERT_EQ(11, ::recv(fds[1], buffer.data(), buffer.size(), 0));
+    EXPECT_EQ("headpayload", std::string(buffer.data(), 11));
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+TEST(SendQueue, file_range_sent_in_order)
+{
+    MockSocketCore core;
+    FakePoller poller;
+    sockets::SendQueue queue;
+    FILE *file = tmpfile();
+    ASSERT_NE(nullptr, file);
+    queue.append("abc", 3);
+    ASSERT_TRUE(queue.appendFile(fileno(file), 10, 100));
+    queue.append("xyz", 3);
+    // File ranges aren't buffered, so they don't count towards the queue's size
+    EXPECT_EQ(6u, queue.size());
+
+    {
+        InSequence seq;
+        EXPECT_CALL(core, Send(3, _, 3, _)).WillOnce(Return(3));
+        EXPECT_CALL(core, SendFile(3, _, ::testing::Pointee(10), 100))
+            .WillOnce([](int, int, off_t *offset, size_t) {
+                *offset += 60;
+                return ssize_t(60);
+            });
+        EXPECT_CALL(core, SendFile(3, _, ::testing::Pointee(70), 40)).WillOnce(Return(40));
+        EXPECT_CALL(core, Send(3, _, 3, _)).WillOnce(Return(3));
+    }
+    EXPECT_EQ(63, queue.flush(core, 3, poller));
+    EXPECT_EQ(3u, queue.size());
+    EXPECT_TRUE(queue.writePending());
+    EXPECT_EQ(43, queue.flush(core, 3, poller));
+    EXPECT_TRUE(queue.empty());
+    fclose(file);
+}
+
+TEST(SendQueue, file_shorter_than_range_fails)
+{
+    MockSocketCore core;
+    FakePoller poller;
+    sockets::SendQueue queue;
+    FILE *file = tmpfile();
+    ASSERT_NE(nullptr, file);
+    ASSERT_TRUE(queue.appendFile(fileno(file), 0, 100));
+    EXPECT_CALL(core, SendFile(3, _, _, 100)).WillOnce(Return(0));
+    EXPECT_EQ(-1, queue.flush(core, 3, poller));
+    EXPECT_EQ(EIO, errno);
+    fclose(file);
+}
+
+TEST(SendQueue, file_sent_after_caller_closes_it)
+{
+    sockets::SocketCore core;
+    FakePoller poller;
+    sockets::SendQueue queue;
+    std::string contents(100000, 'f');
+    for (size_t idx = 0; idx < contents.size(); idx += 7) {
+        contents[idx] = static_cast<char>('a' + idx % 26);
+    }
+    FILE *file = tmpfile();
+    ASSERT_NE(nullptr, file);
+    ASSERT_EQ(contents.size(), fwrite(contents.data(), 1, contents.size(), file));
+    ASSERT_EQ(0, fflush(file));
+    int fds[2];
+    ASSERT_EQ(0, ::socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+    ASSERT_EQ(0, core.SetNonBlocking(fds[0]));
+
+    ASSERT_TRUE(queue.appendFile(fileno(file), 1000, 50000));
+    fclose(file);
+    std::string received;
+    std::vector<char> buffer(65536);
+    while (!queue.empty()) {
+        ASSERT_GE(queue.flush(core, fds[0], poller), 0);
+        ssize_t got = ::recv(fds[1], buffer.data(), buffer.size(), 0);
+        ASSERT_GT(got, 0);
+        received.append(buffer.data(), static_cast<size_t>(got));
+    }
+    while (received.size() < 50000) {
+        ssize_t got = ::recv(fds[1], buffer.data(), buffer.size(), 0);
+        ASSERT_GT(got, 0);
+        received.append(buffer.data(), static_cast<size_t>(got));
+    }
+    EXPECT_EQ(contents.substr(1000, 50000), received);
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+#if defined(SOCKETS_MSG_ZEROCOPY)
+
+namespace {
+
+/**
+ * @brief Build a RecvMsg() action delivering one MSG_ZEROCOPY release notification
+ */
+auto notification(uint32_t first, uint32_t last, bool copied) {
+    return [first, last, copied](int, struct msghdr *msg, int) -> ssize_t {
+        struct sock_extended_err err;
+        memset(&err, 0, sizeof(err));
+        err.ee_origin = SO_EE_ORIGIN_ZEROCOPY;
+        err.ee_code = copied ? SO_EE_CODE_ZEROCOPY_COPIED : 0;
+        err.ee_info = first;
+        err.ee_data = last;
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg);
+        cmsg->cmsg_level = SOL_IP;
+        cmsg->cmsg_type = IP_RECVERR;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(err));
+        memcpy(CMSG_DATA(cmsg), &err, sizeof(err));
+        msg->msg_controllen = CMSG_SPACE(sizeof(err));
+        return 0;
+    };
+}
+
+ssize_t queueEmpty(int, struct msghdr *, int) {
+    errno = EAGAIN;
+    return -1;
+}
+
+}  // namespace
+
+TEST(SendQueue, msg_zerocopy_holds_buffer_until_notified)
+{
+    MockSocketCore core;
+    FakePoller poller;
+    sockets::SendQueue queue;
+    queue.useMsgZeroCopy();
+    sockets::SharedBuffer big = sockets::SharedBuffer::copyOf(std::vector<char>(100, 'z').data(), 100);
+    queue.append(big, 0, true);
+    EXPECT_TRUE(queue.writePending());
+
+    EXPECT_CALL(core, Send(3, big.data(), 100, sockets::SEND_FLAGS | MSG_ZEROCOPY)).WillOnce(Return(60));
+    EXPECT_EQ(60, queue.flush(core, 3, poller));
+    EXPECT_CALL(core, Send(3, big.data() + 60, 40, sockets::SEND_FLAGS | MSG_ZEROCOPY)).WillOnce(Return(40));
+    EXPECT_EQ(40, queue.flush(core, 3, poller));
+    EXPECT_TRUE(poller.m_sends.empty());
+    EXPECT_TRUE(queue.empty());
+    EXPECT_TRUE(queue.zeroCopyHeld());
+    std::vector<sockets::SharedBuffer> completed;
+    queue.takeCompleted(completed);
+    EXPECT_TRUE(completed.empty());
+
+    // Both sends are released by one coalesced notification
+    EXPECT_CALL(core, RecvMsg(3, _, MSG_ERRQUEUE)).WillOnce(notification(0, 1, false)).WillOnce(queueEmpty);
+    EXPECT_TRUE(queue.readNotifications(core, 3));
+    EXPECT_FALSE(queue.zeroCopyHeld());
+    queue.takeCompleted(completed);
+    ASSERT_EQ(1u, completed.size());
+    EXPECT_EQ(big.data(), completed[0].data());
+}
+
+TEST(SendQueue, msg_zerocopy_stops_when_kernel_copied)
+{
+    MockSocketCore core;
+    FakePoller poller;
+    sockets::SendQueue queue;
+    queue.useMsgZeroCopy();
+    sockets::SharedBuffer big = sockets::SharedBuffer::copyOf(std::vector<char>(100, 'z').data(), 100);
+    queue.append(big, 0, true);
+    EXPECT_CALL(core, Send(3, big.data(), 100, sockets::SEND_FLAGS | MSG_ZEROCOPY)).WillOnce(Return(100));
+    EXPECT_EQ(100, queue.flush(core, 3, poller));
+    EXPECT_CALL(core, RecvMsg(3, _, MSG_ERRQUEUE)).WillOnce(notification(0, 0, true)).WillOnce(queueEmpty);
+    EXPECT_TRUE(queue.readNotifications(core, 3));
+
+    queue.append(big, 0, true);
+    EXPECT_CALL(core, Send(3, big.data(), 100, sockets::SEND_FLAGS)).WillOnce(Return(100));
+    EXPECT_EQ(100, queue.flush(core, 3, poller));
+    EXPECT_FALSE(queue.zeroCopyHeld());
+    std::vector<sockets::SharedBuffer> completed;
+    queue.takeCompleted(completed);
+    EXPECT_EQ(2u, completed.size());
+}
+
+TEST(SendQueue, msg_zerocopy_copies_when_out_of_option_memory)
+{
+    MockSocketCore core;
+    FakePoller poller;
+    sockets::SendQueue queue;
+    queue.useMsgZeroCopy();
+    sockets::SharedBuffer big = sockets::SharedBuffer::copyOf(std::vector<char>(100, 'z').data(), 100);
+    queue.append(big, 0, true);
+    {
+        InSequence seq;
+        EXPECT_CALL(core, Send(3, big.data(), 100, sockets::SEND_FLAGS | MSG_ZEROCOPY))
+            .WillOnce([](int, const void *, size_t, int) {
+                errno = ENOBUFS;
+                return ssize_t(-1);
+            });
+        EXPECT_CALL(core, Send(3, big.data(), 100, sockets::SEND_FLAGS)).WillOnce(Return(100));
+    }
+    EXPECT_EQ(100, queue.flush(core, 3, poller));
+    EXPECT_FALSE(queue.zeroCopyHeld());
+    std::vector<sockets::SharedBuffer> completed;
+    queue.takeCompleted(completed);
+    EXPECT_EQ(1u, completed.size());
+}
+
+TEST(SendQueue, msg_zerocopy_loopback)
+{
+    sockets::SocketCore core;
+    FakePoller poller;
+    int listenFd = ::socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GE(listenFd, 0);
+    struct sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(0, ::bind(listenFd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)));
+    ASSERT_EQ(0, ::listen(listenFd, 1));
+    socklen_t len = sizeof(addr);
+    ASSERT_EQ(0, ::getsockname(listenFd, reinterpret_cast<struct sockaddr *>(&addr), &len));
+    int sender = ::socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_EQ(0, ::connect(sender, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)));
+    int receiver = ::accept(listenFd, nullptr, nullptr);
+    ASSERT_GE(receiver, 0);
+
+    sockets::SocketOpt options;
+    options.m_zeroCopySend = true;
+    options.m_eventBackend = sockets::EventBackend::Epoll;
+    if (!sockets::enableMsgZeroCopy(core, sender, options)) {
+        ::close(receiver);
+        ::close(sender);
+        ::close(listenFd);
+        GTEST_SKIP() << "SO_ZEROCOPY unavailable: errno " << errno;
+    }
+    sockets::SendQueue queue;
+    queue.useMsgZeroCopy();
+    constexpr size_t SIZE = 32768;
+    sockets::SharedBuffer big = sockets::SharedBuffer::copyOf(std::vector<char>(SIZE, 'z').data(), SIZE);
+    queue.append(big, 0, true);
+    EXPECT_EQ(static_cast<ssize_t>(SIZE), queue.flush(core, sender, poller));
+    EXPECT_TRUE(queue.zeroCopyHeld());
+
+    // The notification makes the socket report an error
+    struct pollfd pfd { sender, 0, 0 };
+    ASSERT_EQ(1, ::poll(&pfd, 1, 1000));
+    EXPECT_NE(0, pfd.revents & POLLERR);
+    EXPECT_TRUE(queue.readNotifications(core, sender));
+    EXPECT_FALSE(queue.zeroCopyHeld());
+    std::vector<sockets::SharedBuffer> completed;
+    queue.takeCompleted(completed);
+    EXPECT_EQ(1u, completed.size());
+
+    std::vector<char> data(SIZE);
+    size_t received = 0;
+    while (received < SIZE) {
+        ssize_t got = ::recv(receiver, data.data() + received, SIZE - received, 0);
+        ASSERT_GT(got, 0);
+        received += static_cast<size_t>(got);
+    }
+    EXPECT_EQ(std::vector<char>(SIZE, 'z'), data);
+    ::close(receiver);
+    ::close(sender);
+    ::close(listenFd);
+}
+
+#endif
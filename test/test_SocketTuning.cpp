@@ -0,0 +1,130 @@
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "MockSocketCore.h"
+#include "SocketTuning.h"
+
+using ::testing::_;
+using ::testing::Invoke;
+using ::testing::Return;
+
+namespace {
+
+/**
+ * @brief GetSockOpt action reporting double the requested buffer sizes, as Linux does, and 1 for other options
+ */
+int fakeGetSockOpt(int, int level, int optname, void *optval, socklen_t *) {
+    int value = 1;
+    if (level == SOL_SOCKET && optname == SO_SNDBUF) {
+        value = 2 * 256 * 1024;
+    } else if (level == SOL_SOCKET && optname == SO_RCVBUF) {
+        value = 2 * 256 * 1024;
+    }
+    *static_cast<int *>(optval) = value;
+    return 0;
+}
+
+}  // namespace
+
+TEST(SocketTuning, profile_values)
+{
+    sockets::SocketOpt opts;
+    opts.m_listenAddr = "127.0.0.1";
+
+    sockets::applyProfile(opts, sockets::TuningProfile::LowLatency);
+    EXPECT_TRUE(opts.m_noDelay);
+    EXPECT_TRUE(opts.m_quickAck);
+    EXPECT_GT(opts.m_notSentLowat, 0);
+    EXPECT_GT(opts.m_busyPollUsecs, 0);
+    EXPECT_FALSE(opts.m_keepAlive);
+    EXPECT_EQ("127.0.0.1", opts.m_listenAddr);
+
+    sockets::applyProfile(opts, sockets::TuningProfile::Throughput);
+    EXPECT_FALSE(opts.m_noDelay);
+    EXPECT_FALSE(opts.m_quickAck);
+    EXPECT_EQ(0, opts.m_busyPollUsecs);
+    EXPECT_GT(opts.m_rxBufSize, sockets::SocketOpt().m_rxBufSize);
+    EXPECT_GT(opts.m_txBufSize, sockets::SocketOpt().m_txBufSize);
+
+    sockets::applyProfile(opts, sockets::TuningProfile::ManyIdle);
+    EXPECT_TRUE(opts.m_keepAlive);
+    EXPECT_GT(opts.m_keepIdleSecs, 0);
+    EXPECT_EQ(SOMAXCONN, opts.m_listenBacklog);
+
+    sockets::applyProfile(opts, sockets::TuningProfile::Default);
+    EXPECT_FALSE(opts.m_keepAlive);
+    EXPECT_EQ(sockets::LISTEN_BACKLOG, opts.m_listenBacklog);
+    EXPECT_EQ(sockets::SocketOpt().m_rxBufSize, opts.m_rxBufSize);
+}
+
+TEST(SocketTuning, default_options_untouched)
+{
+    MockSocketCore core;
+    sockets::SocketOpt opts;
+
+    EXPECT_CALL(core, SetSockOpt(_,_,_,_,_)).Times(0);
+    sockets::applyTuning(core, 4, opts, true);
+    sockets::rearmQuickAck(core, 4, opts);
+}
+
+TEST(SocketTuning, low_latency_tcp_options)
+{
+    MockSocketCore core;
+    sockets::SocketOpt opts;
+    sockets::applyProfile(opts, sockets::TuningProfile::LowLatency);
+
+    EXPECT_CALL(core, SetSockOpt(4,IPPROTO_TCP,TCP_NODELAY,_,_)).WillOnce(Return(0));
+#if defined(TCP_QUICKACK)
+    EXPECT_CALL(core, SetSockOpt(4,IPPROTO_TCP,TCP_QUICKACK,_,_)).Times(2).WillRepeatedly(Return(0));
+#endif
+#if defined(TCP_NOTSENT_LOWAT)
+    EXPECT_CALL(core, SetSockOpt(4,IPPROTO_TCP,TCP_NOTSENT_LOWAT,_,_)).WillOnce(Return(0));
+#endif
+#if defined(SO_BUSY_POLL)
+    // Failure without CAP_NET_ADMIN is tolerated
+    EXPECT_CALL(core, SetSockOpt(4,SOL_SOCKET,SO_BUSY_POLL,_,_)).WillOnce(Return(-1));
+#endif
+    sockets::applyTuning(core, 4, opts, true);
+    sockets::rearmQuickAck(core, 4, opts);
+}
+
+TEST(SocketTuning, udp_skips_tcp_options)
+{
+    MockSocketCore core;
+    sockets::SocketOpt opts;
+    sockets::applyProfile(opts, sockets::TuningProfile::LowLatency);
+
+    EXPECT_CALL(core, SetSockOpt(_,IPPROTO_TCP,_,_,_)).Times(0);
+#if defined(SO_BUSY_POLL)
+    EXPECT_CALL(core, SetSockOpt(4,SOL_SOCKET,SO_BUSY_POLL,_,_)).WillOnce(Return(0));
+#endif
+    sockets::applyTuning(core, 4, opts, false);
+}
+
+TEST(SocketTuning, read_back_effective_values)
+{
+    MockSocketCore core;
+    sockets::SocketOpt opts;
+    sockets::applyProfile(opts, sockets::TuningProfile::LowLatency);
+
+    EXPECT_CALL(core, GetSockOpt(4,_,_,_,_)).WillRepeatedly(Invoke(fakeGetSockOpt));
+    sockets::SocketOpt effective = opts;
+    sockets::readTuning(core, 4, true, effective);
+    EXPECT_EQ(2 * opts.m_rxBufSize, effective.m_rxBufSize);
+    EXPECT_EQ(2 * opts.m_txBufSize, effective.m_txBufSize);
+    EXPECT_TRUE(effective.m_noDelay);
+    EXPECT_EQ(opts.m_listenBacklog, effective.m_listenBacklog);
+}
+
+TEST(SocketTuning, read_back_failure_keeps_requested)
+{
+    MockSocketCore core;
+    sockets::SocketOpt opts;
+    sockets::applyProfile(opts, sockets::TuningProfile::ManyIdle);
+
+    EXPECT_CALL(core, GetSockOpt(4,_,_,_,_)).WillRepeatedly(Return(-1));
+    sockets::SocketOpt effective = opts;
+    sockets::readTuning(core, 4, true, effective);
+    EXPECT_EQ(opts.m_rxBufSize, effective.m_rxBufSize);
+    EXPECT_TRUE(effective.m_keepAlive);
+    EXPECT_EQ(opts.m_keepIdleSecs, effective.m_keepIdleSecs);
+}
@@ -0,0 +1,84 @@
+#include "Strand.h"
+#include "ThreadPool.h"
+#include "gtest/gtest.h"
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <vector>
+
+TEST(ThreadPool, tasks_posted_by_tasks_run_before_destruction)
+{
+    std::atomic<int> count { 0 };
+    {
+        sockets::ThreadPool pool(3);
+        for (int idx = 0; idx < 100; idx++) {
+            pool.post([&pool, &count]() {
+                EXPECT_TRUE(pool.inWorker());
+                count++;
+                // Queued on this worker, or stolen by an idle one
+                pool.post([&count]() { count++; });
+            });
+        }
+        EXPECT_FALSE(pool.inWorker());
+    }
+    EXPECT_EQ(200, count.load());
+}
+
+TEST(ThreadPool, no_workers_runs_inline)
+{
+    sockets::ThreadPool pool(0);
+    bool ran = false;
+    pool.post([&ran]() { ran = true; });
+    EXPECT_TRUE(ran);
+}
+
+TEST(Strand, tasks_run_in_order_one_at_a_time)
+{
+    constexpr size_t STRANDS = 4;
+    constexpr size_t TASKS = 1000;
+    std::vector<std::vector<size_t>> order(STRANDS);
+    std::vector<std::atomic<int>> running(STRANDS);
+    std::atomic<bool> overlapped { false };
+    {
+        sockets::ThreadPool pool(4);
+        std::vector<std::shared_ptr<sockets::Strand>> strands;
+        for (size_t idx = 0; idx < STRANDS; idx++) {
+            strands.push_back(std::make_shared<sockets::Strand>(pool));
+        }
+        for (size_t task = 0; task < TASKS; task++) {
+            for (size_t idx = 0; idx < STRANDS; idx++) {
+                strands[idx]->post([&, idx, task]() {
+                    if (running[idx]++ != 0) {
+                        overlapped = true;
+                    }
+                    order[idx].push_back(task);
+                    running[idx]--;
+                });
+            }
+        }
+    }
+    EXPECT_FALSE(overlapped.load());
+    for (size_t idx = 0; idx < STRANDS; idx++) {
+        ASSERT_EQ(TASKS, order[idx].size());
+        for (size_t task = 0; task < TASKS; task++) {
+            EXPECT_EQ(task, order[idx][task]);
+        }
+    }
+}
+
+TEST(Strand, strands_run_in_parallel)
+{
+    sockets::ThreadPool pool(2);
+    auto slow = std::make_shared<sockets::Strand>(pool);
+    auto fast = std::make_shared<sockets::Strand>(pool);
+    std::promise<void> fastRan;
+    std::future<void> fastDone = fastRan.get_future();
+    std::promise<bool> slowRan;
+    std::future<bool> slowDone = slowRan.get_future();
+
+    // A blocked strand doesn't hold up another one
+    slow->post([&]() { slowRan.set_value(fastDone.wait_for(std::chrono::seconds(5)) == std::future_status::ready); });
+    fast->post([&]() { fastRan.set_value(); });
+    EXPECT_TRUE(slowDone.get());
+}
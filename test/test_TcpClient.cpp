@@ -12,6 +12,8 @@ using ::testing::_;
 using ::testing::SetArgPointee;
 using ::testing::SetArrayArgument;
 using ::testing::DoAll;
+using ::testing::IsNull;
+using ::testing::SetErrnoAndReturn;
 
 class TcpClientTestApp {
 public:
@@ -44,6 +46,25 @@ TcpClientTestApp::onReceiveData(const char *data, size_t size) {
     m_receiveData = std::string(data,size);
 }
 
+/**
+ * @brief Callback recipient taking ownership of received data
+ */
+class TcpClientBufferApp {
+public:
+    TcpClientBufferApp(): m_socket(*this)
+    {};
+
+    void onReceiveBuffer(sockets::SharedBuffer buffer) {
+        m_buffer = std::move(buffer);
+    }
+
+    void onDisconnect(const sockets::SocketRet &) {}
+
+    sockets::TcpClient<TcpClientBufferApp,MockSocketCore> m_socket;
+
+    sockets::SharedBuffer m_buffer;
+};
+
 TEST(TcpClientSocket,tcp_socket_fail) 
 {
     TcpClientTestApp app;
@@ -185,7 +206,7 @@ TEST(TcpClientSocket,tcp_send_fail)
     EXPECT_CALL(core, FreeAddrInfo(_));
     EXPECT_CALL(core, Connect(_,_,_)).WillOnce(Return(0));
     EXPECT_CALL(core, Select(_,_,_,_,_)).WillRepeatedly(Return(0));
-    EXPECT_CALL(core, Send(_,_,_,_)).WillOnce(Return(-1));
+    EXPECT_CALL(core, Send(_,_,_,_)).WillOnce(SetErrnoAndReturn(EPIPE,-1));
     EXPECT_CALL(core, Close(_)).WillOnce(Return(0));
     auto ret = app.m_socket.connectTo("localhost",5000);
     EXPECT_EQ(true,ret.m_success);
@@ -213,17 +234,68 @@ TEST(TcpClientSocket,tcp_send_partial)
     EXPECT_CALL(core, GetAddrInfo(_,_, NotNull(),_)).WillOnce(DoAll(SetArgPointee<3>(&res), Return(0)));
     EXPECT_CALL(core, FreeAddrInfo(_));
     EXPECT_CALL(core, Connect(_,_,_)).WillOnce(Return(0));
-    EXPECT_CALL(core, Select(_,_,_,_,_)).WillRepeatedly(Return(0));
-    EXPECT_CALL(core, Send(_,_,_,_)).WillOnce(Return(5));
+    fd_set writeFds;
+    FD_ZERO(&writeFds);
+    FD_SET(4,&writeFds);
+    fd_set noFds;
+    FD_ZERO(&noFds);
+    EXPECT_CALL(core, Select(_,_,IsNull(),_,_)).WillRepeatedly(Return(0));
+    // The unsent remainder is sent once the socket becomes writable
+    EXPECT_CALL(core, Select(_,_,NotNull(),_,_)).WillOnce(DoAll(SetArgPointee<1>(noFds),SetArgPointee<2>(writeFds),Return(1))).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, Send(_,_,12,_)).WillOnce(Return(5));
+    EXPECT_CALL(core, Send(_,_,7,_)).WillOnce(Return(7));
     EXPECT_CALL(core, Close(_)).WillOnce(Return(0));
     auto ret = app.m_socket.connectTo("localhost",5000);
     EXPECT_EQ(true,ret.m_success);
 
     ret = app.m_socket.sendMsg("Message Data",12);
-    EXPECT_EQ(false,ret.m_success);
+    EXPECT_EQ(true,ret.m_success);
+
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    app.m_socket.finish();
+}
+
+TEST(TcpClientSocket,tcp_sendv_partial)
+{
+    TcpClientTestApp app;
+    MockSocketCore &core = app.m_socket.getCore();
+    struct addrinfo res;
+    struct sockaddr theAddr = { 0, 
+#ifdef __APPLE__
+    0,
+#endif   
+    "\000\000\177\000\000\001" };
+    res.ai_addr = &theAddr;
+    EXPECT_CALL(core, Socket(_,_,_)).WillOnce(Return(4));
+    EXPECT_CALL(core, SetSockOpt(_,_,_,_,_)).WillOnce(Return(0)).WillOnce(Return(0));
+    EXPECT_CALL(core, GetAddrInfo(_,_, NotNull(),_)).WillOnce(DoAll(SetArgPointee<3>(&res), Return(0)));
+    EXPECT_CALL(core, FreeAddrInfo(_));
+    EXPECT_CALL(core, Connect(_,_,_)).WillOnce(Return(0));
+    fd_set writeFds;
+    FD_ZERO(&writeFds);
+    FD_SET(4,&writeFds);
+    fd_set noFds;
+    FD_ZERO(&noFds);
+    EXPECT_CALL(core, Select(_,_,IsNull(),_,_)).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, Select(_,_,NotNull(),_,_)).WillOnce(DoAll(SetArgPointee<1>(noFds),SetArgPointee<2>(writeFds),Return(1))).WillRepeatedly(Return(0));
+    // Header and payload go out in one call; the unsent tail of both is gathered and sent once writable
+    EXPECT_CALL(core, SendMsg(4,_,_)).WillOnce(Return(2));
+    std::string remainder;
+    EXPECT_CALL(core, Send(_,_,9,_)).WillOnce([&remainder](int, const void *buf, size_t len, int) {
+        remainder.assign(static_cast<const char *>(buf), len);
+        return ssize_t(len);
+    });
+    EXPECT_CALL(core, Close(_)).WillOnce(Return(0));
+    auto ret = app.m_socket.connectTo("localhost",5000);
+    EXPECT_EQ(true,ret.m_success);
+
+    sockets::MsgPart parts[] = { { "head", 4 }, { "payload", 7 } };
+    ret = app.m_socket.sendMsgv(parts, 2);
+    EXPECT_EQ(true,ret.m_success);
 
     std::this_thread::sleep_for(std::chrono::seconds(1));
     app.m_socket.finish();
+    EXPECT_EQ("adpayload", remainder);
 }
 
 TEST(TcpClientSocket,tcp_send_success)
@@ -278,7 +350,7 @@ TEST(TcpClientSocket,tcp_receive)
     EXPECT_CALL(core, FreeAddrInfo(_));
     EXPECT_CALL(core, Connect(_,_,_)).WillOnce(Return(0));
     EXPECT_CALL(core, Select(_,_,_,_,_)).WillOnce(DoAll(SetArgPointee<1>(fds),Return(1))).WillRepeatedly(Return(0));
-    EXPECT_CALL(core, Recv(_,_,_,_)).WillOnce(DoAll(SetArrayArgument<1>(ptr,ptr+13), Return(13)));
+    EXPECT_CALL(core, RecvMsg(_,_,_)).WillOnce(DoAll(FillMsgBuffers(ptr,13), Return(13)));
     EXPECT_CALL(core, Close(_)).WillOnce(Return(0));
     auto ret = app.m_socket.connectTo("localhost",5000);
     EXPECT_EQ(true,ret.m_success);
@@ -289,9 +361,9 @@ TEST(TcpClientSocket,tcp_receive)
     EXPECT_EQ(app.m_receiveData,"Received Data");
 }
 
-TEST(TcpClientSocket,tcp_server_disconnect)
+TEST(TcpClientSocket,tcp_receive_buffer)
 {
-    TcpClientTestApp app;
+    TcpClientBufferApp app;
     MockSocketCore &core = app.m_socket.getCore();
     struct addrinfo res;
     struct sockaddr theAddr = { 0, 
@@ -312,7 +384,42 @@ TEST(TcpClientSocket,tcp_server_disconnect)
     EXPECT_CALL(core, FreeAddrInfo(_));
     EXPECT_CALL(core, Connect(_,_,_)).WillOnce(Return(0));
     EXPECT_CALL(core, Select(_,_,_,_,_)).WillOnce(DoAll(SetArgPointee<1>(fds),Return(1))).WillRepeatedly(Return(0));
-    EXPECT_CALL(core, Recv(_,_,_,_)).WillOnce(DoAll(SetArrayArgument<1>(ptr,ptr+13), Return(0)));
+    EXPECT_CALL(core, RecvMsg(_,_,_)).WillOnce(DoAll(FillMsgBuffers(ptr,13), Return(13)));
+    EXPECT_CALL(core, Close(_)).WillOnce(Return(0));
+    auto ret = app.m_socket.connectTo("localhost",5000);
+    EXPECT_EQ(true,ret.m_success);
+
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+    app.m_socket.finish();
+
+    // The handle refers to the pooled receive buffer, shared with the receive chain until its next receive
+    EXPECT_EQ(std::string("Received Data"), std::string(app.m_buffer.data(), app.m_buffer.size()));
+    EXPECT_EQ(2L, app.m_buffer.useCount());
+    EXPECT_EQ(0u, app.m_socket.getReceivePoolStats().m_misses);
+}
+
+TEST(TcpClientSocket,tcp_server_disconnect)
+{
+    TcpClientTestApp app;
+    MockSocketCore &core = app.m_socket.getCore();
+    struct addrinfo res;
+    struct sockaddr theAddr = { 0, 
+#ifdef __APPLE__
+    0,
+#endif
+    "\000\000\177\000\000\001" };
+    res.ai_addr = &theAddr;
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(4,&fds);
+
+    EXPECT_CALL(core, Socket(_,_,_)).WillOnce(Return(4));
+    EXPECT_CALL(core, SetSockOpt(_,_,_,_,_)).WillOnce(Return(0)).WillOnce(Return(0));
+    EXPECT_CALL(core, GetAddrInfo(_,_, NotNull(),_)).WillOnce(DoAll(SetArgPointee<3>(&res), Return(0)));
+    EXPECT_CALL(core, FreeAddrInfo(_));
+    EXPECT_CALL(core, Connect(_,_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Select(_,_,_,_,_)).WillOnce(DoAll(SetArgPointee<1>(fds),Return(1))).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, RecvMsg(_,_,_)).WillOnce(Return(0));
     EXPECT_CALL(core, Close(_)).WillOnce(Return(0));
     auto ret = app.m_socket.connectTo("localhost",5000);
     EXPECT_EQ(true,ret.m_success);
@@ -3,8 +3,15 @@
 #define TEST_CORE_ACCESS
 #include "TcpServer.h"
 #include "MockSocketCore.h"
+#include <algorithm>
+#include <atomic>
+#include <future>
 #include <map>
+#include <mutex>
+#include <string>
+#include <vector>
 #include <thread>
+#include <tuple>
 
 using ::testing::AtLeast;
 using ::testing::Return;
@@ -13,6 +20,10 @@ using ::testing::_;
 using ::testing::SetArgPointee;
 using ::testing::SetArrayArgument;
 using ::testing::DoAll;
+using ::testing::IsNull;
+using ::testing::SetErrnoAndReturn;
+using ::testing::InvokeWithoutArgs;
+using ::testing::Invoke;
 
 class TcpServerTestApp {
 public:
@@ -30,12 +41,24 @@ public:
 
     void onClientDisconnect(const sockets::ClientHandle &client, const sockets::SocketRet &ret);
 
+    void onBackPressure(const sockets::ClientHandle &client, size_t queued);
+
+    void onWritable(const sockets::ClientHandle &client);
+
+    void onAcceptRejected(const std::string &ipAddr, uint16_t port, sockets::AdmissionReject reason);
+
     sockets::TcpServer<TcpServerTestApp,MockSocketCore> m_socket;
 
     std::map<sockets::ClientHandle, std::string> m_receiveData;
 
     std::set<sockets::ClientHandle> m_clients;
 
+    std::map<sockets::ClientHandle, size_t> m_backPressure;
+
+    std::set<sockets::ClientHandle> m_writable;
+
+    std::vector<sockets::AdmissionReject> m_rejected;
+
 };
 
 void TcpServerTestApp::onClientConnect(const sockets::ClientHandle &client) {
@@ -50,6 +73,133 @@ void TcpServerTestApp::onClientDisconnect(const sockets::ClientHandle &client, c
     m_clients.erase(client);
 }
 
+void TcpServerTestApp::onBackPressure(const sockets::ClientHandle &client, size_t queued) {
+    m_backPressure[client] = queued;
+}
+
+void TcpServerTestApp::onWritable(const sockets::ClientHandle &client) {
+    m_writable.insert(client);
+}
+
+void TcpServerTestApp::onAcceptRejected(const std::string &ipAddr, uint16_t, sockets::AdmissionReject reason) {
+    EXPECT_EQ("127.0.0.1", ipAddr);
+    m_rejected.push_back(reason);
+}
+
+/**
+ * @brief Callback recipient taking ownership of received data
+ */
+class TcpServerBufferApp {
+public:
+    TcpServerBufferApp(): m_socket(*this)
+    {}
+
+    void onClientConnect(const sockets::ClientHandle &) {}
+
+    void onReceiveClientBuffer(const sockets::ClientHandle &client, sockets::SharedBuffer buffer) {
+        m_buffers[client].push_back(std::move(buffer));
+    }
+
+    void onClientDisconnect(const sockets::ClientHandle &, const sockets::SocketRet &) {}
+
+    sockets::TcpServer<TcpServerBufferApp,MockSocketCore> m_socket;
+
+    std::map<sockets::ClientHandle, std::vector<sockets::SharedBuffer>> m_buffers;
+};
+
+/**
+ * @brief Callback recipient recording the callbacks run by the worker pool
+ */
+class TcpServerStrandApp {
+public:
+    TcpServerStrandApp(sockets::SocketOpt *opts): m_socket(*this,opts)
+    {}
+
+    void onClientConnect(const sockets::ClientHandle &) {
+        record("connect");
+    }
+
+    void onReceiveClientData(const sockets::ClientHandle &, const char *data, size_t size) {
+        // A slow handler mustn't hold up the event loop, nor see its data overwritten by the next receive
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        record(std::string(data,size));
+    }
+
+    void onClientDisconnect(const sockets::ClientHandle &, const sockets::SocketRet &) {
+        record("disconnect");
+    }
+
+    void record(const std::string &event) {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_events.push_back(event);
+    }
+
+    sockets::TcpServer<TcpServerStrandApp,MockSocketCore> m_socket;
+
+    std::mutex m_mutex;
+
+    std::vector<std::string> m_events;
+};
+
+/**
+ * @brief Callback recipient whose receive callbacks block until released, backing up the connection's strand
+ */
+class TcpServerBlockedApp {
+public:
+    TcpServerBlockedApp(sockets::SocketOpt *opts): m_released(m_release.get_future()), m_socket(*this,opts)
+    {}
+
+    void onClientConnect(const sockets::ClientHandle &) {}
+
+    void onReceiveClientData(const sockets::ClientHandle &, const char *, size_t) {
+        m_released.wait();
+    }
+
+    void onClientDisconnect(const sockets::ClientHandle &, const sockets::SocketRet &) {}
+
+    std::promise<void> m_release;
+
+    std::shared_future<void> m_released;
+
+    sockets::TcpServer<TcpServerBlockedApp,MockSocketCore> m_socket;
+};
+
+/**
+ * @brief Tracing hooks recording each tracing point
+ */
+struct TraceRecorder {
+    static void onTrace(sockets::TraceEvent event, SOCKET fd, int64_t size, std::chrono::steady_clock::time_point) {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_events.push_back(std::make_tuple(event, fd, size));
+    }
+
+    static std::mutex m_mutex;
+
+    static std::vector<std::tuple<sockets::TraceEvent, SOCKET, int64_t>> m_events;
+};
+
+std::mutex TraceRecorder::m_mutex;
+
+std::vector<std::tuple<sockets::TraceEvent, SOCKET, int64_t>> TraceRecorder::m_events;
+
+/**
+ * @brief Callback recipient of a server traced by TraceRecorder
+ */
+class TcpServerTraceApp {
+public:
+    TcpServerTraceApp(): m_socket(*this)
+    {}
+
+    void onClientConnect(const sockets::ClientHandle &) {}
+
+    void onReceiveClientData(const sockets::ClientHandle &, const char *, size_t) {}
+
+    void onClientDisconnect(const sockets::ClientHandle &, const sockets::SocketRet &) {}
+
+    sockets::TcpServer<TcpServerTraceApp,MockSocketCore,sockets::RawFraming,
+                       sockets::HookTracing<TraceRecorder>> m_socket;
+};
+
 TEST(TcpServerSocket,start_socket_fail)
 {
     TcpServerTestApp app;
@@ -141,6 +291,97 @@ TEST(TcpServerSocket,start_success)
     app.m_socket.finish();
 }
 
+TEST(TcpServerSocket,start_tuning_profile)
+{
+    sockets::SocketOpt opts;
+    sockets::applyProfile(opts, sockets::TuningProfile::LowLatency);
+    TcpServerTestApp app(&opts);
+    MockSocketCore &core = app.m_socket.getCore();
+
+    EXPECT_CALL(core, Socket(_,_,_)).WillOnce(Return(4));
+    EXPECT_CALL(core, SetSockOpt(_,_,_,_,_)).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, SetSockOpt(4,IPPROTO_TCP,TCP_NODELAY,_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, GetSockOpt(4,_,_,_,_)).WillRepeatedly(::testing::Invoke(
+        [](int, int level, int optname, void *optval, socklen_t *) {
+            *static_cast<int *>(optval) = (level == SOL_SOCKET && optname == SO_RCVBUF) ? 4096 : 1;
+            return 0;
+        }));
+    EXPECT_CALL(core, Bind(_,_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Listen(4,opts.m_listenBacklog)).WillOnce(Return(0));
+    EXPECT_CALL(core, Select(_,_,_,_,_)).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, Close(_)).WillOnce(Return(0));
+    auto ret = app.m_socket.start(5000);
+    EXPECT_EQ(true,ret.m_success);
+
+    sockets::SocketOpt effective = app.m_socket.getEffectiveOptions();
+    EXPECT_EQ(4096,effective.m_rxBufSize);
+    EXPECT_TRUE(effective.m_noDelay);
+    EXPECT_EQ(opts.m_listenBacklog,effective.m_listenBacklog);
+    app.m_socket.finish();
+}
+
+TEST(TcpServerSocket,start_multiple_threads)
+{
+    sockets::SocketOpt opts;
+    opts.m_serverThreads = 2;
+    TcpServerTestApp app(&opts);
+    MockSocketCore &core = app.m_socket.getCore();
+
+    EXPECT_CALL(core, Socket(_,_,_)).WillOnce(Return(4)).WillOnce(Return(5));
+    EXPECT_CALL(core, SetSockOpt(_,SOL_SOCKET,SO_REUSEPORT,_,_)).Times(2).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, SetSockOpt(_,SOL_SOCKET,::testing::Ne(SO_REUSEPORT),_,_)).Times(6).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, Bind(_,_,_)).Times(2).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, Listen(_,_)).Times(2).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, Select(_,_,_,_,_)).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, Close(4)).WillOnce(Return(0));
+    EXPECT_CALL(core, Close(5)).WillOnce(Return(0));
+    auto ret = app.m_socket.start(5000);
+    EXPECT_EQ(true,ret.m_success);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    app.m_socket.finish();
+}
+
+TEST(TcpServerSocket,start_multiple_threads_reuseport_fail)
+{
+    sockets::SocketOpt opts;
+    opts.m_serverThreads = 2;
+    TcpServerTestApp app(&opts);
+    MockSocketCore &core = app.m_socket.getCore();
+
+    EXPECT_CALL(core, Socket(_,_,_)).WillOnce(Return(4));
+    EXPECT_CALL(core, SetSockOpt(_,_,_,_,_)).WillOnce(Return(0)).WillOnce(Return(-1));
+    EXPECT_CALL(core, Close(4)).WillOnce(Return(0));
+    auto ret = app.m_socket.start(5000);
+    EXPECT_EQ(false,ret.m_success);
+}
+
+TEST(TcpServerSocket,start_multiple_threads_bind_fail)
+{
+    sockets::SocketOpt opts;
+    opts.m_serverThreads = 2;
+    TcpServerTestApp app(&opts);
+    MockSocketCore &core = app.m_socket.getCore();
+    std::vector<int> closed;
+
+    EXPECT_CALL(core, Socket(_,_,_)).WillOnce(Return(4)).WillOnce(Return(5));
+    EXPECT_CALL(core, SetSockOpt(_,_,_,_,_)).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, Bind(_,_,_)).WillOnce(Return(0)).WillOnce(Return(-1));
+    EXPECT_CALL(core, Listen(_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Close(_)).WillRepeatedly(Invoke([&closed](int fd) {
+        closed.push_back(fd);
+        return 0;
+    }));
+    auto ret = app.m_socket.start(5000);
+    EXPECT_EQ(false,ret.m_success);
+
+    // The listener already created for the first loop is closed as well as the failed one
+    std::sort(closed.begin(), closed.end());
+    EXPECT_EQ(std::vector<int>({ 4, 5 }), closed);
+    app.m_socket.finish();
+    EXPECT_EQ(2u, closed.size());
+}
+
 TEST(TcpServerSocket,client_connect_send)
 {
     TcpServerTestApp app;
@@ -160,8 +401,8 @@ TEST(TcpServerSocket,client_connect_send)
     EXPECT_CALL(core, Bind(_,_,_)).WillOnce(Return(0));
     EXPECT_CALL(core, Listen(_,_)).WillOnce(Return(0));
     EXPECT_CALL(core, Select(_,_,_,_,_)).WillOnce(DoAll(SetArgPointee<1>(fds),Return(1))).WillRepeatedly(Return(0));
-    EXPECT_CALL(core, Accept(_,_,_)).WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(5)));
-    EXPECT_CALL(core, Send(_,_,_,_)).WillOnce(Return(-1)).WillOnce(Return(5)).WillOnce(Return(12));
+    EXPECT_CALL(core, AcceptNonBlocking(_,_,_)).WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(5))).WillRepeatedly(SetErrnoAndReturn(EAGAIN,-1));
+    EXPECT_CALL(core, Send(_,_,_,_)).WillOnce(SetErrnoAndReturn(EPIPE,-1)).WillOnce(Return(5));
 
     EXPECT_CALL(core, Close(_)).WillRepeatedly(Return(0));
     auto ret = app.m_socket.start(5000);
@@ -176,14 +417,20 @@ TEST(TcpServerSocket,client_connect_send)
     ret = app.m_socket.sendClientMessage(badHandle,"Message Data",12);
     EXPECT_EQ(false,ret.m_success);
 
+    // Handle for a different connection generation on the same descriptor
+    sockets::ClientHandle staleHandle = (int64_t(1) << 32) | 5;
+    ret = app.m_socket.sendClientMessage(staleHandle,"Message Data",12);
+    EXPECT_EQ(false,ret.m_success);
+
     // Good Client handle, send() fails
     ret = app.m_socket.sendClientMessage(goodHandle,"Message Data",12);
     EXPECT_EQ(false,ret.m_success);
 
-    // Good client handle, partial send()
+    // Good client handle, partial send() queues the remainder
     ret = app.m_socket.sendClientMessage(goodHandle,"Message Data",12);
-    EXPECT_EQ(false,ret.m_success);
+    EXPECT_EQ(true,ret.m_success);
 
+    // Queued behind the remainder without calling send()
     ret = app.m_socket.sendClientMessage(goodHandle,"Message Data",12);
     EXPECT_EQ(true,ret.m_success);   
 
@@ -194,7 +441,7 @@ TEST(TcpServerSocket,client_connect_send)
     EXPECT_EQ(true,(app.m_clients.find(5) != app.m_clients.end()));
 }
 
-TEST(TcpServerSocket,client_connect_receive_disconnect)
+TEST(TcpServerSocket,accept_burst_single_wakeup)
 {
     TcpServerTestApp app;
     MockSocketCore &core = app.m_socket.getCore();
@@ -202,32 +449,1003 @@ TEST(TcpServerSocket,client_connect_receive_disconnect)
 #ifdef __APPLE__
     0,
 #endif
-   "\000\000\177\000\000\001" };
+    "\000\000\177\000\000\001" };
+    struct sockaddr *ptr = &client_addr;
+    struct sockaddr *endPtr = ptr + 1;
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(4,&fds);
+    EXPECT_CALL(core, Socket(_,_,_)).WillOnce(Return(4));
+    EXPECT_CALL(core, SetSockOpt(_,_,_,_,_)).WillOnce(Return(0)).WillOnce(Return(0)).WillOnce(Return(0));
+    EXPECT_CALL(core, Bind(_,_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Listen(4,sockets::LISTEN_BACKLOG)).WillOnce(Return(0));
+    // The listening socket is only reported readable once
+    EXPECT_CALL(core, Select(_,_,_,_,_)).WillOnce(DoAll(SetArgPointee<1>(fds),Return(1))).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, AcceptNonBlocking(4,_,_))
+        .WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(5)))
+        .WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(6)))
+        .WillOnce(SetErrnoAndReturn(ECONNABORTED,-1))
+        .WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(7)))
+        .WillOnce(SetErrnoAndReturn(EAGAIN,-1));
+    EXPECT_CALL(core, Close(_)).WillRepeatedly(Return(0));
+    auto ret = app.m_socket.start(5000);
+    EXPECT_EQ(true,ret.m_success);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    EXPECT_EQ(3u,app.m_clients.size());
+    app.m_socket.finish();
+}
+
+TEST(TcpServerSocket,accept_batch_limit)
+{
+    sockets::SocketOpt opts;
+    opts.m_acceptBatch = 2;
+    TcpServerTestApp app(&opts);
+    MockSocketCore &core = app.m_socket.getCore();
+    struct sockaddr client_addr = { 0, 
+#ifdef __APPLE__
+    0,
+#endif
+    "\000\000\177\000\000\001" };
+    struct sockaddr *ptr = &client_addr;
+    struct sockaddr *endPtr = ptr + 1;
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(4,&fds);
+    EXPECT_CALL(core, Socket(_,_,_)).WillOnce(Return(4));
+    EXPECT_CALL(core, SetSockOpt(_,_,_,_,_)).WillOnce(Return(0)).WillOnce(Return(0)).WillOnce(Return(0));
+    EXPECT_CALL(core, Bind(_,_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Listen(_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Select(_,_,_,_,_)).WillOnce(DoAll(SetArgPointee<1>(fds),Return(1))).WillOnce(DoAll(SetArgPointee<1>(fds),Return(1))).WillRepeatedly(Return(0));
+    // Two connections on the first pass, the third on the next
+    EXPECT_CALL(core, AcceptNonBlocking(4,_,_))
+        .WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(5)))
+        .WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(6)))
+        .WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(7)))
+        .WillOnce(SetErrnoAndReturn(EAGAIN,-1));
+    EXPECT_CALL(core, Close(_)).WillRepeatedly(Return(0));
+    auto ret = app.m_socket.start(5000);
+    EXPECT_EQ(true,ret.m_success);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    EXPECT_EQ(3u,app.m_clients.size());
+    app.m_socket.finish();
+}
+
+TEST(TcpServerSocket,client_send_queued_until_writable)
+{
+    TcpServerTestApp app;
+    MockSocketCore &core = app.m_socket.getCore();
+    struct sockaddr client_addr = { 0, 
+#ifdef __APPLE__
+    0,
+#endif
+    "\000\000\177\000\000\001" };
     struct sockaddr *ptr = &client_addr;
     struct sockaddr *endPtr = ptr + 1;
     fd_set acceptFds;
     FD_ZERO(&acceptFds);
     FD_SET(4,&acceptFds);
-    fd_set recvFds;
-    FD_ZERO(&recvFds);
-    FD_SET(5,&recvFds);
-    char receiveData[] = { "Received Data" };
-    char *dataPtr = receiveData;
+    fd_set writeFds;
+    FD_ZERO(&writeFds);
+    FD_SET(5,&writeFds);
+    fd_set noFds;
+    FD_ZERO(&noFds);
     EXPECT_CALL(core, Socket(_,_,_)).WillOnce(Return(4));
     EXPECT_CALL(core, SetSockOpt(_,_,_,_,_)).WillOnce(Return(0)).WillOnce(Return(0)).WillOnce(Return(0));
     EXPECT_CALL(core, Bind(_,_,_)).WillOnce(Return(0));
     EXPECT_CALL(core, Listen(_,_)).WillOnce(Return(0));
-    EXPECT_CALL(core, Select(_,_,_,_,_)).WillOnce(DoAll(SetArgPointee<1>(acceptFds),Return(1))).WillOnce(DoAll(SetArgPointee<1>(recvFds),Return(1))).WillOnce(DoAll(SetArgPointee<1>(recvFds),Return(1))).WillRepeatedly(Return(0));
-    EXPECT_CALL(core, Accept(_,_,_)).WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(5)));
-    EXPECT_CALL(core, Recv(_,_,_,_)).WillOnce(DoAll(SetArrayArgument<1>(dataPtr,dataPtr+13), Return(13))).WillOnce(DoAll(SetArrayArgument<1>(dataPtr,dataPtr+13), Return(0)));
+    EXPECT_CALL(core, Select(_,_,IsNull(),_,_)).WillOnce(DoAll(SetArgPointee<1>(acceptFds),Return(1))).WillRepeatedly(Return(0));
+    // Once data is queued the client socket is monitored for writability
+    EXPECT_CALL(core, Select(_,_,NotNull(),_,_)).WillOnce(DoAll(SetArgPointee<1>(noFds),SetArgPointee<2>(writeFds),Return(1))).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, AcceptNonBlocking(_,_,_)).WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(5))).WillRepeatedly(SetErrnoAndReturn(EAGAIN,-1));
+    EXPECT_CALL(core, Send(5,_,12,_)).WillOnce(SetErrnoAndReturn(EAGAIN,-1)).WillOnce(Return(12)).WillOnce(Return(12));
     EXPECT_CALL(core, Close(_)).WillRepeatedly(Return(0));
     auto ret = app.m_socket.start(5000);
     EXPECT_EQ(true,ret.m_success);
 
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // Socket buffer full, so both messages are queued
+    sockets::ClientHandle handle = 5;
+    ret = app.m_socket.sendClientMessage(handle,"Message Data",12);
+    EXPECT_EQ(true,ret.m_success);
+    ret = app.m_socket.sendClientMessage(handle,"Message Data",12);
+    EXPECT_EQ(true,ret.m_success);
+
     std::this_thread::sleep_for(std::chrono::seconds(1));
 
+    // One send would block, then the event loop flushes both queued messages
+    sockets::SocketMetrics client;
+    EXPECT_TRUE(app.m_socket.getClientMetrics(handle,client));
+    EXPECT_EQ(2u,client[sockets::Counter::MessagesOut]);
+    EXPECT_EQ(3u,client[sockets::Counter::SendCalls]);
+    EXPECT_EQ(1u,client[sockets::Counter::SendWouldBlock]);
+    EXPECT_EQ(24u,client[sockets::Counter::BytesOut]);
+    EXPECT_EQ(0u,client[sockets::Counter::QueuedBytes]);
+    EXPECT_EQ(0u,client.m_sendLatency.count());
+    sockets::SocketMetrics total = app.m_socket.getMetrics();
+    EXPECT_EQ(24u,total[sockets::Counter::BytesOut]);
+    EXPECT_EQ(2u,total.m_sendLatency.count());
+    EXPECT_FALSE(app.m_socket.getClientMetrics(6,client));
+
     app.m_socket.finish();
+}
 
-    EXPECT_EQ(app.m_receiveData[5],"Received Data");
-    EXPECT_EQ(true,(app.m_clients.find(5) == app.m_clients.end()));
-}
\ No newline at end of file
+TEST(TcpServerSocket,client_sendv_one_call)
+{
+    TcpServerTestApp app;
+    MockSocketCore &core = app.m_socket.getCore();
+    struct sockaddr client_addr = { 0, 
+#ifdef __APPLE__
+    0,
+#endif
+    "\000\000\177\000\000\001" };
+    struct sockaddr *ptr = &client_addr;
+    struct sockaddr *endPtr = ptr + 1;
+    fd_set acceptFds;
+    FD_ZERO(&acceptFds);
+    FD_SET(4,&acceptFds);
+    EXPECT_CALL(core, Socket(_,_,_)).WillOnce(Return(4));
+    EXPECT_CALL(core, SetSockOpt(_,_,_,_,_)).WillOnce(Return(0)).WillOnce(Return(0)).WillOnce(Return(0));
+    EXPECT_CALL(core, Bind(_,_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Listen(_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Select(_,_,_,_,_)).WillOnce(DoAll(SetArgPointee<1>(acceptFds),Return(1))).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, AcceptNonBlocking(_,_,_)).WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(5))).WillRepeatedly(SetErrnoAndReturn(EAGAIN,-1));
+    // The unicast and the broadcast each go out with one sendmsg()
+    EXPECT_CALL(core, SendMsg(5,_,_)).Times(2).WillRepeatedly([](int, const struct msghdr *msg, int) {
+        EXPECT_EQ(2u, msg->msg_iovlen);
+        return ssize_t(msg->msg_iov[0].iov_len + msg->msg_iov[1].iov_len);
+    });
+    EXPECT_CALL(core, Close(_)).WillRepeatedly(Return(0));
+    auto ret = app.m_socket.start(5000);
+    EXPECT_EQ(true,ret.m_success);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    sockets::ClientHandle handle = 5;
+    sockets::MsgPart parts[] = { { "head", 4 }, { "payload", 7 } };
+    ret = app.m_socket.sendClientMessagev(handle, parts, 2);
+    EXPECT_EQ(true,ret.m_success);
+    ret = app.m_socket.sendBcastv(parts, 2);
+    EXPECT_EQ(true,ret.m_success);
+    ret = app.m_socket.sendClientMessagev(handle, parts, sockets::MAX_MSG_PARTS + 1);
+    EXPECT_EQ(false,ret.m_success);
+
+    app.m_socket.finish();
+}
+
+TEST(TcpServerSocket,bcast_shares_queued_buffer)
+{
+    sockets::SocketOpt opts;
+    opts.m_bcastThreads = 2;
+    opts.m_bcastParallelMin = 1;
+    TcpServerTestApp app(&opts);
+    MockSocketCore &core = app.m_socket.getCore();
+    struct sockaddr client_addr = { 0, 
+#ifdef __APPLE__
+    0,
+#endif
+    "\000\000\177\000\000\001" };
+    struct sockaddr *ptr = &client_addr;
+    struct sockaddr *endPtr = ptr + 1;
+    fd_set acceptFds;
+    FD_ZERO(&acceptFds);
+    FD_SET(4,&acceptFds);
+    EXPECT_CALL(core, Socket(_,_,_)).WillOnce(Return(4));
+    EXPECT_CALL(core, SetSockOpt(_,_,_,_,_)).WillOnce(Return(0)).WillOnce(Return(0)).WillOnce(Return(0));
+    EXPECT_CALL(core, Bind(_,_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Listen(_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Select(_,_,_,_,_)).WillOnce(DoAll(SetArgPointee<1>(acceptFds),Return(1))).WillOnce(DoAll(SetArgPointee<1>(acceptFds),Return(1))).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, AcceptNonBlocking(_,_,_)).WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(5))).WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(6))).WillRepeatedly(SetErrnoAndReturn(EAGAIN,-1));
+    // Neither client can take the whole message
+    EXPECT_CALL(core, Send(5,_,12,_)).WillOnce(SetErrnoAndReturn(EAGAIN,-1));
+    EXPECT_CALL(core, Send(6,_,12,_)).WillOnce(Return(4));
+    EXPECT_CALL(core, Close(_)).WillRepeatedly(Return(0));
+    auto ret = app.m_socket.start(5000);
+    EXPECT_EQ(true,ret.m_success);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    sockets::SharedBuffer buffer = sockets::SharedBuffer::copyOf("Message Data",12);
+    ret = app.m_socket.sendBcast(buffer);
+    EXPECT_EQ(true,ret.m_success);
+
+    // Both send queues refer to the caller's buffer rather than copies of it
+    EXPECT_EQ(3,buffer.useCount());
+
+    app.m_socket.finish();
+
+    EXPECT_EQ(1,buffer.useCount());
+}
+
+TEST(TcpServerSocket,client_send_back_pressure)
+{
+    sockets::SocketOpt opts;
+    opts.m_sendHighWatermark = 10;
+    opts.m_sendLowWatermark = 0;
+    opts.m_sendQueueLimit = 20;
+    TcpServerTestApp app(&opts);
+    MockSocketCore &core = app.m_socket.getCore();
+    struct sockaddr client_addr = { 0, 
+#ifdef __APPLE__
+    0,
+#endif
+    "\000\000\177\000\000\001" };
+    struct sockaddr *ptr = &client_addr;
+    struct sockaddr *endPtr = ptr + 1;
+    fd_set acceptFds;
+    FD_ZERO(&acceptFds);
+    FD_SET(4,&acceptFds);
+    fd_set writeFds;
+    FD_ZERO(&writeFds);
+    FD_SET(5,&writeFds);
+    fd_set noFds;
+    FD_ZERO(&noFds);
+    EXPECT_CALL(core, Socket(_,_,_)).WillOnce(Return(4));
+    EXPECT_CALL(core, SetSockOpt(_,_,_,_,_)).WillOnce(Return(0)).WillOnce(Return(0)).WillOnce(Return(0));
+    EXPECT_CALL(core, Bind(_,_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Listen(_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Select(_,_,IsNull(),_,_)).WillOnce(DoAll(SetArgPointee<1>(acceptFds),Return(1))).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, Select(_,_,NotNull(),_,_)).WillOnce(Return(0)).WillOnce(DoAll(SetArgPointee<1>(noFds),SetArgPointee<2>(writeFds),Return(1))).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, AcceptNonBlocking(_,_,_)).WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(5))).WillRepeatedly(SetErrnoAndReturn(EAGAIN,-1));
+    EXPECT_CALL(core, Send(5,_,12,_)).WillOnce(SetErrnoAndReturn(EAGAIN,-1)).WillOnce(Return(12));
+    EXPECT_CALL(core, Close(_)).WillRepeatedly(Return(0));
+    auto ret = app.m_socket.start(5000);
+    EXPECT_EQ(true,ret.m_success);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    // Queued message crosses the high watermark
+    sockets::ClientHandle handle = 5;
+    ret = app.m_socket.sendClientMessage(handle,"Message Data",12);
+    EXPECT_EQ(true,ret.m_success);
+    EXPECT_EQ(12u,app.m_backPressure[5]);
+
+    // Queue limit reached
+    ret = app.m_socket.sendClientMessage(handle,"Message Data",12);
+    EXPECT_EQ(false,ret.m_success);
+
+    EXPECT_EQ(true,app.m_socket.pauseReceive(handle));
+    EXPECT_EQ(true,app.m_socket.resumeReceive(handle));
+    EXPECT_EQ(false,app.m_socket.pauseReceive(3));
+
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+
+    // Queue drained by the event loop
+    EXPECT_EQ(1u,app.m_writable.count(5));
+
+    app.m_socket.finish();
+}
+
+TEST(TcpServerSocket,client_connect_receive_disconnect)
+{
+    TcpServerTestApp app;
+    MockSocketCore &core = app.m_socket.getCore();
+    struct sockaddr client_addr = { 0, 
+#ifdef __APPLE__
+    0,
+#endif
+   "\000\000\177\000\000\001" };
+    struct sockaddr *ptr = &client_addr;
+    struct sockaddr *endPtr = ptr + 1;
+    fd_set acceptFds;
+    FD_ZERO(&acceptFds);
+    FD_SET(4,&acceptFds);
+    fd_set recvFds;
+    FD_ZERO(&recvFds);
+    FD_SET(5,&recvFds);
+    char receiveData[] = { "Received Data" };
+    char *dataPtr = receiveData;
+    EXPECT_CALL(core, Socket(_,_,_)).WillOnce(Return(4));
+    EXPECT_CALL(core, SetSockOpt(_,_,_,_,_)).WillOnce(Return(0)).WillOnce(Return(0)).WillOnce(Return(0));
+    EXPECT_CALL(core, Bind(_,_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Listen(_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Select(_,_,_,_,_)).WillOnce(DoAll(SetArgPointee<1>(acceptFds),Return(1))).WillOnce(DoAll(SetArgPointee<1>(recvFds),Return(1))).WillOnce(DoAll(SetArgPointee<1>(recvFds),Return(1))).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, AcceptNonBlocking(_,_,_)).WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(5))).WillRepeatedly(SetErrnoAndReturn(EAGAIN,-1));
+    EXPECT_CALL(core, RecvMsg(_,_,_)).WillOnce(DoAll(FillMsgBuffers(dataPtr,13), Return(13))).WillOnce(Return(0));
+    EXPECT_CALL(core, Close(_)).WillRepeatedly(Return(0));
+    auto ret = app.m_socket.start(5000);
+    EXPECT_EQ(true,ret.m_success);
+
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+
+    app.m_socket.finish();
+
+    EXPECT_EQ(app.m_receiveData[5],"Received Data");
+    EXPECT_EQ(true,(app.m_clients.find(5) == app.m_clients.end()));
+
+    sockets::SocketMetrics metrics = app.m_socket.getMetrics();
+    EXPECT_EQ(13u,metrics[sockets::Counter::BytesIn]);
+    EXPECT_EQ(1u,metrics[sockets::Counter::MessagesIn]);
+    EXPECT_EQ(2u,metrics[sockets::Counter::RecvCalls]);
+    EXPECT_EQ(1u,metrics[sockets::Counter::DisconnectPeer]);
+    EXPECT_EQ(0u,metrics[sockets::Counter::DisconnectLocal]);
+    EXPECT_LT(0u,metrics[sockets::Counter::PollWaits]);
+    // Connect, receive and disconnect callbacks
+    EXPECT_EQ(3u,metrics.m_callbackTime.count());
+}
+
+TEST(TcpServerSocket,tracing_hooks)
+{
+    TcpServerTraceApp app;
+    MockSocketCore &core = app.m_socket.getCore();
+    struct sockaddr client_addr = { 0, 
+#ifdef __APPLE__
+    0,
+#endif
+   "\000\000\177\000\000\001" };
+    struct sockaddr *ptr = &client_addr;
+    struct sockaddr *endPtr = ptr + 1;
+    fd_set acceptFds;
+    FD_ZERO(&acceptFds);
+    FD_SET(4,&acceptFds);
+    fd_set recvFds;
+    FD_ZERO(&recvFds);
+    FD_SET(5,&recvFds);
+    char receiveData[] = { "Received Data" };
+    char *dataPtr = receiveData;
+    EXPECT_CALL(core, Socket(_,_,_)).WillOnce(Return(4));
+    EXPECT_CALL(core, SetSockOpt(_,_,_,_,_)).WillOnce(Return(0)).WillOnce(Return(0)).WillOnce(Return(0));
+    EXPECT_CALL(core, Bind(_,_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Listen(_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Select(_,_,_,_,_)).WillOnce(DoAll(SetArgPointee<1>(acceptFds),Return(1))).WillOnce(DoAll(SetArgPointee<1>(recvFds),Return(1))).WillOnce(DoAll(SetArgPointee<1>(recvFds),Return(1))).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, AcceptNonBlocking(_,_,_)).WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(5))).WillRepeatedly(SetErrnoAndReturn(EAGAIN,-1));
+    EXPECT_CALL(core, RecvMsg(_,_,_)).WillOnce(DoAll(FillMsgBuffers(dataPtr,13), Return(13))).WillOnce(Return(0));
+    EXPECT_CALL(core, Close(_)).WillRepeatedly(Return(0));
+    TraceRecorder::m_events.clear();
+    auto ret = app.m_socket.start(5000);
+    EXPECT_EQ(true,ret.m_success);
+
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+
+    app.m_socket.finish();
+
+    using sockets::TraceEvent;
+    std::vector<std::tuple<TraceEvent, SOCKET, int64_t>> expected = {
+        std::make_tuple(TraceEvent::Accept, 5, 0),
+        std::make_tuple(TraceEvent::CallbackBegin, 5, 0),  // onClientConnect
+        std::make_tuple(TraceEvent::CallbackEnd, 5, 0),
+        std::make_tuple(TraceEvent::Receive, 5, 13),
+        std::make_tuple(TraceEvent::CallbackBegin, 5, 13),  // onReceiveClientData
+        std::make_tuple(TraceEvent::CallbackEnd, 5, 13),
+        std::make_tuple(TraceEvent::Receive, 5, 0),
+        std::make_tuple(TraceEvent::CallbackBegin, 5, 0),  // onClientDisconnect
+        std::make_tuple(TraceEvent::CallbackEnd, 5, 0)
+    };
+    std::lock_guard<std::mutex> guard(TraceRecorder::m_mutex);
+    EXPECT_EQ(expected, TraceRecorder::m_events);
+}
+
+TEST(TcpServerSocket,client_receive_buffer_ownership)
+{
+    TcpServerBufferApp app;
+    MockSocketCore &core = app.m_socket.getCore();
+    struct sockaddr client_addr = { 0, 
+#ifdef __APPLE__
+    0,
+#endif
+   "\000\000\177\000\000\001" };
+    struct sockaddr *ptr = &client_addr;
+    struct sockaddr *endPtr = ptr + 1;
+    fd_set acceptFds;
+    FD_ZERO(&acceptFds);
+    FD_SET(4,&acceptFds);
+    fd_set recvFds;
+    FD_ZERO(&recvFds);
+    FD_SET(5,&recvFds);
+    char first[] = { "First chunk" };
+    char second[] = { "Second chunk" };
+    EXPECT_CALL(core, Socket(_,_,_)).WillOnce(Return(4));
+    EXPECT_CALL(core, SetSockOpt(_,_,_,_,_)).WillOnce(Return(0)).WillOnce(Return(0)).WillOnce(Return(0));
+    EXPECT_CALL(core, Bind(_,_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Listen(_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Select(_,_,_,_,_)).WillOnce(DoAll(SetArgPointee<1>(acceptFds),Return(1))).WillOnce(DoAll(SetArgPointee<1>(recvFds),Return(1))).WillOnce(DoAll(SetArgPointee<1>(recvFds),Return(1))).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, AcceptNonBlocking(_,_,_)).WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(5))).WillRepeatedly(SetErrnoAndReturn(EAGAIN,-1));
+    EXPECT_CALL(core, RecvMsg(_,_,_)).WillOnce(DoAll(FillMsgBuffers(first,11), Return(11))).WillOnce(DoAll(FillMsgBuffers(second,12), Return(12)));
+    EXPECT_CALL(core, Close(_)).WillRepeatedly(Return(0));
+    auto ret = app.m_socket.start(5000);
+    EXPECT_EQ(true,ret.m_success);
+
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+
+    // The second receive mustn't overwrite the buffer held by the application
+    sockets::BufferPoolStats stats = app.m_socket.getReceivePoolStats();
+    EXPECT_EQ(0u, stats.m_misses);
+    app.m_socket.finish();
+
+    ASSERT_EQ(2u, app.m_buffers[5].size());
+    EXPECT_NE(app.m_buffers[5][0].data(), app.m_buffers[5][1].data());
+    EXPECT_EQ(std::string("First chunk"), std::string(app.m_buffers[5][0].data(), app.m_buffers[5][0].size()));
+    EXPECT_EQ(std::string("Second chunk"), std::string(app.m_buffers[5][1].data(), app.m_buffers[5][1].size()));
+}
+
+TEST(TcpServerSocket,client_callbacks_on_worker_strand)
+{
+    sockets::SocketOpt opts;
+    opts.m_callbackThreads = 2;
+    TcpServerStrandApp app(&opts);
+    MockSocketCore &core = app.m_socket.getCore();
+    struct sockaddr client_addr = { 0, 
+#ifdef __APPLE__
+    0,
+#endif
+   "\000\000\177\000\000\001" };
+    struct sockaddr *ptr = &client_addr;
+    struct sockaddr *endPtr = ptr + 1;
+    fd_set acceptFds;
+    FD_ZERO(&acceptFds);
+    FD_SET(4,&acceptFds);
+    fd_set recvFds;
+    FD_ZERO(&recvFds);
+    FD_SET(5,&recvFds);
+    char first[] = { "First chunk" };
+    char second[] = { "Second chunk" };
+    EXPECT_CALL(core, Socket(_,_,_)).WillOnce(Return(4));
+    EXPECT_CALL(core, SetSockOpt(_,_,_,_,_)).WillOnce(Return(0)).WillOnce(Return(0)).WillOnce(Return(0));
+    EXPECT_CALL(core, Bind(_,_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Listen(_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Select(_,_,_,_,_)).WillOnce(DoAll(SetArgPointee<1>(acceptFds),Return(1))).WillOnce(DoAll(SetArgPointee<1>(recvFds),Return(1))).WillOnce(DoAll(SetArgPointee<1>(recvFds),Return(1))).WillOnce(DoAll(SetArgPointee<1>(recvFds),Return(1))).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, AcceptNonBlocking(_,_,_)).WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(5))).WillRepeatedly(SetErrnoAndReturn(EAGAIN,-1));
+    EXPECT_CALL(core, RecvMsg(_,_,_)).WillOnce(DoAll(FillMsgBuffers(first,11), Return(11))).WillOnce(DoAll(FillMsgBuffers(second,12), Return(12))).WillOnce(Return(0));
+    EXPECT_CALL(core, Close(_)).WillRepeatedly(Return(0));
+    auto ret = app.m_socket.start(5000);
+    EXPECT_EQ(true,ret.m_success);
+
+    // finish() runs the callbacks still queued on the strand
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    app.m_socket.finish();
+
+    std::vector<std::string> expected { "connect", "First chunk", "Second chunk", "disconnect" };
+    EXPECT_EQ(expected, app.m_events);
+}
+
+TEST(TcpServerSocket,idle_client_timed_out)
+{
+    sockets::SocketOpt opts;
+    opts.m_idleTimeoutMs = 300;
+    TcpServerTestApp app(&opts);
+    MockSocketCore &core = app.m_socket.getCore();
+    struct sockaddr client_addr = { 0, 
+#ifdef __APPLE__
+    0,
+#endif
+   "\000\000\177\000\000\001" };
+    struct sockaddr *ptr = &client_addr;
+    struct sockaddr *endPtr = ptr + 1;
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(4,&fds);
+    EXPECT_CALL(core, Socket(_,_,_)).WillOnce(Return(4));
+    EXPECT_CALL(core, SetSockOpt(_,_,_,_,_)).WillOnce(Return(0)).WillOnce(Return(0)).WillOnce(Return(0));
+    EXPECT_CALL(core, Bind(_,_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Listen(_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Select(_,_,_,_,_)).WillOnce(DoAll(SetArgPointee<1>(fds),Return(1))).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, AcceptNonBlocking(_,_,_)).WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(5))).WillRepeatedly(SetErrnoAndReturn(EAGAIN,-1));
+    EXPECT_CALL(core, Close(_)).WillRepeatedly(Return(0));
+    auto ret = app.m_socket.start(5000);
+    EXPECT_EQ(true,ret.m_success);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    sockets::ClientHandle handle = 5;
+    EXPECT_EQ(1U,app.m_clients.count(handle));
+    std::atomic<int> fired { 0 };
+    sockets::TimerId deadline = app.m_socket.scheduleTimer(handle, std::chrono::milliseconds(20), [&fired]() { fired++; });
+    EXPECT_NE(sockets::INVALID_TIMER,deadline);
+    sockets::TimerId cancelled = app.m_socket.scheduleTimer(handle, std::chrono::milliseconds(100), [&fired]() { fired += 100; });
+    EXPECT_TRUE(app.m_socket.cancelTimer(cancelled));
+
+    // Nothing received, so the connection is closed once the timeout expires
+    std::this_thread::sleep_for(std::chrono::milliseconds(700));
+    EXPECT_EQ(1,fired.load());
+    EXPECT_EQ(0U,app.m_clients.count(handle));
+    ret = app.m_socket.sendClientMessage(handle,"Message Data",12);
+    EXPECT_EQ(false,ret.m_success);
+    EXPECT_EQ(sockets::INVALID_TIMER,app.m_socket.scheduleTimer(handle, std::chrono::milliseconds(20), []() {}));
+
+    app.m_socket.finish();
+}
+
+TEST(TcpServerSocket,max_connections_rejects_excess)
+{
+    sockets::SocketOpt opts;
+    opts.m_maxConnections = 1;
+    TcpServerTestApp app(&opts);
+    MockSocketCore &core = app.m_socket.getCore();
+    struct sockaddr client_addr = { 0, 
+#ifdef __APPLE__
+    0,
+#endif
+   "\000\000\177\000\000\001" };
+    struct sockaddr *ptr = &client_addr;
+    struct sockaddr *endPtr = ptr + 1;
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(4,&fds);
+    EXPECT_CALL(core, Socket(_,_,_)).WillOnce(Return(4));
+    EXPECT_CALL(core, SetSockOpt(_,_,_,_,_)).WillOnce(Return(0)).WillOnce(Return(0)).WillOnce(Return(0));
+    // The rejected connection is reset
+    EXPECT_CALL(core, SetSockOpt(6,SOL_SOCKET,SO_LINGER,_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Bind(_,_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Listen(_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Select(_,_,_,_,_)).WillOnce(DoAll(SetArgPointee<1>(fds),Return(1))).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, AcceptNonBlocking(_,_,_))
+        .WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(5)))
+        .WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(6)))
+        .WillRepeatedly(SetErrnoAndReturn(EAGAIN,-1));
+    EXPECT_CALL(core, Close(_)).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, Close(6)).WillOnce(Return(0));
+    auto ret = app.m_socket.start(5000);
+    EXPECT_EQ(true,ret.m_success);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    app.m_socket.finish();
+
+    EXPECT_EQ(1U,app.m_clients.count(5));
+    EXPECT_EQ(0U,app.m_clients.count(6));
+    std::vector<sockets::AdmissionReject> expected { sockets::AdmissionReject::MaxConnections };
+    EXPECT_EQ(expected,app.m_rejected);
+    sockets::AdmissionStats stats = app.m_socket.getAdmissionStats();
+    EXPECT_EQ(1U,stats.m_admitted);
+    EXPECT_EQ(1U,stats.m_rejectedMax);
+    EXPECT_EQ(0U,stats.m_rejectedRate);
+    EXPECT_EQ(0U,stats.m_rejectedOverload);
+}
+
+TEST(TcpServerSocket,accept_rate_limit)
+{
+    sockets::SocketOpt opts;
+    opts.m_acceptRate = 1.0;
+    opts.m_acceptBurst = 1;
+    TcpServerTestApp app(&opts);
+    MockSocketCore &core = app.m_socket.getCore();
+    struct sockaddr client_addr = { 0, 
+#ifdef __APPLE__
+    0,
+#endif
+   "\000\000\177\000\000\001" };
+    struct sockaddr *ptr = &client_addr;
+    struct sockaddr *endPtr = ptr + 1;
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(4,&fds);
+    EXPECT_CALL(core, Socket(_,_,_)).WillOnce(Return(4));
+    EXPECT_CALL(core, SetSockOpt(_,_,_,_,_)).WillOnce(Return(0)).WillOnce(Return(0)).WillOnce(Return(0));
+    // The rejected connection is reset
+    EXPECT_CALL(core, SetSockOpt(6,SOL_SOCKET,SO_LINGER,_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Bind(_,_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Listen(_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Select(_,_,_,_,_)).WillOnce(DoAll(SetArgPointee<1>(fds),Return(1))).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, AcceptNonBlocking(_,_,_))
+        .WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(5)))
+        .WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(6)))
+        .WillRepeatedly(SetErrnoAndReturn(EAGAIN,-1));
+    EXPECT_CALL(core, Close(_)).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, Close(6)).WillOnce(Return(0));
+    auto ret = app.m_socket.start(5000);
+    EXPECT_EQ(true,ret.m_success);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    app.m_socket.finish();
+
+    EXPECT_EQ(1U,app.m_clients.count(5));
+    EXPECT_EQ(0U,app.m_clients.count(6));
+    std::vector<sockets::AdmissionReject> expected { sockets::AdmissionReject::RateLimit };
+    EXPECT_EQ(expected,app.m_rejected);
+    sockets::AdmissionStats stats = app.m_socket.getAdmissionStats();
+    EXPECT_EQ(1U,stats.m_admitted);
+    EXPECT_EQ(0U,stats.m_rejectedMax);
+    EXPECT_EQ(1U,stats.m_rejectedRate);
+    EXPECT_EQ(0U,stats.m_rejectedOverload);
+}
+
+TEST(TcpServerSocket,post_runs_on_event_loop)
+{
+    TcpServerTestApp app;
+    MockSocketCore &core = app.m_socket.getCore();
+    struct sockaddr client_addr = { 0, 
+#ifdef __APPLE__
+    0,
+#endif
+   "\000\000\177\000\000\001" };
+    struct sockaddr *ptr = &client_addr;
+    struct sockaddr *endPtr = ptr + 1;
+    fd_set fds;
+    FD_ZERO(&fds);
+    FD_SET(4,&fds);
+    EXPECT_CALL(core, Socket(_,_,_)).WillOnce(Return(4));
+    EXPECT_CALL(core, SetSockOpt(_,_,_,_,_)).WillOnce(Return(0)).WillOnce(Return(0)).WillOnce(Return(0));
+    EXPECT_CALL(core, Bind(_,_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Listen(_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Select(_,_,_,_,_)).WillOnce(DoAll(SetArgPointee<1>(fds),Return(1))).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, AcceptNonBlocking(_,_,_)).WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(5))).WillRepeatedly(SetErrnoAndReturn(EAGAIN,-1));
+    EXPECT_CALL(core, Close(_)).WillRepeatedly(Return(0));
+
+    // Not running yet
+    EXPECT_FALSE(app.m_socket.post([]() {}));
+    auto ret = app.m_socket.start(5000);
+    EXPECT_EQ(true,ret.m_success);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::promise<std::thread::id> loopTask;
+    std::promise<std::thread::id> clientTask;
+    sockets::ClientHandle handle = 5;
+    sockets::ClientHandle badHandle = 3;
+    EXPECT_TRUE(app.m_socket.post([&loopTask]() { loopTask.set_value(std::this_thread::get_id()); }));
+    EXPECT_TRUE(app.m_socket.post(handle, [&clientTask]() { clientTask.set_value(std::this_thread::get_id()); }));
+    EXPECT_FALSE(app.m_socket.post(badHandle, []() {}));
+    auto loopDone = loopTask.get_future();
+    auto clientDone = clientTask.get_future();
+    ASSERT_EQ(std::future_status::ready, loopDone.wait_for(std::chrono::seconds(5)));
+    ASSERT_EQ(std::future_status::ready, clientDone.wait_for(std::chrono::seconds(5)));
+    EXPECT_NE(std::this_thread::get_id(), loopDone.get());
+    EXPECT_NE(std::this_thread::get_id(), clientDone.get());
+
+    app.m_socket.finish();
+}
+
+#if defined(__linux__)
+TEST(TcpServerSocket,epoll_client_connect_receive_disconnect)
+{
+    sockets::SocketOpt opts;
+    opts.m_eventBackend = sockets::EventBackend::Epoll;
+    TcpServerTestApp app(&opts);
+    MockSocketCore &core = app.m_socket.getCore();
+    struct sockaddr client_addr = { 0,
+   "\000\000\177\000\000\001" };
+    struct sockaddr *ptr = &client_addr;
+    struct sockaddr *endPtr = ptr + 1;
+    struct epoll_event acceptEvent {};
+    acceptEvent.events = EPOLLIN;
+    acceptEvent.data.fd = 4;
+    struct epoll_event recvEvent {};
+    recvEvent.events = EPOLLIN;
+    recvEvent.data.fd = 5;
+    char receiveData[] = { "Received Data" };
+    char *dataPtr = receiveData;
+    EXPECT_CALL(core, Socket(_,_,_)).WillOnce(Return(4));
+    EXPECT_CALL(core, SetSockOpt(_,_,_,_,_)).WillOnce(Return(0)).WillOnce(Return(0)).WillOnce(Return(0));
+    EXPECT_CALL(core, Bind(_,_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Listen(_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, EpollCreate()).WillOnce(Return(10));
+    EXPECT_CALL(core, EpollCtl(10,EPOLL_CTL_ADD,4,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, EpollCtl(10,EPOLL_CTL_ADD,5,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, EpollCtl(10,EPOLL_CTL_DEL,5,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, EpollWait(10,_,_,_))
+        .WillOnce(DoAll(SetArrayArgument<1>(&acceptEvent,&acceptEvent+1),Return(1)))
+        .WillOnce(DoAll(SetArrayArgument<1>(&recvEvent,&recvEvent+1),Return(1)))
+        .WillOnce(DoAll(SetArrayArgument<1>(&recvEvent,&recvEvent+1),Return(1)))
+        .WillRepeatedly(Return(0));
+    EXPECT_CALL(core, AcceptNonBlocking(_,_,_)).WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(5))).WillRepeatedly(SetErrnoAndReturn(EAGAIN,-1));
+    EXPECT_CALL(core, RecvMsg(5,_,_)).WillOnce(DoAll(FillMsgBuffers(dataPtr,13), Return(13))).WillOnce(Return(0));
+    EXPECT_CALL(core, Close(_)).WillRepeatedly(Return(0));
+    auto ret = app.m_socket.start(5000);
+    EXPECT_EQ(true,ret.m_success);
+
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+
+    app.m_socket.finish();
+
+    EXPECT_EQ(app.m_receiveData[5],"Received Data");
+    EXPECT_EQ(true,(app.m_clients.find(5) == app.m_clients.end()));
+}
+
+TEST(TcpServerSocket,acceptor_least_connections)
+{
+    sockets::SocketOpt opts;
+    opts.m_eventBackend = sockets::EventBackend::Epoll;
+    opts.m_serverThreads = 2;
+    opts.m_acceptMode = sockets::AcceptMode::Acceptor;
+    TcpServerTestApp app(&opts);
+    MockSocketCore &core = app.m_socket.getCore();
+    struct sockaddr client_addr = { 0,
+   "\000\000\177\000\000\001" };
+    struct sockaddr *ptr = &client_addr;
+    struct sockaddr *endPtr = ptr + 1;
+    struct epoll_event acceptEvent {};
+    acceptEvent.events = EPOLLIN;
+    acceptEvent.data.fd = 4;
+    EXPECT_CALL(core, Socket(_,_,_)).WillOnce(Return(4));
+    EXPECT_CALL(core, SetSockOpt(_,_,_,_,_)).WillOnce(Return(0)).WillOnce(Return(0)).WillOnce(Return(0));
+    EXPECT_CALL(core, Bind(_,_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Listen(_,_)).WillOnce(Return(0));
+    // Worker loops are created before the acceptor loop
+    EXPECT_CALL(core, EpollCreate()).WillOnce(Return(10)).WillOnce(Return(11)).WillOnce(Return(12));
+    EXPECT_CALL(core, EpollCtl(12,EPOLL_CTL_ADD,4,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, EpollCtl(10,EPOLL_CTL_ADD,5,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, EpollCtl(11,EPOLL_CTL_ADD,6,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, EpollCtl(10,EPOLL_CTL_ADD,7,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, EpollWait(12,_,_,_))
+        .WillOnce(DoAll(SetArrayArgument<1>(&acceptEvent,&acceptEvent+1),Return(1)))
+        .WillOnce(DoAll(SetArrayArgument<1>(&acceptEvent,&acceptEvent+1),Return(1)))
+        .WillOnce(DoAll(SetArrayArgument<1>(&acceptEvent,&acceptEvent+1),Return(1)))
+        .WillRepeatedly(Return(0));
+    EXPECT_CALL(core, EpollWait(10,_,_,_)).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, EpollWait(11,_,_,_)).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, AcceptNonBlocking(4,_,_))
+        .WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(5)))
+        .WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(6)))
+        .WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(7))).WillRepeatedly(SetErrnoAndReturn(EAGAIN,-1));
+    EXPECT_CALL(core, Close(_)).WillRepeatedly(Return(0));
+    auto ret = app.m_socket.start(5000);
+    EXPECT_EQ(true,ret.m_success);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    auto counts = app.m_socket.getLoopConnectionCounts();
+    ASSERT_EQ(2u, counts.size());
+    EXPECT_EQ(2u, counts[0]);
+    EXPECT_EQ(1u, counts[1]);
+
+    app.m_socket.finish();
+}
+
+TEST(TcpServerSocket,acceptor_least_bytes)
+{
+    sockets::SocketOpt opts;
+    opts.m_eventBackend = sockets::EventBackend::Epoll;
+    opts.m_serverThreads = 2;
+    opts.m_acceptMode = sockets::AcceptMode::Acceptor;
+    opts.m_loadBalance = sockets::LoadBalance::LeastBytes;
+    TcpServerTestApp app(&opts);
+    MockSocketCore &core = app.m_socket.getCore();
+    struct sockaddr client_addr = { 0,
+   "\000\000\177\000\000\001" };
+    struct sockaddr *ptr = &client_addr;
+    struct sockaddr *endPtr = ptr + 1;
+    struct epoll_event acceptEvent {};
+    acceptEvent.events = EPOLLIN;
+    acceptEvent.data.fd = 4;
+    struct epoll_event recvEvent {};
+    recvEvent.events = EPOLLIN;
+    recvEvent.data.fd = 5;
+    char receiveData[] = { "Received Data" };
+    char *dataPtr = receiveData;
+    auto pause = [](int millis) {
+        return [millis]() { std::this_thread::sleep_for(std::chrono::milliseconds(millis)); };
+    };
+    EXPECT_CALL(core, Socket(_,_,_)).WillOnce(Return(4));
+    EXPECT_CALL(core, SetSockOpt(_,_,_,_,_)).WillOnce(Return(0)).WillOnce(Return(0)).WillOnce(Return(0));
+    EXPECT_CALL(core, Bind(_,_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Listen(_,_)).WillOnce(Return(0));
+    // Worker loops are created before the acceptor loop
+    EXPECT_CALL(core, EpollCreate()).WillOnce(Return(10)).WillOnce(Return(11)).WillOnce(Return(12));
+    EXPECT_CALL(core, EpollCtl(_,_,_,_)).WillRepeatedly(Return(0));
+    // One connection, then a burst of four once the first one's traffic has been sampled
+    EXPECT_CALL(core, EpollWait(12,_,_,_))
+        .WillOnce(DoAll(SetArrayArgument<1>(&acceptEvent,&acceptEvent+1),Return(1)))
+        .WillOnce(DoAll(InvokeWithoutArgs(pause(200)),SetArrayArgument<1>(&acceptEvent,&acceptEvent+1),Return(1)))
+        .WillRepeatedly(Return(0));
+    EXPECT_CALL(core, EpollWait(10,_,_,_))
+        .WillOnce(DoAll(InvokeWithoutArgs(pause(50)),SetArrayArgument<1>(&recvEvent,&recvEvent+1),Return(1)))
+        .WillRepeatedly(Return(0));
+    EXPECT_CALL(core, EpollWait(11,_,_,_)).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, AcceptNonBlocking(4,_,_))
+        .WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(5)))
+        .WillOnce(SetErrnoAndReturn(EAGAIN,-1))
+        .WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(6)))
+        .WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(7)))
+        .WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(8)))
+        .WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(9)))
+        .WillRepeatedly(SetErrnoAndReturn(EAGAIN,-1));
+    EXPECT_CALL(core, RecvMsg(5,_,_)).WillOnce(DoAll(FillMsgBuffers(dataPtr,13), Return(13)));
+    EXPECT_CALL(core, Close(_)).WillRepeatedly(Return(0));
+    auto ret = app.m_socket.start(5000);
+    EXPECT_EQ(true,ret.m_success);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(400));
+
+    // The burst isn't all handed to the idle loop: each connection handed to a loop counts as the busy
+    // connection's rate until the next sample
+    auto counts = app.m_socket.getLoopConnectionCounts();
+    ASSERT_EQ(2u, counts.size());
+    EXPECT_EQ(3u, counts[0]);
+    EXPECT_EQ(2u, counts[1]);
+
+    app.m_socket.finish();
+}
+
+TEST(TcpServerSocket,acceptor_handoff_registers_on_worker)
+{
+    sockets::SocketOpt opts;
+    opts.m_eventBackend = sockets::EventBackend::Epoll;
+    opts.m_serverThreads = 1;
+    opts.m_acceptMode = sockets::AcceptMode::Acceptor;
+    TcpServerTestApp app(&opts);
+    MockSocketCore &core = app.m_socket.getCore();
+    struct sockaddr client_addr = { 0,
+   "\000\000\177\000\000\001" };
+    struct sockaddr *ptr = &client_addr;
+    struct sockaddr *endPtr = ptr + 1;
+    struct epoll_event acceptEvent {};
+    acceptEvent.events = EPOLLIN;
+    acceptEvent.data.fd = 4;
+    char receiveData[] = { "Received Data" };
+    char *dataPtr = receiveData;
+    std::atomic_bool added(false);
+    std::atomic_bool delivered(false);
+    EXPECT_CALL(core, Socket(_,_,_)).WillOnce(Return(4));
+    EXPECT_CALL(core, SetSockOpt(_,_,_,_,_)).WillOnce(Return(0)).WillOnce(Return(0)).WillOnce(Return(0));
+    EXPECT_CALL(core, Bind(_,_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Listen(_,_)).WillOnce(Return(0));
+    // Worker loop is created before the acceptor loop
+    EXPECT_CALL(core, EpollCreate()).WillOnce(Return(10)).WillOnce(Return(11));
+    EXPECT_CALL(core, EpollCtl(11,EPOLL_CTL_ADD,4,_)).WillOnce(Return(0));
+    // Monitoring starts a while before the rest of the registration is done
+    EXPECT_CALL(core, EpollCtl(10,EPOLL_CTL_ADD,5,_)).WillOnce(InvokeWithoutArgs([&added]() {
+        added = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        return 0;
+    }));
+    EXPECT_CALL(core, EpollWait(11,_,_,_))
+        .WillOnce(DoAll(SetArrayArgument<1>(&acceptEvent,&acceptEvent+1),Return(1)))
+        .WillRepeatedly(Return(0));
+    // The worker reports data on the first wait once the connection is monitored
+    EXPECT_CALL(core, EpollWait(10,_,_,_))
+        .WillRepeatedly(Invoke([&added, &delivered](int, struct epoll_event *events, int, int) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            if (!added.load() || delivered.exchange(true)) {
+                return 0;
+            }
+            events[0].events = EPOLLIN;
+            events[0].data.fd = 5;
+            return 1;
+        }));
+    EXPECT_CALL(core, AcceptNonBlocking(4,_,_))
+        .WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(5)))
+        .WillRepeatedly(SetErrnoAndReturn(EAGAIN,-1));
+    EXPECT_CALL(core, RecvMsg(5,_,_)).WillOnce(DoAll(FillMsgBuffers(dataPtr,13), Return(13)));
+    EXPECT_CALL(core, Close(_)).WillRepeatedly(Return(0));
+    auto ret = app.m_socket.start(5000);
+    EXPECT_EQ(true,ret.m_success);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    sockets::ClientHandle handle = 5;
+    EXPECT_EQ(1U,app.m_clients.count(handle));
+    EXPECT_EQ("Received Data",app.m_receiveData[handle]);
+    auto counts = app.m_socket.getLoopConnectionCounts();
+    ASSERT_EQ(1u, counts.size());
+    EXPECT_EQ(1u, counts[0]);
+
+    app.m_socket.finish();
+}
+
+TEST(TcpServerSocket,acceptor_idle_client_timed_out)
+{
+    sockets::SocketOpt opts;
+    opts.m_eventBackend = sockets::EventBackend::Epoll;
+    opts.m_serverThreads = 1;
+    opts.m_acceptMode = sockets::AcceptMode::Acceptor;
+    opts.m_idleTimeoutMs = 300;
+    TcpServerTestApp app(&opts);
+    MockSocketCore &core = app.m_socket.getCore();
+    struct sockaddr client_addr = { 0,
+   "\000\000\177\000\000\001" };
+    struct sockaddr *ptr = &client_addr;
+    struct sockaddr *endPtr = ptr + 1;
+    struct epoll_event acceptEvent {};
+    acceptEvent.events = EPOLLIN;
+    acceptEvent.data.fd = 4;
+    EXPECT_CALL(core, Socket(_,_,_)).WillOnce(Return(4));
+    EXPECT_CALL(core, SetSockOpt(_,_,_,_,_)).WillOnce(Return(0)).WillOnce(Return(0)).WillOnce(Return(0));
+    EXPECT_CALL(core, Bind(_,_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Listen(_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, EpollCreate()).WillOnce(Return(10)).WillOnce(Return(11));
+    EXPECT_CALL(core, EpollCtl(_,_,_,_)).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, EpollWait(11,_,_,_))
+        .WillOnce(DoAll(SetArrayArgument<1>(&acceptEvent,&acceptEvent+1),Return(1)))
+        .WillRepeatedly(Return(0));
+    // The worker only comes back early for its timers, as when blocked in a real wait
+    EXPECT_CALL(core, EpollWait(10,_,_,_))
+        .WillRepeatedly(Invoke([](int, struct epoll_event *, int, int timeout) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(timeout >= 0 ? std::min(timeout, 20) : 20));
+            return 0;
+        }));
+    EXPECT_CALL(core, AcceptNonBlocking(4,_,_))
+        .WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(5)))
+        .WillRepeatedly(SetErrnoAndReturn(EAGAIN,-1));
+    EXPECT_CALL(core, Close(_)).WillRepeatedly(Return(0));
+    auto ret = app.m_socket.start(5000);
+    EXPECT_EQ(true,ret.m_success);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    sockets::ClientHandle handle = 5;
+    EXPECT_EQ(1U,app.m_clients.count(handle));
+
+    // Nothing received, so the worker closes the connection once the timeout expires
+    std::this_thread::sleep_for(std::chrono::milliseconds(700));
+    EXPECT_EQ(0U,app.m_clients.count(handle));
+    auto counts = app.m_socket.getLoopConnectionCounts();
+    ASSERT_EQ(1u, counts.size());
+    EXPECT_EQ(0u, counts[0]);
+
+    app.m_socket.finish();
+}
+
+TEST(TcpServerSocket,strand_backlog_pauses_reads)
+{
+    sockets::SocketOpt opts;
+    opts.m_eventBackend = sockets::EventBackend::Epoll;
+    opts.m_callbackThreads = 1;
+    opts.m_recvHighWatermark = 20;
+    opts.m_recvLowWatermark = 0;
+    TcpServerBlockedApp app(&opts);
+    MockSocketCore &core = app.m_socket.getCore();
+    struct sockaddr client_addr = { 0,
+   "\000\000\177\000\000\001" };
+    struct sockaddr *ptr = &client_addr;
+    struct sockaddr *endPtr = ptr + 1;
+    struct epoll_event acceptEvent {};
+    acceptEvent.events = EPOLLIN;
+    acceptEvent.data.fd = 4;
+    struct epoll_event recvEvent {};
+    recvEvent.events = EPOLLIN;
+    recvEvent.data.fd = 5;
+    char receiveData[] = { "First chunk" };
+    char *dataPtr = receiveData;
+    std::mutex modMutex;
+    std::vector<uint32_t> modified;
+    EXPECT_CALL(core, Socket(_,_,_)).WillOnce(Return(4));
+    EXPECT_CALL(core, SetSockOpt(_,_,_,_,_)).WillOnce(Return(0)).WillOnce(Return(0)).WillOnce(Return(0));
+    EXPECT_CALL(core, Bind(_,_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Listen(_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, EpollCreate()).WillOnce(Return(10));
+    EXPECT_CALL(core, EpollCtl(10,EPOLL_CTL_ADD,_,_)).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, EpollCtl(10,EPOLL_CTL_MOD,5,_))
+        .WillRepeatedly(Invoke([&](int, int, int, struct epoll_event *event) {
+            std::lock_guard<std::mutex> guard(modMutex);
+            modified.push_back(event->events);
+            return 0;
+        }));
+    EXPECT_CALL(core, EpollCtl(10,EPOLL_CTL_DEL,_,_)).WillRepeatedly(Return(0));
+    EXPECT_CALL(core, EpollWait(10,_,_,_))
+        .WillOnce(DoAll(SetArrayArgument<1>(&acceptEvent,&acceptEvent+1),Return(1)))
+        .WillOnce(DoAll(SetArrayArgument<1>(&recvEvent,&recvEvent+1),Return(1)))
+        .WillOnce(DoAll(SetArrayArgument<1>(&recvEvent,&recvEvent+1),Return(1)))
+        .WillRepeatedly(Return(0));
+    EXPECT_CALL(core, AcceptNonBlocking(_,_,_)).WillOnce(DoAll(SetArrayArgument<1>(ptr,endPtr),Return(5))).WillRepeatedly(SetErrnoAndReturn(EAGAIN,-1));
+    EXPECT_CALL(core, RecvMsg(5,_,_))
+        .WillOnce(DoAll(FillMsgBuffers(dataPtr,11), Return(11)))
+        .WillOnce(DoAll(FillMsgBuffers(dataPtr,11), Return(11)));
+    EXPECT_CALL(core, Close(_)).WillRepeatedly(Return(0));
+    auto ret = app.m_socket.start(5000);
+    EXPECT_EQ(true,ret.m_success);
+
+    // The second chunk takes the strand's backlog past the high watermark while the first callback is blocked
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    std::vector<uint32_t> whileBlocked;
+    {
+        std::lock_guard<std::mutex> guard(modMutex);
+        whileBlocked = modified;
+    }
+    app.m_release.set_value();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    app.m_socket.finish();
+
+    ASSERT_EQ(1u, whileBlocked.size());
+    EXPECT_EQ(0u, whileBlocked[0] & EPOLLIN);
+    // Reading resumes once the callbacks have drained the backlog
+    ASSERT_EQ(2u, modified.size());
+    EXPECT_NE(0u, modified[1] & EPOLLIN);
+}
+
+TEST(TcpServerSocket,epoll_create_fail)
+{
+    sockets::SocketOpt opts;
+    opts.m_eventBackend = sockets::EventBackend::Epoll;
+    TcpServerTestApp app(&opts);
+    MockSocketCore &core = app.m_socket.getCore();
+
+    EXPECT_CALL(core, Socket(_,_,_)).WillOnce(Return(4));
+    EXPECT_CALL(core, SetSockOpt(_,_,_,_,_)).WillOnce(Return(0)).WillOnce(Return(0)).WillOnce(Return(0));
+    EXPECT_CALL(core, Bind(_,_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Listen(_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, EpollCreate()).WillOnce(Return(-1));
+    EXPECT_CALL(core, Close(_)).WillOnce(Return(0));
+    auto ret = app.m_socket.start(5000);
+    EXPECT_EQ(false,ret.m_success);
+}
+#endif
@@ -0,0 +1,114 @@
+#include "TimerWheel.h"
+#include "gtest/gtest.h"
+#include <chrono>
+#include <vector>
+
+using std::chrono::milliseconds;
+
+namespace {
+    constexpr milliseconds TICK(10);
+
+    /**
+     * @brief Time point in the middle of a tick of a wheel created just before start
+     */
+    std::chrono::steady_clock::time_point after(std::chrono::steady_clock::time_point start, int ticks) {
+        return start + TICK * ticks + TICK / 2;
+    }
+}
+
+TEST(TimerWheel, fires_after_delay)
+{
+    sockets::TimerWheel wheel(TICK, 8);
+    auto start = std::chrono::steady_clock::now();
+    int fired = 0;
+    EXPECT_TRUE(wheel.empty());
+    sockets::TimerId id = wheel.schedule(milliseconds(25), [&fired]() { fired++; });
+    EXPECT_NE(sockets::INVALID_TIMER, id);
+    EXPECT_FALSE(wheel.empty());
+
+    // Runs on the first tick starting after the due time
+    EXPECT_EQ(0U, wheel.advance(after(start, 2)));
+    EXPECT_EQ(0, fired);
+    EXPECT_EQ(1U, wheel.advance(after(start, 3)));
+    EXPECT_EQ(1, fired);
+    EXPECT_TRUE(wheel.empty());
+    EXPECT_EQ(3U, wheel.now());
+}
+
+TEST(TimerWheel, cancel)
+{
+    sockets::TimerWheel wheel(TICK, 8);
+    auto start = std::chrono::steady_clock::now();
+    int fired = 0;
+    sockets::TimerId id = wheel.schedule(milliseconds(10), [&fired]() { fired++; });
+    EXPECT_TRUE(wheel.cancel(id));
+    EXPECT_FALSE(wheel.cancel(id));
+    EXPECT_TRUE(wheel.empty());
+    EXPECT_EQ(0U, wheel.advance(after(start, 5)));
+    EXPECT_EQ(0, fired);
+
+    // The freed entry is reused, but the old id stays stale
+    sockets::TimerId reused = wheel.schedule(milliseconds(10), [&fired]() { fired++; });
+    EXPECT_NE(id, reused);
+    EXPECT_FALSE(wheel.cancel(id));
+    EXPECT_EQ(1U, wheel.advance(after(start, 6)));
+    EXPECT_EQ(1, fired);
+    EXPECT_FALSE(wheel.cancel(reused));
+}
+
+TEST(TimerWheel, delays_beyond_one_revolution)
+{
+    sockets::TimerWheel wheel(TICK, 8);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<int> order;
+    // Due just after ticks 26, 10 and 2, so all run from slot 3: three, one and zero revolutions out
+    wheel.schedule(TICK * 26, [&order]() { order.push_back(26); });
+    wheel.schedule(TICK * 10, [&order]() { order.push_back(10); });
+    wheel.schedule(TICK * 2, [&order]() { order.push_back(2); });
+
+    EXPECT_EQ(1U, wheel.advance(after(start, 10)));
+    EXPECT_EQ(1U, wheel.advance(after(start, 11)));
+    EXPECT_EQ(0U, wheel.advance(after(start, 26)));
+    EXPECT_EQ(1U, wheel.advance(after(start, 27)));
+    EXPECT_EQ((std::vector<int> { 2, 10, 26 }), order);
+}
+
+TEST(TimerWheel, periodic_until_cancelled)
+{
+    sockets::TimerWheel wheel(TICK, 4);
+    auto start = std::chrono::steady_clock::now();
+    int fired = 0;
+    sockets::TimerId id = wheel.schedule(TICK * 2, [&fired]() { fired++; }, TICK * 3);
+
+    // Runs at ticks 3, 6, 9 and 12
+    EXPECT_EQ(4U, wheel.advance(after(start, 12)));
+    EXPECT_EQ(4, fired);
+    EXPECT_TRUE(wheel.cancel(id));
+    EXPECT_EQ(0U, wheel.advance(after(start, 20)));
+    EXPECT_EQ(4, fired);
+}
+
+TEST(TimerWheel, callbacks_may_schedule_and_cancel)
+{
+    sockets::TimerWheel wheel(TICK, 8);
+    auto start = std::chrono::steady_clock::now();
+    int fired = 0;
+    sockets::TimerId victim = wheel.schedule(TICK * 3, [&fired]() { fired += 100; });
+    wheel.schedule(TICK, [&]() {
+        EXPECT_TRUE(wheel.cancel(victim));
+        wheel.schedule(TICK, [&fired]() { fired++; });
+    });
+    EXPECT_EQ(1U, wheel.advance(after(start, 2)));
+    EXPECT_EQ(1U, wheel.advance(after(start, 5)));
+    EXPECT_EQ(1, fired);
+}
+
+TEST(TimerWheel, ids_carry_the_wheel_tag)
+{
+    sockets::TimerWheel first(TICK, 8, 0);
+    sockets::TimerWheel second(TICK, 8, 3);
+    sockets::TimerId id = second.schedule(TICK, []() {});
+    EXPECT_EQ(3, sockets::TimerWheel::tagOf(id));
+    EXPECT_FALSE(first.cancel(id));
+    EXPECT_TRUE(second.cancel(id));
+}
@@ -394,4 +394,41 @@ TEST(UdpSocket,send_msg)
 
     std::this_thread::sleep_for(std::chrono::seconds(1));
     app.m_socket.finish();
-}
\ No newline at end of file
+}
+TEST(UdpSocket,unicast_sendv_success)
+{
+    UdpTestApp app;
+    MockSocketCore &core = app.m_socket.getCore();
+
+    struct addrinfo res;
+    struct sockaddr theAddr = { 0,
+#ifdef __APPLE__
+    0,
+#endif
+    "\000\000\177\000\000\001" };
+    res.ai_addr = &theAddr;
+    EXPECT_CALL(core, GetAddrInfo(_,_, NotNull(),_)).WillOnce(DoAll(SetArgPointee<3>(&res), Return(0)));
+    EXPECT_CALL(core, FreeAddrInfo(_));
+    EXPECT_CALL(core, Socket(_,_,_)).WillOnce(Return(4));
+    EXPECT_CALL(core, SetSockOpt(_,_,_,_,_)).WillOnce(Return(0)).WillOnce(Return(0)).WillOnce(Return(0));
+    EXPECT_CALL(core, Bind(_,_,_)).WillOnce(Return(0));
+    EXPECT_CALL(core, Close(_)).WillOnce(Return(0));
+    // Both parts go out in one datagram, addressed to the peer
+    EXPECT_CALL(core, SendMsg(4,_,_)).WillOnce([](int, const struct msghdr *msg, int) {
+        EXPECT_EQ(2u, msg->msg_iovlen);
+        EXPECT_NE(nullptr, msg->msg_name);
+        return ssize_t(msg->msg_iov[0].iov_len + msg->msg_iov[1].iov_len);
+    });
+    EXPECT_CALL(core, Select(_,_,_,_,_)).WillRepeatedly(Return(0));
+    auto ret = app.m_socket.startUnicast("localhost",5000,5001);
+    EXPECT_EQ(true,ret.m_success);
+
+    sockets::MsgPart parts[] = { { "head", 4 }, { "payload", 7 } };
+    ret = app.m_socket.sendMsgv(parts, 2);
+    EXPECT_EQ(true,ret.m_success);
+    ret = app.m_socket.sendMsgv(parts, 0);
+    EXPECT_EQ(false,ret.m_success);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    app.m_socket.finish();
+}